@@ -0,0 +1,1307 @@
+/*******************************************************************************
+ * FILENAME: AsyncMatch.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This file checks lines against the rules on worker threads so the
+ *    connection never waits on the rules.  The connection copies each line
+ *    in to a job, a worker runs the rules on it and works out the styles,
+ *    and the connection applies the styles the next time it gets a chance
+ *    (WhippyTerm can only be called from the connection's thread).  See
+ *    AsyncMatch.h for how the job ring works.
+ *
+ *    There is one pool of workers for the whole process (one per core), no
+ *    matter how many connections there are.  Each worker has a queue of
+ *    connections that have jobs waiting.  A worker takes the connection at
+ *    the front of its own queue, checks up to ASYNCMATCH_BATCH_LINES of its
+ *    jobs and puts it on the back of the queue if it still has more, so a
+ *    connection that is flooding only gets its turn like everyone else.
+ *    When a worker's queue is empty it steals from the back of the other
+ *    workers' queues.
+ *
+ *    A connection is only ever on one queue or being checked by one worker
+ *    ('Queued' / 'Running' under 'SchedMutex'), so its jobs are always
+ *    checked in order and by one thread at a time.  The connection only
+ *    takes 'SchedMutex' when it looks like no worker has it.
+ *
+ *    A connection with a very big rule set can have its rules split in to
+ *    shards.  The worker that has the connection then puts its batch of
+ *    lines on the shard board and the other workers help out, each taking a
+ *    shard and running its rules on every line in the batch.  Each shard
+ *    keeps its own spans, and once they are all done the worker that owns
+ *    the batch joins them up in shard order.  The shards are in rule order,
+ *    so the spans (and the styles) come out just like they would if one
+ *    thread had run all the rules.
+ *
+ *    A connection can also have its lines checked by a helper process (see
+ *    MatchHelper.h).  The worker then just passes its batch of lines to the
+ *    helper and waits for the styles.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "AsyncMatch.h"
+#include "MatchHelper.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define WORKER_POLL_MS              50
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+struct AsyncMatchWorker
+{
+    mutex QueueMutex;
+    deque<struct AsyncMatcher *> Queue;
+    thread Thread;
+};
+
+/* A block of rules that one thread runs on all the lines in a batch */
+struct AsyncMatchShard
+{
+    uint32_t FirstRule;
+    uint32_t EndRule;               // One past the last rule
+    struct LineMatchSpanSet Spans;  // Only 'Spans' is used
+    vector<size_t> LineEnd;         // The end of each line's spans
+};
+
+struct AsyncMatchShardBatch
+{
+    struct AsyncMatcher *Async;
+    vector<struct AsyncMatchShard> Shards;
+    uint64_t FirstJob;
+    unsigned int Lines;
+    atomic<unsigned int> NextShard;     // The next shard to hand out
+    atomic<unsigned int> ShardsLeft;    // Shards that aren't done yet
+    mutex DoneMutex;                    // 'DoneCond' is signaled when
+    condition_variable DoneCond;        //   'ShardsLeft' gets to 0
+    unsigned int Helpers;               // Under 'm_BoardMutex'
+};
+
+/*** FUNCTION PROTOTYPES      ***/
+static bool AsyncMatch_StartPool(void);
+static void AsyncMatch_StopPool(void);
+static void AsyncMatch_Schedule(unsigned int WorkerIndex,
+        struct AsyncMatcher *Async);
+static struct AsyncMatcher *AsyncMatch_NextTask(unsigned int Self,
+        bool *Stolen);
+static void AsyncMatch_WorkerThread(unsigned int Self);
+static void AsyncMatch_RunBatch(unsigned int Self,struct AsyncMatcher *Async,
+        bool Stolen);
+static void AsyncMatch_RunShards(struct AsyncMatcher *Async,
+        uint64_t FirstJob,unsigned int Lines);
+static bool AsyncMatch_HelpShards(void);
+static void AsyncMatch_WorkShards(struct AsyncMatchShardBatch *Batch);
+static void AsyncMatch_RunHelper(struct AsyncMatcher *Async,
+        uint64_t FirstJob,unsigned int Lines);
+static void AsyncMatch_BuildStyles(struct LineMatchSpanSet *Spans,
+        struct AsyncMatchJob *Job);
+
+/*** VARIABLE DEFINITIONS     ***/
+static mutex m_PoolMutex;
+static struct AsyncMatchWorker *m_Workers;
+static unsigned int m_WorkerCount;
+static atomic<unsigned int> m_NextHome;
+static atomic<int> m_Pending;           // Matchers on all the queues
+static atomic<int> m_Sleepers;          // Workers waiting on 'm_WakeCond'
+static mutex m_WakeMutex;
+static condition_variable m_WakeCond;
+static atomic<bool> m_PoolStop;
+static unsigned int m_PoolSize;         // 0 for one per core
+static bool m_StopAtExit;
+static mutex m_BoardMutex;
+static vector<struct AsyncMatchShardBatch *> m_Board;  // Batches to help with
+static atomic<int> m_BoardSize;
+static condition_variable m_BoardCond;  // A batch's 'Helpers' got to 0
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_Start
+ *
+ * SYNOPSIS:
+ *    struct AsyncMatcher *AsyncMatch_Start(const t_LineMatchRuleList &Rules,
+ *          uint32_t MaxJobs,uint32_t RulesPerShard);
+ *
+ * PARAMETERS:
+ *    Rules [I] -- The rules to check the lines against.  The matcher keeps
+ *                 its own copy (so the rules can't change under the
+ *                 workers, stop the matcher and start a new one to change
+ *                 them).
+ *    MaxJobs [I] -- The most lines that can be waiting at once
+ *    RulesPerShard [I] -- If there are more rules than this they are split
+ *                         in to shards of about this many rules that the
+ *                         workers run at the same time.  0 to never split
+ *                         them.
+ *
+ * FUNCTION:
+ *    This function allocates the job ring for a connection.  The worker
+ *    pool is started the first time this is called.  The rules are only
+ *    split if there is more than one worker.
+ *
+ * RETURNS:
+ *    The new matcher or NULL if we are out of memory (or couldn't start the
+ *    workers).
+ *
+ * SEE ALSO:
+ *    AsyncMatch_Stop(), AsyncMatch_Free()
+ ******************************************************************************/
+struct AsyncMatcher *AsyncMatch_Start(const t_LineMatchRuleList &Rules,
+        uint32_t MaxJobs,uint32_t RulesPerShard)
+{
+    struct AsyncMatcher *Async;
+    struct AsyncMatchShardBatch *Batch;
+    uint32_t Count;
+    uint32_t s;
+
+    if(!AsyncMatch_StartPool())
+        return NULL;
+
+    Async=NULL;
+    try
+    {
+        Async=new struct AsyncMatcher;
+        Async->Jobs.resize(MaxJobs);
+        Async->Head=0;
+        Async->Done=0;
+        Async->Tail=0;
+        Async->Rules=Rules;
+        Async->Home=m_NextHome.fetch_add(1,memory_order_relaxed)%
+                m_WorkerCount;
+        Async->Shards=NULL;
+        Async->Helper=NULL;
+        Async->HelperMode=false;
+        Async->Queued=false;
+        Async->Running=false;
+        Async->Stop=false;
+
+        if(RulesPerShard>0 && Rules.size()>RulesPerShard && m_WorkerCount>1)
+        {
+            /* Spread the rules evenly over the shards */
+            Count=(Rules.size()+RulesPerShard-1)/RulesPerShard;
+            Batch=new struct AsyncMatchShardBatch;
+            Async->Shards=Batch;
+            Batch->Async=Async;
+            Batch->Shards.resize(Count);
+            for(s=0;s<Count;s++)
+            {
+                Batch->Shards[s].FirstRule=(uint64_t)Rules.size()*s/Count;
+                Batch->Shards[s].EndRule=(uint64_t)Rules.size()*(s+1)/Count;
+            }
+            Batch->FirstJob=0;
+            Batch->Lines=0;
+            Batch->NextShard=0;
+            Batch->ShardsLeft=0;
+            Batch->Helpers=0;
+        }
+    }
+    catch(...)
+    {
+        if(Async!=NULL)
+            delete Async->Shards;
+        delete Async;
+        return NULL;
+    }
+
+    return Async;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_Stop
+ *
+ * SYNOPSIS:
+ *    void AsyncMatch_Stop(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher to stop
+ *
+ * FUNCTION:
+ *    This function takes the matcher off the workers (waiting for the
+ *    worker checking it to finish the line it is on).  Any jobs that
+ *    weren't checked are marked as done with no styles, so the connection
+ *    can get them back with AsyncMatch_GetDoneJob() (to free its marks)
+ *    before calling AsyncMatch_Free().
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    AsyncMatch_Start(), AsyncMatch_Free()
+ ******************************************************************************/
+void AsyncMatch_Stop(struct AsyncMatcher *Async)
+{
+    struct AsyncMatchJob *Job;
+    uint64_t Done;
+    uint64_t Head;
+
+    {
+        unique_lock<mutex> Lock(Async->SchedMutex);
+        Async->Stop=true;
+
+        /* A queued matcher is dropped by the next worker to get to it
+           (unless the pool has been stopped at exit) */
+        while((Async->Queued || Async->Running) && !m_PoolStop)
+        {
+            Async->StopCond.wait_for(Lock,
+                    chrono::milliseconds(WORKER_POLL_MS));
+        }
+    }
+
+    Head=Async->Head.load(memory_order_relaxed);
+    for(Done=Async->Done.load(memory_order_acquire);Done<Head;Done++)
+    {
+        Job=&Async->Jobs[Done%Async->Jobs.size()];
+        Job->Styles.clear();
+        Job->Hits.clear();
+        Job->Stolen=false;
+        Job->Fallback=false;
+    }
+    Async->Done.store(Head,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_Free
+ *
+ * SYNOPSIS:
+ *    void AsyncMatch_Free(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher to free
+ *
+ * FUNCTION:
+ *    This function stops the matcher (if it hasn't been) and frees it.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    AsyncMatch_Stop()
+ ******************************************************************************/
+void AsyncMatch_Free(struct AsyncMatcher *Async)
+{
+    if(Async==NULL)
+        return;
+
+    AsyncMatch_Stop(Async);
+    MatchHelper_Free(Async->Helper);
+    delete Async->Shards;
+    delete Async;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_GetFreeJob
+ *
+ * SYNOPSIS:
+ *    struct AsyncMatchJob *AsyncMatch_GetFreeJob(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher
+ *
+ * FUNCTION:
+ *    This function gets the next free job so the connection can fill it in.
+ *    It isn't given to the workers until AsyncMatch_QueueJob() is called.
+ *
+ * RETURNS:
+ *    The job to fill in or NULL if the ring is full.
+ *
+ * SEE ALSO:
+ *    AsyncMatch_QueueJob()
+ ******************************************************************************/
+struct AsyncMatchJob *AsyncMatch_GetFreeJob(struct AsyncMatcher *Async)
+{
+    uint64_t Head;
+
+    Head=Async->Head.load(memory_order_relaxed);
+    if(Head-Async->Tail>=Async->Jobs.size())
+        return NULL;
+
+    return &Async->Jobs[Head%Async->Jobs.size()];
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_QueueJob
+ *
+ * SYNOPSIS:
+ *    void AsyncMatch_QueueJob(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher
+ *
+ * FUNCTION:
+ *    This function gives the job from AsyncMatch_GetFreeJob() to the
+ *    workers.  If no worker has this matcher yet it goes on the queue of
+ *    its home worker.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    AsyncMatch_GetFreeJob(), AsyncMatch_GetDoneJob()
+ ******************************************************************************/
+void AsyncMatch_QueueJob(struct AsyncMatcher *Async)
+{
+    Async->Head.fetch_add(1);
+
+    /* A worker that is running us clears 'Running' and then checks the head
+       again before it lets go (both seq_cst), so either it sees this job or
+       we see it has let go */
+    if(Async->Queued.load() || Async->Running.load())
+        return;
+
+    Async->SchedMutex.lock();
+    if(Async->Queued || Async->Running || Async->Stop)
+    {
+        Async->SchedMutex.unlock();
+        return;
+    }
+    Async->Queued=true;
+    Async->SchedMutex.unlock();
+
+    AsyncMatch_Schedule(Async->Home,Async);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_GetDoneJob
+ *
+ * SYNOPSIS:
+ *    struct AsyncMatchJob *AsyncMatch_GetDoneJob(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher
+ *
+ * FUNCTION:
+ *    This function gets the oldest job the workers have finished.  The
+ *    connection applies the styles and then calls AsyncMatch_FreeJob().
+ *    Jobs always come back in the order they were queued.
+ *
+ * RETURNS:
+ *    The finished job or NULL if the oldest job isn't done yet (or there are
+ *    no jobs).
+ *
+ * SEE ALSO:
+ *    AsyncMatch_FreeJob()
+ ******************************************************************************/
+struct AsyncMatchJob *AsyncMatch_GetDoneJob(struct AsyncMatcher *Async)
+{
+    if(Async->Tail==Async->Done.load(memory_order_acquire))
+        return NULL;
+
+    return &Async->Jobs[Async->Tail%Async->Jobs.size()];
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_FreeJob
+ *
+ * SYNOPSIS:
+ *    void AsyncMatch_FreeJob(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher
+ *
+ * FUNCTION:
+ *    This function gives the job from AsyncMatch_GetDoneJob() back to the
+ *    ring.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    AsyncMatch_GetDoneJob()
+ ******************************************************************************/
+void AsyncMatch_FreeJob(struct AsyncMatcher *Async)
+{
+    Async->Tail++;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_WaitIdle
+ *
+ * SYNOPSIS:
+ *    bool AsyncMatch_WaitIdle(struct AsyncMatcher *Async,uint32_t MaxWaitUS);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher
+ *    MaxWaitUS [I] -- The longest to wait (in micro seconds)
+ *
+ * FUNCTION:
+ *    This function waits for the workers to finish all the queued jobs.
+ *
+ * RETURNS:
+ *    true -- All the jobs are done
+ *    false -- We gave up waiting
+ ******************************************************************************/
+bool AsyncMatch_WaitIdle(struct AsyncMatcher *Async,uint32_t MaxWaitUS)
+{
+    chrono::steady_clock::time_point GiveUp;
+
+    GiveUp=chrono::steady_clock::now()+chrono::microseconds(MaxWaitUS);
+    while(Async->Done.load(memory_order_acquire)!=
+            Async->Head.load(memory_order_relaxed))
+    {
+        if(chrono::steady_clock::now()>=GiveUp)
+            return false;
+        this_thread::yield();
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_GetBacklog
+ *
+ * SYNOPSIS:
+ *    uint32_t AsyncMatch_GetBacklog(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher
+ *
+ * FUNCTION:
+ *    This function gets how many jobs are waiting for a worker.
+ *
+ * RETURNS:
+ *    The number of jobs that haven't been checked yet.
+ ******************************************************************************/
+uint32_t AsyncMatch_GetBacklog(struct AsyncMatcher *Async)
+{
+    return Async->Head.load(memory_order_relaxed)-
+            Async->Done.load(memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_SetPoolSize
+ *
+ * SYNOPSIS:
+ *    void AsyncMatch_SetPoolSize(unsigned int Workers);
+ *
+ * PARAMETERS:
+ *    Workers [I] -- The number of worker threads to use (0 for one per
+ *                   core, the default)
+ *
+ * FUNCTION:
+ *    This function changes the size of the worker pool.  If the workers are
+ *    running they are stopped, and the next AsyncMatch_Start() starts the
+ *    new number of them.  This is for the benchmarks, there can't be any
+ *    matchers when it is called.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void AsyncMatch_SetPoolSize(unsigned int Workers)
+{
+    if(m_WorkerCount>0)
+    {
+        AsyncMatch_StopPool();
+
+        lock_guard<mutex> Lock(m_PoolMutex);
+        delete [] m_Workers;
+        m_Workers=NULL;
+        m_WorkerCount=0;
+        m_Pending=0;
+    }
+    m_PoolSize=Workers;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_GetWorkerCount
+ *
+ * SYNOPSIS:
+ *    unsigned int AsyncMatch_GetWorkerCount(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function gets the number of workers in the pool.  The pool is
+ *    started by the first AsyncMatch_Start().
+ *
+ * RETURNS:
+ *    The number of worker threads (0 if the pool hasn't been started).
+ ******************************************************************************/
+unsigned int AsyncMatch_GetWorkerCount(void)
+{
+    lock_guard<mutex> Lock(m_PoolMutex);
+
+    return m_WorkerCount;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_UseHelper
+ *
+ * SYNOPSIS:
+ *    bool AsyncMatch_UseHelper(struct AsyncMatcher *Async,
+ *          const char *CPUList,uint32_t TimeoutMS);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher (no jobs can have been queued yet)
+ *    CPUList [I] -- The CPUs to pin the helper to, "" for any
+ *    TimeoutMS [I] -- How long the helper can go without answering
+ *
+ * FUNCTION:
+ *    This function moves the checking of the matcher's lines out to a
+ *    helper process (see MatchHelper.h).  The worker still takes the jobs,
+ *    it just sends them to the helper and waits for the styles.  The rules
+ *    are not split in to shards when there is a helper.
+ *
+ *    If the helper can't be started, or later stops answering, the lines
+ *    are checked on the worker with only the simple (not regex) rules and
+ *    the jobs are marked as 'Fallback'.
+ *
+ * RETURNS:
+ *    true -- The helper was started
+ *    false -- It wasn't, the lines will only get the simple rules
+ *
+ * SEE ALSO:
+ *    AsyncMatch_Start()
+ ******************************************************************************/
+bool AsyncMatch_UseHelper(struct AsyncMatcher *Async,const char *CPUList,
+        uint32_t TimeoutMS)
+{
+    delete Async->Shards;
+    Async->Shards=NULL;
+    Async->HelperMode=true;
+    Async->Helper=MatchHelper_Start(Async->Rules,CPUList,TimeoutMS);
+
+    return Async->Helper!=NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_CheckLine
+ *
+ * SYNOPSIS:
+ *    void AsyncMatch_CheckLine(const t_LineMatchRuleList &Rules,
+ *          struct LineMatchSpanSet *Spans,struct AsyncMatchJob *Job,
+ *          bool SimpleOnly);
+ *
+ * PARAMETERS:
+ *    Rules [I] -- The rules to run
+ *    Spans [I] -- Scratch spans to use
+ *    Job [I/O] -- The job to check.  The 'Styles' and 'Hits' are filled in.
+ *    SimpleOnly [I] -- Skip the regex rules
+ *
+ * FUNCTION:
+ *    This function runs the rules on a line and works out the styles, the
+ *    same way TextLineHighlighter_RunRules() does.  The only difference is
+ *    the whole line is given as its length (not 0 for to the cursor),
+ *    because the cursor has moved on by the time the styles are applied.
+ *
+ *    This is also what the helper process runs on each line.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void AsyncMatch_CheckLine(const t_LineMatchRuleList &Rules,
+        struct LineMatchSpanSet *Spans,struct AsyncMatchJob *Job,
+        bool SimpleOnly)
+{
+    unsigned int r;
+
+    LineMatch_ClearSpans(Spans);
+    Job->Hits.resize(Rules.size());
+    for(r=0;r<Rules.size();r++)
+    {
+        if(SimpleOnly && Rules[r].Type==e_LineMatchRule_Regex)
+        {
+            Job->Hits[r]=0;
+            continue;
+        }
+        Job->Hits[r]=LineMatch_RunRule(&Rules[r],Job->Line.data(),Job->Len,
+                0,Spans);
+    }
+
+    AsyncMatch_BuildStyles(Spans,Job);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_StartPool
+ *
+ * SYNOPSIS:
+ *    static bool AsyncMatch_StartPool(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function starts the worker threads (one per core) if they
+ *    haven't been started yet.  They are stopped at exit.
+ *
+ * RETURNS:
+ *    true -- The workers are running
+ *    false -- We couldn't start any workers
+ ******************************************************************************/
+static bool AsyncMatch_StartPool(void)
+{
+    unsigned int Count;
+    unsigned int w;
+
+    lock_guard<mutex> Lock(m_PoolMutex);
+
+    if(m_WorkerCount>0)
+        return true;
+
+    Count=m_PoolSize;
+    if(Count==0)
+        Count=thread::hardware_concurrency();
+    if(Count<1)
+        Count=1;
+
+    try
+    {
+        m_Workers=new struct AsyncMatchWorker[Count];
+    }
+    catch(...)
+    {
+        m_Workers=NULL;
+        return false;
+    }
+
+    /* The workers need the count as soon as they start.  If we can't start
+       them all the queues without a worker still get stolen from. */
+    m_PoolStop=false;
+    m_WorkerCount=Count;
+    for(w=0;w<Count;w++)
+    {
+        try
+        {
+            m_Workers[w].Thread=thread(AsyncMatch_WorkerThread,w);
+        }
+        catch(...)
+        {
+            break;
+        }
+    }
+
+    if(w==0)
+    {
+        m_WorkerCount=0;
+        delete [] m_Workers;
+        m_Workers=NULL;
+        return false;
+    }
+
+    if(!m_StopAtExit)
+    {
+        atexit(AsyncMatch_StopPool);
+        m_StopAtExit=true;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_StopPool
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_StopPool(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function stops the worker threads and waits for them to exit.  It
+ *    is called at exit (and by AsyncMatch_SetPoolSize()).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_StopPool(void)
+{
+    unsigned int w;
+
+    m_WakeMutex.lock();
+    m_PoolStop=true;
+    m_WakeMutex.unlock();
+    m_WakeCond.notify_all();
+
+    for(w=0;w<m_WorkerCount;w++)
+        if(m_Workers[w].Thread.joinable())
+            m_Workers[w].Thread.join();
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_Schedule
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_Schedule(unsigned int WorkerIndex,
+ *          struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    WorkerIndex [I] -- The worker whose queue to put the matcher on
+ *    Async [I] -- The matcher to queue.  'Queued' must already be set.
+ *
+ * FUNCTION:
+ *    This function puts a matcher on the back of a worker's queue and wakes
+ *    up a worker if they are all sleeping.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_Schedule(unsigned int WorkerIndex,
+        struct AsyncMatcher *Async)
+{
+    struct AsyncMatchWorker *Worker=&m_Workers[WorkerIndex];
+
+    Worker->QueueMutex.lock();
+    Worker->Queue.push_back(Async);
+    Worker->QueueMutex.unlock();
+
+    /* Both of these are seq_cst so either we see the worker going to sleep
+       or it sees the new work before it sleeps */
+    m_Pending.fetch_add(1);
+    if(m_Sleepers.load()>0)
+    {
+        m_WakeMutex.lock();
+        m_WakeMutex.unlock();
+        m_WakeCond.notify_one();
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_NextTask
+ *
+ * SYNOPSIS:
+ *    static struct AsyncMatcher *AsyncMatch_NextTask(unsigned int Self,
+ *          bool *Stolen);
+ *
+ * PARAMETERS:
+ *    Self [I] -- The worker looking for work
+ *    Stolen [O] -- Set to true if the matcher came from another worker's
+ *                  queue
+ *
+ * FUNCTION:
+ *    This function takes the matcher at the front of our queue.  If our
+ *    queue is empty we steal from the back of the other workers' queues
+ *    (starting with the one after us so the workers don't all go after the
+ *    same queue).
+ *
+ * RETURNS:
+ *    The matcher to run or NULL if there is nothing to do.
+ ******************************************************************************/
+static struct AsyncMatcher *AsyncMatch_NextTask(unsigned int Self,
+        bool *Stolen)
+{
+    struct AsyncMatchWorker *Worker;
+    struct AsyncMatcher *Async;
+    unsigned int w;
+
+    Async=NULL;
+    Worker=&m_Workers[Self];
+    Worker->QueueMutex.lock();
+    if(!Worker->Queue.empty())
+    {
+        Async=Worker->Queue.front();
+        Worker->Queue.pop_front();
+    }
+    Worker->QueueMutex.unlock();
+    *Stolen=false;
+
+    for(w=1;w<m_WorkerCount && Async==NULL;w++)
+    {
+        Worker=&m_Workers[(Self+w)%m_WorkerCount];
+        Worker->QueueMutex.lock();
+        if(!Worker->Queue.empty())
+        {
+            Async=Worker->Queue.back();
+            Worker->Queue.pop_back();
+            *Stolen=true;
+        }
+        Worker->QueueMutex.unlock();
+    }
+
+    if(Async!=NULL)
+        m_Pending.fetch_sub(1);
+
+    return Async;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_WorkerThread
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_WorkerThread(unsigned int Self);
+ *
+ * PARAMETERS:
+ *    Self [I] -- Our index in 'm_Workers'
+ *
+ * FUNCTION:
+ *    This is a worker thread.  It runs matchers from the queues (and helps
+ *    with the shards of other workers' batches) until there are none left
+ *    and then sleeps until it is woken up (or WORKER_POLL_MS goes by).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_WorkerThread(unsigned int Self)
+{
+    struct AsyncMatcher *Async;
+    bool Stolen;
+
+    while(!m_PoolStop)
+    {
+        /* Helping with a batch that is already running comes first */
+        if(AsyncMatch_HelpShards())
+            continue;
+
+        Async=AsyncMatch_NextTask(Self,&Stolen);
+        if(Async!=NULL)
+        {
+            AsyncMatch_RunBatch(Self,Async,Stolen);
+            continue;
+        }
+
+        m_Sleepers.fetch_add(1);
+        {
+            unique_lock<mutex> Lock(m_WakeMutex);
+            if(m_Pending.load()==0 && m_BoardSize.load()==0 && !m_PoolStop)
+            {
+                m_WakeCond.wait_for(Lock,
+                        chrono::milliseconds(WORKER_POLL_MS));
+            }
+        }
+        m_Sleepers.fetch_sub(1);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_RunBatch
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_RunBatch(unsigned int Self,
+ *          struct AsyncMatcher *Async,bool Stolen);
+ *
+ * PARAMETERS:
+ *    Self [I] -- The worker running the batch
+ *    Async [I] -- The matcher we took off a queue
+ *    Stolen [I] -- We stole the matcher from another worker
+ *
+ * FUNCTION:
+ *    This function checks up to ASYNCMATCH_BATCH_LINES of a matcher's jobs.
+ *    If it has more waiting it goes on the back of our queue so the other
+ *    connections get a turn first.  If the matcher's rules are split the
+ *    whole batch is checked at once with AsyncMatch_RunShards().
+ *
+ *    Once we have let go of the matcher (cleared 'Running') we don't touch
+ *    it again, the connection may free it.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_RunBatch(unsigned int Self,struct AsyncMatcher *Async,
+        bool Stolen)
+{
+    struct AsyncMatchJob *Job;
+    uint64_t Done;
+    uint64_t Head;
+    unsigned int Lines;
+    bool Requeue;
+
+    Async->SchedMutex.lock();
+    Async->Queued=false;
+    if(Async->Stop)
+    {
+        Async->StopCond.notify_all();
+        Async->SchedMutex.unlock();
+        return;
+    }
+    Async->Running=true;
+    Async->SchedMutex.unlock();
+
+    Done=Async->Done.load(memory_order_relaxed);
+    Head=Async->Head.load(memory_order_acquire);
+    if(Async->HelperMode)
+    {
+        Lines=Head-Done;
+        if(Lines>ASYNCMATCH_BATCH_LINES)
+            Lines=ASYNCMATCH_BATCH_LINES;
+        if(Lines>0)
+        {
+            AsyncMatch_RunHelper(Async,Done,Lines);
+            Async->Jobs[Done%Async->Jobs.size()].Stolen=Stolen;
+            Done+=Lines;
+            Async->Done.store(Done,memory_order_release);
+        }
+    }
+    else if(Async->Shards!=NULL)
+    {
+        Lines=Head-Done;
+        if(Lines>ASYNCMATCH_BATCH_LINES)
+            Lines=ASYNCMATCH_BATCH_LINES;
+        if(Lines>0)
+        {
+            AsyncMatch_RunShards(Async,Done,Lines);
+            Async->Jobs[Done%Async->Jobs.size()].Stolen=Stolen;
+            Done+=Lines;
+            Async->Done.store(Done,memory_order_release);
+        }
+    }
+    else
+    {
+        for(Lines=0;Lines<ASYNCMATCH_BATCH_LINES && Done<Head;Lines++)
+        {
+            Job=&Async->Jobs[Done%Async->Jobs.size()];
+            AsyncMatch_CheckLine(Async->Rules,&Async->Spans,Job,false);
+            Job->Stolen=Stolen && Lines==0;
+            Done++;
+            Async->Done.store(Done,memory_order_release);
+        }
+    }
+
+    Async->SchedMutex.lock();
+    Async->Running=false;
+    Requeue=false;
+    if(Async->Stop)
+    {
+        Async->StopCond.notify_all();
+    }
+    else if(Done!=Async->Head.load())
+    {
+        Async->Queued=true;
+        Requeue=true;
+    }
+    Async->SchedMutex.unlock();
+
+    /* 'Queued' keeps the matcher alive until it comes off the queue */
+    if(Requeue)
+        AsyncMatch_Schedule(Self,Async);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_RunShards
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_RunShards(struct AsyncMatcher *Async,
+ *          uint64_t FirstJob,unsigned int Lines);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher (its rules are split in to shards)
+ *    FirstJob [I] -- The first job to check (as a count, not an index)
+ *    Lines [I] -- The number of jobs to check
+ *
+ * FUNCTION:
+ *    This function checks a batch of jobs with the rule shards running on
+ *    as many workers as can help.  The batch goes on the shard board, we
+ *    wake up the sleeping workers and then run shards ourself until they
+ *    have all been taken.  Once every shard is done the spans are joined
+ *    in shard order (which is rule order) and the styles are worked out the
+ *    same as AsyncMatch_CheckLine() would.
+ *
+ *    While the other workers finish their shards we sleep (on the batch's
+ *    'DoneCond' and then 'm_BoardCond') instead of spinning, so a big
+ *    batch doesn't keep a whole core busy waiting.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_RunShards(struct AsyncMatcher *Async,
+        uint64_t FirstJob,unsigned int Lines)
+{
+    struct AsyncMatchShardBatch *Batch=Async->Shards;
+    struct AsyncMatchShard *Shard;
+    struct AsyncMatchJob *Job;
+    vector<struct LineMatchSpan>::iterator Start;
+    unsigned int l;
+    size_t s;
+
+    for(l=0;l<Lines;l++)
+        Async->Jobs[(FirstJob+l)%Async->Jobs.size()].Hits.resize(
+                Async->Rules.size());
+
+    Batch->FirstJob=FirstJob;
+    Batch->Lines=Lines;
+    Batch->NextShard.store(0,memory_order_relaxed);
+    Batch->ShardsLeft.store(Batch->Shards.size(),memory_order_relaxed);
+
+    /* The board lock hands the batch (and the jobs) to the helpers */
+    m_BoardMutex.lock();
+    m_Board.push_back(Batch);
+    m_BoardSize.fetch_add(1);
+    m_BoardMutex.unlock();
+    if(m_Sleepers.load()>0)
+    {
+        m_WakeMutex.lock();
+        m_WakeMutex.unlock();
+        m_WakeCond.notify_all();
+    }
+
+    AsyncMatch_WorkShards(Batch);
+    {
+        unique_lock<mutex> Lock(Batch->DoneMutex);
+        while(Batch->ShardsLeft.load(memory_order_acquire)!=0)
+            Batch->DoneCond.wait(Lock);
+    }
+
+    /* Once it is off the board no one new can find it, but a helper may
+       still be looking at it */
+    {
+        unique_lock<mutex> Lock(m_BoardMutex);
+        m_Board.erase(find(m_Board.begin(),m_Board.end(),Batch));
+        m_BoardSize.fetch_sub(1);
+        while(Batch->Helpers!=0)
+            m_BoardCond.wait(Lock);
+    }
+
+    for(l=0;l<Lines;l++)
+    {
+        Job=&Async->Jobs[(FirstJob+l)%Async->Jobs.size()];
+        LineMatch_ClearSpans(&Async->Spans);
+        for(s=0;s<Batch->Shards.size();s++)
+        {
+            Shard=&Batch->Shards[s];
+            Start=Shard->Spans.Spans.begin();
+            Async->Spans.Spans.insert(Async->Spans.Spans.end(),
+                    Start+(l==0?0:Shard->LineEnd[l-1]),
+                    Start+Shard->LineEnd[l]);
+        }
+        AsyncMatch_BuildStyles(&Async->Spans,Job);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_HelpShards
+ *
+ * SYNOPSIS:
+ *    static bool AsyncMatch_HelpShards(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function looks on the shard board for a batch that still has
+ *    shards no one has taken and runs them.
+ *
+ * RETURNS:
+ *    true -- We helped with a batch
+ *    false -- There was nothing to help with
+ ******************************************************************************/
+static bool AsyncMatch_HelpShards(void)
+{
+    struct AsyncMatchShardBatch *Batch;
+    size_t b;
+
+    if(m_BoardSize.load(memory_order_relaxed)==0)
+        return false;
+
+    Batch=NULL;
+    m_BoardMutex.lock();
+    for(b=0;b<m_Board.size();b++)
+    {
+        if(m_Board[b]->NextShard.load(memory_order_relaxed)<
+                m_Board[b]->Shards.size())
+        {
+            Batch=m_Board[b];
+            Batch->Helpers++;
+            break;
+        }
+    }
+    m_BoardMutex.unlock();
+
+    if(Batch==NULL)
+        return false;
+
+    AsyncMatch_WorkShards(Batch);
+
+    m_BoardMutex.lock();
+    if(--Batch->Helpers==0)
+        m_BoardCond.notify_all();
+    m_BoardMutex.unlock();
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_WorkShards
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_WorkShards(struct AsyncMatchShardBatch *Batch);
+ *
+ * PARAMETERS:
+ *    Batch [I] -- The batch to work on
+ *
+ * FUNCTION:
+ *    This function takes shards from a batch until they have all been
+ *    taken.  Each shard runs its rules on every line in the batch, setting
+ *    the line's 'Hits' for its rules and keeping the spans itself.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_WorkShards(struct AsyncMatchShardBatch *Batch)
+{
+    struct AsyncMatcher *Async=Batch->Async;
+    struct AsyncMatchShard *Shard;
+    struct AsyncMatchJob *Job;
+    unsigned int s;
+    unsigned int l;
+    uint32_t r;
+
+    while((s=Batch->NextShard.fetch_add(1,memory_order_relaxed))<
+            Batch->Shards.size())
+    {
+        Shard=&Batch->Shards[s];
+        Shard->Spans.Spans.clear();
+        Shard->LineEnd.clear();
+        for(l=0;l<Batch->Lines;l++)
+        {
+            Job=&Async->Jobs[(Batch->FirstJob+l)%Async->Jobs.size()];
+            for(r=Shard->FirstRule;r<Shard->EndRule;r++)
+            {
+                Job->Hits[r]=LineMatch_RunRule(&Async->Rules[r],
+                        Job->Line.data(),Job->Len,0,&Shard->Spans);
+            }
+            Shard->LineEnd.push_back(Shard->Spans.Spans.size());
+        }
+
+        /* The owner can't miss this, it checks 'ShardsLeft' under the lock */
+        if(Batch->ShardsLeft.fetch_sub(1,memory_order_release)==1)
+        {
+            Batch->DoneMutex.lock();
+            Batch->DoneCond.notify_all();
+            Batch->DoneMutex.unlock();
+        }
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_RunHelper
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_RunHelper(struct AsyncMatcher *Async,
+ *          uint64_t FirstJob,unsigned int Lines);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher (it has 'HelperMode' set)
+ *    FirstJob [I] -- The first job to check (as a count, not an index)
+ *    Lines [I] -- The number of jobs to check
+ *
+ * FUNCTION:
+ *    This function checks a batch of jobs with the helper process.  If the
+ *    helper has failed (or didn't start) the rest of the lines are checked
+ *    here with only the simple rules, so a rule that hung the helper can't
+ *    hang the worker, and are marked 'Fallback'.  Lines the helper couldn't
+ *    take (too big) are checked the same way.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_RunHelper(struct AsyncMatcher *Async,
+        uint64_t FirstJob,unsigned int Lines)
+{
+    struct AsyncMatchJob *Jobs[ASYNCMATCH_BATCH_LINES];
+    bool Local[ASYNCMATCH_BATCH_LINES];
+    unsigned int Answered;
+    unsigned int l;
+
+    for(l=0;l<Lines;l++)
+    {
+        Jobs[l]=&Async->Jobs[(FirstJob+l)%Async->Jobs.size()];
+        Jobs[l]->Stolen=false;
+        Jobs[l]->Fallback=false;
+    }
+
+    Answered=0;
+    if(Async->Helper!=NULL)
+        Answered=MatchHelper_CheckJobs(Async->Helper,Jobs,Lines,Local);
+
+    for(l=0;l<Lines;l++)
+    {
+        if(l>=Answered || Local[l])
+        {
+            AsyncMatch_CheckLine(Async->Rules,&Async->Spans,Jobs[l],true);
+            Jobs[l]->Fallback=true;
+        }
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_BuildStyles
+ *
+ * SYNOPSIS:
+ *    static void AsyncMatch_BuildStyles(struct LineMatchSpanSet *Spans,
+ *          struct AsyncMatchJob *Job);
+ *
+ * PARAMETERS:
+ *    Spans [I/O] -- The spans for the line
+ *    Job [I/O] -- The job the spans are for.  The 'Styles' are filled in.
+ *
+ * FUNCTION:
+ *    This function merges the line's spans and turns them in to the styles
+ *    to apply.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void AsyncMatch_BuildStyles(struct LineMatchSpanSet *Spans,
+        struct AsyncMatchJob *Job)
+{
+    const struct LineMatchInterval *Interval;
+    struct AsyncMatchStyle Style;
+    size_t i;
+    uint32_t s;
+
+    LineMatch_MergeSpans(Spans);
+    Job->Styles.clear();
+    for(i=0;i<Spans->Intervals.size();i++)
+    {
+        Interval=&Spans->Intervals[i];
+        Style.Offset=Interval->Start;
+        Style.Len=Interval->End-Interval->Start;
+
+        /* The whole line includes any '\r' the rules didn't see */
+        if(Interval->Start==0 && Interval->End==Job->Len)
+            Style.Len=Job->Line.size();
+
+        for(s=0;s<Interval->StyleCount;s++)
+        {
+            Style.StyleIndex=Spans->Styles[Interval->FirstStyle+s];
+            Job->Styles.push_back(Style);
+        }
+    }
+}
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * FILENAME: AsyncMatch.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the AsyncMatch.cpp file.
+ *
+ *    Each connection passes its lines to the worker threads in a ring of
+ *    jobs.  The ring has three counters that only ever go up:
+ *       Tail <= Done <= Head
+ *    Jobs from Tail to Done have been checked and are waiting for the
+ *    connection to apply their styles.  Jobs from Done to Head are waiting
+ *    for a worker.  The connection is the only one that moves Head and
+ *    Tail, and only one worker at a time checks a connection's jobs (see
+ *    AsyncMatch.cpp), so that worker is the only one that moves Done.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __ASYNCMATCH_H_
+#define __ASYNCMATCH_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include "LineMatch.h"
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/***  DEFINES                          ***/
+/* The most lines a worker checks for one connection before it moves on to
+   the next connection waiting */
+#define ASYNCMATCH_BATCH_LINES              32
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+struct AsyncMatchShardBatch;
+struct MatchHelper;
+
+/* A style to apply to the line (Len is never 0) */
+struct AsyncMatchStyle
+{
+    uint32_t Offset;
+    uint32_t Len;
+    int StyleIndex;
+};
+
+struct AsyncMatchJob
+{
+    /* Filled in by the connection */
+    uint64_t Mark;              // The start of the line (a MarkPool handle,
+                                // not used by us)
+    std::vector<uint8_t> Line;  // The line as it is on the screen
+    uint32_t Len;               // How much of 'Line' the rules see
+    uint64_t EndTicks;          // When the line ended (not used by us)
+
+    /* Filled in by the worker.  'Hits' has a 1 for each rule that matched. */
+    std::vector<struct AsyncMatchStyle> Styles;
+    std::vector<uint8_t> Hits;
+    bool Stolen;                // The first job a worker stole from another
+    bool Fallback;              // The helper had failed, only the simple
+                                // rules were checked
+};
+
+struct AsyncMatcher
+{
+    std::vector<struct AsyncMatchJob> Jobs;
+    std::atomic<uint64_t> Head;     // Only written by the connection
+    std::atomic<uint64_t> Done;     // Only written by the worker
+    uint64_t Tail;                  // Only used by the connection
+
+    /* Only used by the worker checking the jobs */
+    t_LineMatchRuleList Rules;
+    struct LineMatchSpanSet Spans;
+    struct AsyncMatchShardBatch *Shards;    // NULL if the rules aren't split
+    struct MatchHelper *Helper;     // NULL if there is no helper process
+    bool HelperMode;                // Lines go to 'Helper' (even if NULL)
+
+    /* Scheduling.  'Queued' is set while we are on a worker's queue and
+       'Running' while a worker is checking our jobs (never both).  They are
+       only changed under 'SchedMutex', but are atomic so the connection can
+       look at them without it. */
+    unsigned int Home;          // The worker whose queue we go on
+    std::mutex SchedMutex;
+    std::condition_variable StopCond;
+    std::atomic<bool> Queued;
+    std::atomic<bool> Running;
+    bool Stop;
+};
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+struct AsyncMatcher *AsyncMatch_Start(const t_LineMatchRuleList &Rules,
+        uint32_t MaxJobs,uint32_t RulesPerShard);
+void AsyncMatch_Stop(struct AsyncMatcher *Async);
+void AsyncMatch_Free(struct AsyncMatcher *Async);
+struct AsyncMatchJob *AsyncMatch_GetFreeJob(struct AsyncMatcher *Async);
+void AsyncMatch_QueueJob(struct AsyncMatcher *Async);
+struct AsyncMatchJob *AsyncMatch_GetDoneJob(struct AsyncMatcher *Async);
+void AsyncMatch_FreeJob(struct AsyncMatcher *Async);
+bool AsyncMatch_WaitIdle(struct AsyncMatcher *Async,uint32_t MaxWaitUS);
+uint32_t AsyncMatch_GetBacklog(struct AsyncMatcher *Async);
+void AsyncMatch_SetPoolSize(unsigned int Workers);
+unsigned int AsyncMatch_GetWorkerCount(void);
+bool AsyncMatch_UseHelper(struct AsyncMatcher *Async,const char *CPUList,
+        uint32_t TimeoutMS);
+void AsyncMatch_CheckLine(const t_LineMatchRuleList &Rules,
+        struct LineMatchSpanSet *Spans,struct AsyncMatchJob *Job,
+        bool SimpleOnly);
+
+/*******************************************************************************
+ * NAME:
+ *    AsyncMatch_HasDoneJobs
+ *
+ * SYNOPSIS:
+ *    static inline bool AsyncMatch_HasDoneJobs(struct AsyncMatcher *Async);
+ *
+ * PARAMETERS:
+ *    Async [I] -- The matcher to check
+ *
+ * FUNCTION:
+ *    This function checks if the worker has finished any jobs that are
+ *    waiting for AsyncMatch_GetDoneJob().  It is cheap enough to call for
+ *    every byte.
+ *
+ * RETURNS:
+ *    true -- There are done jobs
+ *    false -- There are none
+ *
+ * SEE ALSO:
+ *    AsyncMatch_GetDoneJob()
+ ******************************************************************************/
+static inline bool AsyncMatch_HasDoneJobs(struct AsyncMatcher *Async)
+{
+    return Async->Done.load(std::memory_order_relaxed)!=Async->Tail;
+}
+
+#endif
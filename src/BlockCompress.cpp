@@ -0,0 +1,335 @@
+/*******************************************************************************
+ * FILENAME: BlockCompress.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a small fast block compressor used for the stream capture
+ *    files.  The output is the LZ4 block format (so anything that can read
+ *    LZ4 blocks can read it) but we don't need the LZ4 lib to make it:
+ *
+ *    A block is a list of sequences.  Each sequence is:
+ *       Token -- 1 byte.  The high 4 bits are the number of literal bytes,
+ *                the low 4 bits are the match length less 4.  A value of
+ *                15 means more length bytes follow.
+ *       [Literal length bytes] -- If the literal length was 15, bytes are
+ *                added to it until a byte that isn't 255.
+ *       Literals -- The literal bytes.
+ *       Offset -- 2 bytes, little endian.  How far back the match starts.
+ *       [Match length bytes] -- Same as the literal length bytes.
+ *    The last sequence only has the token and literals (no match).  The
+ *    last 5 bytes of a block are always literals.
+ *
+ *    Terminal output compresses well with this (lots of repeated time
+ *    stamps and prefixes) and it is much faster than the stream comes in.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "BlockCompress.h"
+#include <string.h>
+
+/*** DEFINES                  ***/
+#define HASH_BITS                   12
+#define HASH_SIZE                   (1<<HASH_BITS)
+#define MIN_MATCH                   4
+#define MAX_OFFSET                  65535
+#define LAST_LITERALS               5       // The last 5 bytes are literals
+#define MATCH_FIND_LIMIT            12      // No match can start in the last 12
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+static inline uint32_t BlockCompress_Read32(const uint8_t *p);
+static inline uint32_t BlockCompress_Hash(uint32_t Value);
+static uint8_t *BlockCompress_WriteLength(uint8_t *Out,uint32_t Len);
+
+/*** VARIABLE DEFINITIONS     ***/
+
+/*******************************************************************************
+ * NAME:
+ *    BlockCompress_Compress
+ *
+ * SYNOPSIS:
+ *    uint32_t BlockCompress_Compress(const uint8_t *Src,uint32_t SrcLen,
+ *              uint8_t *Dest);
+ *
+ * PARAMETERS:
+ *    Src [I] -- The bytes to compress
+ *    SrcLen [I] -- The number of bytes in 'Src'
+ *    Dest [O] -- Where to put the compressed bytes.  This must be at least
+ *                BLOCKCOMPRESS_MAX_SIZE(SrcLen) bytes.
+ *
+ * FUNCTION:
+ *    This function compresses a block.
+ *
+ * RETURNS:
+ *    The number of bytes written to 'Dest'
+ *
+ * SEE ALSO:
+ *    BlockCompress_Decompress()
+ ******************************************************************************/
+uint32_t BlockCompress_Compress(const uint8_t *Src,uint32_t SrcLen,
+        uint8_t *Dest)
+{
+    int32_t Table[HASH_SIZE];
+    uint8_t *Out;
+    uint32_t Pos;
+    uint32_t Anchor;
+    uint32_t FindLimit;
+    uint32_t MatchLimit;
+    uint32_t Hash;
+    int32_t Ref;
+    uint32_t LitLen;
+    uint32_t MatchLen;
+    uint32_t Offset;
+    uint8_t *Token;
+
+    memset(Table,0xFF,sizeof(Table));
+    Out=Dest;
+    Pos=0;
+    Anchor=0;
+    FindLimit=SrcLen>MATCH_FIND_LIMIT?SrcLen-MATCH_FIND_LIMIT:0;
+    MatchLimit=SrcLen>LAST_LITERALS?SrcLen-LAST_LITERALS:0;
+
+    while(Pos<FindLimit)
+    {
+        Hash=BlockCompress_Hash(BlockCompress_Read32(&Src[Pos]));
+        Ref=Table[Hash];
+        Table[Hash]=Pos;
+
+        if(Ref<0 || Pos-Ref>MAX_OFFSET ||
+                BlockCompress_Read32(&Src[Ref])!=
+                BlockCompress_Read32(&Src[Pos]))
+        {
+            Pos++;
+            continue;
+        }
+
+        MatchLen=MIN_MATCH;
+        while(Pos+MatchLen<MatchLimit && Src[Ref+MatchLen]==Src[Pos+MatchLen])
+            MatchLen++;
+
+        LitLen=Pos-Anchor;
+        Offset=Pos-Ref;
+
+        Token=Out++;
+        *Token=(LitLen>=15?15:LitLen)<<4;
+        if(LitLen>=15)
+            Out=BlockCompress_WriteLength(Out,LitLen-15);
+        memcpy(Out,&Src[Anchor],LitLen);
+        Out+=LitLen;
+
+        *Out++=Offset&0xFF;
+        *Out++=(Offset>>8)&0xFF;
+
+        *Token|=(MatchLen-MIN_MATCH>=15?15:MatchLen-MIN_MATCH);
+        if(MatchLen-MIN_MATCH>=15)
+            Out=BlockCompress_WriteLength(Out,MatchLen-MIN_MATCH-15);
+
+        Pos+=MatchLen;
+        Anchor=Pos;
+    }
+
+    /* The last literals */
+    LitLen=SrcLen-Anchor;
+    Token=Out++;
+    *Token=(LitLen>=15?15:LitLen)<<4;
+    if(LitLen>=15)
+        Out=BlockCompress_WriteLength(Out,LitLen-15);
+    memcpy(Out,&Src[Anchor],LitLen);
+    Out+=LitLen;
+
+    return Out-Dest;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BlockCompress_Decompress
+ *
+ * SYNOPSIS:
+ *    bool BlockCompress_Decompress(const uint8_t *Src,uint32_t SrcLen,
+ *              uint8_t *Dest,uint32_t DestLen);
+ *
+ * PARAMETERS:
+ *    Src [I] -- The compressed block
+ *    SrcLen [I] -- The number of bytes in 'Src'
+ *    Dest [O] -- Where to put the bytes
+ *    DestLen [I] -- The number of bytes the block should decompress to.
+ *
+ * FUNCTION:
+ *    This function decompresses a block made with BlockCompress_Compress().
+ *    Everything is bounds checked so a damaged file can't write past
+ *    'Dest'.
+ *
+ * RETURNS:
+ *    true -- The block decompressed to exactly 'DestLen' bytes
+ *    false -- The block is damaged
+ *
+ * SEE ALSO:
+ *    BlockCompress_Compress()
+ ******************************************************************************/
+bool BlockCompress_Decompress(const uint8_t *Src,uint32_t SrcLen,
+        uint8_t *Dest,uint32_t DestLen)
+{
+    uint32_t In;
+    uint32_t Out;
+    uint32_t Len;
+    uint32_t Offset;
+    uint8_t Token;
+    uint8_t Byte;
+
+    In=0;
+    Out=0;
+    while(In<SrcLen)
+    {
+        Token=Src[In++];
+
+        /* Literals */
+        Len=Token>>4;
+        if(Len==15)
+        {
+            do
+            {
+                if(In>=SrcLen)
+                    return false;
+                Byte=Src[In++];
+                Len+=Byte;
+            } while(Byte==255);
+        }
+        if(Len>SrcLen-In || Len>DestLen-Out)
+            return false;
+        memcpy(&Dest[Out],&Src[In],Len);
+        In+=Len;
+        Out+=Len;
+
+        /* The last sequence has no match */
+        if(In==SrcLen)
+            break;
+
+        /* Match */
+        if(SrcLen-In<2)
+            return false;
+        Offset=Src[In]|(Src[In+1]<<8);
+        In+=2;
+        if(Offset==0 || Offset>Out)
+            return false;
+
+        Len=(Token&0x0F)+MIN_MATCH;
+        if((Token&0x0F)==15)
+        {
+            do
+            {
+                if(In>=SrcLen)
+                    return false;
+                Byte=Src[In++];
+                Len+=Byte;
+            } while(Byte==255);
+        }
+        if(Len>DestLen-Out)
+            return false;
+
+        /* Byte at a time because the match can overlap what we are
+           writing */
+        for(;Len>0;Len--,Out++)
+            Dest[Out]=Dest[Out-Offset];
+    }
+
+    return Out==DestLen;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BlockCompress_Read32
+ *
+ * SYNOPSIS:
+ *    static inline uint32_t BlockCompress_Read32(const uint8_t *p);
+ *
+ * PARAMETERS:
+ *    p [I] -- Where to read from
+ *
+ * FUNCTION:
+ *    This function reads 4 bytes that may not be aligned.
+ *
+ * RETURNS:
+ *    The 4 bytes
+ ******************************************************************************/
+static inline uint32_t BlockCompress_Read32(const uint8_t *p)
+{
+    uint32_t Value;
+
+    memcpy(&Value,p,sizeof(Value));
+    return Value;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BlockCompress_Hash
+ *
+ * SYNOPSIS:
+ *    static inline uint32_t BlockCompress_Hash(uint32_t Value);
+ *
+ * PARAMETERS:
+ *    Value [I] -- The 4 bytes to hash
+ *
+ * FUNCTION:
+ *    This function hashes 4 bytes in to a match table index.
+ *
+ * RETURNS:
+ *    The table index
+ ******************************************************************************/
+static inline uint32_t BlockCompress_Hash(uint32_t Value)
+{
+    return (Value*2654435761U)>>(32-HASH_BITS);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BlockCompress_WriteLength
+ *
+ * SYNOPSIS:
+ *    static uint8_t *BlockCompress_WriteLength(uint8_t *Out,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Out [O] -- Where to write
+ *    Len [I] -- The extra length (past the 15 in the token)
+ *
+ * FUNCTION:
+ *    This function writes the extra length bytes for a literal or match
+ *    length (255's and then the rest).
+ *
+ * RETURNS:
+ *    The new 'Out'
+ ******************************************************************************/
+static uint8_t *BlockCompress_WriteLength(uint8_t *Out,uint32_t Len)
+{
+    while(Len>=255)
+    {
+        *Out++=255;
+        Len-=255;
+    }
+    *Out++=Len;
+    return Out;
+}
@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * FILENAME: BlockCompress.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the BlockCompress.cpp file.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __BLOCKCOMPRESS_H_
+#define __BLOCKCOMPRESS_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include <stdint.h>
+
+/***  DEFINES                          ***/
+
+/***  MACROS                           ***/
+/* The biggest a block of 'Len' bytes can get when it doesn't compress */
+#define BLOCKCOMPRESS_MAX_SIZE(Len)         ((Len)+(Len)/255+16)
+
+/***  TYPE DEFINITIONS                 ***/
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+uint32_t BlockCompress_Compress(const uint8_t *Src,uint32_t SrcLen,
+        uint8_t *Dest);
+bool BlockCompress_Decompress(const uint8_t *Src,uint32_t SrcLen,
+        uint8_t *Dest,uint32_t DestLen);
+
+#endif
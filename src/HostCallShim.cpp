@@ -0,0 +1,540 @@
+/*******************************************************************************
+ * FILENAME: HostCallShim.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is an optional shim that sits between the plugin and the
+ *    WhippyTerm DPS_API.  It counts and times every mark / stream call we
+ *    make to WhippyTerm so we can tell how much of a connection's time is
+ *    spent in our code and how much is spent in WhippyTerm.
+ *
+ *    The plugin calls HostCallShim_Enter() / HostCallShim_Leave() around
+ *    the work it does for a connection.  Any host call made between them is
+ *    added to that connection's counters.
+ *
+ *    It is turned on by setting HOSTCALLSHIM_ENV_VAR to 1 before
+ *    WhippyTerm is started (the DPS_API is captured in RegisterPlugin()
+ *    so it can't be changed after that).
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "HostCallShim.h"
+#include "PerfTimer.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** DEFINES                  ***/
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+static inline void HostCallShim_Count(e_HostCallType Call,uint64_t Start);
+static t_DataProMark *HostCallShim_AllocateMark(void);
+static void HostCallShim_FreeMark(t_DataProMark *Mark);
+static PG_BOOL HostCallShim_IsMarkValid(t_DataProMark *Mark);
+static void HostCallShim_SetMark2CursorPos(t_DataProMark *Mark);
+static void HostCallShim_ApplyAttrib2Mark(t_DataProMark *Mark,uint32_t Attrib,
+        uint32_t Offset,uint32_t Len);
+static void HostCallShim_RemoveAttribFromMark(t_DataProMark *Mark,
+        uint32_t Attrib,uint32_t Offset,uint32_t Len);
+static void HostCallShim_ApplyFGColor2Mark(t_DataProMark *Mark,
+        uint32_t FGColor,uint32_t Offset,uint32_t Len);
+static void HostCallShim_ApplyBGColor2Mark(t_DataProMark *Mark,
+        uint32_t BGColor,uint32_t Offset,uint32_t Len);
+static void HostCallShim_MoveMark(t_DataProMark *Mark,int Amount);
+static const uint8_t *HostCallShim_GetMarkString(t_DataProMark *Mark,
+        uint32_t *Size,uint32_t Offset,uint32_t Len);
+static void HostCallShim_FreezeStream(void);
+static void HostCallShim_ClearFrozenStream(void);
+static void HostCallShim_ReleaseFrozenStream(void);
+static const uint8_t *HostCallShim_GetFrozenString(uint32_t *Size);
+static void HostCallShim_ApplyStyle2Mark(t_DataProMark *Mark,uint32_t FGColor,
+        uint32_t BGColor,uint32_t Attribs,uint32_t ULineColor,uint32_t Offset,
+        uint32_t Len,uint32_t Mask);
+static void HostCallShim_GetScrollBackLines(uint64_t *FirstLine,
+        uint64_t *EndLine);
+static const uint8_t *HostCallShim_GetScrollBackLine(uint64_t Line,
+        uint32_t *Size);
+static PG_BOOL HostCallShim_SetMark2ScrollBackLine(t_DataProMark *Mark,
+        uint64_t Line);
+
+/*** VARIABLE DEFINITIONS     ***/
+static const struct DPS_API *m_RealDPS;
+static struct DPS_API m_ShimDPS;
+
+/* The counters for the connection we are working on in this thread */
+static thread_local struct HostCallCounters *m_CurrentCounters;
+
+static const char *m_HostCallNames[e_HostCallMAX]=
+{
+    "AllocateMark",
+    "FreeMark",
+    "IsMarkValid",
+    "SetMark2CursorPos",
+    "ApplyAttrib2Mark",
+    "RemoveAttribFromMark",
+    "ApplyFGColor2Mark",
+    "ApplyBGColor2Mark",
+    "MoveMark",
+    "GetMarkString",
+    "FreezeStream",
+    "ClearFrozenStream",
+    "ReleaseFrozenStream",
+    "GetFrozenString",
+    "ApplyStyle2Mark",
+    "GetScrollBackLines",
+    "GetScrollBackLine",
+    "SetMark2ScrollBackLine"
+};
+
+/*******************************************************************************
+ * NAME:
+ *    HostCallShim_IsWanted
+ *
+ * SYNOPSIS:
+ *    bool HostCallShim_IsWanted(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function checks if the user asked for the shim to be used.
+ *
+ * RETURNS:
+ *    true -- The shim should be used
+ *    false -- Talk to WhippyTerm directly
+ ******************************************************************************/
+bool HostCallShim_IsWanted(void)
+{
+    const char *Env;
+
+    Env=getenv(HOSTCALLSHIM_ENV_VAR);
+    if(Env==NULL)
+        return false;
+    return atoi(Env)!=0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostCallShim_Wrap
+ *
+ * SYNOPSIS:
+ *    const struct DPS_API *HostCallShim_Wrap(const struct DPS_API *RealDPS,
+ *          int DPSVersion);
+ *
+ * PARAMETERS:
+ *    RealDPS [I] -- The API we got from WhippyTerm
+ *    DPSVersion [I] -- The DPS_API_VERSION_x that WhippyTerm has.  We only
+ *                      copy the parts of 'RealDPS' that are there, anything
+ *                      newer is left NULL.
+ *
+ * FUNCTION:
+ *    This function makes a copy of the WhippyTerm API with the mark and
+ *    stream functions replaced with ones that count and time the call.  The
+ *    rest of the functions are left as is.
+ *
+ * RETURNS:
+ *    The API to use in place of 'RealDPS'
+ ******************************************************************************/
+const struct DPS_API *HostCallShim_Wrap(const struct DPS_API *RealDPS,
+        int DPSVersion)
+{
+    m_RealDPS=RealDPS;
+    memset(&m_ShimDPS,0x00,sizeof(m_ShimDPS));
+    if(DPSVersion>=DPS_API_VERSION_4)
+    {
+        m_ShimDPS=*RealDPS;
+    }
+    else if(DPSVersion>=DPS_API_VERSION_3)
+    {
+        memcpy(&m_ShimDPS,RealDPS,offsetof(struct DPS_API,
+                GetScrollBackLines));
+    }
+    else
+    {
+        memcpy(&m_ShimDPS,RealDPS,offsetof(struct DPS_API,ApplyStyle2Mark));
+    }
+
+    m_ShimDPS.AllocateMark=HostCallShim_AllocateMark;
+    m_ShimDPS.FreeMark=HostCallShim_FreeMark;
+    m_ShimDPS.IsMarkValid=HostCallShim_IsMarkValid;
+    m_ShimDPS.SetMark2CursorPos=HostCallShim_SetMark2CursorPos;
+    m_ShimDPS.ApplyAttrib2Mark=HostCallShim_ApplyAttrib2Mark;
+    m_ShimDPS.RemoveAttribFromMark=HostCallShim_RemoveAttribFromMark;
+    m_ShimDPS.ApplyFGColor2Mark=HostCallShim_ApplyFGColor2Mark;
+    m_ShimDPS.ApplyBGColor2Mark=HostCallShim_ApplyBGColor2Mark;
+    m_ShimDPS.MoveMark=HostCallShim_MoveMark;
+    m_ShimDPS.GetMarkString=HostCallShim_GetMarkString;
+    m_ShimDPS.FreezeStream=HostCallShim_FreezeStream;
+    m_ShimDPS.ClearFrozenStream=HostCallShim_ClearFrozenStream;
+    m_ShimDPS.ReleaseFrozenStream=HostCallShim_ReleaseFrozenStream;
+    m_ShimDPS.GetFrozenString=HostCallShim_GetFrozenString;
+
+    if(DPSVersion>=DPS_API_VERSION_3)
+        m_ShimDPS.ApplyStyle2Mark=HostCallShim_ApplyStyle2Mark;
+    if(DPSVersion>=DPS_API_VERSION_4)
+    {
+        m_ShimDPS.GetScrollBackLines=HostCallShim_GetScrollBackLines;
+        m_ShimDPS.GetScrollBackLine=HostCallShim_GetScrollBackLine;
+        m_ShimDPS.SetMark2ScrollBackLine=HostCallShim_SetMark2ScrollBackLine;
+    }
+
+    return &m_ShimDPS;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostCallShim_Reset
+ *
+ * SYNOPSIS:
+ *    void HostCallShim_Reset(struct HostCallCounters *Counters);
+ *
+ * PARAMETERS:
+ *    Counters [I] -- The counters to zero
+ *
+ * FUNCTION:
+ *    This function zeros a set of counters.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void HostCallShim_Reset(struct HostCallCounters *Counters)
+{
+    memset(Counters->Calls,0x00,sizeof(Counters->Calls));
+    memset(Counters->Ticks,0x00,sizeof(Counters->Ticks));
+    Counters->HostTicks=0;
+    Counters->TotalTicks=0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostCallShim_Enter
+ *
+ * SYNOPSIS:
+ *    void HostCallShim_Enter(struct HostCallCounters *Counters);
+ *
+ * PARAMETERS:
+ *    Counters [I] -- The counters for the connection we are starting work
+ *                    on.
+ *
+ * FUNCTION:
+ *    This function is called when the plugin starts working for a
+ *    connection.  Host calls from this thread will be added to 'Counters'
+ *    until HostCallShim_Leave() is called.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    HostCallShim_Leave()
+ ******************************************************************************/
+void HostCallShim_Enter(struct HostCallCounters *Counters)
+{
+    m_CurrentCounters=Counters;
+    Counters->EnterTicks=PerfTimer_Now();
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostCallShim_Leave
+ *
+ * SYNOPSIS:
+ *    void HostCallShim_Leave(struct HostCallCounters *Counters);
+ *
+ * PARAMETERS:
+ *    Counters [I] -- The counters that where passed to HostCallShim_Enter()
+ *
+ * FUNCTION:
+ *    This function is called when the plugin is done working for a
+ *    connection.  The time since HostCallShim_Enter() is added to the total
+ *    time.  The plugin time is the total time less the host time.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    HostCallShim_Enter()
+ ******************************************************************************/
+void HostCallShim_Leave(struct HostCallCounters *Counters)
+{
+    Counters->TotalTicks+=PerfTimer_Now()-Counters->EnterTicks;
+    m_CurrentCounters=NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostCallShim_GetCallName
+ *
+ * SYNOPSIS:
+ *    const char *HostCallShim_GetCallName(e_HostCallType Call);
+ *
+ * PARAMETERS:
+ *    Call [I] -- The call to get the name of
+ *
+ * FUNCTION:
+ *    This function gets the DPS_API name of a host call.
+ *
+ * RETURNS:
+ *    The name of the call.
+ ******************************************************************************/
+const char *HostCallShim_GetCallName(e_HostCallType Call)
+{
+    if(Call>=e_HostCallMAX)
+        return "?";
+    return m_HostCallNames[Call];
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostCallShim_Count
+ *
+ * SYNOPSIS:
+ *    static inline void HostCallShim_Count(e_HostCallType Call,
+ *              uint64_t Start);
+ *
+ * PARAMETERS:
+ *    Call [I] -- The call that was made
+ *    Start [I] -- The PerfTimer_Now() from before the call was made
+ *
+ * FUNCTION:
+ *    This function adds a call to the current connection's counters.  Calls
+ *    made outside of HostCallShim_Enter() / HostCallShim_Leave() (like
+ *    from FreeData()) are not counted.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static inline void HostCallShim_Count(e_HostCallType Call,uint64_t Start)
+{
+    struct HostCallCounters *Counters;
+    uint64_t Ticks;
+
+    Counters=m_CurrentCounters;
+    if(Counters==NULL)
+        return;
+
+    Ticks=PerfTimer_Now()-Start;
+    Counters->Calls[Call]++;
+    Counters->Ticks[Call]+=Ticks;
+    Counters->HostTicks+=Ticks;
+}
+
+/*******************************************************************************
+ * The wrappers.  These all just time the real call and count it against
+ * the current connection.
+ ******************************************************************************/
+static t_DataProMark *HostCallShim_AllocateMark(void)
+{
+    t_DataProMark *RetValue;
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    RetValue=m_RealDPS->AllocateMark();
+    HostCallShim_Count(e_HostCall_AllocateMark,Start);
+
+    return RetValue;
+}
+
+static void HostCallShim_FreeMark(t_DataProMark *Mark)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->FreeMark(Mark);
+    HostCallShim_Count(e_HostCall_FreeMark,Start);
+}
+
+static PG_BOOL HostCallShim_IsMarkValid(t_DataProMark *Mark)
+{
+    PG_BOOL RetValue;
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    RetValue=m_RealDPS->IsMarkValid(Mark);
+    HostCallShim_Count(e_HostCall_IsMarkValid,Start);
+
+    return RetValue;
+}
+
+static void HostCallShim_SetMark2CursorPos(t_DataProMark *Mark)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->SetMark2CursorPos(Mark);
+    HostCallShim_Count(e_HostCall_SetMark2CursorPos,Start);
+}
+
+static void HostCallShim_ApplyAttrib2Mark(t_DataProMark *Mark,uint32_t Attrib,
+        uint32_t Offset,uint32_t Len)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->ApplyAttrib2Mark(Mark,Attrib,Offset,Len);
+    HostCallShim_Count(e_HostCall_ApplyAttrib2Mark,Start);
+}
+
+static void HostCallShim_RemoveAttribFromMark(t_DataProMark *Mark,
+        uint32_t Attrib,uint32_t Offset,uint32_t Len)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->RemoveAttribFromMark(Mark,Attrib,Offset,Len);
+    HostCallShim_Count(e_HostCall_RemoveAttribFromMark,Start);
+}
+
+static void HostCallShim_ApplyFGColor2Mark(t_DataProMark *Mark,
+        uint32_t FGColor,uint32_t Offset,uint32_t Len)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->ApplyFGColor2Mark(Mark,FGColor,Offset,Len);
+    HostCallShim_Count(e_HostCall_ApplyFGColor2Mark,Start);
+}
+
+static void HostCallShim_ApplyBGColor2Mark(t_DataProMark *Mark,
+        uint32_t BGColor,uint32_t Offset,uint32_t Len)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->ApplyBGColor2Mark(Mark,BGColor,Offset,Len);
+    HostCallShim_Count(e_HostCall_ApplyBGColor2Mark,Start);
+}
+
+static void HostCallShim_MoveMark(t_DataProMark *Mark,int Amount)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->MoveMark(Mark,Amount);
+    HostCallShim_Count(e_HostCall_MoveMark,Start);
+}
+
+static const uint8_t *HostCallShim_GetMarkString(t_DataProMark *Mark,
+        uint32_t *Size,uint32_t Offset,uint32_t Len)
+{
+    const uint8_t *RetValue;
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    RetValue=m_RealDPS->GetMarkString(Mark,Size,Offset,Len);
+    HostCallShim_Count(e_HostCall_GetMarkString,Start);
+
+    return RetValue;
+}
+
+static void HostCallShim_FreezeStream(void)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->FreezeStream();
+    HostCallShim_Count(e_HostCall_FreezeStream,Start);
+}
+
+static void HostCallShim_ClearFrozenStream(void)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->ClearFrozenStream();
+    HostCallShim_Count(e_HostCall_ClearFrozenStream,Start);
+}
+
+static void HostCallShim_ReleaseFrozenStream(void)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->ReleaseFrozenStream();
+    HostCallShim_Count(e_HostCall_ReleaseFrozenStream,Start);
+}
+
+static const uint8_t *HostCallShim_GetFrozenString(uint32_t *Size)
+{
+    const uint8_t *RetValue;
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    RetValue=m_RealDPS->GetFrozenString(Size);
+    HostCallShim_Count(e_HostCall_GetFrozenString,Start);
+
+    return RetValue;
+}
+
+static void HostCallShim_ApplyStyle2Mark(t_DataProMark *Mark,uint32_t FGColor,
+        uint32_t BGColor,uint32_t Attribs,uint32_t ULineColor,uint32_t Offset,
+        uint32_t Len,uint32_t Mask)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->ApplyStyle2Mark(Mark,FGColor,BGColor,Attribs,ULineColor,Offset,
+            Len,Mask);
+    HostCallShim_Count(e_HostCall_ApplyStyle2Mark,Start);
+}
+
+static void HostCallShim_GetScrollBackLines(uint64_t *FirstLine,
+        uint64_t *EndLine)
+{
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    m_RealDPS->GetScrollBackLines(FirstLine,EndLine);
+    HostCallShim_Count(e_HostCall_GetScrollBackLines,Start);
+}
+
+static const uint8_t *HostCallShim_GetScrollBackLine(uint64_t Line,
+        uint32_t *Size)
+{
+    const uint8_t *RetValue;
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    RetValue=m_RealDPS->GetScrollBackLine(Line,Size);
+    HostCallShim_Count(e_HostCall_GetScrollBackLine,Start);
+
+    return RetValue;
+}
+
+static PG_BOOL HostCallShim_SetMark2ScrollBackLine(t_DataProMark *Mark,
+        uint64_t Line)
+{
+    PG_BOOL RetValue;
+    uint64_t Start;
+
+    Start=PerfTimer_Now();
+    RetValue=m_RealDPS->SetMark2ScrollBackLine(Mark,Line);
+    HostCallShim_Count(e_HostCall_SetMark2ScrollBackLine,Start);
+
+    return RetValue;
+}
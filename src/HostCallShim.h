@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * FILENAME: HostCallShim.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the HostCallShim.cpp file.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __HOSTCALLSHIM_H_
+#define __HOSTCALLSHIM_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include "PluginSDK/DataProcessors.h"
+#include <stdint.h>
+
+/***  DEFINES                          ***/
+/* Set this environment var to 1 to turn the shim on */
+#define HOSTCALLSHIM_ENV_VAR                "WHIPPYTERM_TLH_HOSTCALLS"
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+typedef enum
+{
+    e_HostCall_AllocateMark,
+    e_HostCall_FreeMark,
+    e_HostCall_IsMarkValid,
+    e_HostCall_SetMark2CursorPos,
+    e_HostCall_ApplyAttrib2Mark,
+    e_HostCall_RemoveAttribFromMark,
+    e_HostCall_ApplyFGColor2Mark,
+    e_HostCall_ApplyBGColor2Mark,
+    e_HostCall_MoveMark,
+    e_HostCall_GetMarkString,
+    e_HostCall_FreezeStream,
+    e_HostCall_ClearFrozenStream,
+    e_HostCall_ReleaseFrozenStream,
+    e_HostCall_GetFrozenString,
+    e_HostCall_ApplyStyle2Mark,
+    e_HostCall_GetScrollBackLines,
+    e_HostCall_GetScrollBackLine,
+    e_HostCall_SetMark2ScrollBackLine,
+    e_HostCallMAX
+} e_HostCallType;
+
+/* Only the connection's thread writes to these */
+struct HostCallCounters
+{
+    uint64_t Calls[e_HostCallMAX];
+    uint64_t Ticks[e_HostCallMAX];
+    uint64_t HostTicks;         // Time spent in all the calls
+    uint64_t TotalTicks;        // Time spent between Enter() and Leave()
+    uint64_t EnterTicks;
+};
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+bool HostCallShim_IsWanted(void);
+const struct DPS_API *HostCallShim_Wrap(const struct DPS_API *RealDPS,
+        int DPSVersion);
+void HostCallShim_Reset(struct HostCallCounters *Counters);
+void HostCallShim_Enter(struct HostCallCounters *Counters);
+void HostCallShim_Leave(struct HostCallCounters *Counters);
+const char *HostCallShim_GetCallName(e_HostCallType Call);
+
+#endif
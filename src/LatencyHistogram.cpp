@@ -0,0 +1,369 @@
+/*******************************************************************************
+ * FILENAME: LatencyHistogram.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a HDR (high dynamic range) style histogram for recording
+ *    latencies.  The buckets are log spaced (each power of 2 is split in to
+ *    LATENCYHIST_SUB_BUCKETS linear buckets) so it uses the same amount of
+ *    memory no matter how many values are recorded and still has a fixed
+ *    relative precision from 1 tick up to many minutes.
+ *
+ *    There is only ever one thread recording in to a histogram (the
+ *    connection's thread) so recording is just relaxed loads and stores, no
+ *    locks or read/modify/write atomics.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "LatencyHistogram.h"
+#if defined(_MSC_VER)
+ #include <intrin.h>
+#endif
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define MAX_RECORDABLE_VALUE    ((((uint64_t)1)<<LATENCYHIST_MAX_VALUE_BITS)-1)
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+static inline int LatencyHist_HighestBit(uint64_t Value);
+static inline unsigned int LatencyHist_BucketIndex(uint64_t Value);
+static void LatencyHist_BucketRange(unsigned int Index,uint64_t *Low,
+        uint64_t *High);
+
+/*** VARIABLE DEFINITIONS     ***/
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_Reset
+ *
+ * SYNOPSIS:
+ *    void LatencyHist_Reset(struct LatencyHistogram *Hist);
+ *
+ * PARAMETERS:
+ *    Hist [I] -- The histogram to clear
+ *
+ * FUNCTION:
+ *    This function zeros a histogram.  It must be called before the
+ *    histogram is first used.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void LatencyHist_Reset(struct LatencyHistogram *Hist)
+{
+    unsigned int b;
+
+    for(b=0;b<LATENCYHIST_BUCKETS;b++)
+        Hist->Buckets[b].store(0,memory_order_relaxed);
+    Hist->Count.store(0,memory_order_relaxed);
+    Hist->Max.store(0,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_Record
+ *
+ * SYNOPSIS:
+ *    void LatencyHist_Record(struct LatencyHistogram *Hist,uint64_t Value);
+ *
+ * PARAMETERS:
+ *    Hist [I] -- The histogram to add to
+ *    Value [I] -- The value to record (in what ever units you like, normally
+ *                 PerfTimer ticks)
+ *
+ * FUNCTION:
+ *    This function records a value in the histogram.  Only one thread may
+ *    record in to a histogram.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void LatencyHist_Record(struct LatencyHistogram *Hist,uint64_t Value)
+{
+    unsigned int Index;
+
+    if(Value>MAX_RECORDABLE_VALUE)
+        Value=MAX_RECORDABLE_VALUE;
+
+    Index=LatencyHist_BucketIndex(Value);
+    Hist->Buckets[Index].store(Hist->Buckets[Index].load(
+            memory_order_relaxed)+1,memory_order_relaxed);
+    Hist->Count.store(Hist->Count.load(memory_order_relaxed)+1,
+            memory_order_relaxed);
+    if(Value>Hist->Max.load(memory_order_relaxed))
+        Hist->Max.store(Value,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_Percentile
+ *
+ * SYNOPSIS:
+ *    uint64_t LatencyHist_Percentile(const struct LatencyHistogram *Hist,
+ *              double Percent);
+ *
+ * PARAMETERS:
+ *    Hist [I] -- The histogram to read
+ *    Percent [I] -- The percentile to find (0-100)
+ *
+ * FUNCTION:
+ *    This function finds the value that 'Percent' of the recorded values
+ *    are at or below.  The value returned is the top of the bucket the
+ *    percentile falls in (but never more than the max recorded).
+ *
+ * RETURNS:
+ *    The value at the percentile or 0 if nothing has been recorded.
+ ******************************************************************************/
+uint64_t LatencyHist_Percentile(const struct LatencyHistogram *Hist,
+        double Percent)
+{
+    uint64_t Total;
+    uint64_t Wanted;
+    uint64_t Seen;
+    uint64_t Low;
+    uint64_t High;
+    uint64_t Max;
+    unsigned int b;
+
+    /* Add the buckets up ourself instead of using 'Count' so we agree with
+       the buckets if a record is happening while we read */
+    Total=0;
+    for(b=0;b<LATENCYHIST_BUCKETS;b++)
+        Total+=Hist->Buckets[b].load(memory_order_relaxed);
+    if(Total==0)
+        return 0;
+
+    Wanted=(uint64_t)(Total*Percent/100.0+0.5);
+    if(Wanted<1)
+        Wanted=1;
+    if(Wanted>Total)
+        Wanted=Total;
+
+    Max=Hist->Max.load(memory_order_relaxed);
+    Seen=0;
+    for(b=0;b<LATENCYHIST_BUCKETS;b++)
+    {
+        Seen+=Hist->Buckets[b].load(memory_order_relaxed);
+        if(Seen>=Wanted)
+        {
+            LatencyHist_BucketRange(b,&Low,&High);
+            return High<Max?High:Max;
+        }
+    }
+    return Max;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_Summary
+ *
+ * SYNOPSIS:
+ *    void LatencyHist_Summary(const struct LatencyHistogram *Hist,
+ *              struct LatencyHistogramSummary *Summary);
+ *
+ * PARAMETERS:
+ *    Hist [I] -- The histogram to read
+ *    Summary [O] -- The count, p50, p90, p99, p99.9 and max
+ *
+ * FUNCTION:
+ *    This function reads the standard set of percentiles from a histogram.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void LatencyHist_Summary(const struct LatencyHistogram *Hist,
+        struct LatencyHistogramSummary *Summary)
+{
+    Summary->Count=Hist->Count.load(memory_order_relaxed);
+    Summary->P50=LatencyHist_Percentile(Hist,50.0);
+    Summary->P90=LatencyHist_Percentile(Hist,90.0);
+    Summary->P99=LatencyHist_Percentile(Hist,99.0);
+    Summary->P999=LatencyHist_Percentile(Hist,99.9);
+    Summary->Max=Hist->Max.load(memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_Dump
+ *
+ * SYNOPSIS:
+ *    void LatencyHist_Dump(const struct LatencyHistogram *Hist,FILE *out,
+ *              uint64_t (*Convert)(uint64_t Value));
+ *
+ * PARAMETERS:
+ *    Hist [I] -- The histogram to write out
+ *    out [I] -- The file to write to
+ *    Convert [I] -- A function to convert the recorded values to the units
+ *                   to write (for example PerfTimer_Ticks2NS()).  NULL to
+ *                   write the values as recorded.
+ *
+ * FUNCTION:
+ *    This function writes the none empty buckets of a histogram out as
+ *    CSV lines:
+ *          low,high,count,cumulative_percent
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void LatencyHist_Dump(const struct LatencyHistogram *Hist,FILE *out,
+        uint64_t (*Convert)(uint64_t Value))
+{
+    uint64_t Total;
+    uint64_t Seen;
+    uint64_t Count;
+    uint64_t Low;
+    uint64_t High;
+    unsigned int b;
+
+    Total=0;
+    for(b=0;b<LATENCYHIST_BUCKETS;b++)
+        Total+=Hist->Buckets[b].load(memory_order_relaxed);
+
+    fprintf(out,"low,high,count,cumulative_percent\n");
+    Seen=0;
+    for(b=0;b<LATENCYHIST_BUCKETS;b++)
+    {
+        Count=Hist->Buckets[b].load(memory_order_relaxed);
+        if(Count==0)
+            continue;
+        Seen+=Count;
+
+        LatencyHist_BucketRange(b,&Low,&High);
+        if(Convert!=NULL)
+        {
+            Low=Convert(Low);
+            High=Convert(High);
+        }
+        fprintf(out,"%llu,%llu,%llu,%.4f\n",(unsigned long long)Low,
+                (unsigned long long)High,(unsigned long long)Count,
+                Seen*100.0/Total);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_HighestBit
+ *
+ * SYNOPSIS:
+ *    static inline int LatencyHist_HighestBit(uint64_t Value);
+ *
+ * PARAMETERS:
+ *    Value [I] -- The value to look at (must not be 0)
+ *
+ * FUNCTION:
+ *    This function finds the bit number of the highest set bit.
+ *
+ * RETURNS:
+ *    The bit number (0-63)
+ ******************************************************************************/
+static inline int LatencyHist_HighestBit(uint64_t Value)
+{
+#if defined(__GNUC__)
+    return 63-__builtin_clzll(Value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long Bit;
+    _BitScanReverse64(&Bit,Value);
+    return Bit;
+#else
+    int Bit;
+
+    Bit=0;
+    while(Value>>=1)
+        Bit++;
+    return Bit;
+#endif
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_BucketIndex
+ *
+ * SYNOPSIS:
+ *    static inline unsigned int LatencyHist_BucketIndex(uint64_t Value);
+ *
+ * PARAMETERS:
+ *    Value [I] -- The value to find the bucket for
+ *
+ * FUNCTION:
+ *    This function works out which bucket a value goes in.  Values under
+ *    2*LATENCYHIST_SUB_BUCKETS get a bucket each.  After that each power
+ *    of 2 gets LATENCYHIST_SUB_BUCKETS buckets.
+ *
+ * RETURNS:
+ *    The bucket index.
+ ******************************************************************************/
+static inline unsigned int LatencyHist_BucketIndex(uint64_t Value)
+{
+    int Shift;
+
+    if(Value<2*LATENCYHIST_SUB_BUCKETS)
+        return Value;
+
+    Shift=LatencyHist_HighestBit(Value)-LATENCYHIST_SUB_BUCKET_BITS;
+    return Shift*LATENCYHIST_SUB_BUCKETS+(Value>>Shift);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LatencyHist_BucketRange
+ *
+ * SYNOPSIS:
+ *    static void LatencyHist_BucketRange(unsigned int Index,uint64_t *Low,
+ *              uint64_t *High);
+ *
+ * PARAMETERS:
+ *    Index [I] -- The bucket index
+ *    Low [O] -- The lowest value that goes in this bucket
+ *    High [O] -- The highest value that goes in this bucket
+ *
+ * FUNCTION:
+ *    This function is the reverse of LatencyHist_BucketIndex().
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void LatencyHist_BucketRange(unsigned int Index,uint64_t *Low,
+        uint64_t *High)
+{
+    unsigned int Shift;
+    uint64_t Sub;
+
+    if(Index<2*LATENCYHIST_SUB_BUCKETS)
+    {
+        *Low=Index;
+        *High=Index;
+        return;
+    }
+
+    Shift=Index/LATENCYHIST_SUB_BUCKETS-1;
+    Sub=Index-Shift*LATENCYHIST_SUB_BUCKETS;
+    *Low=Sub<<Shift;
+    *High=((Sub+1)<<Shift)-1;
+}
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * FILENAME: LatencyHistogram.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the LatencyHistogram.cpp file.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __LATENCYHISTOGRAM_H_
+#define __LATENCYHISTOGRAM_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+/***  DEFINES                          ***/
+/* Each power of 2 is split in to this many buckets (2^5, so each bucket is
+   within about 3% of the value recorded) */
+#define LATENCYHIST_SUB_BUCKET_BITS         5
+#define LATENCYHIST_SUB_BUCKETS             (1<<LATENCYHIST_SUB_BUCKET_BITS)
+/* The biggest value we can record is 2^this (bigger values are clipped) */
+#define LATENCYHIST_MAX_VALUE_BITS          44
+#define LATENCYHIST_BUCKETS                 ((LATENCYHIST_MAX_VALUE_BITS-  \
+                                                LATENCYHIST_SUB_BUCKET_BITS+1)* \
+                                                LATENCYHIST_SUB_BUCKETS)
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+/* The recorder is the only one to write to this.  Anyone can read it at any
+   time without locks (they may see a record half way in, which just means
+   'Count' may be off by one from the bucket total) */
+struct LatencyHistogram
+{
+    std::atomic<uint64_t> Buckets[LATENCYHIST_BUCKETS];
+    std::atomic<uint64_t> Count;
+    std::atomic<uint64_t> Max;
+};
+
+struct LatencyHistogramSummary
+{
+    uint64_t Count;
+    uint64_t P50;
+    uint64_t P90;
+    uint64_t P99;
+    uint64_t P999;
+    uint64_t Max;
+};
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+void LatencyHist_Reset(struct LatencyHistogram *Hist);
+void LatencyHist_Record(struct LatencyHistogram *Hist,uint64_t Value);
+uint64_t LatencyHist_Percentile(const struct LatencyHistogram *Hist,
+        double Percent);
+void LatencyHist_Summary(const struct LatencyHistogram *Hist,
+        struct LatencyHistogramSummary *Summary);
+void LatencyHist_Dump(const struct LatencyHistogram *Hist,FILE *out,
+        uint64_t (*Convert)(uint64_t Value));
+
+#endif
@@ -0,0 +1,784 @@
+/*******************************************************************************
+ * FILENAME: LineMatch.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This has the matching kernels for the text line highlighter.  Everything
+ *    in here works on a line buffer + length and does not talk to WhippyTerm
+ *    so it can be linked into the tools (bench marks, fuzzers, etc).
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "LineMatch.h"
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+static inline regex_constants::match_flag_type LineMatch_RegexFlags(
+        uint32_t Flags);
+
+/*** VARIABLE DEFINITIONS     ***/
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_StartsWith
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_StartsWith(const uint8_t *Line,uint32_t Len,
+ *          const char *Str,uint32_t StrLen);
+ *
+ * PARAMETERS:
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Str [I] -- The string to look for
+ *    StrLen [I] -- The number of bytes in 'Str'
+ *
+ * FUNCTION:
+ *    This function checks if a line starts with a string.
+ *
+ * RETURNS:
+ *    true -- The line starts with 'Str'
+ *    false -- It does not
+ *
+ * SEE ALSO:
+ *    LineMatch_EndsWith(), LineMatch_Contains()
+ ******************************************************************************/
+bool LineMatch_StartsWith(const uint8_t *Line,uint32_t Len,const char *Str,
+        uint32_t StrLen)
+{
+    if(StrLen>Len)
+        return false;
+    return memcmp(Line,Str,StrLen)==0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_EndsWith
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_EndsWith(const uint8_t *Line,uint32_t Len,
+ *          const char *Str,uint32_t StrLen);
+ *
+ * PARAMETERS:
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Str [I] -- The string to look for
+ *    StrLen [I] -- The number of bytes in 'Str'
+ *
+ * FUNCTION:
+ *    This function checks if a line ends with a string.
+ *
+ * RETURNS:
+ *    true -- The line ends with 'Str'
+ *    false -- It does not
+ *
+ * SEE ALSO:
+ *    LineMatch_StartsWith(), LineMatch_Contains()
+ ******************************************************************************/
+bool LineMatch_EndsWith(const uint8_t *Line,uint32_t Len,const char *Str,
+        uint32_t StrLen)
+{
+    if(StrLen>Len)
+        return false;
+    return memcmp(&Line[Len-StrLen],Str,StrLen)==0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_Contains
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_Contains(const uint8_t *Line,uint32_t Len,
+ *          const char *Str,uint32_t StrLen);
+ *
+ * PARAMETERS:
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Str [I] -- The string to look for
+ *    StrLen [I] -- The number of bytes in 'Str'
+ *
+ * FUNCTION:
+ *    This function checks if a string is anywhere in a line.
+ *
+ * RETURNS:
+ *    true -- The line has 'Str' in it
+ *    false -- It does not
+ *
+ * SEE ALSO:
+ *    LineMatch_StartsWith(), LineMatch_EndsWith(), LineMatch_FindContains()
+ ******************************************************************************/
+bool LineMatch_Contains(const uint8_t *Line,uint32_t Len,const char *Str,
+        uint32_t StrLen)
+{
+    return LineMatch_FindContains(Line,Len,Str,StrLen)!=NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_FindContains
+ *
+ * SYNOPSIS:
+ *    const uint8_t *LineMatch_FindContains(const uint8_t *Line,uint32_t Len,
+ *          const char *Str,uint32_t StrLen);
+ *
+ * PARAMETERS:
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Str [I] -- The string to look for
+ *    StrLen [I] -- The number of bytes in 'Str'
+ *
+ * FUNCTION:
+ *    This function finds the first place a string is in a line.  It uses
+ *    memchr() to skip to the places where the first char of 'Str' is and
+ *    only compares the rest of the string there.
+ *
+ * RETURNS:
+ *    A pointer to where 'Str' starts in 'Line' or NULL if it isn't there
+ *
+ * SEE ALSO:
+ *    LineMatch_Contains()
+ ******************************************************************************/
+const uint8_t *LineMatch_FindContains(const uint8_t *Line,uint32_t Len,
+        const char *Str,uint32_t StrLen)
+{
+    const uint8_t *Pos;
+    const uint8_t *End;
+
+    if(StrLen==0)
+        return Line;
+    if(StrLen>Len)
+        return NULL;
+
+    /* 'End' is one past the last place the string could start */
+    End=Line+(Len-StrLen)+1;
+    Pos=Line;
+    while(Pos<End)
+    {
+        Pos=(const uint8_t *)memchr(Pos,(uint8_t)Str[0],End-Pos);
+        if(Pos==NULL)
+            return NULL;
+        if(memcmp(Pos+1,Str+1,StrLen-1)==0)
+            return Pos;
+        Pos++;
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_Regex
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_Regex(const uint8_t *Line,uint32_t Len,
+ *          const std::regex &Pattern,uint32_t Flags);
+ *
+ * PARAMETERS:
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Pattern [I] -- The compiled regex to search for
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* if 'Line' is only part of the line
+ *                 (so ^ and $ don't match at the ends of it)
+ *
+ * FUNCTION:
+ *    This function searches a line for a regex.
+ *
+ * RETURNS:
+ *    true -- The regex was found in the line
+ *    false -- It was not
+ *
+ * SEE ALSO:
+ *    LineMatch_AddRule()
+ ******************************************************************************/
+bool LineMatch_Regex(const uint8_t *Line,uint32_t Len,const std::regex &Pattern,
+        uint32_t Flags)
+{
+    return regex_search((const char *)Line,(const char *)Line+Len,Pattern,
+            LineMatch_RegexFlags(Flags));
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_FindRegex
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_FindRegex(const uint8_t *Line,uint32_t Len,
+ *          const std::regex &Pattern,uint32_t Flags,uint32_t *Start,
+ *          uint32_t *MatchLen);
+ *
+ * PARAMETERS:
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Pattern [I] -- The compiled regex to search for
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* (see LineMatch_Regex())
+ *    Start [O] -- Where the match starts in 'Line'
+ *    MatchLen [O] -- The number of bytes that matched (can be 0)
+ *
+ * FUNCTION:
+ *    This function is the same as LineMatch_Regex() but also returns where
+ *    the (first) match is.
+ *
+ * RETURNS:
+ *    true -- The regex was found in the line
+ *    false -- It was not
+ *
+ * SEE ALSO:
+ *    LineMatch_Regex()
+ ******************************************************************************/
+bool LineMatch_FindRegex(const uint8_t *Line,uint32_t Len,
+        const std::regex &Pattern,uint32_t Flags,uint32_t *Start,
+        uint32_t *MatchLen)
+{
+    cmatch Match;
+
+    if(!regex_search((const char *)Line,(const char *)Line+Len,Match,Pattern,
+            LineMatch_RegexFlags(Flags)))
+    {
+        return false;
+    }
+
+    *Start=Match.position(0);
+    *MatchLen=Match.length(0);
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_AddRule
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_AddRule(t_LineMatchRuleList &Rules,
+ *          e_LineMatchRuleType Type,const char *Str,int StyleIndex,
+ *          bool MatchSpan);
+ *
+ * PARAMETERS:
+ *    Rules [I/O] -- The list of rules to add to
+ *    Type [I] -- What type of match this rule does
+ *    Str [I] -- The string to match (or the regex for e_LineMatchRule_Regex)
+ *    StyleIndex [I] -- The style to use when this rule matches
+ *    MatchSpan [I] -- Only style the part of the line that matched (true)
+ *                     or the whole line (false)
+ *
+ * FUNCTION:
+ *    This function adds a rule to the end of a rule list.  Regex's are
+ *    compiled here so the kernels never have to.
+ *
+ * RETURNS:
+ *    true -- The rule was added
+ *    false -- The rule was not added (empty string or a bad regex)
+ *
+ * SEE ALSO:
+ *    LineMatch_TestRule()
+ ******************************************************************************/
+bool LineMatch_AddRule(t_LineMatchRuleList &Rules,e_LineMatchRuleType Type,
+        const char *Str,int StyleIndex,bool MatchSpan)
+{
+    struct LineMatchRule NewRule;
+
+    if(*Str==0)
+        return false;
+
+    try
+    {
+        NewRule.Type=Type;
+        NewRule.Literal=Str;
+        NewRule.StyleIndex=StyleIndex;
+        NewRule.MatchSpan=MatchSpan;
+        if(Type==e_LineMatchRule_Regex)
+            NewRule.Pattern.assign(Str);
+
+        Rules.push_back(NewRule);
+    }
+    catch(...)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_TestRule
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_TestRule(const struct LineMatchRule *Rule,
+ *          const uint8_t *Line,uint32_t Len,uint32_t Flags);
+ *
+ * PARAMETERS:
+ *    Rule [I] -- The rule to test
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* if 'Line' is only part of the line.
+ *                 Starts with rules never match if it isn't the start of
+ *                 the line, ends with rules if it isn't the end.
+ *
+ * FUNCTION:
+ *    This function runs the kernel for a rule on a line.
+ *
+ * RETURNS:
+ *    true -- The rule matches the line
+ *    false -- It does not
+ *
+ * SEE ALSO:
+ *    LineMatch_AddRule()
+ ******************************************************************************/
+bool LineMatch_TestRule(const struct LineMatchRule *Rule,const uint8_t *Line,
+        uint32_t Len,uint32_t Flags)
+{
+    switch(Rule->Type)
+    {
+        case e_LineMatchRule_StartsWith:
+            if(Flags&LINEMATCH_NOT_LINE_START)
+                return false;
+            return LineMatch_StartsWith(Line,Len,Rule->Literal.c_str(),
+                    Rule->Literal.length());
+        case e_LineMatchRule_Contains:
+            return LineMatch_Contains(Line,Len,Rule->Literal.c_str(),
+                    Rule->Literal.length());
+        case e_LineMatchRule_EndsWith:
+            if(Flags&LINEMATCH_NOT_LINE_END)
+                return false;
+            return LineMatch_EndsWith(Line,Len,Rule->Literal.c_str(),
+                    Rule->Literal.length());
+        case e_LineMatchRule_Regex:
+            return LineMatch_Regex(Line,Len,Rule->Pattern,Flags);
+        case e_LineMatchRuleMAX:
+        default:
+        break;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_FindRule
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_FindRule(const struct LineMatchRule *Rule,
+ *          const uint8_t *Line,uint32_t Len,uint32_t Flags,uint32_t *Start,
+ *          uint32_t *MatchLen);
+ *
+ * PARAMETERS:
+ *    Rule [I] -- The rule to test
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* (see LineMatch_TestRule())
+ *    Start [O] -- Where the match starts in 'Line'
+ *    MatchLen [O] -- The number of bytes that matched
+ *
+ * FUNCTION:
+ *    This function is the same as LineMatch_TestRule() but also returns
+ *    where in the line the rule matched.  Contains and regex rules return
+ *    the first match.
+ *
+ * RETURNS:
+ *    true -- The rule matches the line
+ *    false -- It does not
+ *
+ * SEE ALSO:
+ *    LineMatch_TestRule()
+ ******************************************************************************/
+bool LineMatch_FindRule(const struct LineMatchRule *Rule,const uint8_t *Line,
+        uint32_t Len,uint32_t Flags,uint32_t *Start,uint32_t *MatchLen)
+{
+    const uint8_t *Pos;
+
+    switch(Rule->Type)
+    {
+        case e_LineMatchRule_StartsWith:
+            if((Flags&LINEMATCH_NOT_LINE_START) || !LineMatch_StartsWith(Line,Len,Rule->Literal.c_str(),
+                    Rule->Literal.length()))
+            {
+                return false;
+            }
+            *Start=0;
+            *MatchLen=Rule->Literal.length();
+            return true;
+        case e_LineMatchRule_Contains:
+            Pos=LineMatch_FindContains(Line,Len,Rule->Literal.c_str(),
+                    Rule->Literal.length());
+            if(Pos==NULL)
+                return false;
+            *Start=Pos-Line;
+            *MatchLen=Rule->Literal.length();
+            return true;
+        case e_LineMatchRule_EndsWith:
+            if((Flags&LINEMATCH_NOT_LINE_END) || !LineMatch_EndsWith(Line,Len,Rule->Literal.c_str(),
+                    Rule->Literal.length()))
+            {
+                return false;
+            }
+            *Start=Len-Rule->Literal.length();
+            *MatchLen=Rule->Literal.length();
+            return true;
+        case e_LineMatchRule_Regex:
+            return LineMatch_FindRegex(Line,Len,Rule->Pattern,Flags,Start,
+                    MatchLen);
+        case e_LineMatchRuleMAX:
+        default:
+        break;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_SetGroupStyles
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_SetGroupStyles(struct LineMatchRule *Rule,
+ *          const t_LineMatchGroupStyleList &Groups);
+ *
+ * PARAMETERS:
+ *    Rule [I/O] -- The regex rule to set the group styles on
+ *    Groups [I] -- The capture groups to style and the style for each
+ *
+ * FUNCTION:
+ *    This function sets what styles to use on what capture groups when a
+ *    regex rule matches.  Groups the regex doesn't have are dropped.  Once
+ *    a rule has group styles only the groups are styled (use group 0 to
+ *    style the whole match as well).
+ *
+ * RETURNS:
+ *    true -- All the groups were set
+ *    false -- Some groups were dropped (or this isn't a regex rule)
+ *
+ * SEE ALSO:
+ *    LineMatch_AddGroupSpans()
+ ******************************************************************************/
+bool LineMatch_SetGroupStyles(struct LineMatchRule *Rule,
+        const t_LineMatchGroupStyleList &Groups)
+{
+    size_t g;
+
+    Rule->Groups.clear();
+    if(Rule->Type!=e_LineMatchRule_Regex)
+        return Groups.empty();
+
+    for(g=0;g<Groups.size();g++)
+        if(Groups[g].Group<=Rule->Pattern.mark_count())
+            Rule->Groups.push_back(Groups[g]);
+
+    return Rule->Groups.size()==Groups.size();
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_AddGroupSpans
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_AddGroupSpans(const struct LineMatchRule *Rule,
+ *          const uint8_t *Line,uint32_t Len,uint32_t Flags,
+ *          struct LineMatchSpanSet *Set);
+ *
+ * PARAMETERS:
+ *    Rule [I] -- The regex rule (with group styles) to run
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* (see LineMatch_Regex())
+ *    Set [I/O] -- The span set to add the group spans to
+ *
+ * FUNCTION:
+ *    This function runs a regex rule on a line and if it matches adds a
+ *    span for each capture group in 'Rule->Groups' (in the order they are
+ *    listed).  The submatches come from the same search that found the
+ *    match, the line is only scanned once.  Groups that didn't take part
+ *    in the match are skipped.
+ *
+ * RETURNS:
+ *    true -- The rule matches the line
+ *    false -- It does not
+ *
+ * SEE ALSO:
+ *    LineMatch_SetGroupStyles(), LineMatch_AddSpan()
+ ******************************************************************************/
+bool LineMatch_AddGroupSpans(const struct LineMatchRule *Rule,
+        const uint8_t *Line,uint32_t Len,uint32_t Flags,
+        struct LineMatchSpanSet *Set)
+{
+    cmatch Match;
+    size_t g;
+    unsigned int Group;
+
+    if(!regex_search((const char *)Line,(const char *)Line+Len,Match,
+            Rule->Pattern,LineMatch_RegexFlags(Flags)))
+    {
+        return false;
+    }
+
+    for(g=0;g<Rule->Groups.size();g++)
+    {
+        Group=Rule->Groups[g].Group;
+        if(Group>=Match.size() || !Match[Group].matched)
+            continue;
+        LineMatch_AddSpan(Set,Match.position(Group),Match.length(Group),
+                Rule->Groups[g].StyleIndex);
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_RunRule
+ *
+ * SYNOPSIS:
+ *    bool LineMatch_RunRule(const struct LineMatchRule *Rule,
+ *          const uint8_t *Line,uint32_t Len,uint32_t Flags,
+ *          struct LineMatchSpanSet *Set);
+ *
+ * PARAMETERS:
+ *    Rule [I] -- The rule to run
+ *    Line [I] -- The line to check
+ *    Len [I] -- The number of bytes in 'Line'
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* (see LineMatch_TestRule())
+ *    Set [I/O] -- The span set to add what the rule wants styled to
+ *
+ * FUNCTION:
+ *    This function runs a rule on a line and if it matches adds the spans
+ *    it wants styled: its capture groups if it has group styles, what it
+ *    matched if it is a match span rule, or else the whole line.
+ *
+ * RETURNS:
+ *    true -- The rule matches the line
+ *    false -- It does not
+ *
+ * SEE ALSO:
+ *    LineMatch_TestRule(), LineMatch_MergeSpans()
+ ******************************************************************************/
+bool LineMatch_RunRule(const struct LineMatchRule *Rule,const uint8_t *Line,
+        uint32_t Len,uint32_t Flags,struct LineMatchSpanSet *Set)
+{
+    uint32_t Start;
+    uint32_t MatchLen;
+
+    if(!Rule->Groups.empty())
+        return LineMatch_AddGroupSpans(Rule,Line,Len,Flags,Set);
+
+    if(Rule->MatchSpan)
+    {
+        if(!LineMatch_FindRule(Rule,Line,Len,Flags,&Start,&MatchLen))
+            return false;
+        LineMatch_AddSpan(Set,Start,MatchLen,Rule->StyleIndex);
+        return true;
+    }
+
+    if(!LineMatch_TestRule(Rule,Line,Len,Flags))
+        return false;
+    LineMatch_AddSpan(Set,0,Len,Rule->StyleIndex);
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_ClearSpans
+ *
+ * SYNOPSIS:
+ *    void LineMatch_ClearSpans(struct LineMatchSpanSet *Set);
+ *
+ * PARAMETERS:
+ *    Set [I/O] -- The span set to clear
+ *
+ * FUNCTION:
+ *    This function empties a span set so it can be used for the next line.
+ *    The memory is kept.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    LineMatch_AddSpan(), LineMatch_MergeSpans()
+ ******************************************************************************/
+void LineMatch_ClearSpans(struct LineMatchSpanSet *Set)
+{
+    Set->Spans.clear();
+    Set->Intervals.clear();
+    Set->Styles.clear();
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_AddSpan
+ *
+ * SYNOPSIS:
+ *    void LineMatch_AddSpan(struct LineMatchSpanSet *Set,uint32_t Start,
+ *          uint32_t Len,int StyleIndex);
+ *
+ * PARAMETERS:
+ *    Set [I/O] -- The span set to add to
+ *    Start [I] -- The offset into the line of the first byte to style
+ *    Len [I] -- The number of bytes to style
+ *    StyleIndex [I] -- The style to apply
+ *
+ * FUNCTION:
+ *    This function adds a span that a rule wants styled.  Spans must be
+ *    added in rule order (later rules are applied on top of earlier ones).
+ *    Empty spans are ignored.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    LineMatch_MergeSpans()
+ ******************************************************************************/
+void LineMatch_AddSpan(struct LineMatchSpanSet *Set,uint32_t Start,
+        uint32_t Len,int StyleIndex)
+{
+    struct LineMatchSpan NewSpan;
+
+    if(Len==0)
+        return;
+
+    NewSpan.Start=Start;
+    NewSpan.End=Start+Len;
+    NewSpan.StyleIndex=StyleIndex;
+    Set->Spans.push_back(NewSpan);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_MergeSpans
+ *
+ * SYNOPSIS:
+ *    void LineMatch_MergeSpans(struct LineMatchSpanSet *Set);
+ *
+ * PARAMETERS:
+ *    Set [I/O] -- The span set to merge
+ *
+ * FUNCTION:
+ *    This function turns the (possibly overlapping) spans into a sorted
+ *    list of intervals that don't overlap.  Each interval has the list of
+ *    styles that cover it, in the order the spans were added, so applying
+ *    them in that order gives the same result as applying every span on its
+ *    own.  Next to each other intervals with the same styles are joined.
+ *
+ *    The spans are cut at every start and end, so this is
+ *    O(Spans^2) but there is only ever a hand full of spans on a line.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    LineMatch_AddSpan()
+ ******************************************************************************/
+void LineMatch_MergeSpans(struct LineMatchSpanSet *Set)
+{
+    struct LineMatchInterval NewInterval;
+    struct LineMatchInterval *Last;
+    uint32_t First;
+    uint32_t Count;
+    size_t p;
+    size_t s;
+
+    Set->Intervals.clear();
+    Set->Styles.clear();
+    if(Set->Spans.empty())
+        return;
+
+    Set->Points.clear();
+    for(s=0;s<Set->Spans.size();s++)
+    {
+        Set->Points.push_back(Set->Spans[s].Start);
+        Set->Points.push_back(Set->Spans[s].End);
+    }
+    sort(Set->Points.begin(),Set->Points.end());
+    Set->Points.erase(unique(Set->Points.begin(),Set->Points.end()),
+            Set->Points.end());
+
+    for(p=0;p+1<Set->Points.size();p++)
+    {
+        NewInterval.Start=Set->Points[p];
+        NewInterval.End=Set->Points[p+1];
+
+        First=Set->Styles.size();
+        for(s=0;s<Set->Spans.size();s++)
+        {
+            if(Set->Spans[s].Start<=NewInterval.Start &&
+                    Set->Spans[s].End>=NewInterval.End)
+            {
+                Set->Styles.push_back(Set->Spans[s].StyleIndex);
+            }
+        }
+        Count=Set->Styles.size()-First;
+        if(Count==0)
+            continue;
+
+        /* Join it to the last one if it's the same styles */
+        if(!Set->Intervals.empty())
+        {
+            Last=&Set->Intervals.back();
+            if(Last->End==NewInterval.Start && Last->StyleCount==Count &&
+                    equal(Set->Styles.begin()+Last->FirstStyle,
+                    Set->Styles.begin()+Last->FirstStyle+Count,
+                    Set->Styles.begin()+First))
+            {
+                Last->End=NewInterval.End;
+                Set->Styles.resize(First);
+                continue;
+            }
+        }
+
+        NewInterval.FirstStyle=First;
+        NewInterval.StyleCount=Count;
+        Set->Intervals.push_back(NewInterval);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LineMatch_RegexFlags
+ *
+ * SYNOPSIS:
+ *    static inline regex_constants::match_flag_type LineMatch_RegexFlags(
+ *          uint32_t Flags);
+ *
+ * PARAMETERS:
+ *    Flags [I] -- The LINEMATCH_NOT_LINE_* flags
+ *
+ * FUNCTION:
+ *    This function converts our flags to the regex match flags.
+ *
+ * RETURNS:
+ *    The flags to give regex_search()
+ ******************************************************************************/
+static inline regex_constants::match_flag_type LineMatch_RegexFlags(
+        uint32_t Flags)
+{
+    regex_constants::match_flag_type RegexFlags;
+
+    RegexFlags=regex_constants::match_default;
+    if(Flags&LINEMATCH_NOT_LINE_START)
+        RegexFlags|=regex_constants::match_not_bol;
+    if(Flags&LINEMATCH_NOT_LINE_END)
+        RegexFlags|=regex_constants::match_not_eol;
+    return RegexFlags;
+}
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * FILENAME: LineMatch.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This has the matching kernels used by the text line highlighter.  They
+ *    only work on a buffer + length so they can be used (and timed) without
+ *    WhippyTerm.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __LINEMATCH_H_
+#define __LINEMATCH_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include <stdint.h>
+#include <string>
+#include <regex>
+#include <vector>
+
+/***  DEFINES                          ***/
+/* Flags for when the kernels are only given part of a line (a long line is
+   checked in windows) */
+#define LINEMATCH_NOT_LINE_START            0x0001  // Doesn't start at the start of the line
+#define LINEMATCH_NOT_LINE_END              0x0002  // Doesn't go to the end of the line
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+typedef enum
+{
+    e_LineMatchRule_StartsWith,
+    e_LineMatchRule_Contains,
+    e_LineMatchRule_EndsWith,
+    e_LineMatchRule_Regex,
+    e_LineMatchRuleMAX
+} e_LineMatchRuleType;
+
+/* Style a regex capture group */
+struct LineMatchGroupStyle
+{
+    unsigned int Group;
+    int StyleIndex;
+};
+
+typedef std::vector<struct LineMatchGroupStyle> t_LineMatchGroupStyleList;
+
+struct LineMatchRule
+{
+    e_LineMatchRuleType Type;
+    std::string Literal;        // The string for the simple types (and the source for regex)
+    std::regex Pattern;         // Only for e_LineMatchRule_Regex
+    int StyleIndex;
+    bool MatchSpan;             // Only style what matched (not the whole line)
+    t_LineMatchGroupStyleList Groups;   // Regex only.  If not empty only these groups are styled
+};
+
+typedef std::vector<struct LineMatchRule> t_LineMatchRuleList;
+
+/* A part of the line that a rule wants styled */
+struct LineMatchSpan
+{
+    uint32_t Start;
+    uint32_t End;               // One past the last byte
+    int StyleIndex;
+};
+
+/* A part of the line after the spans are merged.  Every byte in it has the
+   same styles applied (in rule order), they are
+   Styles[FirstStyle] to Styles[FirstStyle+StyleCount-1] */
+struct LineMatchInterval
+{
+    uint32_t Start;
+    uint32_t End;
+    uint32_t FirstStyle;
+    uint32_t StyleCount;
+};
+
+/* The spans for a line.  This is kept between lines so the vectors don't
+   have to be allocated again for every line. */
+struct LineMatchSpanSet
+{
+    std::vector<struct LineMatchSpan> Spans;            // In rule order
+    std::vector<uint32_t> Points;                       // Merge scratch
+    std::vector<struct LineMatchInterval> Intervals;    // Sorted, no overlaps
+    std::vector<int> Styles;
+};
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+bool LineMatch_StartsWith(const uint8_t *Line,uint32_t Len,const char *Str,
+        uint32_t StrLen);
+bool LineMatch_EndsWith(const uint8_t *Line,uint32_t Len,const char *Str,
+        uint32_t StrLen);
+bool LineMatch_Contains(const uint8_t *Line,uint32_t Len,const char *Str,
+        uint32_t StrLen);
+const uint8_t *LineMatch_FindContains(const uint8_t *Line,uint32_t Len,
+        const char *Str,uint32_t StrLen);
+bool LineMatch_Regex(const uint8_t *Line,uint32_t Len,const std::regex &Pattern,
+        uint32_t Flags);
+bool LineMatch_FindRegex(const uint8_t *Line,uint32_t Len,
+        const std::regex &Pattern,uint32_t Flags,uint32_t *Start,
+        uint32_t *MatchLen);
+bool LineMatch_AddRule(t_LineMatchRuleList &Rules,e_LineMatchRuleType Type,
+        const char *Str,int StyleIndex,bool MatchSpan);
+bool LineMatch_TestRule(const struct LineMatchRule *Rule,const uint8_t *Line,
+        uint32_t Len,uint32_t Flags);
+bool LineMatch_SetGroupStyles(struct LineMatchRule *Rule,
+        const t_LineMatchGroupStyleList &Groups);
+bool LineMatch_AddGroupSpans(const struct LineMatchRule *Rule,
+        const uint8_t *Line,uint32_t Len,uint32_t Flags,
+        struct LineMatchSpanSet *Set);
+bool LineMatch_FindRule(const struct LineMatchRule *Rule,const uint8_t *Line,
+        uint32_t Len,uint32_t Flags,uint32_t *Start,uint32_t *MatchLen);
+bool LineMatch_RunRule(const struct LineMatchRule *Rule,const uint8_t *Line,
+        uint32_t Len,uint32_t Flags,struct LineMatchSpanSet *Set);
+void LineMatch_ClearSpans(struct LineMatchSpanSet *Set);
+void LineMatch_AddSpan(struct LineMatchSpanSet *Set,uint32_t Start,
+        uint32_t Len,int StyleIndex);
+void LineMatch_MergeSpans(struct LineMatchSpanSet *Set);
+
+#endif
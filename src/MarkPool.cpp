@@ -0,0 +1,239 @@
+/*******************************************************************************
+ * FILENAME: MarkPool.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This file has the parts of the mark pool that call WhippyTerm to
+ *    allocate or free marks.  Retaining and releasing marks is in
+ *    MarkPool.h (they are done every line and never call WhippyTerm).
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "MarkPool.h"
+#include <algorithm>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+static void MarkPool_Rewind(struct MarkPool *Pool);
+
+/*** VARIABLE DEFINITIONS     ***/
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Init
+ *
+ * SYNOPSIS:
+ *    void MarkPool_Init(struct MarkPool *Pool);
+ *
+ * PARAMETERS:
+ *    Pool [O] -- The pool to init
+ *
+ * FUNCTION:
+ *    This function sets up an empty pool with room for just the current
+ *    line's mark.  Nothing is allocated until MarkPool_Fill() is called.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void MarkPool_Init(struct MarkPool *Pool)
+{
+    Pool->Slots.clear();
+    Pool->Size=1;
+    Pool->Head=0;
+    Pool->InUse=0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Fill
+ *
+ * SYNOPSIS:
+ *    uint32_t MarkPool_Fill(struct MarkPool *Pool,const struct DPS_API *DPS);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool to fill
+ *    DPS [I] -- The WhippyTerm API to allocate the marks with
+ *
+ * FUNCTION:
+ *    This function allocates the marks the pool is missing, so retaining a
+ *    mark never has to allocate one.  This has to be called from the
+ *    connection's thread with a connection (WhippyTerm can't allocate marks
+ *    in AllocateData()).
+ *
+ *    The pool can only grow when no marks are retained.  If WhippyTerm
+ *    can't give us a mark we keep the ones we got and try for the rest the
+ *    next time we are called ('Size' is what was asked for, not what we
+ *    have).
+ *
+ * RETURNS:
+ *    The number of marks we asked WhippyTerm for.
+ *
+ * SEE ALSO:
+ *    MarkPool_Resize()
+ ******************************************************************************/
+uint32_t MarkPool_Fill(struct MarkPool *Pool,const struct DPS_API *DPS)
+{
+    struct MarkPoolSlot Slot;
+    uint32_t Calls;
+
+    if(Pool->Slots.size()>=Pool->Size || Pool->InUse!=0)
+        return 0;
+
+    MarkPool_Rewind(Pool);
+
+    Calls=0;
+    Slot.Gen=1;
+    while(Pool->Slots.size()<Pool->Size)
+    {
+        Calls++;
+        Slot.Mark=DPS->AllocateMark();
+        if(Slot.Mark==NULL)
+            break;
+        try
+        {
+            Pool->Slots.push_back(Slot);
+        }
+        catch(...)
+        {
+            DPS->FreeMark(Slot.Mark);
+            Calls++;
+            break;
+        }
+    }
+
+    return Calls;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Resize
+ *
+ * SYNOPSIS:
+ *    uint32_t MarkPool_Resize(struct MarkPool *Pool,const struct DPS_API *DPS,
+ *          uint32_t MaxRetained);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool to resize
+ *    DPS [I] -- The WhippyTerm API to free marks with
+ *    MaxRetained [I] -- The most marks that can be retained at once (the
+ *                       pool has one more for the current line)
+ *
+ * FUNCTION:
+ *    This function changes the size of the pool.  Extra marks are freed now
+ *    (the current line's mark is always kept), new ones are allocated by
+ *    the next MarkPool_Fill().  All the retained marks should be released
+ *    first, if they aren't the pool can't shrink until they are.
+ *
+ * RETURNS:
+ *    The number of marks we freed.
+ *
+ * SEE ALSO:
+ *    MarkPool_Fill()
+ ******************************************************************************/
+uint32_t MarkPool_Resize(struct MarkPool *Pool,const struct DPS_API *DPS,
+        uint32_t MaxRetained)
+{
+    uint32_t Calls;
+
+    Pool->Size=MaxRetained+1;
+    if(Pool->Slots.size()<=Pool->Size || Pool->InUse!=0)
+        return 0;
+
+    MarkPool_Rewind(Pool);
+
+    Calls=0;
+    while(Pool->Slots.size()>Pool->Size)
+    {
+        DPS->FreeMark(Pool->Slots.back().Mark);
+        Pool->Slots.pop_back();
+        Calls++;
+    }
+
+    return Calls;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Free
+ *
+ * SYNOPSIS:
+ *    void MarkPool_Free(struct MarkPool *Pool,const struct DPS_API *DPS);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool to free
+ *    DPS [I] -- The WhippyTerm API to free the marks with
+ *
+ * FUNCTION:
+ *    This function frees all the marks in the pool (retained or not) and
+ *    leaves it empty.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void MarkPool_Free(struct MarkPool *Pool,const struct DPS_API *DPS)
+{
+    size_t s;
+
+    for(s=0;s<Pool->Slots.size();s++)
+        DPS->FreeMark(Pool->Slots[s].Mark);
+    Pool->Slots.clear();
+    Pool->Head=0;
+    Pool->InUse=0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Rewind
+ *
+ * SYNOPSIS:
+ *    static void MarkPool_Rewind(struct MarkPool *Pool);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool
+ *
+ * FUNCTION:
+ *    This function rotates the ring so the current line's mark is in the
+ *    first slot, so slots can be added or removed at the end.  No marks
+ *    can be retained.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MarkPool_Rewind(struct MarkPool *Pool)
+{
+    if(Pool->Head==0)
+        return;
+
+    rotate(Pool->Slots.begin(),Pool->Slots.begin()+Pool->Head,
+            Pool->Slots.end());
+    Pool->Head=0;
+}
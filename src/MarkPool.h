@@ -0,0 +1,223 @@
+/*******************************************************************************
+ * FILENAME: MarkPool.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the MarkPool.cpp file.
+ *
+ *    The pool is a ring of marks allocated from WhippyTerm.  The slot at
+ *    'Head' is the start of the current line.  When a line has to be kept
+ *    (for a record or for the worker thread) it is retained, 'Head' moves
+ *    on to the next slot and that mark becomes the start of the next line.
+ *    Retained marks are released oldest first, so the 'InUse' slots before
+ *    'Head' are always the retained ones and nothing is ever searched.
+ *
+ *    A retained mark is given out as a handle, the slot in the low 32 bits
+ *    and the slot's generation in the high 32 bits.  The generation goes
+ *    up every time the slot is released, so an old handle can't get at the
+ *    mark after it has been reused for another line.  Generations start at
+ *    1 so MARKPOOL_NO_HANDLE (0) is never a good handle.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __MARKPOOL_H_
+#define __MARKPOOL_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include "PluginSDK/DataProcessors.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/***  DEFINES                          ***/
+#define MARKPOOL_NO_HANDLE                  0
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+typedef uint64_t t_MarkPoolHandle;
+
+struct MarkPoolSlot
+{
+    t_DataProMark *Mark;
+    uint32_t Gen;
+};
+
+/* Only used from the connection's thread */
+struct MarkPool
+{
+    std::vector<struct MarkPoolSlot> Slots;     // The ring
+    uint32_t Size;          // The number of slots asked for (MarkPool_Fill()
+                            // keeps trying to grow 'Slots' to this)
+    uint32_t Head;          // The slot of the start of the current line
+    uint32_t InUse;         // Retained marks (the slots just before 'Head')
+};
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+void MarkPool_Init(struct MarkPool *Pool);
+uint32_t MarkPool_Fill(struct MarkPool *Pool,const struct DPS_API *DPS);
+uint32_t MarkPool_Resize(struct MarkPool *Pool,const struct DPS_API *DPS,
+        uint32_t MaxRetained);
+void MarkPool_Free(struct MarkPool *Pool,const struct DPS_API *DPS);
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Current
+ *
+ * SYNOPSIS:
+ *    static inline t_DataProMark *MarkPool_Current(struct MarkPool *Pool);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool
+ *
+ * FUNCTION:
+ *    This function gets the mark for the start of the current line.
+ *
+ * RETURNS:
+ *    The mark or NULL if the pool hasn't been filled yet.
+ ******************************************************************************/
+static inline t_DataProMark *MarkPool_Current(struct MarkPool *Pool)
+{
+    if(Pool->Slots.empty())
+        return NULL;
+    return Pool->Slots[Pool->Head].Mark;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Retain
+ *
+ * SYNOPSIS:
+ *    static inline t_MarkPoolHandle MarkPool_Retain(struct MarkPool *Pool);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool
+ *
+ * FUNCTION:
+ *    This function keeps the mark for the start of the current line and
+ *    moves on to the next mark in the ring for the next line (get it with
+ *    MarkPool_Current()).  The caller has to point the new mark at the
+ *    cursor before using it.
+ *
+ * RETURNS:
+ *    A handle to the kept mark or MARKPOOL_NO_HANDLE if every other mark is
+ *    already retained (the current line's mark stays the current mark).
+ *
+ * SEE ALSO:
+ *    MarkPool_Release(), MarkPool_GetMark()
+ ******************************************************************************/
+static inline t_MarkPoolHandle MarkPool_Retain(struct MarkPool *Pool)
+{
+    t_MarkPoolHandle Handle;
+    uint32_t Count;
+
+    Count=Pool->Slots.size();
+    if(Pool->InUse+1>=Count)
+        return MARKPOOL_NO_HANDLE;
+
+    Handle=((t_MarkPoolHandle)Pool->Slots[Pool->Head].Gen<<32)|Pool->Head;
+    Pool->Head++;
+    if(Pool->Head>=Count)
+        Pool->Head=0;
+    Pool->InUse++;
+
+    return Handle;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_GetMark
+ *
+ * SYNOPSIS:
+ *    static inline t_DataProMark *MarkPool_GetMark(struct MarkPool *Pool,
+ *          t_MarkPoolHandle Handle);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool
+ *    Handle [I] -- The handle from MarkPool_Retain()
+ *
+ * FUNCTION:
+ *    This function gets the mark for a handle.
+ *
+ * RETURNS:
+ *    The mark or NULL if the handle has been released.
+ ******************************************************************************/
+static inline t_DataProMark *MarkPool_GetMark(struct MarkPool *Pool,
+        t_MarkPoolHandle Handle)
+{
+    uint32_t Slot=(uint32_t)Handle;
+
+    if(Slot>=Pool->Slots.size() || Pool->Slots[Slot].Gen!=(Handle>>32))
+        return NULL;
+    return Pool->Slots[Slot].Mark;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MarkPool_Release
+ *
+ * SYNOPSIS:
+ *    static inline bool MarkPool_Release(struct MarkPool *Pool,
+ *          t_MarkPoolHandle Handle);
+ *
+ * PARAMETERS:
+ *    Pool [I] -- The pool
+ *    Handle [I] -- The handle from MarkPool_Retain().  This has to be the
+ *                  oldest retained mark.
+ *
+ * FUNCTION:
+ *    This function gives a retained mark back to the pool.  The handle (and
+ *    any copies of it) stops working.
+ *
+ * RETURNS:
+ *    true -- The mark was released
+ *    false -- The handle wasn't the oldest retained mark (nothing was done)
+ ******************************************************************************/
+static inline bool MarkPool_Release(struct MarkPool *Pool,
+        t_MarkPoolHandle Handle)
+{
+    uint32_t Count;
+    uint32_t Oldest;
+    uint32_t Slot=(uint32_t)Handle;
+
+    Count=Pool->Slots.size();
+    if(Pool->InUse==0)
+        return false;
+    Oldest=Pool->Head>=Pool->InUse?Pool->Head-Pool->InUse:
+            Pool->Head+Count-Pool->InUse;
+    if(Slot!=Oldest || Pool->Slots[Slot].Gen!=(Handle>>32))
+        return false;
+
+    if(++Pool->Slots[Slot].Gen==0)
+        Pool->Slots[Slot].Gen=1;
+    Pool->InUse--;
+
+    return true;
+}
+
+#endif
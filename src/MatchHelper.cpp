@@ -0,0 +1,1172 @@
+/*******************************************************************************
+ * FILENAME: MatchHelper.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This file has both ends of the out of process helper (see
+ *    MatchHelper.h).  The plugin end starts the helper, sends it lines and
+ *    reads back the styles (this is only ever called from the worker thread
+ *    that is checking the connection's jobs).  The helper end
+ *    (MatchHelper_Serve()) is what TextLineHighlighterHelper runs.
+ *
+ *    The helper is given the shared memory and the two eventfds as open
+ *    file handles (their numbers are on the command line).  It loads the
+ *    rules from the shared memory, sets 'Ready' and then checks lines until
+ *    the plugin kills it (or goes away).
+ *
+ *    If the helper doesn't answer for 'TimeoutMS' (it is stuck on a rule or
+ *    it crashed) the plugin kills it and marks it failed.  The worker then
+ *    checks the lines itself with just the simple rules (see
+ *    AsyncMatch_RunHelper()).
+ *
+ *    The helper is Linux only, on other systems MatchHelper_Start() always
+ *    fails.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "MatchHelper.h"
+#include "AsyncMatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+ #include <dlfcn.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <sched.h>
+ #include <signal.h>
+ #include <sys/eventfd.h>
+ #include <sys/mman.h>
+ #include <sys/wait.h>
+ #include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+
+/*** DEFINES                  ***/
+#define MATCHHELPER_MAGIC               0x484C5457      // "WTLH"
+#define MATCHHELPER_VERSION             1
+#define HEADER_SIZE                     4096
+#define RING_SIZE                       (1024*1024)     // Each ring (power of 2)
+#define START_TIMEOUT_MS                5000
+#define POLL_MS                         10
+/* How many responses the helper writes before it wakes up the worker */
+#define RESPONSE_SIGNAL_LINES           8
+/* A response 'StyleCount' for a line the worker has to check itself (its
+   styles wouldn't fit in the ring) */
+#define RESPONSE_LOCAL                  0xFFFFFFFF
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+struct MatchHelperRing
+{
+    alignas(64) atomic<uint64_t> Head;      // Only moved by the writer
+    alignas(64) atomic<uint64_t> Tail;      // Only moved by the reader
+};
+
+/* At the start of the shared memory.  The rules come after it (at
+   HEADER_SIZE) and then the request ring and the response ring. */
+struct MatchHelperShared
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t RulesSize;
+    uint32_t RulesCount;
+    uint32_t RingSize;
+    atomic<uint32_t> Ready;         // Set by the helper once it has the rules
+    struct MatchHelperRing Requests;
+    struct MatchHelperRing Responses;
+};
+
+struct MatchHelperRequest
+{
+    uint32_t Len;                   // AsyncMatchJob::Len
+    uint32_t Size;                  // Bytes of line that follow
+};
+
+struct MatchHelperResponse
+{
+    uint32_t HitCount;              // Rule indexes (uint32_t) that follow
+    uint32_t StyleCount;            // Then this many AsyncMatchStyle's
+};
+
+struct MatchHelper
+{
+    pid_t PID;                      // -1 once it has been killed
+    int RequestFD;
+    int ResponseFD;
+    uint8_t *Mem;
+    size_t MemSize;
+    struct MatchHelperShared *Shared;
+    uint8_t *Requests;
+    uint8_t *Responses;
+    uint32_t TimeoutMS;
+    bool Failed;
+    vector<uint32_t> Hits;          // Scratch for reading a response
+};
+
+/*** FUNCTION PROTOTYPES      ***/
+static bool MatchHelper_GetPath(string &Path);
+static void MatchHelper_PackRules(const t_LineMatchRuleList &Rules,
+        vector<uint8_t> &Out);
+static bool MatchHelper_UnpackRules(const uint8_t *In,uint32_t Size,
+        uint32_t Count,t_LineMatchRuleList &Rules);
+static void MatchHelper_Kill(struct MatchHelper *Helper);
+static bool MatchHelper_Alive(struct MatchHelper *Helper);
+static void MatchHelper_Signal(int FD);
+static void MatchHelper_RingCopyIn(uint8_t *Ring,uint64_t Pos,
+        const void *Data,uint32_t Len);
+static void MatchHelper_RingCopyOut(const uint8_t *Ring,uint64_t Pos,
+        void *Data,uint32_t Len);
+static bool MatchHelper_SendJob(struct MatchHelper *Helper,
+        const struct AsyncMatchJob *Job);
+static bool MatchHelper_ReadResponse(struct MatchHelper *Helper,
+        struct AsyncMatchJob *Job,bool *Local);
+static void MatchHelper_SetCPUs(const char *CPUList);
+
+/*** VARIABLE DEFINITIONS     ***/
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_Start
+ *
+ * SYNOPSIS:
+ *    struct MatchHelper *MatchHelper_Start(const t_LineMatchRuleList &Rules,
+ *          const char *CPUList,uint32_t TimeoutMS);
+ *
+ * PARAMETERS:
+ *    Rules [I] -- The rules the helper checks the lines against
+ *    CPUList [I] -- The CPUs to pin the helper to ("2,4-5"), "" for any
+ *    TimeoutMS [I] -- How long the helper can go without answering before
+ *                     we give up on it
+ *
+ * FUNCTION:
+ *    This function starts a helper process.  The helper is looked for in
+ *    the same directory as the plugin (or the environment variable
+ *    WHIPPYTERM_TLH_HELPER can give the full path).  It waits for the
+ *    helper to load the rules before returning.
+ *
+ * RETURNS:
+ *    The helper or NULL if it couldn't be started.
+ *
+ * SEE ALSO:
+ *    MatchHelper_Free(), MatchHelper_CheckJobs()
+ ******************************************************************************/
+struct MatchHelper *MatchHelper_Start(const t_LineMatchRuleList &Rules,
+        const char *CPUList,uint32_t TimeoutMS)
+{
+    struct MatchHelper *Helper;
+    vector<uint8_t> PackedRules;
+    string Path;
+    char ShareArg[20];
+    char RequestArg[20];
+    char ResponseArg[20];
+    char *Args[6];
+    size_t RulesSpace;
+    uint64_t Count;
+    int ShareFD;
+    int r;
+
+    if(!MatchHelper_GetPath(Path))
+        return NULL;
+
+    Helper=NULL;
+    ShareFD=-1;
+    try
+    {
+        MatchHelper_PackRules(Rules,PackedRules);
+
+        Helper=new struct MatchHelper;
+        Helper->PID=-1;
+        Helper->RequestFD=-1;
+        Helper->ResponseFD=-1;
+        Helper->Mem=(uint8_t *)MAP_FAILED;
+        Helper->TimeoutMS=TimeoutMS;
+        Helper->Failed=false;
+
+        RulesSpace=(PackedRules.size()+HEADER_SIZE-1)/HEADER_SIZE*HEADER_SIZE;
+        Helper->MemSize=HEADER_SIZE+RulesSpace+RING_SIZE*2;
+
+        ShareFD=memfd_create("WhippyTermTLH",MFD_CLOEXEC);
+        if(ShareFD<0 || ftruncate(ShareFD,Helper->MemSize)!=0)
+            throw(0);
+        Helper->Mem=(uint8_t *)mmap(NULL,Helper->MemSize,
+                PROT_READ|PROT_WRITE,MAP_SHARED,ShareFD,0);
+        if(Helper->Mem==(uint8_t *)MAP_FAILED)
+            throw(0);
+
+        /* The memory is zeroed, so the ring counters start at 0 */
+        Helper->Shared=new(Helper->Mem) struct MatchHelperShared;
+        Helper->Shared->Magic=MATCHHELPER_MAGIC;
+        Helper->Shared->Version=MATCHHELPER_VERSION;
+        Helper->Shared->RulesSize=PackedRules.size();
+        Helper->Shared->RulesCount=Rules.size();
+        Helper->Shared->RingSize=RING_SIZE;
+        Helper->Shared->Ready=0;
+        Helper->Shared->Requests.Head=0;
+        Helper->Shared->Requests.Tail=0;
+        Helper->Shared->Responses.Head=0;
+        Helper->Shared->Responses.Tail=0;
+        if(!PackedRules.empty())
+        {
+            memcpy(Helper->Mem+HEADER_SIZE,PackedRules.data(),
+                    PackedRules.size());
+        }
+        Helper->Requests=Helper->Mem+HEADER_SIZE+RulesSpace;
+        Helper->Responses=Helper->Requests+RING_SIZE;
+
+        /* The helper blocks on the requests eventfd, we poll the responses
+           one (non blocking is shared by both ends, so only set it on the
+           one the helper never reads) */
+        Helper->RequestFD=eventfd(0,EFD_CLOEXEC);
+        Helper->ResponseFD=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK);
+        if(Helper->RequestFD<0 || Helper->ResponseFD<0)
+            throw(0);
+
+        /* Everything the child needs is made before the fork, it only
+           makes async-signal-safe calls */
+        sprintf(ShareArg,"%d",ShareFD);
+        sprintf(RequestArg,"%d",Helper->RequestFD);
+        sprintf(ResponseArg,"%d",Helper->ResponseFD);
+        Args[0]=(char *)Path.c_str();
+        Args[1]=ShareArg;
+        Args[2]=RequestArg;
+        Args[3]=ResponseArg;
+        Args[4]=(char *)(CPUList!=NULL?CPUList:"");
+        Args[5]=NULL;
+
+        Helper->PID=fork();
+        if(Helper->PID<0)
+            throw(0);
+        if(Helper->PID==0)
+        {
+            fcntl(ShareFD,F_SETFD,0);
+            fcntl(Helper->RequestFD,F_SETFD,0);
+            fcntl(Helper->ResponseFD,F_SETFD,0);
+            execv(Args[0],Args);
+            _exit(127);
+        }
+        close(ShareFD);
+        ShareFD=-1;
+
+        /* Wait for the helper to load the rules */
+        for(r=0;r<START_TIMEOUT_MS/POLL_MS;r++)
+        {
+            if(Helper->Shared->Ready.load(memory_order_acquire)!=0)
+                break;
+            if(!MatchHelper_Alive(Helper))
+                throw(0);
+            struct pollfd Poll={Helper->ResponseFD,POLLIN,0};
+            if(poll(&Poll,1,POLL_MS)>0)
+            {
+                if(read(Helper->ResponseFD,&Count,sizeof(Count))){}
+            }
+        }
+        if(Helper->Shared->Ready.load(memory_order_acquire)!=1)
+            throw(0);
+    }
+    catch(...)
+    {
+        if(ShareFD>=0)
+            close(ShareFD);
+        MatchHelper_Free(Helper);
+        return NULL;
+    }
+
+    return Helper;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_Free
+ *
+ * SYNOPSIS:
+ *    void MatchHelper_Free(struct MatchHelper *Helper);
+ *
+ * PARAMETERS:
+ *    Helper [I] -- The helper to free (can be NULL)
+ *
+ * FUNCTION:
+ *    This function kills the helper process and frees the shared memory.
+ *    No worker can be using the helper.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void MatchHelper_Free(struct MatchHelper *Helper)
+{
+    if(Helper==NULL)
+        return;
+
+    MatchHelper_Kill(Helper);
+    if(Helper->Mem!=(uint8_t *)MAP_FAILED)
+        munmap(Helper->Mem,Helper->MemSize);
+    if(Helper->RequestFD>=0)
+        close(Helper->RequestFD);
+    if(Helper->ResponseFD>=0)
+        close(Helper->ResponseFD);
+    delete Helper;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_CheckJobs
+ *
+ * SYNOPSIS:
+ *    unsigned int MatchHelper_CheckJobs(struct MatchHelper *Helper,
+ *          struct AsyncMatchJob **Jobs,unsigned int Count,bool *Local);
+ *
+ * PARAMETERS:
+ *    Helper [I] -- The helper
+ *    Jobs [I/O] -- The jobs to check.  Their 'Styles' and 'Hits' are filled
+ *                  in.
+ *    Count [I] -- The number of jobs in 'Jobs'
+ *    Local [O] -- An array of 'Count' that is set to true for the jobs the
+ *                 helper couldn't do (too big for the rings).  The caller
+ *                 has to check these itself.
+ *
+ * FUNCTION:
+ *    This function sends the jobs to the helper and waits for the answers.
+ *    Jobs are sent as long as there is room in the request ring and the
+ *    answers are read as they come in, so any number of jobs can be sent.
+ *
+ *    If the helper goes 'TimeoutMS' without answering (or exits) it is
+ *    killed and marked failed.
+ *
+ * RETURNS:
+ *    The number of jobs (from the start of 'Jobs') that the helper answered.
+ *    This is 'Count' unless the helper failed.
+ *
+ * SEE ALSO:
+ *    MatchHelper_Failed()
+ ******************************************************************************/
+unsigned int MatchHelper_CheckJobs(struct MatchHelper *Helper,
+        struct AsyncMatchJob **Jobs,unsigned int Count,bool *Local)
+{
+    chrono::steady_clock::time_point LastProgress;
+    unsigned int Sent;
+    unsigned int Answered;
+    unsigned int Signaled;
+    uint64_t Value;
+    bool Progress;
+
+    for(Sent=0;Sent<Count;Sent++)
+        Local[Sent]=false;
+
+    if(Helper->Failed)
+        return 0;
+
+    Sent=0;
+    Signaled=0;
+    Answered=0;
+    LastProgress=chrono::steady_clock::now();
+    while(Answered<Count)
+    {
+        Progress=false;
+
+        /* Lines too big for the ring are never sent */
+        while(Sent<Count)
+        {
+            if(sizeof(struct MatchHelperRequest)+Jobs[Sent]->Line.size()>
+                    RING_SIZE)
+            {
+                Local[Sent]=true;
+            }
+            else if(!MatchHelper_SendJob(Helper,Jobs[Sent]))
+            {
+                break;
+            }
+            Sent++;
+        }
+        if(Sent!=Signaled)
+        {
+            MatchHelper_Signal(Helper->RequestFD);
+            Signaled=Sent;
+        }
+
+        while(Answered<Sent)
+        {
+            if(!Local[Answered] && !MatchHelper_ReadResponse(Helper,
+                    Jobs[Answered],&Local[Answered]))
+            {
+                break;
+            }
+            Answered++;
+            Progress=true;
+        }
+        if(Answered==Count)
+            break;
+
+        if(Progress)
+        {
+            LastProgress=chrono::steady_clock::now();
+            continue;
+        }
+
+        if(chrono::steady_clock::now()-LastProgress>
+                chrono::milliseconds(Helper->TimeoutMS) ||
+                !MatchHelper_Alive(Helper))
+        {
+            MatchHelper_Kill(Helper);
+            Helper->Failed=true;
+            break;
+        }
+
+        struct pollfd Poll={Helper->ResponseFD,POLLIN,0};
+        if(poll(&Poll,1,POLL_MS)>0)
+        {
+            if(read(Helper->ResponseFD,&Value,sizeof(Value))){}
+        }
+    }
+
+    return Answered;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_Failed
+ *
+ * SYNOPSIS:
+ *    bool MatchHelper_Failed(struct MatchHelper *Helper);
+ *
+ * PARAMETERS:
+ *    Helper [I] -- The helper
+ *
+ * FUNCTION:
+ *    This function checks if the helper has stopped answering (and been
+ *    killed).  A failed helper is never restarted, the matcher has to be
+ *    started again (which happens when the settings are applied).
+ *
+ * RETURNS:
+ *    true -- The helper has failed
+ *    false -- It is still running
+ ******************************************************************************/
+bool MatchHelper_Failed(struct MatchHelper *Helper)
+{
+    return Helper->Failed;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_Serve
+ *
+ * SYNOPSIS:
+ *    int MatchHelper_Serve(int ShareFD,int RequestFD,int ResponseFD,
+ *          const char *CPUList);
+ *
+ * PARAMETERS:
+ *    ShareFD [I] -- The shared memory
+ *    RequestFD [I] -- The eventfd the plugin signals when it sends lines
+ *    ResponseFD [I] -- The eventfd we signal when we send answers
+ *    CPUList [I] -- The CPUs to run on ("2,4-5"), "" for any
+ *
+ * FUNCTION:
+ *    This is the helper process.  It loads the rules and then checks the
+ *    lines in the request ring until the plugin kills it.  If the plugin
+ *    goes away (we get a new parent) we exit.
+ *
+ * RETURNS:
+ *    The exit code for the helper.
+ ******************************************************************************/
+int MatchHelper_Serve(int ShareFD,int RequestFD,int ResponseFD,
+        const char *CPUList)
+{
+    struct MatchHelperShared *Shared;
+    struct MatchHelperRequest Request;
+    struct MatchHelperResponse Response;
+    struct AsyncMatchJob Job;
+    struct LineMatchSpanSet Spans;
+    t_LineMatchRuleList Rules;
+    vector<uint32_t> Hits;
+    uint8_t *Mem;
+    uint8_t *Requests;
+    uint8_t *Responses;
+    size_t RulesSpace;
+    size_t MemSize;
+    uint64_t Head;
+    uint64_t Tail;
+    uint64_t Need;
+    uint64_t Value;
+    unsigned int Unsignaled;
+    unsigned int r;
+    pid_t Parent;
+
+    Parent=getppid();
+    MatchHelper_SetCPUs(CPUList);
+
+    Mem=(uint8_t *)mmap(NULL,HEADER_SIZE,PROT_READ|PROT_WRITE,MAP_SHARED,
+            ShareFD,0);
+    if(Mem==(uint8_t *)MAP_FAILED)
+        return 1;
+    Shared=(struct MatchHelperShared *)Mem;
+    if(Shared->Magic!=MATCHHELPER_MAGIC ||
+            Shared->Version!=MATCHHELPER_VERSION ||
+            Shared->RingSize!=RING_SIZE)
+    {
+        return 1;
+    }
+    RulesSpace=((size_t)Shared->RulesSize+HEADER_SIZE-1)/HEADER_SIZE*
+            HEADER_SIZE;
+    MemSize=HEADER_SIZE+RulesSpace+RING_SIZE*2;
+    munmap(Mem,HEADER_SIZE);
+
+    Mem=(uint8_t *)mmap(NULL,MemSize,PROT_READ|PROT_WRITE,MAP_SHARED,
+            ShareFD,0);
+    if(Mem==(uint8_t *)MAP_FAILED)
+        return 1;
+    Shared=(struct MatchHelperShared *)Mem;
+    Requests=Mem+HEADER_SIZE+RulesSpace;
+    Responses=Requests+RING_SIZE;
+
+    if(!MatchHelper_UnpackRules(Mem+HEADER_SIZE,Shared->RulesSize,
+            Shared->RulesCount,Rules))
+    {
+        Shared->Ready.store(2,memory_order_release);
+        MatchHelper_Signal(ResponseFD);
+        return 1;
+    }
+    Shared->Ready.store(1,memory_order_release);
+    MatchHelper_Signal(ResponseFD);
+
+    for(;;)
+    {
+        struct pollfd Poll={RequestFD,POLLIN,0};
+        if(poll(&Poll,1,1000)<=0)
+        {
+            if(getppid()!=Parent)
+                return 0;
+            continue;
+        }
+        if(read(RequestFD,&Value,sizeof(Value))!=sizeof(Value))
+            continue;
+
+        Unsignaled=0;
+        Tail=Shared->Requests.Tail.load(memory_order_relaxed);
+        while(Tail!=Shared->Requests.Head.load(memory_order_acquire))
+        {
+            MatchHelper_RingCopyOut(Requests,Tail,&Request,sizeof(Request));
+            Job.Len=Request.Len;
+            Job.Line.resize(Request.Size);
+            MatchHelper_RingCopyOut(Requests,Tail+sizeof(Request),
+                    Job.Line.data(),Request.Size);
+            Tail+=sizeof(Request)+Request.Size;
+            Shared->Requests.Tail.store(Tail,memory_order_release);
+
+            AsyncMatch_CheckLine(Rules,&Spans,&Job,false);
+
+            Hits.clear();
+            for(r=0;r<Job.Hits.size();r++)
+                if(Job.Hits[r])
+                    Hits.push_back(r);
+            Response.HitCount=Hits.size();
+            Response.StyleCount=Job.Styles.size();
+            Need=sizeof(Response)+Hits.size()*sizeof(uint32_t)+
+                    Job.Styles.size()*sizeof(struct AsyncMatchStyle);
+            if(Need>RING_SIZE)
+            {
+                Response.HitCount=0;
+                Response.StyleCount=RESPONSE_LOCAL;
+                Need=sizeof(Response);
+            }
+
+            /* Wait for the plugin to make room */
+            Head=Shared->Responses.Head.load(memory_order_relaxed);
+            while(RING_SIZE-(Head-Shared->Responses.Tail.load(
+                    memory_order_acquire))<Need)
+            {
+                MatchHelper_Signal(ResponseFD);
+                Unsignaled=0;
+                if(getppid()!=Parent)
+                    return 0;
+                usleep(100);
+            }
+
+            MatchHelper_RingCopyIn(Responses,Head,&Response,sizeof(Response));
+            Head+=sizeof(Response);
+            if(Response.StyleCount!=RESPONSE_LOCAL)
+            {
+                MatchHelper_RingCopyIn(Responses,Head,Hits.data(),
+                        Hits.size()*sizeof(uint32_t));
+                Head+=Hits.size()*sizeof(uint32_t);
+                MatchHelper_RingCopyIn(Responses,Head,Job.Styles.data(),
+                        Job.Styles.size()*sizeof(struct AsyncMatchStyle));
+                Head+=Job.Styles.size()*sizeof(struct AsyncMatchStyle);
+            }
+            Shared->Responses.Head.store(Head,memory_order_release);
+
+            if(++Unsignaled>=RESPONSE_SIGNAL_LINES)
+            {
+                MatchHelper_Signal(ResponseFD);
+                Unsignaled=0;
+            }
+        }
+        MatchHelper_Signal(ResponseFD);
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_GetPath
+ *
+ * SYNOPSIS:
+ *    static bool MatchHelper_GetPath(string &Path);
+ *
+ * PARAMETERS:
+ *    Path [O] -- The helper program
+ *
+ * FUNCTION:
+ *    This function finds the helper program.  It is WHIPPYTERM_TLH_HELPER
+ *    if that is set, otherwise MATCHHELPER_BIN_NAME in the same directory
+ *    as the plugin.
+ *
+ * RETURNS:
+ *    true -- 'Path' was filled in
+ *    false -- We couldn't work out where the plugin is
+ ******************************************************************************/
+static bool MatchHelper_GetPath(string &Path)
+{
+    const char *Env;
+    Dl_info Info;
+    size_t Slash;
+
+    Env=getenv("WHIPPYTERM_TLH_HELPER");
+    if(Env!=NULL && *Env!=0)
+    {
+        Path=Env;
+        return true;
+    }
+
+    if(dladdr((void *)MatchHelper_Start,&Info)==0 || Info.dli_fname==NULL)
+        return false;
+
+    Path=Info.dli_fname;
+    Slash=Path.rfind('/');
+    if(Slash==string::npos)
+        Path="./";
+    else
+        Path.erase(Slash+1);
+    Path+=MATCHHELPER_BIN_NAME;
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_PackRules
+ *
+ * SYNOPSIS:
+ *    static void MatchHelper_PackRules(const t_LineMatchRuleList &Rules,
+ *          vector<uint8_t> &Out);
+ *
+ * PARAMETERS:
+ *    Rules [I] -- The rules to pack
+ *    Out [O] -- The packed rules
+ *
+ * FUNCTION:
+ *    This function packs the rules so they can be put in the shared memory.
+ *    Each rule is:
+ *       uint32_t Type, int32_t StyleIndex, uint32_t MatchSpan,
+ *       uint32_t StrLen, uint32_t GroupCount, the string,
+ *       GroupCount * (uint32_t Group, int32_t StyleIndex)
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    MatchHelper_UnpackRules()
+ ******************************************************************************/
+static void MatchHelper_PackRules(const t_LineMatchRuleList &Rules,
+        vector<uint8_t> &Out)
+{
+    t_LineMatchRuleList::const_iterator Rule;
+    t_LineMatchGroupStyleList::const_iterator Group;
+    uint32_t Fields[5];
+    uint32_t GroupFields[2];
+
+    Out.clear();
+    for(Rule=Rules.begin();Rule!=Rules.end();Rule++)
+    {
+        Fields[0]=Rule->Type;
+        Fields[1]=Rule->StyleIndex;
+        Fields[2]=Rule->MatchSpan;
+        Fields[3]=Rule->Literal.size();
+        Fields[4]=Rule->Groups.size();
+        Out.insert(Out.end(),(uint8_t *)Fields,(uint8_t *)(Fields+5));
+        Out.insert(Out.end(),Rule->Literal.begin(),Rule->Literal.end());
+        for(Group=Rule->Groups.begin();Group!=Rule->Groups.end();Group++)
+        {
+            GroupFields[0]=Group->Group;
+            GroupFields[1]=Group->StyleIndex;
+            Out.insert(Out.end(),(uint8_t *)GroupFields,
+                    (uint8_t *)(GroupFields+2));
+        }
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_UnpackRules
+ *
+ * SYNOPSIS:
+ *    static bool MatchHelper_UnpackRules(const uint8_t *In,uint32_t Size,
+ *          uint32_t Count,t_LineMatchRuleList &Rules);
+ *
+ * PARAMETERS:
+ *    In [I] -- The rules from MatchHelper_PackRules()
+ *    Size [I] -- The number of bytes in 'In'
+ *    Count [I] -- The number of rules in 'In'
+ *    Rules [O] -- The rules
+ *
+ * FUNCTION:
+ *    This function unpacks (and compiles) the rules in the helper.
+ *
+ * RETURNS:
+ *    true -- Everything was unpacked
+ *    false -- The rules were bad or didn't compile
+ ******************************************************************************/
+static bool MatchHelper_UnpackRules(const uint8_t *In,uint32_t Size,
+        uint32_t Count,t_LineMatchRuleList &Rules)
+{
+    t_LineMatchGroupStyleList Groups;
+    struct LineMatchGroupStyle Group;
+    uint32_t Fields[5];
+    uint32_t GroupFields[2];
+    string Str;
+    uint32_t Pos;
+    uint32_t r;
+    uint32_t g;
+
+    Rules.clear();
+    Pos=0;
+    for(r=0;r<Count;r++)
+    {
+        if(Size-Pos<sizeof(Fields))
+            return false;
+        memcpy(Fields,In+Pos,sizeof(Fields));
+        Pos+=sizeof(Fields);
+        if(Fields[0]>=e_LineMatchRuleMAX || Size-Pos<Fields[3] ||
+                (Size-Pos-Fields[3])/sizeof(GroupFields)<Fields[4])
+        {
+            return false;
+        }
+        Str.assign((const char *)In+Pos,Fields[3]);
+        Pos+=Fields[3];
+
+        Groups.clear();
+        for(g=0;g<Fields[4];g++)
+        {
+            memcpy(GroupFields,In+Pos,sizeof(GroupFields));
+            Pos+=sizeof(GroupFields);
+            Group.Group=GroupFields[0];
+            Group.StyleIndex=(int)GroupFields[1];
+            Groups.push_back(Group);
+        }
+
+        if(!LineMatch_AddRule(Rules,(e_LineMatchRuleType)Fields[0],
+                Str.c_str(),(int)Fields[1],Fields[2]!=0))
+        {
+            return false;
+        }
+        if(!Groups.empty() && !LineMatch_SetGroupStyles(&Rules.back(),Groups))
+            return false;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_Kill
+ *
+ * SYNOPSIS:
+ *    static void MatchHelper_Kill(struct MatchHelper *Helper);
+ *
+ * PARAMETERS:
+ *    Helper [I] -- The helper
+ *
+ * FUNCTION:
+ *    This function kills the helper process (if it is still running) and
+ *    waits for it.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MatchHelper_Kill(struct MatchHelper *Helper)
+{
+    if(Helper->PID<=0)
+        return;
+
+    kill(Helper->PID,SIGKILL);
+    while(waitpid(Helper->PID,NULL,0)<0 && errno==EINTR)
+        ;
+    Helper->PID=-1;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_Alive
+ *
+ * SYNOPSIS:
+ *    static bool MatchHelper_Alive(struct MatchHelper *Helper);
+ *
+ * PARAMETERS:
+ *    Helper [I] -- The helper
+ *
+ * FUNCTION:
+ *    This function checks if the helper process is still running (and
+ *    reaps it if it isn't).
+ *
+ * RETURNS:
+ *    true -- It is running
+ *    false -- It exited (or was never started)
+ ******************************************************************************/
+static bool MatchHelper_Alive(struct MatchHelper *Helper)
+{
+    if(Helper->PID<=0)
+        return false;
+
+    if(waitpid(Helper->PID,NULL,WNOHANG)==Helper->PID)
+    {
+        Helper->PID=-1;
+        return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_Signal
+ *
+ * SYNOPSIS:
+ *    static void MatchHelper_Signal(int FD);
+ *
+ * PARAMETERS:
+ *    FD [I] -- The eventfd to signal
+ *
+ * FUNCTION:
+ *    This function wakes up the other end of a ring.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MatchHelper_Signal(int FD)
+{
+    uint64_t Value=1;
+
+    if(write(FD,&Value,sizeof(Value))){}
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_RingCopyIn
+ *
+ * SYNOPSIS:
+ *    static void MatchHelper_RingCopyIn(uint8_t *Ring,uint64_t Pos,
+ *          const void *Data,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Ring [I] -- The ring's buffer (RING_SIZE bytes)
+ *    Pos [I] -- Where to copy to (a Head value, it is wrapped here)
+ *    Data [I] -- The bytes to copy in
+ *    Len [I] -- The number of bytes to copy
+ *
+ * FUNCTION:
+ *    This function copies bytes in to a ring, wrapping around the end.  The
+ *    caller has to check there is room and move 'Head' after.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MatchHelper_RingCopyIn(uint8_t *Ring,uint64_t Pos,
+        const void *Data,uint32_t Len)
+{
+    uint32_t Offset;
+    uint32_t First;
+
+    Offset=Pos&(RING_SIZE-1);
+    First=RING_SIZE-Offset;
+    if(First>=Len)
+    {
+        memcpy(Ring+Offset,Data,Len);
+    }
+    else
+    {
+        memcpy(Ring+Offset,Data,First);
+        memcpy(Ring,(const uint8_t *)Data+First,Len-First);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_RingCopyOut
+ *
+ * SYNOPSIS:
+ *    static void MatchHelper_RingCopyOut(const uint8_t *Ring,uint64_t Pos,
+ *          void *Data,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Ring [I] -- The ring's buffer (RING_SIZE bytes)
+ *    Pos [I] -- Where to copy from (a Tail value, it is wrapped here)
+ *    Data [O] -- Where to copy the bytes to
+ *    Len [I] -- The number of bytes to copy
+ *
+ * FUNCTION:
+ *    This function copies bytes out of a ring, wrapping around the end.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MatchHelper_RingCopyOut(const uint8_t *Ring,uint64_t Pos,
+        void *Data,uint32_t Len)
+{
+    uint32_t Offset;
+    uint32_t First;
+
+    Offset=Pos&(RING_SIZE-1);
+    First=RING_SIZE-Offset;
+    if(First>=Len)
+    {
+        memcpy(Data,Ring+Offset,Len);
+    }
+    else
+    {
+        memcpy(Data,Ring+Offset,First);
+        memcpy((uint8_t *)Data+First,Ring,Len-First);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_SendJob
+ *
+ * SYNOPSIS:
+ *    static bool MatchHelper_SendJob(struct MatchHelper *Helper,
+ *          const struct AsyncMatchJob *Job);
+ *
+ * PARAMETERS:
+ *    Helper [I] -- The helper
+ *    Job [I] -- The job to send
+ *
+ * FUNCTION:
+ *    This function puts a line in the request ring (the caller signals the
+ *    helper).
+ *
+ * RETURNS:
+ *    true -- The line was sent
+ *    false -- There isn't room in the ring right now
+ ******************************************************************************/
+static bool MatchHelper_SendJob(struct MatchHelper *Helper,
+        const struct AsyncMatchJob *Job)
+{
+    struct MatchHelperRing *Ring=&Helper->Shared->Requests;
+    struct MatchHelperRequest Request;
+    uint64_t Head;
+
+    Head=Ring->Head.load(memory_order_relaxed);
+    if(RING_SIZE-(Head-Ring->Tail.load(memory_order_acquire))<
+            sizeof(Request)+Job->Line.size())
+    {
+        return false;
+    }
+
+    Request.Len=Job->Len;
+    Request.Size=Job->Line.size();
+    MatchHelper_RingCopyIn(Helper->Requests,Head,&Request,sizeof(Request));
+    MatchHelper_RingCopyIn(Helper->Requests,Head+sizeof(Request),
+            Job->Line.data(),Request.Size);
+    Ring->Head.store(Head+sizeof(Request)+Request.Size,memory_order_release);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_ReadResponse
+ *
+ * SYNOPSIS:
+ *    static bool MatchHelper_ReadResponse(struct MatchHelper *Helper,
+ *          struct AsyncMatchJob *Job,bool *Local);
+ *
+ * PARAMETERS:
+ *    Helper [I] -- The helper
+ *    Job [O] -- The job the next response is for.  'Styles' and 'Hits' are
+ *               filled in.
+ *    Local [O] -- Set to true if the helper couldn't send the styles (the
+ *                 caller has to check the line itself)
+ *
+ * FUNCTION:
+ *    This function takes the next response out of the response ring.  The
+ *    helper moves 'Head' after the whole response is in the ring, so if
+ *    there is a header there is all of it.
+ *
+ * RETURNS:
+ *    true -- The job was filled in
+ *    false -- No response is waiting
+ ******************************************************************************/
+static bool MatchHelper_ReadResponse(struct MatchHelper *Helper,
+        struct AsyncMatchJob *Job,bool *Local)
+{
+    struct MatchHelperRing *Ring=&Helper->Shared->Responses;
+    struct MatchHelperResponse Response;
+    uint64_t Tail;
+    uint32_t h;
+
+    Tail=Ring->Tail.load(memory_order_relaxed);
+    if(Ring->Head.load(memory_order_acquire)==Tail)
+        return false;
+
+    MatchHelper_RingCopyOut(Helper->Responses,Tail,&Response,
+            sizeof(Response));
+    Tail+=sizeof(Response);
+
+    Job->Styles.clear();
+    Job->Hits.clear();
+    if(Response.StyleCount==RESPONSE_LOCAL)
+    {
+        *Local=true;
+    }
+    else
+    {
+        Helper->Hits.resize(Response.HitCount);
+        MatchHelper_RingCopyOut(Helper->Responses,Tail,Helper->Hits.data(),
+                Response.HitCount*sizeof(uint32_t));
+        Tail+=Response.HitCount*sizeof(uint32_t);
+        Job->Hits.resize(Helper->Shared->RulesCount);
+        for(h=0;h<Response.HitCount;h++)
+            if(Helper->Hits[h]<Job->Hits.size())
+                Job->Hits[Helper->Hits[h]]=1;
+
+        Job->Styles.resize(Response.StyleCount);
+        MatchHelper_RingCopyOut(Helper->Responses,Tail,Job->Styles.data(),
+                Response.StyleCount*sizeof(struct AsyncMatchStyle));
+        Tail+=Response.StyleCount*sizeof(struct AsyncMatchStyle);
+    }
+    Ring->Tail.store(Tail,memory_order_release);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MatchHelper_SetCPUs
+ *
+ * SYNOPSIS:
+ *    static void MatchHelper_SetCPUs(const char *CPUList);
+ *
+ * PARAMETERS:
+ *    CPUList [I] -- The CPUs to run on, a comma separated list of CPU
+ *                   numbers and ranges ("2,4-5").  "" for any CPU.
+ *
+ * FUNCTION:
+ *    This function pins the helper to a set of CPUs.  Anything that can't
+ *    be understood (or set) is ignored.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MatchHelper_SetCPUs(const char *CPUList)
+{
+    cpu_set_t Set;
+    const char *Pos;
+    char *End;
+    unsigned long First;
+    unsigned long Last;
+    unsigned long c;
+    bool Any;
+
+    CPU_ZERO(&Set);
+    Any=false;
+    Pos=CPUList;
+    while(Pos!=NULL && *Pos!=0)
+    {
+        First=strtoul(Pos,&End,10);
+        if(End==Pos)
+            return;
+        Last=First;
+        if(*End=='-')
+        {
+            Pos=End+1;
+            Last=strtoul(Pos,&End,10);
+            if(End==Pos)
+                return;
+        }
+        for(c=First;c<=Last && c<CPU_SETSIZE;c++)
+        {
+            CPU_SET(c,&Set);
+            Any=true;
+        }
+        Pos=End;
+        if(*Pos==',')
+            Pos++;
+        else if(*Pos!=0)
+            return;
+    }
+
+    if(Any)
+        sched_setaffinity(0,sizeof(Set),&Set);
+}
+
+#else
+
+/* The helper is Linux only */
+struct MatchHelper *MatchHelper_Start(const t_LineMatchRuleList &Rules,
+        const char *CPUList,uint32_t TimeoutMS)
+{
+    return NULL;
+}
+
+void MatchHelper_Free(struct MatchHelper *Helper)
+{
+}
+
+unsigned int MatchHelper_CheckJobs(struct MatchHelper *Helper,
+        struct AsyncMatchJob **Jobs,unsigned int Count,bool *Local)
+{
+    return 0;
+}
+
+bool MatchHelper_Failed(struct MatchHelper *Helper)
+{
+    return true;
+}
+
+int MatchHelper_Serve(int ShareFD,int RequestFD,int ResponseFD,
+        const char *CPUList)
+{
+    return 1;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * FILENAME: MatchHelper.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the MatchHelper.cpp file.
+ *
+ *    The helper is a separate process (TextLineHighlighterHelper) that
+ *    checks lines for a worker thread, so a rule that hangs or crashes only
+ *    takes the helper down.  The worker and the helper share a block of
+ *    memory with the rules and two single producer / single consumer byte
+ *    rings in it:
+ *       Requests -- Written by the worker, read by the helper
+ *       Responses -- Written by the helper, read by the worker
+ *    Each ring has a Head (moved by the writer) and a Tail (moved by the
+ *    reader) that only ever go up.  An eventfd for each ring wakes up the
+ *    reader.  The responses come back in the same order as the requests.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __MATCHHELPER_H_
+#define __MATCHHELPER_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include "LineMatch.h"
+#include <stdint.h>
+
+/***  DEFINES                          ***/
+#define MATCHHELPER_BIN_NAME                "TextLineHighlighterHelper"
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+struct MatchHelper;
+struct AsyncMatchJob;
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+struct MatchHelper *MatchHelper_Start(const t_LineMatchRuleList &Rules,
+        const char *CPUList,uint32_t TimeoutMS);
+void MatchHelper_Free(struct MatchHelper *Helper);
+unsigned int MatchHelper_CheckJobs(struct MatchHelper *Helper,
+        struct AsyncMatchJob **Jobs,unsigned int Count,bool *Local);
+bool MatchHelper_Failed(struct MatchHelper *Helper);
+int MatchHelper_Serve(int ShareFD,int RequestFD,int ResponseFD,
+        const char *CPUList);
+
+#endif
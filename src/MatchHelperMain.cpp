@@ -0,0 +1,60 @@
+/*******************************************************************************
+ * FILENAME: MatchHelperMain.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This file is main() for TextLineHighlighterHelper, the helper process
+ *    the plugin starts to check lines out of process (see MatchHelper.h).
+ *    It is only ever run by the plugin:
+ *       TextLineHighlighterHelper ShareFD RequestFD ResponseFD [CPUList]
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "MatchHelper.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*** DEFINES                  ***/
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+
+/*** VARIABLE DEFINITIONS     ***/
+
+int main(int argc,char *argv[])
+{
+    if(argc<4)
+    {
+        fprintf(stderr,"%s is started by the TextLineHighlighter plugin\n",
+                MATCHHELPER_BIN_NAME);
+        return 1;
+    }
+
+    return MatchHelper_Serve(atoi(argv[1]),atoi(argv[2]),atoi(argv[3]),
+            argc>4?argv[4]:"");
+}
@@ -0,0 +1,543 @@
+/*******************************************************************************
+ * FILENAME: MetricsExport.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This exports the highlighter counters in the Prometheus text exposition
+ *    format so test rack dashboards can see how many lines of each kind a
+ *    console is producing.
+ *
+ *    It runs in its own low frequency thread.  The counters are atomics that
+ *    the connections update, this thread only reads them so the connections
+ *    never wait on it.  The text can go to:
+ *       * A file that is rewritten every interval (written to a .tmp file
+ *         and renamed so readers never see half a file).  This works with
+ *         the node_exporter textfile collector.
+ *       * A UNIX domain socket.  Each connection to the socket gets the
+ *         current text and is then closed.  If the client sends a HTTP GET
+ *         first it gets a HTTP reply (so "curl --unix-socket" works).
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "MetricsExport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#ifndef _WIN32
+ #include <poll.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+ #include <unistd.h>
+#endif
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define MIN_INTERVAL_MS                     100
+/* How often the thread wakes up to check for a stop / socket clients */
+#define POLL_MS                             200
+#define CLIENT_REQUEST_TIMEOUT_MS           100
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+static void MetricsExport_Thread(void);
+static bool MetricsExport_WriteFile(void);
+#ifndef _WIN32
+static int MetricsExport_OpenSocket(void);
+static void MetricsExport_ServeClient(int Listener);
+#endif
+
+/*** VARIABLE DEFINITIONS     ***/
+static t_MetricsExportBuildFn m_BuildFn;
+static string m_FileName;
+static string m_SocketName;
+static unsigned int m_IntervalMS;
+static thread m_Thread;
+static mutex m_StopMutex;
+static condition_variable m_StopCond;
+static atomic<bool> m_Stop;
+static bool m_Running;
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_StartFromEnv
+ *
+ * SYNOPSIS:
+ *    bool MetricsExport_StartFromEnv(t_MetricsExportBuildFn BuildFn);
+ *
+ * PARAMETERS:
+ *    BuildFn [I] -- The function to call to build the text to export.
+ *                   This is called from the export thread.
+ *
+ * FUNCTION:
+ *    This function looks at the METRICSEXPORT_ENV_* environment vars and
+ *    starts the export thread if a file or a socket was given.
+ *
+ * RETURNS:
+ *    true -- The exporter is running
+ *    false -- It wasn't asked for or we couldn't start the thread.
+ ******************************************************************************/
+bool MetricsExport_StartFromEnv(t_MetricsExportBuildFn BuildFn)
+{
+    const char *File;
+    const char *Socket;
+    const char *Interval;
+
+    if(m_Running)
+        return true;
+
+    File=getenv(METRICSEXPORT_ENV_FILE);
+    Socket=getenv(METRICSEXPORT_ENV_SOCKET);
+    Interval=getenv(METRICSEXPORT_ENV_INTERVAL);
+
+    if((File==NULL || *File==0) && (Socket==NULL || *Socket==0))
+        return false;
+
+    try
+    {
+        m_FileName=File!=NULL?File:"";
+        m_SocketName=Socket!=NULL?Socket:"";
+#ifdef _WIN32
+        m_SocketName="";
+#endif
+        m_IntervalMS=METRICSEXPORT_DEFAULT_INTERVAL_MS;
+        if(Interval!=NULL)
+            m_IntervalMS=strtoul(Interval,NULL,10);
+        if(m_IntervalMS<MIN_INTERVAL_MS)
+            m_IntervalMS=MIN_INTERVAL_MS;
+
+        m_BuildFn=BuildFn;
+        m_Stop=false;
+        m_Thread=thread(MetricsExport_Thread);
+    }
+    catch(...)
+    {
+        return false;
+    }
+
+    m_Running=true;
+    atexit(MetricsExport_Stop);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_Stop
+ *
+ * SYNOPSIS:
+ *    void MetricsExport_Stop(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function stops the export thread and waits for it to exit.  It is
+ *    called at exit.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void MetricsExport_Stop(void)
+{
+    if(!m_Running)
+        return;
+
+    m_StopMutex.lock();
+    m_Stop=true;
+    m_StopMutex.unlock();
+    m_StopCond.notify_all();
+
+    if(m_Thread.joinable())
+        m_Thread.join();
+
+    m_Running=false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_AddHeader
+ *
+ * SYNOPSIS:
+ *    void MetricsExport_AddHeader(std::string &Out,const char *Name,
+ *              const char *Type,const char *Help);
+ *
+ * PARAMETERS:
+ *    Out [I/O] -- The text to add to
+ *    Name [I] -- The name of the metric
+ *    Type [I] -- The Prometheus type ("counter", "gauge", "summary", ...)
+ *    Help [I] -- The help text for the metric
+ *
+ * FUNCTION:
+ *    This function adds the # HELP and # TYPE lines for a metric.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void MetricsExport_AddHeader(std::string &Out,const char *Name,
+        const char *Type,const char *Help)
+{
+    Out+="# HELP ";
+    Out+=Name;
+    Out+=" ";
+    Out+=Help;
+    Out+="\n# TYPE ";
+    Out+=Name;
+    Out+=" ";
+    Out+=Type;
+    Out+="\n";
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_AddValue
+ *
+ * SYNOPSIS:
+ *    void MetricsExport_AddValue(std::string &Out,const char *Name,
+ *              const char *Labels,double Value);
+ *
+ * PARAMETERS:
+ *    Out [I/O] -- The text to add to
+ *    Name [I] -- The name of the metric
+ *    Labels [I] -- The labels without the {}'s (for example
+ *                  connection="1").  The label values must already be
+ *                  escaped with MetricsExport_EscapeLabel().  NULL for none.
+ *    Value [I] -- The value
+ *
+ * FUNCTION:
+ *    This function adds a sample line for a metric.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void MetricsExport_AddValue(std::string &Out,const char *Name,
+        const char *Labels,double Value)
+{
+    char buff[100];
+
+    Out+=Name;
+    if(Labels!=NULL && *Labels!=0)
+    {
+        Out+="{";
+        Out+=Labels;
+        Out+="}";
+    }
+    sprintf(buff," %.15g\n",Value);
+    Out+=buff;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_EscapeLabel
+ *
+ * SYNOPSIS:
+ *    std::string MetricsExport_EscapeLabel(const char *Str);
+ *
+ * PARAMETERS:
+ *    Str [I] -- The label value to escape
+ *
+ * FUNCTION:
+ *    This function escapes a label value (\, " and new lines).
+ *
+ * RETURNS:
+ *    The escaped string
+ ******************************************************************************/
+std::string MetricsExport_EscapeLabel(const char *Str)
+{
+    string RetValue;
+
+    for(;*Str!=0;Str++)
+    {
+        switch(*Str)
+        {
+            case '\\':
+                RetValue+="\\\\";
+            break;
+            case '"':
+                RetValue+="\\\"";
+            break;
+            case '\n':
+                RetValue+="\\n";
+            break;
+            default:
+                RetValue+=*Str;
+            break;
+        }
+    }
+    return RetValue;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_Thread
+ *
+ * SYNOPSIS:
+ *    static void MetricsExport_Thread(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This is the export thread.  It rewrites the file every interval and
+ *    answers anyone who connects to the socket.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MetricsExport_Thread(void)
+{
+    chrono::steady_clock::time_point NextWrite;
+    int Listener;
+
+    Listener=-1;
+#ifndef _WIN32
+    if(m_SocketName!="")
+        Listener=MetricsExport_OpenSocket();
+#endif
+
+    NextWrite=chrono::steady_clock::now();
+    while(!m_Stop)
+    {
+        if(m_FileName!="" && chrono::steady_clock::now()>=NextWrite)
+        {
+            MetricsExport_WriteFile();
+            NextWrite=chrono::steady_clock::now()+
+                    chrono::milliseconds(m_IntervalMS);
+        }
+
+#ifndef _WIN32
+        if(Listener>=0)
+        {
+            struct pollfd Poll;
+
+            Poll.fd=Listener;
+            Poll.events=POLLIN;
+            Poll.revents=0;
+            if(poll(&Poll,1,POLL_MS)>0 && (Poll.revents&POLLIN))
+                MetricsExport_ServeClient(Listener);
+            continue;
+        }
+#endif
+
+        unique_lock<mutex> Lock(m_StopMutex);
+        m_StopCond.wait_for(Lock,chrono::milliseconds(POLL_MS));
+    }
+
+#ifndef _WIN32
+    if(Listener>=0)
+    {
+        close(Listener);
+        unlink(m_SocketName.c_str());
+    }
+#endif
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_WriteFile
+ *
+ * SYNOPSIS:
+ *    static bool MetricsExport_WriteFile(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function builds the text and writes it to the export file.  It is
+ *    written to a temp file and then renamed so anyone reading the file
+ *    always gets a whole file.
+ *
+ * RETURNS:
+ *    true -- The file was written
+ *    false -- There was an error
+ ******************************************************************************/
+static bool MetricsExport_WriteFile(void)
+{
+    string Text;
+    string TmpName;
+    FILE *out;
+    bool RetValue;
+
+    try
+    {
+        m_BuildFn(Text);
+        TmpName=m_FileName+".tmp";
+    }
+    catch(...)
+    {
+        return false;
+    }
+
+    out=fopen(TmpName.c_str(),"w");
+    if(out==NULL)
+        return false;
+
+    RetValue=fwrite(Text.c_str(),1,Text.length(),out)==Text.length();
+    if(fclose(out)!=0)
+        RetValue=false;
+
+    if(!RetValue)
+    {
+        remove(TmpName.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    /* Windows rename() will not replace a file */
+    remove(m_FileName.c_str());
+#endif
+    return rename(TmpName.c_str(),m_FileName.c_str())==0;
+}
+
+#ifndef _WIN32
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_OpenSocket
+ *
+ * SYNOPSIS:
+ *    static int MetricsExport_OpenSocket(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function makes the UNIX domain socket we listen on.  Any old
+ *    socket file with the same name is removed first.
+ *
+ * RETURNS:
+ *    The socket or -1 if there was an error.
+ ******************************************************************************/
+static int MetricsExport_OpenSocket(void)
+{
+    struct sockaddr_un Addr;
+    int Listener;
+
+    if(m_SocketName.length()>=sizeof(Addr.sun_path))
+        return -1;
+
+    Listener=socket(AF_UNIX,SOCK_STREAM,0);
+    if(Listener<0)
+        return -1;
+
+    memset(&Addr,0x00,sizeof(Addr));
+    Addr.sun_family=AF_UNIX;
+    strcpy(Addr.sun_path,m_SocketName.c_str());
+
+    unlink(m_SocketName.c_str());
+    if(bind(Listener,(struct sockaddr *)&Addr,sizeof(Addr))<0 ||
+            listen(Listener,4)<0)
+    {
+        close(Listener);
+        return -1;
+    }
+
+    return Listener;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    MetricsExport_ServeClient
+ *
+ * SYNOPSIS:
+ *    static void MetricsExport_ServeClient(int Listener);
+ *
+ * PARAMETERS:
+ *    Listener [I] -- The socket we are listening on
+ *
+ * FUNCTION:
+ *    This function accepts a client on the socket, sends it the current
+ *    text and closes it.  If the client sends a HTTP GET within
+ *    CLIENT_REQUEST_TIMEOUT_MS we send a HTTP reply, if it doesn't send
+ *    anything we just send the text.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void MetricsExport_ServeClient(int Listener)
+{
+    struct pollfd Poll;
+    string Text;
+    string Reply;
+    char Request[1024];
+    ssize_t Bytes;
+    size_t Sent;
+    bool HTTP;
+    int Client;
+    char buff[100];
+
+    Client=accept(Listener,NULL,NULL);
+    if(Client<0)
+        return;
+
+    HTTP=false;
+    Poll.fd=Client;
+    Poll.events=POLLIN;
+    Poll.revents=0;
+    if(poll(&Poll,1,CLIENT_REQUEST_TIMEOUT_MS)>0 && (Poll.revents&POLLIN))
+    {
+        Bytes=recv(Client,Request,sizeof(Request),0);
+        if(Bytes>=4 && memcmp(Request,"GET ",4)==0)
+            HTTP=true;
+    }
+
+    try
+    {
+        m_BuildFn(Text);
+        if(HTTP)
+        {
+            sprintf(buff,"Content-Length: %zu\r\n",Text.length());
+            Reply="HTTP/1.0 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n";
+            Reply+=buff;
+            Reply+="Connection: close\r\n\r\n";
+        }
+        Reply+=Text;
+    }
+    catch(...)
+    {
+        close(Client);
+        return;
+    }
+
+    Sent=0;
+    while(Sent<Reply.length())
+    {
+        Bytes=send(Client,Reply.c_str()+Sent,Reply.length()-Sent,
+                MSG_NOSIGNAL);
+        if(Bytes<=0)
+            break;
+        Sent+=Bytes;
+    }
+    close(Client);
+}
+#endif
@@ -0,0 +1,64 @@
+/*******************************************************************************
+ * FILENAME: MetricsExport.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the MetricsExport.cpp file.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __METRICSEXPORT_H_
+#define __METRICSEXPORT_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include <string>
+
+/***  DEFINES                          ***/
+/* Environment vars used to turn the exporter on */
+#define METRICSEXPORT_ENV_FILE              "WHIPPYTERM_TLH_METRICS_FILE"
+#define METRICSEXPORT_ENV_SOCKET            "WHIPPYTERM_TLH_METRICS_SOCKET"
+#define METRICSEXPORT_ENV_INTERVAL          "WHIPPYTERM_TLH_METRICS_INTERVAL_MS"
+
+#define METRICSEXPORT_DEFAULT_INTERVAL_MS   5000
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+/* Called from the export thread to build the text to export */
+typedef void (*t_MetricsExportBuildFn)(std::string &Out);
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+bool MetricsExport_StartFromEnv(t_MetricsExportBuildFn BuildFn);
+void MetricsExport_Stop(void);
+void MetricsExport_AddHeader(std::string &Out,const char *Name,
+        const char *Type,const char *Help);
+void MetricsExport_AddValue(std::string &Out,const char *Name,
+        const char *Labels,double Value);
+std::string MetricsExport_EscapeLabel(const char *Str);
+
+#endif
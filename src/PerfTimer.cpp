@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * FILENAME: PerfTimer.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This has the calibration for the low overhead timer.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "PerfTimer.h"
+#include <chrono>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define CALIBRATE_TIME_MS                   5
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+
+/*** VARIABLE DEFINITIONS     ***/
+static double m_NSPerTick=1.0;
+
+/*******************************************************************************
+ * NAME:
+ *    PerfTimer_Init
+ *
+ * SYNOPSIS:
+ *    void PerfTimer_Init(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function works out how long a tick is.  It spins for a few ms
+ *    watching the timer against the system clock so it should only be
+ *    called once (from RegisterPlugin()).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void PerfTimer_Init(void)
+{
+    chrono::steady_clock::time_point Start;
+    chrono::steady_clock::duration Elapsed;
+    uint64_t StartTicks;
+    uint64_t Ticks;
+
+    Start=chrono::steady_clock::now();
+    StartTicks=PerfTimer_Now();
+    do
+    {
+        Elapsed=chrono::steady_clock::now()-Start;
+    } while(Elapsed<chrono::milliseconds(CALIBRATE_TIME_MS));
+    Ticks=PerfTimer_Now()-StartTicks;
+
+    if(Ticks>0)
+    {
+        m_NSPerTick=chrono::duration<double,nano>(Elapsed).count()/
+                (double)Ticks;
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    PerfTimer_Ticks2NS
+ *
+ * SYNOPSIS:
+ *    uint64_t PerfTimer_Ticks2NS(uint64_t Ticks);
+ *
+ * PARAMETERS:
+ *    Ticks [I] -- The number of ticks to convert
+ *
+ * FUNCTION:
+ *    This function converts a number of PerfTimer_Now() ticks to nano
+ *    seconds.
+ *
+ * RETURNS:
+ *    The number of nano seconds
+ ******************************************************************************/
+uint64_t PerfTimer_Ticks2NS(uint64_t Ticks)
+{
+    return (uint64_t)(Ticks*m_NSPerTick);
+}
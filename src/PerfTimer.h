@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * FILENAME: PerfTimer.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a low overhead timer for timing things in the highlighter.  It
+ *    uses the CPU time stamp counter when there is one.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __PERFTIMER_H_
+#define __PERFTIMER_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+ #include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+ #include <intrin.h>
+#else
+ #include <chrono>
+#endif
+
+/***  DEFINES                          ***/
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+void PerfTimer_Init(void);
+uint64_t PerfTimer_Ticks2NS(uint64_t Ticks);
+
+/*******************************************************************************
+ * NAME:
+ *    PerfTimer_Now
+ *
+ * SYNOPSIS:
+ *    static inline uint64_t PerfTimer_Now(void);
+ *
+ * FUNCTION:
+ *    This function reads the timer.  The value is in ticks, use
+ *    PerfTimer_Ticks2NS() to convert a difference to nano seconds.
+ *
+ * RETURNS:
+ *    The current tick count.
+ ******************************************************************************/
+static inline uint64_t PerfTimer_Now(void)
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+#endif
@@ -42,11 +42,22 @@
 #define DATA_PROCESSORS_API_VERSION_1       1
 #define DATA_PROCESSORS_API_VERSION_2       2
 #define DATA_PROCESSORS_API_VERSION_3       3
+#define DATA_PROCESSORS_API_VERSION_4       4
+#define DATA_PROCESSORS_API_VERSION_5       5
 
 /* Versions of struct DPS_API */
 #define DPS_API_VERSION_1                   1
 #define DPS_API_VERSION_2                   2
 #define DPS_API_VERSION_3                   3
+#define DPS_API_VERSION_4                   4
+
+/* The first WhippyTerm version (the 'Version' passed to RegisterPlugin())
+   that has DPS_API_VERSION_3.  Don't use the V3 functions with older
+   versions, they aren't in the struct. */
+#define DPS_API_VERSION_3_WHIPPYTERM_VERSION 0x02010000
+
+/* The same for DPS_API_VERSION_4 (reading the scroll back) */
+#define DPS_API_VERSION_4_WHIPPYTERM_VERSION 0x02020000
 
 #define TXT_ATTRIB_UNDERLINE                0x0001
 #define TXT_ATTRIB_UNDERLINE_DOUBLE         0x0002
@@ -66,6 +77,12 @@
 /* Goes back to version 1.0 (just here for compatibility) */
 #define TXT_ATTRIB_LINETHROUGHT             TXT_ATTRIB_LINETHROUGH
 
+/* What ApplyStyle2Mark() should apply */
+#define APPLY_STYLE_FGCOLOR                 0x0001
+#define APPLY_STYLE_BGCOLOR                 0x0002
+#define APPLY_STYLE_ATTRIBS                 0x0004
+#define APPLY_STYLE_ULINECOLOR              0x0008
+
 /***  MACROS                           ***/
 
 /***  TYPE DEFINITIONS                 ***/
@@ -175,6 +192,23 @@ struct DataProcessorAPI
     void (*SetSettingsFromWidgets)(t_DataProSettingsWidgetsType *PrivData,t_PIKVList *Settings);
     void (*ApplySettings)(t_DataProcessorHandleType *DataHandle,t_PIKVList *Settings);
     /********* End of DATA_PROCESSORS_API_VERSION_3 *********/
+    /********* Start of DATA_PROCESSORS_API_VERSION_4 *********/
+    /* Replaces ProcessIncomingTextByte() for text processors that don't
+       change or consume bytes (highlighters / loggers).  The bytes in 'Buf'
+       have not been added to the screen yet.  The processor returns how
+       many of them it has handled (at least 1), the host adds that many
+       to the screen and calls again with the rest.  If this is NULL the
+       host uses ProcessIncomingTextByte() */
+    int (*ProcessIncomingTextBlock)(t_DataProcessorHandleType *DataHandle,
+            const uint8_t *Buf,int Len);
+    /********* End of DATA_PROCESSORS_API_VERSION_4 *********/
+    /********* Start of DATA_PROCESSORS_API_VERSION_5 *********/
+    /* Called every so often (about every 50ms) on the connection's thread
+       when no bytes are coming in, so the processor can finish work it
+       has put off.  The DPS_API can be used like in
+       ProcessIncomingTextByte().  Can be NULL. */
+    void (*ProcessIdle)(t_DataProcessorHandleType *DataHandle);
+    /********* End of DATA_PROCESSORS_API_VERSION_5 *********/
 };
 
 /* !!!! You can only add to this.  Changing it will break the plugins !!!! */
@@ -233,6 +267,19 @@ struct DPS_API
     void (*ReleaseFrozenStream)(void);
     const uint8_t *(*GetFrozenString)(uint32_t *Size);
     /********* End of DPS_API_VERSION_2 *********/
+    /********* Start of DPS_API_VERSION_3 *********/
+    void (*ApplyStyle2Mark)(t_DataProMark *Mark,uint32_t FGColor,uint32_t BGColor,uint32_t Attribs,uint32_t ULineColor,uint32_t Offset,uint32_t Len,uint32_t Mask);
+    /********* End of DPS_API_VERSION_3 *********/
+    /********* Start of DPS_API_VERSION_4 *********/
+    /* The scroll back.  Lines are numbered from the start of the
+       connection, so a line keeps its number as old lines are dropped.
+       'EndLine' is one past the last line that has ended (the line the
+       cursor is on isn't included).  GetScrollBackLine() gives the line
+       without its end of line (NULL if it isn't in the scroll back). */
+    void (*GetScrollBackLines)(uint64_t *FirstLine,uint64_t *EndLine);
+    const uint8_t *(*GetScrollBackLine)(uint64_t Line,uint32_t *Size);
+    PG_BOOL (*SetMark2ScrollBackLine)(t_DataProMark *Mark,uint64_t Line);
+    /********* End of DPS_API_VERSION_4 *********/
 };
 
 /***  CLASS DEFINITIONS                ***/
@@ -0,0 +1,1036 @@
+/*******************************************************************************
+ * FILENAME: StreamCapture.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This file captures the raw bytes a connection sees (with coarse time
+ *    stamps) to a file so a problem stream can be replayed later with the
+ *    CaptureReplay tool.  The file format is described in StreamCapture.h.
+ *
+ *    The connection only copies bytes in to a pending buffer.  At the end of
+ *    each line the pending bytes are pushed in to a lock free single
+ *    producer / single consumer ring.  A writer thread (one per capture)
+ *    empties the ring, packs the records in to blocks, compresses them and
+ *    writes them out.  If the writer can't keep up the ring fills and we
+ *    drop bytes (and record how many were dropped) instead of ever making
+ *    the connection wait.
+ *
+ *    If the start of a line sits in the pending buffer for
+ *    PENDING_MAX_AGE_MS (a prompt, or the stream just went quiet) the
+ *    writer thread takes the pending bytes itself.  The connection and the
+ *    writer agree on who owns the bytes with a compare and swap on
+ *    'PendingState', so the connection still never waits.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "StreamCapture.h"
+#include "BlockCompress.h"
+#include "PerfTimer.h"
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define RING_SIZE                   (1024*1024)     // Must be a power of 2
+#define RING_RECORD_HEADER_SIZE     16
+#define BLOCK_SIZE                  (64*1024)
+#define MAX_BLOCK_SIZE              (16*1024*1024)  // Reader sanity check
+#define WRITER_POLL_MS              50
+#define BLOCK_MAX_AGE_MS            1000
+#define PENDING_MAX_AGE_MS          1000
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+struct StreamCaptureWriter
+{
+    struct StreamCapture *Cap;
+    FILE *out;
+    uint8_t *Ring;
+    atomic<uint64_t> Head;          // Only written by the connection
+    atomic<uint64_t> Tail;          // Only written by the writer thread
+    uint32_t LostPending;           // Bytes dropped since the last record
+    atomic<uint64_t> LostTotal;
+    uint64_t StartTicks;
+    uint64_t LastTimeUS;
+    uint64_t PendingSeen;           // The 'PendingState' we last saw
+    chrono::steady_clock::time_point PendingSeenAt;
+    vector<uint8_t> Block;
+    vector<uint8_t> Packed;
+    bool WriteFailed;
+    thread Thread;
+    mutex StopMutex;
+    condition_variable StopCond;
+    atomic<bool> Stop;
+};
+
+/*** FUNCTION PROTOTYPES      ***/
+static void StreamCapture_WriterThread(struct StreamCaptureWriter *Writer);
+static void StreamCapture_RingRead(struct StreamCaptureWriter *Writer,
+        uint64_t Pos,void *Dest,uint32_t Len);
+static void StreamCapture_RingWrite(struct StreamCaptureWriter *Writer,
+        uint64_t Pos,const void *Src,uint32_t Len);
+static bool StreamCapture_DrainRing(struct StreamCaptureWriter *Writer);
+static bool StreamCapture_TakePending(struct StreamCaptureWriter *Writer);
+static void StreamCapture_AddRecordHeader(struct StreamCaptureWriter *Writer,
+        uint64_t Ticks,uint32_t Lost,uint32_t Len);
+static void StreamCapture_WriteBlock(struct StreamCaptureWriter *Writer);
+static void StreamCapture_AddVarInt(vector<uint8_t> &Out,uint64_t Value);
+static bool StreamCapture_GetVarInt(struct StreamCaptureReader *Reader,
+        uint64_t *Value);
+static void StreamCapture_Put32(uint8_t *Out,uint32_t Value);
+static uint32_t StreamCapture_Get32(const uint8_t *In);
+
+/*** VARIABLE DEFINITIONS     ***/
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_Start
+ *
+ * SYNOPSIS:
+ *    struct StreamCapture *StreamCapture_Start(const char *Filename);
+ *
+ * PARAMETERS:
+ *    Filename [I] -- The file to write the capture to.  If it already exists
+ *                    the capture is added to the end of it as a new
+ *                    session.
+ *
+ * FUNCTION:
+ *    This function opens the capture file, writes the file header for a new
+ *    session and starts the writer thread.
+ *
+ * RETURNS:
+ *    The new capture or NULL if the file couldn't be opened (or we are out
+ *    of memory).
+ *
+ * SEE ALSO:
+ *    StreamCapture_Stop(), StreamCapture_AddByte()
+ ******************************************************************************/
+struct StreamCapture *StreamCapture_Start(const char *Filename)
+{
+    struct StreamCapture *Cap;
+    struct StreamCaptureWriter *Writer;
+    uint8_t Header[STREAMCAPTURE_HEADER_SIZE];
+    uint64_t StartTime;
+
+    Cap=NULL;
+    Writer=NULL;
+    try
+    {
+        Cap=new struct StreamCapture;
+        Writer=new struct StreamCaptureWriter;
+        Writer->out=NULL;
+        Writer->Ring=NULL;
+        Writer->Ring=new uint8_t[RING_SIZE];
+        Writer->Block.reserve(BLOCK_SIZE+STREAMCAPTURE_PENDING_SIZE+32);
+        Writer->Packed.resize(BLOCKCOMPRESS_MAX_SIZE(BLOCK_SIZE+
+                STREAMCAPTURE_PENDING_SIZE+32));
+
+        Cap->PendingState=0;
+        Cap->Writer=Writer;
+        Writer->Cap=Cap;
+        Writer->Head=0;
+        Writer->Tail=0;
+        Writer->LostPending=0;
+        Writer->LostTotal=0;
+        Writer->LastTimeUS=0;
+        Writer->PendingSeen=0;
+        Writer->WriteFailed=false;
+        Writer->Stop=false;
+
+        Writer->out=fopen(Filename,"ab");
+        if(Writer->out==NULL)
+            throw(0);
+
+        StartTime=chrono::duration_cast<chrono::microseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+        Writer->StartTicks=PerfTimer_Now();
+
+        memcpy(Header,STREAMCAPTURE_MAGIC,STREAMCAPTURE_MAGIC_LEN);
+        StreamCapture_Put32(&Header[8],STREAMCAPTURE_FILE_VERSION);
+        StreamCapture_Put32(&Header[12],0);
+        StreamCapture_Put32(&Header[16],StartTime&0xFFFFFFFF);
+        StreamCapture_Put32(&Header[20],StartTime>>32);
+        if(fwrite(Header,sizeof(Header),1,Writer->out)!=1)
+            throw(0);
+
+        Writer->Thread=thread(StreamCapture_WriterThread,Writer);
+    }
+    catch(...)
+    {
+        if(Writer!=NULL)
+        {
+            if(Writer->out!=NULL)
+                fclose(Writer->out);
+            delete[] Writer->Ring;
+            delete Writer;
+        }
+        delete Cap;
+        return NULL;
+    }
+
+    return Cap;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_Stop
+ *
+ * SYNOPSIS:
+ *    void StreamCapture_Stop(struct StreamCapture *Cap);
+ *
+ * PARAMETERS:
+ *    Cap [I] -- The capture to stop
+ *
+ * FUNCTION:
+ *    This function sends any pending bytes to the writer, waits for the
+ *    writer to get everything in to the file and then closes it and frees
+ *    the capture.
+ *
+ *    This must be called from the same thread that adds the bytes.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    StreamCapture_Start()
+ ******************************************************************************/
+void StreamCapture_Stop(struct StreamCapture *Cap)
+{
+    struct StreamCaptureWriter *Writer;
+
+    if(Cap==NULL)
+        return;
+
+    Writer=Cap->Writer;
+
+    StreamCapture_FlushPending(Cap);
+
+    Writer->StopMutex.lock();
+    Writer->Stop=true;
+    Writer->StopMutex.unlock();
+    Writer->StopCond.notify_all();
+
+    if(Writer->Thread.joinable())
+        Writer->Thread.join();
+
+    fclose(Writer->out);
+    delete[] Writer->Ring;
+    delete Writer;
+    delete Cap;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_FlushPending
+ *
+ * SYNOPSIS:
+ *    void StreamCapture_FlushPending(struct StreamCapture *Cap);
+ *
+ * PARAMETERS:
+ *    Cap [I] -- The capture to flush
+ *
+ * FUNCTION:
+ *    This function time stamps the pending bytes and pushes them in to the
+ *    ring for the writer thread.  If there isn't room in the ring the bytes
+ *    are dropped and counted as lost.  If the writer already took the
+ *    pending bytes (see StreamCapture_TakePending()) this does nothing.
+ *
+ *    Each ring record is:
+ *       Len -- uint32
+ *       Lost -- uint32, bytes that were dropped before this record
+ *       Ticks -- uint64, PerfTimer_Now() when the record was made
+ *       Data -- 'Len' bytes
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    StreamCapture_AddByte()
+ ******************************************************************************/
+void StreamCapture_FlushPending(struct StreamCapture *Cap)
+{
+    struct StreamCaptureWriter *Writer;
+    uint32_t RecHeader[2];
+    uint64_t Ticks;
+    uint64_t Head;
+    uint64_t Tail;
+    uint64_t State;
+    uint32_t Len;
+
+    Writer=Cap->Writer;
+    State=Cap->PendingState.load(memory_order_relaxed);
+    Len=(uint32_t)State;
+    if(Len==0)
+        return;
+
+    /* Take the bytes back from the writer, if this fails it took them */
+    if(!Cap->PendingState.compare_exchange_strong(State,
+            ((State>>32)+1)<<32,memory_order_acq_rel,memory_order_relaxed))
+    {
+        return;
+    }
+
+    Head=Writer->Head.load(memory_order_relaxed);
+    Tail=Writer->Tail.load(memory_order_acquire);
+    if(RING_SIZE-(Head-Tail)<RING_RECORD_HEADER_SIZE+Len)
+    {
+        /* No room, drop it */
+        Writer->LostPending+=Len;
+        Writer->LostTotal.store(Writer->LostTotal.load(
+                memory_order_relaxed)+Len,memory_order_relaxed);
+        return;
+    }
+
+    RecHeader[0]=Len;
+    RecHeader[1]=Writer->LostPending;
+    Ticks=PerfTimer_Now();
+    StreamCapture_RingWrite(Writer,Head,RecHeader,sizeof(RecHeader));
+    StreamCapture_RingWrite(Writer,Head+8,&Ticks,sizeof(Ticks));
+    StreamCapture_RingWrite(Writer,Head+RING_RECORD_HEADER_SIZE,Cap->Pending,
+            Len);
+    Writer->LostPending=0;
+
+    Writer->Head.store(Head+RING_RECORD_HEADER_SIZE+Len,memory_order_release);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_GetLostBytes
+ *
+ * SYNOPSIS:
+ *    uint64_t StreamCapture_GetLostBytes(struct StreamCapture *Cap);
+ *
+ * PARAMETERS:
+ *    Cap [I] -- The capture to get the count from
+ *
+ * FUNCTION:
+ *    This function gets the number of bytes that were dropped because the
+ *    writer couldn't keep up.
+ *
+ * RETURNS:
+ *    The number of bytes dropped
+ ******************************************************************************/
+uint64_t StreamCapture_GetLostBytes(struct StreamCapture *Cap)
+{
+    return Cap->Writer->LostTotal.load(memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_WriterThread
+ *
+ * SYNOPSIS:
+ *    static void StreamCapture_WriterThread(
+ *              struct StreamCaptureWriter *Writer);
+ *
+ * PARAMETERS:
+ *    Writer [I] -- The writer we are running
+ *
+ * FUNCTION:
+ *    This is the writer thread.  It wakes up every WRITER_POLL_MS, empties
+ *    the ring in to the current block and writes the block when it is full
+ *    (or has been sitting around for BLOCK_MAX_AGE_MS).  Pending bytes that
+ *    have been sitting for PENDING_MAX_AGE_MS are taken and written right
+ *    away.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void StreamCapture_WriterThread(struct StreamCaptureWriter *Writer)
+{
+    chrono::steady_clock::time_point BlockStarted;
+    bool Stopping;
+    bool WasEmpty;
+
+    BlockStarted=chrono::steady_clock::now();
+    for(;;)
+    {
+        /* Read the stop flag before we drain so nothing that was added
+           before the stop is missed */
+        Stopping=Writer->Stop;
+
+        WasEmpty=Writer->Block.size()==0;
+        if(StreamCapture_DrainRing(Writer) && WasEmpty)
+            BlockStarted=chrono::steady_clock::now();
+
+        if(!Stopping && StreamCapture_TakePending(Writer))
+        {
+            StreamCapture_WriteBlock(Writer);
+            BlockStarted=chrono::steady_clock::now();
+            continue;
+        }
+
+        if(Writer->Block.size()>=BLOCK_SIZE || (Writer->Block.size()>0 &&
+                (Stopping || chrono::steady_clock::now()-BlockStarted>=
+                chrono::milliseconds(BLOCK_MAX_AGE_MS))))
+        {
+            StreamCapture_WriteBlock(Writer);
+            BlockStarted=chrono::steady_clock::now();
+            continue;
+        }
+
+        if(Stopping)
+            break;
+
+        unique_lock<mutex> Lock(Writer->StopMutex);
+        if(!Writer->Stop)
+        {
+            Writer->StopCond.wait_for(Lock,
+                    chrono::milliseconds(WRITER_POLL_MS));
+        }
+    }
+    fflush(Writer->out);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_DrainRing
+ *
+ * SYNOPSIS:
+ *    static bool StreamCapture_DrainRing(struct StreamCaptureWriter *Writer);
+ *
+ * PARAMETERS:
+ *    Writer [I] -- The writer to drain the ring for
+ *
+ * FUNCTION:
+ *    This function moves records from the ring in to the current block
+ *    (in the file format) until the ring is empty or the block is full.
+ *
+ * RETURNS:
+ *    true -- Something was added to the block
+ *    false -- The ring was empty
+ ******************************************************************************/
+static bool StreamCapture_DrainRing(struct StreamCaptureWriter *Writer)
+{
+    uint32_t RecHeader[2];
+    uint64_t Ticks;
+    uint64_t Head;
+    uint64_t Tail;
+    size_t Start;
+    bool Added;
+
+    Added=false;
+    Head=Writer->Head.load(memory_order_acquire);
+    Tail=Writer->Tail.load(memory_order_relaxed);
+    while(Tail!=Head && Writer->Block.size()<BLOCK_SIZE)
+    {
+        StreamCapture_RingRead(Writer,Tail,RecHeader,sizeof(RecHeader));
+        StreamCapture_RingRead(Writer,Tail+8,&Ticks,sizeof(Ticks));
+
+        StreamCapture_AddRecordHeader(Writer,Ticks,RecHeader[1],RecHeader[0]);
+        Start=Writer->Block.size();
+        Writer->Block.resize(Start+RecHeader[0]);
+        StreamCapture_RingRead(Writer,Tail+RING_RECORD_HEADER_SIZE,
+                Writer->Block.data()+Start,RecHeader[0]);
+
+        Tail+=RING_RECORD_HEADER_SIZE+RecHeader[0];
+        Added=true;
+    }
+    Writer->Tail.store(Tail,memory_order_release);
+
+    return Added;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_TakePending
+ *
+ * SYNOPSIS:
+ *    static bool StreamCapture_TakePending(
+ *              struct StreamCaptureWriter *Writer);
+ *
+ * PARAMETERS:
+ *    Writer [I] -- The writer to take the pending bytes for
+ *
+ * FUNCTION:
+ *    This function takes the connection's pending bytes and adds them to
+ *    the current block if they have been sitting for PENDING_MAX_AGE_MS
+ *    (the same generation of 'PendingState' with bytes in it).
+ *
+ *    This is only done when the ring is empty.  The state is read before
+ *    the ring head, so if the swap works nothing newer than the taken
+ *    bytes can be in the ring and the records stay in order.
+ *
+ * RETURNS:
+ *    true -- The pending bytes were added to the block
+ *    false -- Nothing was taken
+ ******************************************************************************/
+static bool StreamCapture_TakePending(struct StreamCaptureWriter *Writer)
+{
+    struct StreamCapture *Cap;
+    uint64_t State;
+    uint32_t Len;
+    size_t Start;
+
+    Cap=Writer->Cap;
+    State=Cap->PendingState.load(memory_order_acquire);
+    Len=(uint32_t)State;
+    if(Len==0)
+        return false;
+
+    if(State>>32!=Writer->PendingSeen>>32 || (uint32_t)Writer->PendingSeen==0)
+    {
+        Writer->PendingSeen=State;
+        Writer->PendingSeenAt=chrono::steady_clock::now();
+        return false;
+    }
+    if(chrono::steady_clock::now()-Writer->PendingSeenAt<
+            chrono::milliseconds(PENDING_MAX_AGE_MS))
+    {
+        return false;
+    }
+
+    if(Writer->Head.load(memory_order_acquire)!=
+            Writer->Tail.load(memory_order_relaxed))
+    {
+        return false;
+    }
+
+    /* Copy first, the bytes are only ours if the swap works */
+    Start=Writer->Block.size();
+    StreamCapture_AddRecordHeader(Writer,PerfTimer_Now(),0,Len);
+    Writer->Block.insert(Writer->Block.end(),Cap->Pending,Cap->Pending+Len);
+    if(!Cap->PendingState.compare_exchange_strong(State,
+            ((State>>32)+1)<<32,memory_order_acq_rel,memory_order_relaxed))
+    {
+        Writer->Block.resize(Start);
+        return false;
+    }
+    Writer->PendingSeen=0;
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_AddRecordHeader
+ *
+ * SYNOPSIS:
+ *    static void StreamCapture_AddRecordHeader(
+ *              struct StreamCaptureWriter *Writer,uint64_t Ticks,
+ *              uint32_t Lost,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Writer [I] -- The writer with the block to add to
+ *    Ticks [I] -- PerfTimer_Now() when the record was made
+ *    Lost [I] -- The number of bytes dropped before this record
+ *    Len [I] -- The number of data bytes that will follow
+ *
+ * FUNCTION:
+ *    This function adds a lost record (if 'Lost' isn't 0) and the start of
+ *    a data record to the current block.  The caller adds the 'Len' data
+ *    bytes after it.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void StreamCapture_AddRecordHeader(struct StreamCaptureWriter *Writer,
+        uint64_t Ticks,uint32_t Lost,uint32_t Len)
+{
+    uint64_t TimeUS;
+
+    TimeUS=PerfTimer_Ticks2NS(Ticks-Writer->StartTicks)/1000;
+    if(Ticks<Writer->StartTicks || TimeUS<Writer->LastTimeUS)
+        TimeUS=Writer->LastTimeUS;
+
+    if(Lost>0)
+    {
+        StreamCapture_AddVarInt(Writer->Block,TimeUS-Writer->LastTimeUS);
+        StreamCapture_AddVarInt(Writer->Block,((uint64_t)Lost<<1)|
+                STREAMCAPTURE_RECORD_LOST);
+        Writer->LastTimeUS=TimeUS;
+    }
+
+    StreamCapture_AddVarInt(Writer->Block,TimeUS-Writer->LastTimeUS);
+    StreamCapture_AddVarInt(Writer->Block,((uint64_t)Len<<1)|
+            STREAMCAPTURE_RECORD_DATA);
+    Writer->LastTimeUS=TimeUS;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_WriteBlock
+ *
+ * SYNOPSIS:
+ *    static void StreamCapture_WriteBlock(struct StreamCaptureWriter *Writer);
+ *
+ * PARAMETERS:
+ *    Writer [I] -- The writer to write the current block for
+ *
+ * FUNCTION:
+ *    This function compresses the current block and writes it to the file.
+ *    If the block didn't get any smaller it is stored as is.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void StreamCapture_WriteBlock(struct StreamCaptureWriter *Writer)
+{
+    uint8_t BlockHeader[STREAMCAPTURE_BLOCK_HEADER_SIZE];
+    uint32_t RawLen;
+    uint32_t StoredLen;
+    const uint8_t *Stored;
+    uint32_t Flags;
+
+    RawLen=Writer->Block.size();
+    StoredLen=BlockCompress_Compress(Writer->Block.data(),RawLen,
+            Writer->Packed.data());
+    if(StoredLen<RawLen)
+    {
+        Stored=Writer->Packed.data();
+        Flags=STREAMCAPTURE_BLOCK_COMPRESSED;
+    }
+    else
+    {
+        Stored=Writer->Block.data();
+        StoredLen=RawLen;
+        Flags=0;
+    }
+
+    StreamCapture_Put32(&BlockHeader[0],RawLen);
+    StreamCapture_Put32(&BlockHeader[4],StoredLen);
+    StreamCapture_Put32(&BlockHeader[8],Flags);
+
+    /* If the disk fills we just stop writing (and keep draining so the
+       connection isn't affected) */
+    if(!Writer->WriteFailed)
+    {
+        if(fwrite(BlockHeader,sizeof(BlockHeader),1,Writer->out)!=1 ||
+                fwrite(Stored,StoredLen,1,Writer->out)!=1)
+        {
+            Writer->WriteFailed=true;
+        }
+    }
+
+    Writer->Block.clear();
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_RingWrite
+ *
+ * SYNOPSIS:
+ *    static void StreamCapture_RingWrite(struct StreamCaptureWriter *Writer,
+ *              uint64_t Pos,const void *Src,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Writer [I] -- The writer with the ring in it
+ *    Pos [I] -- The position (not wrapped) to write at
+ *    Src [I] -- The bytes to write
+ *    Len [I] -- The number of bytes to write
+ *
+ * FUNCTION:
+ *    This function copies bytes in to the ring, wrapping around the end.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    StreamCapture_RingRead()
+ ******************************************************************************/
+static void StreamCapture_RingWrite(struct StreamCaptureWriter *Writer,
+        uint64_t Pos,const void *Src,uint32_t Len)
+{
+    uint32_t Offset;
+    uint32_t First;
+
+    Offset=Pos&(RING_SIZE-1);
+    First=RING_SIZE-Offset;
+    if(First>Len)
+        First=Len;
+    memcpy(&Writer->Ring[Offset],Src,First);
+    memcpy(Writer->Ring,(const uint8_t *)Src+First,Len-First);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_RingRead
+ *
+ * SYNOPSIS:
+ *    static void StreamCapture_RingRead(struct StreamCaptureWriter *Writer,
+ *              uint64_t Pos,void *Dest,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Writer [I] -- The writer with the ring in it
+ *    Pos [I] -- The position (not wrapped) to read from
+ *    Dest [O] -- Where to put the bytes
+ *    Len [I] -- The number of bytes to read
+ *
+ * FUNCTION:
+ *    This function copies bytes out of the ring, wrapping around the end.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    StreamCapture_RingWrite()
+ ******************************************************************************/
+static void StreamCapture_RingRead(struct StreamCaptureWriter *Writer,
+        uint64_t Pos,void *Dest,uint32_t Len)
+{
+    uint32_t Offset;
+    uint32_t First;
+
+    Offset=Pos&(RING_SIZE-1);
+    First=RING_SIZE-Offset;
+    if(First>Len)
+        First=Len;
+    memcpy(Dest,&Writer->Ring[Offset],First);
+    memcpy((uint8_t *)Dest+First,Writer->Ring,Len-First);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_OpenReader
+ *
+ * SYNOPSIS:
+ *    bool StreamCapture_OpenReader(struct StreamCaptureReader *Reader,
+ *              const char *Filename);
+ *
+ * PARAMETERS:
+ *    Reader [O] -- The reader to setup
+ *    Filename [I] -- The capture file to open
+ *
+ * FUNCTION:
+ *    This function opens a capture file and checks the header.
+ *
+ * RETURNS:
+ *    true -- The file is open and ready for StreamCapture_ReadRecord()
+ *    false -- The file couldn't be opened or isn't a capture file
+ *
+ * SEE ALSO:
+ *    StreamCapture_ReadRecord(), StreamCapture_CloseReader()
+ ******************************************************************************/
+bool StreamCapture_OpenReader(struct StreamCaptureReader *Reader,
+        const char *Filename)
+{
+    uint8_t Header[STREAMCAPTURE_HEADER_SIZE];
+
+    Reader->in=fopen(Filename,"rb");
+    if(Reader->in==NULL)
+        return false;
+
+    if(fread(Header,sizeof(Header),1,Reader->in)!=1 ||
+            memcmp(Header,STREAMCAPTURE_MAGIC,STREAMCAPTURE_MAGIC_LEN)!=0 ||
+            StreamCapture_Get32(&Header[8])!=STREAMCAPTURE_FILE_VERSION)
+    {
+        fclose(Reader->in);
+        Reader->in=NULL;
+        return false;
+    }
+
+    Reader->StartTime=StreamCapture_Get32(&Header[16])|
+            ((uint64_t)StreamCapture_Get32(&Header[20])<<32);
+    Reader->LastTimeUS=0;
+    Reader->Sessions=1;
+    Reader->Block.clear();
+    Reader->BlockPos=0;
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_ReadRecord
+ *
+ * SYNOPSIS:
+ *    bool StreamCapture_ReadRecord(struct StreamCaptureReader *Reader,
+ *              struct StreamCaptureRecord *Record,bool *Damaged);
+ *
+ * PARAMETERS:
+ *    Reader [I] -- The reader to read from
+ *    Record [O] -- The record that was read.  'Data' points in to the
+ *                  reader and is only good until the next call.
+ *    Damaged [O] -- Set to true if we stopped because the file is damaged
+ *                   (false for the normal end of the file).
+ *
+ * FUNCTION:
+ *    This function reads the next record from a capture file.
+ *
+ *    When a new session starts its records follow on from the last record
+ *    of the one before (the time between the sessions isn't kept) so
+ *    'TimeUS' never goes backwards.
+ *
+ * RETURNS:
+ *    true -- 'Record' has the next record
+ *    false -- There are no more records
+ *
+ * SEE ALSO:
+ *    StreamCapture_OpenReader()
+ ******************************************************************************/
+bool StreamCapture_ReadRecord(struct StreamCaptureReader *Reader,
+        struct StreamCaptureRecord *Record,bool *Damaged)
+{
+    uint8_t BlockHeader[STREAMCAPTURE_HEADER_SIZE];
+    uint32_t RawLen;
+    uint32_t StoredLen;
+    uint32_t Flags;
+    uint64_t Delta;
+    uint64_t LenAndType;
+    size_t Got;
+
+    *Damaged=false;
+
+    while(Reader->BlockPos>=Reader->Block.size())
+    {
+        Got=fread(BlockHeader,1,STREAMCAPTURE_BLOCK_HEADER_SIZE,Reader->in);
+        if(Got==0)
+            return false;
+        if(Got!=STREAMCAPTURE_BLOCK_HEADER_SIZE)
+        {
+            *Damaged=true;
+            return false;
+        }
+
+        /* The start of the next session? */
+        if(memcmp(BlockHeader,STREAMCAPTURE_MAGIC,
+                STREAMCAPTURE_MAGIC_LEN)==0)
+        {
+            if(fread(&BlockHeader[STREAMCAPTURE_BLOCK_HEADER_SIZE],
+                    STREAMCAPTURE_HEADER_SIZE-STREAMCAPTURE_BLOCK_HEADER_SIZE,
+                    1,Reader->in)!=1 || StreamCapture_Get32(&BlockHeader[8])!=
+                    STREAMCAPTURE_FILE_VERSION)
+            {
+                *Damaged=true;
+                return false;
+            }
+            Reader->Sessions++;
+            continue;
+        }
+
+        RawLen=StreamCapture_Get32(&BlockHeader[0]);
+        StoredLen=StreamCapture_Get32(&BlockHeader[4]);
+        Flags=StreamCapture_Get32(&BlockHeader[8]);
+        if(RawLen>MAX_BLOCK_SIZE || StoredLen>BLOCKCOMPRESS_MAX_SIZE(RawLen))
+        {
+            *Damaged=true;
+            return false;
+        }
+
+        Reader->Stored.resize(StoredLen);
+        Reader->Block.resize(RawLen);
+        Reader->BlockPos=0;
+        if(StoredLen>0 && fread(Reader->Stored.data(),StoredLen,1,
+                Reader->in)!=1)
+        {
+            *Damaged=true;
+            return false;
+        }
+
+        if(Flags&STREAMCAPTURE_BLOCK_COMPRESSED)
+        {
+            if(!BlockCompress_Decompress(Reader->Stored.data(),StoredLen,
+                    Reader->Block.data(),RawLen))
+            {
+                *Damaged=true;
+                return false;
+            }
+        }
+        else
+        {
+            if(StoredLen!=RawLen)
+            {
+                *Damaged=true;
+                return false;
+            }
+            Reader->Block.swap(Reader->Stored);
+        }
+    }
+
+    if(!StreamCapture_GetVarInt(Reader,&Delta) ||
+            !StreamCapture_GetVarInt(Reader,&LenAndType))
+    {
+        *Damaged=true;
+        return false;
+    }
+
+    Reader->LastTimeUS+=Delta;
+    Record->TimeUS=Reader->LastTimeUS;
+    Record->Type=LenAndType&1;
+    Record->Len=LenAndType>>1;
+    Record->Data=NULL;
+
+    if(Record->Type==STREAMCAPTURE_RECORD_DATA)
+    {
+        if(Record->Len>Reader->Block.size()-Reader->BlockPos)
+        {
+            *Damaged=true;
+            return false;
+        }
+        Record->Data=&Reader->Block[Reader->BlockPos];
+        Reader->BlockPos+=Record->Len;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_CloseReader
+ *
+ * SYNOPSIS:
+ *    void StreamCapture_CloseReader(struct StreamCaptureReader *Reader);
+ *
+ * PARAMETERS:
+ *    Reader [I] -- The reader to close
+ *
+ * FUNCTION:
+ *    This function closes a capture file opened with
+ *    StreamCapture_OpenReader().
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void StreamCapture_CloseReader(struct StreamCaptureReader *Reader)
+{
+    if(Reader->in!=NULL)
+        fclose(Reader->in);
+    Reader->in=NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_AddVarInt
+ *
+ * SYNOPSIS:
+ *    static void StreamCapture_AddVarInt(vector<uint8_t> &Out,
+ *              uint64_t Value);
+ *
+ * PARAMETERS:
+ *    Out [I/O] -- The block to add to
+ *    Value [I] -- The value to add
+ *
+ * FUNCTION:
+ *    This function adds a varint (7 bits per byte, low bits first) to a
+ *    block.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void StreamCapture_AddVarInt(vector<uint8_t> &Out,uint64_t Value)
+{
+    while(Value>=0x80)
+    {
+        Out.push_back((Value&0x7F)|0x80);
+        Value>>=7;
+    }
+    Out.push_back(Value);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_GetVarInt
+ *
+ * SYNOPSIS:
+ *    static bool StreamCapture_GetVarInt(struct StreamCaptureReader *Reader,
+ *              uint64_t *Value);
+ *
+ * PARAMETERS:
+ *    Reader [I] -- The reader to read the varint from
+ *    Value [O] -- The value read
+ *
+ * FUNCTION:
+ *    This function reads a varint from the current block.
+ *
+ * RETURNS:
+ *    true -- 'Value' was read
+ *    false -- The varint ran off the end of the block (or is too long)
+ ******************************************************************************/
+static bool StreamCapture_GetVarInt(struct StreamCaptureReader *Reader,
+        uint64_t *Value)
+{
+    uint8_t Byte;
+    int Shift;
+
+    *Value=0;
+    for(Shift=0;Shift<64;Shift+=7)
+    {
+        if(Reader->BlockPos>=Reader->Block.size())
+            return false;
+        Byte=Reader->Block[Reader->BlockPos++];
+        *Value|=(uint64_t)(Byte&0x7F)<<Shift;
+        if((Byte&0x80)==0)
+            return true;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_Put32
+ *
+ * SYNOPSIS:
+ *    static void StreamCapture_Put32(uint8_t *Out,uint32_t Value);
+ *
+ * PARAMETERS:
+ *    Out [O] -- Where to write the value
+ *    Value [I] -- The value to write
+ *
+ * FUNCTION:
+ *    This function writes a little endian uint32.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    StreamCapture_Get32()
+ ******************************************************************************/
+static void StreamCapture_Put32(uint8_t *Out,uint32_t Value)
+{
+    Out[0]=Value&0xFF;
+    Out[1]=(Value>>8)&0xFF;
+    Out[2]=(Value>>16)&0xFF;
+    Out[3]=(Value>>24)&0xFF;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_Get32
+ *
+ * SYNOPSIS:
+ *    static uint32_t StreamCapture_Get32(const uint8_t *In);
+ *
+ * PARAMETERS:
+ *    In [I] -- Where to read the value from
+ *
+ * FUNCTION:
+ *    This function reads a little endian uint32.
+ *
+ * RETURNS:
+ *    The value
+ *
+ * SEE ALSO:
+ *    StreamCapture_Put32()
+ ******************************************************************************/
+static uint32_t StreamCapture_Get32(const uint8_t *In)
+{
+    return In[0]|(In[1]<<8)|(In[2]<<16)|((uint32_t)In[3]<<24);
+}
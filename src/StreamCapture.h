@@ -0,0 +1,233 @@
+/*******************************************************************************
+ * FILENAME: StreamCapture.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the .h file for the StreamCapture.cpp file.
+ *
+ *    Capture file format (all numbers are little endian):
+ *       A file is one or more sessions.  Every time a capture is started
+ *       (a new connection or a restart) a new session is added to the end
+ *       of the file, the file is never truncated.  A session is a file
+ *       header followed by blocks.  The reader tells a file header from a
+ *       block header by the magic (as a block RawLen it would be way over
+ *       the max block size).
+ *       File header (24 bytes):
+ *          Magic -- 8 bytes "TLHCAP\0\1"
+ *          Version -- uint32 (STREAMCAPTURE_FILE_VERSION)
+ *          Flags -- uint32 (0)
+ *          StartTime -- uint64 micro seconds since 1970 when the capture
+ *                       started.
+ *       Then blocks until the next file header or the end of the file:
+ *          RawLen -- uint32, the size of the block once decompressed
+ *          StoredLen -- uint32, the number of bytes that follow
+ *          Flags -- uint32, bit 0 set if the block is compressed (see
+ *                   BlockCompress.cpp), clear if it is stored as is.
+ *          Data -- 'StoredLen' bytes
+ *       Once decompressed a block is a list of records:
+ *          Delta -- varint, micro seconds since the last record (the first
+ *                   record in a session is relative to its StartTime).
+ *          LenAndType -- varint, (Len<<1)|Type
+ *                Type 0 -- 'Len' bytes of stream data follow
+ *                Type 1 -- 'Len' bytes were lost here (the capture
+ *                          buffer was full).  No data follows.
+ *       A varint is 7 bits per byte, low bits first, the top bit set on all
+ *       but the last byte.
+ *
+ *    Records are made at the end of each line (or every
+ *    STREAMCAPTURE_PENDING_SIZE bytes, or when the start of a line has been
+ *    sitting for a while with nothing more coming in) so the timestamps are
+ *    as coarse as the lines.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __STREAMCAPTURE_H_
+#define __STREAMCAPTURE_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+/***  DEFINES                          ***/
+#define STREAMCAPTURE_MAGIC                 "TLHCAP\0\1"
+#define STREAMCAPTURE_MAGIC_LEN             8
+#define STREAMCAPTURE_FILE_VERSION          1
+#define STREAMCAPTURE_HEADER_SIZE           24
+#define STREAMCAPTURE_BLOCK_HEADER_SIZE     12
+#define STREAMCAPTURE_BLOCK_COMPRESSED      0x0001
+
+#define STREAMCAPTURE_RECORD_DATA           0
+#define STREAMCAPTURE_RECORD_LOST           1
+
+/* Bytes are collected here until the end of the line */
+#define STREAMCAPTURE_PENDING_SIZE          4096
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+struct StreamCaptureWriter;
+
+/* Only 'Pending' and 'PendingState' are touched by the connection, the
+   rest belongs to the writer thread (see StreamCapture.cpp).  'PendingState'
+   is (Generation<<32)|Len.  Only the connection adds bytes, the writer can
+   take the pending bytes if they have been sitting too long, which sets the
+   len to 0 and bumps the generation (as does a flush by the connection). */
+struct StreamCapture
+{
+    uint8_t Pending[STREAMCAPTURE_PENDING_SIZE];
+    std::atomic<uint64_t> PendingState;
+    struct StreamCaptureWriter *Writer;
+};
+
+/* Used by the replay tools to read a capture file */
+struct StreamCaptureRecord
+{
+    uint64_t TimeUS;            // Micro seconds since the capture started
+    int Type;                   // STREAMCAPTURE_RECORD_*
+    uint32_t Len;
+    const uint8_t *Data;        // Only for STREAMCAPTURE_RECORD_DATA
+};
+
+struct StreamCaptureReader
+{
+    FILE *in;
+    uint64_t StartTime;         // When the first session started
+    uint64_t LastTimeUS;
+    uint32_t Sessions;
+    std::vector<uint8_t> Stored;
+    std::vector<uint8_t> Block;
+    uint32_t BlockPos;
+};
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+struct StreamCapture *StreamCapture_Start(const char *Filename);
+void StreamCapture_Stop(struct StreamCapture *Cap);
+void StreamCapture_FlushPending(struct StreamCapture *Cap);
+uint64_t StreamCapture_GetLostBytes(struct StreamCapture *Cap);
+
+bool StreamCapture_OpenReader(struct StreamCaptureReader *Reader,
+        const char *Filename);
+bool StreamCapture_ReadRecord(struct StreamCaptureReader *Reader,
+        struct StreamCaptureRecord *Record,bool *Damaged);
+void StreamCapture_CloseReader(struct StreamCaptureReader *Reader);
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_AddByte
+ *
+ * SYNOPSIS:
+ *    static inline void StreamCapture_AddByte(struct StreamCapture *Cap,
+ *          uint8_t Byte,bool EndOfLine);
+ *
+ * PARAMETERS:
+ *    Cap [I] -- The capture to add to
+ *    Byte [I] -- The byte that came in
+ *    EndOfLine [I] -- true if this byte ends the line
+ *
+ * FUNCTION:
+ *    This function adds a byte to the capture.  The byte is just stored in
+ *    the pending buffer, it is sent to the writer thread at the end of the
+ *    line.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static inline void StreamCapture_AddByte(struct StreamCapture *Cap,
+        uint8_t Byte,bool EndOfLine)
+{
+    uint64_t State;
+
+    State=Cap->PendingState.load(std::memory_order_relaxed);
+    Cap->Pending[(uint32_t)State]=Byte;
+    if(!Cap->PendingState.compare_exchange_strong(State,State+1,
+            std::memory_order_release,std::memory_order_relaxed))
+    {
+        /* The writer took the pending bytes ('State' now has a len of 0) */
+        Cap->Pending[0]=Byte;
+        Cap->PendingState.store(State+1,std::memory_order_release);
+    }
+    if(EndOfLine || (uint32_t)State+1>=STREAMCAPTURE_PENDING_SIZE)
+        StreamCapture_FlushPending(Cap);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    StreamCapture_AddBlock
+ *
+ * SYNOPSIS:
+ *    static inline void StreamCapture_AddBlock(struct StreamCapture *Cap,
+ *          const uint8_t *Buf,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Cap [I] -- The capture to add to
+ *    Buf [I] -- The bytes that came in.  This must not have an end of line
+ *               in it (use StreamCapture_AddByte() for those so the line
+ *               gets its time stamp).
+ *    Len [I] -- The number of bytes in 'Buf'
+ *
+ * FUNCTION:
+ *    This function adds a run of bytes to the capture.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    StreamCapture_AddByte()
+ ******************************************************************************/
+static inline void StreamCapture_AddBlock(struct StreamCapture *Cap,
+        const uint8_t *Buf,uint32_t Len)
+{
+    uint64_t State;
+    uint32_t Room;
+
+    while(Len>0)
+    {
+        State=Cap->PendingState.load(std::memory_order_relaxed);
+        Room=STREAMCAPTURE_PENDING_SIZE-(uint32_t)State;
+        if(Room>Len)
+            Room=Len;
+        memcpy(&Cap->Pending[(uint32_t)State],Buf,Room);
+        if(!Cap->PendingState.compare_exchange_strong(State,State+Room,
+                std::memory_order_release,std::memory_order_relaxed))
+        {
+            /* The writer took the pending bytes ('State' now has a len
+               of 0) */
+            memcpy(Cap->Pending,Buf,Room);
+            Cap->PendingState.store(State+Room,std::memory_order_release);
+        }
+        Buf+=Room;
+        Len-=Room;
+        if((uint32_t)State+Room>=STREAMCAPTURE_PENDING_SIZE)
+            StreamCapture_FlushPending(Cap);
+    }
+}
+
+#endif
@@ -31,12 +31,27 @@
 
 /*** HEADER FILES TO INCLUDE  ***/
 #include "TextLineHighlighter.h"
+#include "LineMatch.h"
+#include "PerfTimer.h"
+#include "LatencyHistogram.h"
+#include "HostCallShim.h"
+#include "MetricsExport.h"
+#include "StreamCapture.h"
+#include "AsyncMatch.h"
+#include "MarkPool.h"
 #include "PluginSDK/Plugin.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string>
-#include <regex>
+#include <vector>
+#include <list>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -48,40 +63,382 @@ using namespace std;
 #define NUM_OF_SIMPLE               3
 #define NUM_OF_STYLES               (NUM_OF_REGEXS+NUM_OF_SIMPLE)
 
+/* We only time 1 out of this many lines (reading the timer isn't free) */
+#define STATS_TIME_SAMPLE_RATE      16
+
+/* Lines longer than the max line length are checked in windows of that
+   size.  Each window starts this many bytes before the end of the last one
+   so matches up to this long that cross a window edge are still found. */
+#define DEFAULT_MAX_LINE_LENGTH     65536
+#define MIN_MAX_LINE_LENGTH         1024
+#define LINE_WINDOW_OVERLAP         256
+
+/* Multi-line records keep a mark for each line, this is the most (and
+   so the most marks a connection will allocate for them) */
+#define DEFAULT_RECORD_MAX_LINES    64
+#define MIN_RECORD_MAX_LINES        2
+#define MAX_RECORD_MAX_LINES        4096
+
+/* TextLineHighlighterData 'RecordHits' */
+#define RECORD_RULE_HIT             0x01    // The rule matched the record
+#define RECORD_RULE_LAST_LINE_HIT   0x02    // "ends with" matched the last line
+
+/* Checking lines on a worker thread.  The max lag is the most lines that
+   can be waiting for their styles (each one holds a mark).  When the
+   connection stops using the worker we wait this long for it to finish the
+   lines it has so their styles can still be applied. */
+#define DEFAULT_ASYNC_MAX_LINES     256
+#define MIN_ASYNC_MAX_LINES         16
+#define MAX_ASYNC_MAX_LINES         65536
+#define ASYNC_FLUSH_WAIT_US         2000
+
+/* Big rule sets are split in to shards of this many rules that the workers
+   check at the same time (0 = never split) */
+#define DEFAULT_ASYNC_SHARD_RULES   256
+#define MIN_ASYNC_SHARD_RULES       16
+#define MAX_ASYNC_SHARD_RULES       65536
+
+/* How long the helper process can go without answering before the worker
+   gives up on it and falls back to the simple rules */
+#define DEFAULT_HELPER_TIMEOUT_MS   2000
+#define MIN_HELPER_TIMEOUT_MS       10
+#define MAX_HELPER_TIMEOUT_MS       60000
+
+/* Micro-batching on the connection.  Lines are held until there are
+   'BatchLines' of them or the first one has waited 'BatchDelayUS', and the
+   rules are run on them all at once.  Hosts that give us a byte at a time
+   check the delay on every byte while a batch is waiting. */
+#define DEFAULT_BATCH_LINES         1
+#define MAX_BATCH_LINES             4096
+#define DEFAULT_BATCH_DELAY_US      1000
+#define MAX_BATCH_DELAY_US          1000000
+
+/* Load shedding (see TextLineHighlighter_Governor()).  Every window the
+   governor works out how much of the time checking lines would take at
+   each level, and goes to the lowest level that fits in the budget.  It
+   only comes back down to a level once that level fits in half the budget
+   (so it doesn't flip back and forth).  The cost of a line is averaged
+   over windows with SHED_COST_SHIFT (1/8 new, 7/8 old). */
+#define DEFAULT_SHED_BUDGET_PCT     50
+#define MIN_SHED_BUDGET_PCT         1
+#define MAX_SHED_BUDGET_PCT         100
+#define DEFAULT_SHED_SAMPLE         8
+#define MIN_SHED_SAMPLE             2
+#define MAX_SHED_SAMPLE             1024
+#define SHED_WINDOW_MS              250
+#define SHED_COST_SHIFT             3
+
+/* Style rate limits (see TextLineHighlighter_StyleLimitPass()) */
+#define DEFAULT_STYLE_LIMIT_WINDOW_MS   1000
+#define MIN_STYLE_LIMIT_WINDOW_MS       10
+#define MAX_STYLE_LIMIT_WINDOW_MS       60000
+#define DEFAULT_STYLE_LIMIT_NTH         10
+#define MIN_STYLE_LIMIT_NTH             2
+#define MAX_STYLE_LIMIT_NTH             100000
+
+/* Re-highlighting the scroll back (see TextLineHighlighter_RunRescan()) */
+#define RESCAN_CHUNK_LINES              64      // Lines per job fed at once
+#define RESCAN_MAX_MATCHERS             8
+#define RESCAN_LINE_BUDGET_US           20      // After each line that ends
+#define RESCAN_IDLE_BUDGET_US           10000   // When WhippyTerm is idle
+
+/* Early highlighting (see TextLineHighlighter_EarlyCheck()).  The rules
+   are checked again after this many more bytes of the line come in. */
+#define EARLY_CHECK_BYTES               8
+
 /*** MACROS                   ***/
 
 /*** TYPE DEFINITIONS         ***/
+/* What ends a line (these are saved in the settings so only add to the end) */
+typedef enum
+{
+    e_LineEnd_LF,               // '\n' (a '\r' before it isn't matched)
+    e_LineEnd_CR,               // '\r' or '\n' (for "\r" progress lines)
+    e_LineEnd_CRLF,             // Only "\r\n"
+    e_LineEnd_NUL,              // '\0'
+    e_LineEnd_Custom,           // 'LineEndByte'
+    e_LineEndMAX
+} e_LineEndType;
+
+/* How far the load shedding governor has backed off (the most to use is
+   saved in the settings so only add to the end) */
+typedef enum
+{
+    e_Shed_Full,                // Check every line with every rule
+    e_Shed_SkipRegex,           // Only the simple (literal) rules
+    e_Shed_Sample,              // Only the simple rules on 1 in 'ShedSample' lines
+    e_Shed_Pause,               // Don't check the lines at all
+    e_ShedMAX
+} e_ShedLevelType;
+
+/* What to do with a rule's matches once it is over its style limit (saved
+   in the settings so only add to the end) */
+typedef enum
+{
+    e_StyleLimit_Drop,          // Don't style any more until the next window
+    e_StyleLimit_EveryNth,      // Style 1 in 'StyleLimitNth' of them
+    e_StyleLimitMAX
+} e_StyleLimitType;
+
+/* What makes a line part of the record before it (saved in the settings) */
+typedef enum
+{
+    e_RecordCont_Indented,      // Starts with a space or tab
+    e_RecordCont_Prefix,        // Starts with 'RecordPrefix'
+    e_RecordContMAX
+} e_RecordContType;
+
+/* What to do with the scroll back when the settings are applied (saved in
+   the settings so only add to the end) */
+typedef enum
+{
+    e_Rehighlight_Off,          // Leave it alone
+    e_Rehighlight_OnTop,        // Apply the new rules over the old styles
+    e_Rehighlight_Reset,        // Put the lines back to the default colors
+                                // and then apply the new rules
+    e_RehighlightMAX
+} e_RehighlightType;
+
+/* What we know about a rule part way through a line */
+typedef enum
+{
+    e_Early_Undecided,          // Haven't seen enough of the line
+    e_Early_NoMatch,            // Can't match no matter what comes next
+    e_Early_Match,              // Matches no matter what comes next
+    e_EarlyMAX
+} e_EarlyStateType;
+
 struct TextLineHighlighter_TextStyle
 {
     uint32_t FGColor;
     uint32_t BGColor;
     uint32_t Attribs;
+    bool ULineColorOn;      // Use 'ULineColor' for the underline
+    uint32_t ULineColor;
 };
 
-struct TextLineHighlighterSimpleData
+/* The statistics are only written by the connection's thread but are read
+   by the UI and the metrics export thread, so they are atomics.  Use
+   TextLineHighlighter_StatAdd() to change them. */
+typedef atomic<uint64_t> t_StatCounter;
+
+struct TextLineHighlighter_RuleStats
 {
-    string StartsWith;
-    string Contains;
-    string EndsWith;
-    int StyleIndex;
+    string Name;
+    t_StatCounter Evaluations;
+    t_StatCounter Hits;
+    t_StatCounter TimedEvaluations; // How many of 'Evaluations' where timed
+    t_StatCounter TotalTicks;       // Total time of the timed evaluations
+    t_StatCounter MaxTicks;
+    t_StatCounter Suppressed;       // Matches not styled (style limit)
+};
+/* A deque because atomics can't be moved (so no vector) */
+typedef deque<struct TextLineHighlighter_RuleStats> t_RuleStatsList;
+
+struct TextLineHighlighter_ConStats
+{
+    t_StatCounter Lines;
+    t_StatCounter Bytes;
+    t_StatCounter HostCalls;
+    t_StatCounter LongLines;    // Lines that went over the max line length
+    t_StatCounter Records;      // Multi-line records
+    t_StatCounter AsyncLines;   // Lines checked on the worker thread
+    t_StatCounter AsyncInline;  // Lines checked inline (the worker was behind)
+    t_StatCounter AsyncStale;   // Lines scrolled away before their styles came
+    t_StatCounter AsyncQueue;   // Lines waiting for a worker (not a count)
+    t_StatCounter AsyncSteals;  // Batches a worker stole from another worker
+    t_StatCounter Marks;        // Marks in the pool (not a count)
+    t_StatCounter MarksInUse;   // Marks retained from the pool (not a count)
+    t_StatCounter MarksPeak;    // The most 'MarksInUse' has been
+    t_StatCounter Batches;      // Micro-batches of lines checked
+    t_StatCounter ShedLevel;    // The governor's e_ShedLevelType (not a count)
+    t_StatCounter ShedLines;    // Lines not checked because of load shedding
+    t_StatCounter StylesSuppressed; // Styles not applied (style limit)
+    t_StatCounter HelperFallback;   // Lines only given the simple rules
+                                    // because the helper process failed
+    t_StatCounter RehighlightTotal; // Lines in the running re-highlight
+                                    // (not a count, 0 = not running)
+    t_StatCounter RehighlightLeft;  // Lines it has left (not a count)
+    t_StatCounter RehighlightLines; // Scroll back lines re-highlighted
+    t_StatCounter EarlyLines;       // Lines styled before they ended
+};
+
+/* How much has been styled in the current style limit window */
+struct TextLineHighlighter_StyleLimit
+{
+    uint64_t WindowStart;           // PerfTimer ticks (0 = not started)
+    uint32_t Count;                 // Let through in this window
+    uint32_t Over;                  // Over the limit since the last one let through
+};
+
+/* A starts with / contains rule that can be decided before the line ends */
+struct TextLineHighlighter_EarlyRule
+{
+    unsigned int Rule;              // Index in to 'Rules'
+    e_EarlyStateType State;
+    uint32_t Start;                 // What matched (for e_Early_Match)
+    uint32_t Len;
+    bool Allowed;                   // Passed the rule's style limit
 };
 
-struct TextLineHighlighterRegexData
+/* A style applied to the current line before it ended */
+struct TextLineHighlighter_EarlyStyle
 {
-    string Pattern;
+    unsigned int Rule;              // Index in to 'Rules'
+    uint32_t Start;
+    uint32_t End;                   // One past the last byte styled so far
     int StyleIndex;
+    bool WholeLine;                 // Stretched over the line as it comes in
+};
+
+/* A line waiting in a micro-batch */
+struct TextLineHighlighter_BatchLine
+{
+    t_MarkPoolHandle Mark;          // The start of the line (retained)
+    vector<uint8_t> Line;           // The line as it is on the screen
+    uint32_t Len;                   // How much of 'Line' the rules see
+    struct LineMatchSpanSet Spans;
 };
 
 struct TextLineHighlighterData
 {
+    /* The start of the current line.  This is always the current mark in
+       'Marks' (kept here because it is used for every byte). */
     t_DataProMark *StartOfLineMarker;
+    struct MarkPool Marks;
 
-    struct TextLineHighlighterSimpleData Simple[NUM_OF_SIMPLE];
-    struct TextLineHighlighterRegexData Regex[NUM_OF_REGEXS];
+    t_LineMatchRuleList Rules;
     struct TextLineHighlighter_TextStyle Styles[NUM_OF_STYLES];
 
     bool GrabNewMark;
+
+    /* The number of bytes from 'StartOfLineMarker' to the cursor, and if
+       the current line has gone over 'MaxLineLength' (0 = no max) */
+    uint32_t MaxLineLength;
+    uint32_t LineBytes;
+    bool LineWindowed;
+
+    /* What ends a line.  'LineEndByte' is the byte we scan for (the
+       '\n' for CRLF) and 'LastByte' is the byte before the current one */
+    e_LineEndType LineEnd;
+    uint8_t LineEndByte;
+    uint8_t LastByte;
+
+    /* Multi-line records (see TextLineHighlighter_HandleRecordLine()).
+       'RecordMarks' is the start of each line in the record so far and
+       'RecordHits' has RECORD_RULE_* flags for each rule.  Once a record
+       has 'RecordMaxLines' lines it is committed (styled) and the rest of
+       its lines get the same styles as they come in.  'RecordMarks' are
+       retained from 'Marks'. */
+    bool RecordMode;
+    t_LineMatchRuleList RecordStart;    // The start regex (empty if bad)
+    e_RecordContType RecordCont;
+    string RecordPrefix;
+    uint32_t RecordMaxLines;
+    bool InRecord;
+    bool RecordCommitted;
+    vector<t_MarkPoolHandle> RecordMarks;
+    vector<uint32_t> RecordLineBytes;
+    vector<uint8_t> RecordHits;
+
+    /* Checking lines on a worker thread (NULL when off).  Each line waiting
+       on the worker has retained a mark from 'Marks'. */
+    bool AsyncMode;
+    uint32_t AsyncMaxLines;
+    uint32_t AsyncShardRules;
+    bool HelperMode;                    // Worker sends lines to a helper
+    string HelperCPUs;
+    uint32_t HelperTimeoutMS;
+    struct AsyncMatcher *Async;
+
+    /* Micro-batching (see TextLineHighlighter_BatchLine()).  'Batch' has
+       'BatchLines' entries (kept between batches so the lines aren't
+       allocated again), the first 'BatchCount' are waiting.  Each waiting
+       line has retained a mark from 'Marks'. */
+    uint32_t BatchLines;                // 1 = off
+    uint32_t BatchDelayUS;
+    vector<struct TextLineHighlighter_BatchLine> Batch;
+    uint32_t BatchCount;
+    uint64_t BatchStartTicks;           // When the first line was added
+
+    /* Load shedding (see TextLineHighlighter_Governor()).  'ShedMax' is
+       the furthest the governor can go (e_Shed_Full for off).  The window
+       counts are for the window that started at 'ShedWindowStart' (0 if
+       it hasn't started).  'ShedCost' is the average ticks to check a
+       line with all the rules [0] and with just the simple rules [1]. */
+    e_ShedLevelType ShedMax;
+    uint32_t ShedBudgetPct;
+    uint32_t ShedSample;
+    e_ShedLevelType ShedLevel;
+    bool ShedLineChecked;               // HandleLine() checked the line
+    uint32_t ShedSampleCount;
+    uint64_t ShedWindowStart;
+    uint32_t ShedWindowLines;
+    uint32_t ShedWindowChecked;
+    uint64_t ShedWindowTicks;
+    uint64_t ShedCost[2];
+    bool ShedCostKnown[2];
+
+    /* Style limits (0 for no limit).  'RuleLimits' is always the same size
+       as 'Rules'. */
+    uint32_t StyleLimitRule;            // Matches a rule can style a window
+    uint32_t StyleLimitCon;             // Styles the connection can apply
+    uint32_t StyleLimitWindowMS;
+    e_StyleLimitType StyleLimitPolicy;  // For the rule limit
+    uint32_t StyleLimitNth;
+    vector<struct TextLineHighlighter_StyleLimit> RuleLimits;
+    struct TextLineHighlighter_StyleLimit ConLimit;
+
+    /* Re-highlighting the scroll back (see TextLineHighlighter_RunRescan()).
+       The lines from 'RescanNext' to 'RescanEnd' still have to be given to
+       the 'RescanMatchers' (empty when not running), 'RescanFeed' is the
+       one being fed and 'RescanChunkLeft' how many more lines it gets
+       before we move on to the next one.  'Job->Mark' is the line number. */
+    e_RehighlightType Rehighlight;
+    vector<struct AsyncMatcher *> RescanMatchers;
+    unsigned int RescanFeed;
+    uint32_t RescanChunkLeft;
+    uint64_t RescanNext;
+    uint64_t RescanEnd;
+    t_DataProMark *RescanMark;
+    uint32_t RescanFG;                  // The default colors (for Reset)
+    uint32_t RescanBG;
+
+    /* Early highlighting (see TextLineHighlighter_EarlyCheck()).
+       'EarlyRules' has the starts with / contains rules in rule order.
+       The rest is for the current line: the rules have been checked on
+       the first 'EarlyCheckedBytes' bytes, the line was last looked at
+       when it had 'EarlyAskedBytes' and 'EarlyApplied' has the styles
+       applied so far (in rule order, 'EarlyWholeLines' of them style the
+       whole line). */
+    bool EarlyMode;
+    vector<struct TextLineHighlighter_EarlyRule> EarlyRules;
+    uint32_t EarlyUndecided;
+    uint32_t EarlyMatched;
+    uint32_t EarlyCheckedBytes;
+    uint32_t EarlyAskedBytes;
+    uint32_t EarlyWholeLines;
+    vector<struct TextLineHighlighter_EarlyStyle> EarlyApplied;
+
+    /* What the rules want styled on the current line */
+    struct LineMatchSpanSet Spans;
+
+    /* Statistics.  'RuleStats' is always the same size as 'Rules'.  It
+       can only be changed with 'm_ConnectionsMutex' locked */
+    unsigned int ConnectionID;
+    t_RuleStatsList RuleStats;
+    struct TextLineHighlighter_ConStats Stats;
+    struct LatencyHistogram LineLatency;    // '\n' to styles applied (ticks)
+    uint64_t LineEndTicks;                  // When the current line ended
+    bool LineQueued;            // The line went to the worker, its latency
+                                // is recorded when its styles are applied
+    struct HostCallCounters HostCalls;      // Only used with the host call shim
+
+    /* Raw stream capture (NULL when not capturing) */
+    struct StreamCapture *Capture;
+    string CaptureFile;
 };
+typedef list<struct TextLineHighlighterData *> t_ConnectionList;
 
 struct SettingsStylingWidgetsSet
 {
@@ -93,6 +450,8 @@ struct SettingsStylingWidgetsSet
     struct PI_Checkbox *AttribBold;
     struct PI_Checkbox *AttribItalic;
     struct PI_Checkbox *AttribOutLine;
+    struct PI_Checkbox *ULineColorOn;
+    struct PI_ColorPick *ULineColor;
 };
 
 struct TextLineHighlighter_RegexWidgets
@@ -100,6 +459,8 @@ struct TextLineHighlighter_RegexWidgets
     struct PI_ComboBox *StyleList;
     struct PI_GroupBox *GroupBox;
     struct PI_TextInput *RegexWid;
+    struct PI_Checkbox *MatchSpan;
+    struct PI_TextInput *GroupStyles;
 };
 
 struct TextLineHighlighter_SimpleWidgets
@@ -109,6 +470,7 @@ struct TextLineHighlighter_SimpleWidgets
     struct PI_TextInput *StartsWith;
     struct PI_TextInput *Contains;
     struct PI_TextInput *EndsWith;
+    struct PI_Checkbox *MatchSpan;
 };
 
 struct TextLineHighlighter_SettingsWidgets
@@ -122,12 +484,58 @@ struct TextLineHighlighter_SettingsWidgets
 
     t_WidgetSysHandle *StylesTabHandle[NUM_OF_STYLES];
     struct SettingsStylingWidgetsSet Styles[NUM_OF_STYLES];
+
+    t_WidgetSysHandle *StatsTabHandle;
+    struct PI_ColumnViewInput *ConStatsView;
+    struct PI_ColumnViewInput *RuleStatsView;
+    struct PI_ColumnViewInput *LatencyView;
+    struct PI_ColumnViewInput *HostCallsView;
+    struct PI_ButtonInput *ResetStatsBttn;
+    struct PI_ButtonInput *SaveLatencyBttn;
+    struct PI_Indicator *ShedIndicators[e_ShedMAX-1];
+    struct PI_Indicator *RehighlightIndicator;
+
+    t_WidgetSysHandle *CaptureTabHandle;
+    struct PI_Checkbox *CaptureOn;
+    struct PI_TextInput *CaptureFile;
+
+    t_WidgetSysHandle *AdvancedTabHandle;
+    struct PI_TextInput *MaxLineLength;
+    struct PI_ComboBox *LineEnd;
+    struct PI_TextInput *LineEndByte;
+    struct PI_Checkbox *AsyncMode;
+    struct PI_TextInput *AsyncMaxLines;
+    struct PI_TextInput *AsyncShardRules;
+    struct PI_Checkbox *HelperMode;
+    struct PI_TextInput *HelperCPUs;
+    struct PI_TextInput *HelperTimeout;
+    struct PI_TextInput *BatchLines;
+    struct PI_TextInput *BatchDelay;
+    struct PI_ComboBox *ShedMax;
+    struct PI_TextInput *ShedBudget;
+    struct PI_TextInput *ShedSample;
+    struct PI_TextInput *StyleLimitRule;
+    struct PI_TextInput *StyleLimitCon;
+    struct PI_TextInput *StyleLimitWindow;
+    struct PI_ComboBox *StyleLimitPolicy;
+    struct PI_TextInput *StyleLimitNth;
+    struct PI_ComboBox *Rehighlight;
+    struct PI_Checkbox *EarlyMode;
+
+    t_WidgetSysHandle *RecordsTabHandle;
+    struct PI_Checkbox *RecordMode;
+    struct PI_TextInput *RecordStart;
+    struct PI_ComboBox *RecordCont;
+    struct PI_TextInput *RecordPrefix;
+    struct PI_TextInput *RecordMaxLines;
 };
 
 /*** FUNCTION PROTOTYPES      ***/
 const struct DataProcessorInfo *TextLineHighlighter_GetProcessorInfo(
         unsigned int *SizeOfInfo);
 void TextLineHighlighter_ProcessIncomingTextByte(t_DataProcessorHandleType *DataHandle,const uint8_t RawByte,uint8_t *ProcessedChar,int *CharLen,PG_BOOL *Consumed);
+int TextLineHighlighter_ProcessIncomingTextBlock(t_DataProcessorHandleType *DataHandle,const uint8_t *Buf,int Len);
+void TextLineHighlighter_ProcessIdle(t_DataProcessorHandleType *DataHandle);
 static t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetSysHandle *WidgetHandle,t_PIKVList *Settings);
 static void TextLineHighlighter_FreeSettingsWidgets(t_DataProSettingsWidgetsType *PrivData);
 static void TextLineHighlighter_SetSettingsFromWidgets(t_DataProSettingsWidgetsType *PrivData,t_PIKVList *Settings);
@@ -154,9 +562,107 @@ static void TextLineHighlighter_SetSettingKV(t_PIKVList *Settings,
 static void TextLineHighlighter_ApplySetting_SetData(t_PIKVList *Settings,
         struct TextLineHighlighter_TextStyle *Style,const char *Prefix,
         uint32_t DefaultStyleSet);
+static void TextLineHighlighter_ProcessByte(struct TextLineHighlighterData *Data,
+        uint8_t RawByte);
+static int TextLineHighlighter_ProcessBlock(struct TextLineHighlighterData *Data,
+        const uint8_t *Buf,int Len);
+static inline bool TextLineHighlighter_MarkStartOfLine(
+        struct TextLineHighlighterData *Data);
 static void TextLineHighlighter_HandleLine(struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_HandleLongLine(struct TextLineHighlighterData *Data);
+static bool TextLineHighlighter_CheckLine(struct TextLineHighlighterData *Data,
+        uint32_t Len,uint32_t Flags,bool SimpleOnly);
+static void TextLineHighlighter_RunRules(struct TextLineHighlighterData *Data,
+        const uint8_t *Line,uint32_t Bytes,uint32_t Flags,bool SimpleOnly);
+static inline uint32_t TextLineHighlighter_TrimLineEnd(
+        struct TextLineHighlighterData *Data,const uint8_t *Line,
+        uint32_t Bytes,uint32_t Flags);
+static bool TextLineHighlighter_HandleRecordLine(
+        struct TextLineHighlighterData *Data,const uint8_t *Line,
+        uint32_t Len,uint32_t Bytes);
+static void TextLineHighlighter_AddRecordLine(
+        struct TextLineHighlighterData *Data,const uint8_t *Line,
+        uint32_t Len,uint32_t Bytes);
+static void TextLineHighlighter_EndRecord(struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_DropRecord(struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_ApplyRecordStyles(
+        struct TextLineHighlighterData *Data,t_DataProMark *Mark,uint32_t Len);
+static t_MarkPoolHandle TextLineHighlighter_RetainLineMark(
+        struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_ReleaseLineMark(
+        struct TextLineHighlighterData *Data,t_MarkPoolHandle Handle);
+static void TextLineHighlighter_QueueLine(struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_ApplyAsyncResults(
+        struct TextLineHighlighterData *Data,bool Drop);
+static void TextLineHighlighter_StopAsync(struct TextLineHighlighterData *Data,
+        bool Apply);
+static void TextLineHighlighter_StartRescan(
+        struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_StopRescan(
+        struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_RunRescan(struct TextLineHighlighterData *Data,
+        uint32_t BudgetUS);
+static void TextLineHighlighter_ApplyRescanJob(
+        struct TextLineHighlighterData *Data,struct AsyncMatchJob *Job);
+static void TextLineHighlighter_ResetEarly(
+        struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_EarlyCheck(
+        struct TextLineHighlighterData *Data,uint32_t MinNewBytes);
+static void TextLineHighlighter_EarlyExtend(
+        struct TextLineHighlighterData *Data,uint32_t Bytes,bool ToCursor);
+static bool TextLineHighlighter_EarlyCovers(
+        struct TextLineHighlighterData *Data,
+        const struct LineMatchInterval *Interval);
+static void TextLineHighlighter_BatchLine(struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_FlushBatch(struct TextLineHighlighterData *Data,
+        bool Drop);
+static inline void TextLineHighlighter_PollBatch(
+        struct TextLineHighlighterData *Data);
+static bool TextLineHighlighter_ShedLine(struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_Governor(struct TextLineHighlighterData *Data,
+        uint64_t Now,uint64_t Ticks);
+static void TextLineHighlighter_ResetGovernor(
+        struct TextLineHighlighterData *Data);
+static bool TextLineHighlighter_StyleLimitPass(
+        struct TextLineHighlighterData *Data,
+        struct TextLineHighlighter_StyleLimit *Limit,uint32_t Max,
+        uint32_t Amount,bool UsePolicy);
+static inline bool TextLineHighlighter_RuleStyleAllowed(
+        struct TextLineHighlighterData *Data,unsigned int RuleIndex);
+static inline bool TextLineHighlighter_ConStyleAllowed(
+        struct TextLineHighlighterData *Data,uint32_t Styles);
+static void TextLineHighlighter_ResetStyleLimits(
+        struct TextLineHighlighterData *Data);
+static inline bool TextLineHighlighter_IsLineEnd(
+        struct TextLineHighlighterData *Data,uint8_t RawByte);
+static inline const uint8_t *TextLineHighlighter_FindLineEnd(
+        struct TextLineHighlighterData *Data,const uint8_t *Buf,int Len);
 static void TextLineHighlighter_ApplyStyleSet2Marker(struct TextLineHighlighterData *Data,
-        int StyleIndex);
+        t_DataProMark *Mark,int StyleIndex,uint32_t Offset,uint32_t Len);
+static bool TextLineHighlighter_AddRule(struct TextLineHighlighterData *Data,
+        e_LineMatchRuleType Type,const char *Str,int StyleIndex,
+        bool MatchSpan,const char *Name);
+static void TextLineHighlighter_ParseGroupStyles(const char *Str,
+        t_LineMatchGroupStyleList &Groups);
+static void TextLineHighlighter_ResetStats(struct TextLineHighlighterData *Data);
+static void TextLineHighlighter_ApplyCaptureSettings(
+        struct TextLineHighlighterData *Data,t_PIKVList *Settings);
+static inline void TextLineHighlighter_StatAdd(t_StatCounter &Counter,
+        uint64_t Amount);
+static void TextLineHighlighter_BuildMetrics(string &Out);
+static void TextLineHighlighter_FillStatsViews(
+        struct TextLineHighlighter_SettingsWidgets *WData);
+static void TextLineHighlighter_FillHostCallsView(
+        struct TextLineHighlighter_SettingsWidgets *WData,const char *ConName,
+        const struct HostCallCounters *Counters);
+static void TextLineHighlighter_AddHostCallsRow(
+        struct TextLineHighlighter_SettingsWidgets *WData,const char *ConName,
+        const char *Call,uint64_t Count,uint64_t Ticks);
+static void TextLineHighlighter_ResetStatsBttnCB(
+        const struct PIButtonEvent *Event,void *UserData);
+static void TextLineHighlighter_SaveLatencyBttnCB(
+        const struct PIButtonEvent *Event,void *UserData);
+static bool TextLineHighlighter_SaveLatencyHistograms(const char *Filename);
 
 /*** VARIABLE DEFINITIONS     ***/
 struct DataProcessorAPI m_TextLineHighlighterCBs=
@@ -173,6 +679,10 @@ struct DataProcessorAPI m_TextLineHighlighterCBs=
     TextLineHighlighter_FreeSettingsWidgets,
     TextLineHighlighter_SetSettingsFromWidgets,
     TextLineHighlighter_ApplySettings,
+    /* V4 */
+    TextLineHighlighter_ProcessIncomingTextBlock,
+    /* V5 */
+    TextLineHighlighter_ProcessIdle,
 };
 
 
@@ -192,6 +702,19 @@ static const struct PI_SystemAPI *m_TLF_SysAPI;
 static const struct DPS_API *m_TLF_DPS;
 static const struct PI_UIAPI *m_TLF_UIAPI;
 
+/* All the connections we are running on (for the statistics tab) */
+static t_ConnectionList m_Connections;
+static mutex m_ConnectionsMutex;
+static unsigned int m_NextConnectionID=1;
+
+static bool m_UsingHostCallShim;
+
+/* WhippyTerm has DPS_API_VERSION_3 so we can style with one call */
+static bool m_HostHasApplyStyle2Mark;
+
+/* WhippyTerm has DPS_API_VERSION_4 so we can read the scroll back */
+static bool m_HostHasScrollBack;
+
 static const struct TextLineHighlighter_TextStyle m_DefaultStyleSets[NUM_OF_STYLES]=
 {
     {0xFFFFFF,0xFF0000,0},                      // 0
@@ -206,6 +729,59 @@ static const struct TextLineHighlighter_TextStyle m_DefaultStyleSets[NUM_OF_STYL
 //    {0x00FF00,0x000000,0},                      // 9
 };
 
+static const char *m_LineEndNames[e_LineEndMAX]=
+{
+    "LF",
+    "CR (or LF)",
+    "CRLF",
+    "NUL",
+    "Custom",
+};
+
+static const char *m_ShedLevelNames[e_ShedMAX]=
+{
+    "Off",
+    "Skip regex rules",
+    "Skip regex rules, then sample lines",
+    "Skip regex rules, sample lines, then pause",
+};
+
+static const char *m_StyleLimitNames[e_StyleLimitMAX]=
+{
+    "Drop",
+    "Highlight every Nth match",
+};
+
+/* The "Shed Level" statistic */
+static const char *m_ShedStateNames[e_ShedMAX]=
+{
+    "Full",
+    "Skip Regex",
+    "Sampling",
+    "Paused",
+};
+
+/* The indicators on the statistics tab, one for each level past full */
+static const char *m_ShedIndicatorNames[e_ShedMAX-1]=
+{
+    "Load shedding: regex rules skipped",
+    "Load shedding: sampling lines",
+    "Load shedding: highlighting paused",
+};
+
+static const char *m_RehighlightNames[e_RehighlightMAX]=
+{
+    "Off",
+    "On top of the old colors",
+    "Reset the old colors first",
+};
+
+static const char *m_RecordContNames[e_RecordContMAX]=
+{
+    "Indented",
+    "Start with the prefix",
+};
+
 /*******************************************************************************
  * NAME:
  *    TextLineHighlighter_RegisterPlugin
@@ -249,6 +825,39 @@ extern "C"
         m_TLF_DPS=SysAPI->GetAPI_DataProcessors();
         m_TLF_UIAPI=m_TLF_DPS->GetAPI_UI();
 
+        /* The V3 part of the DPS_API isn't there at all on older versions
+           so don't even look at it */
+        m_HostHasApplyStyle2Mark=false;
+        if(Version>=DPS_API_VERSION_3_WHIPPYTERM_VERSION &&
+                m_TLF_DPS->ApplyStyle2Mark!=NULL)
+        {
+            m_HostHasApplyStyle2Mark=true;
+        }
+        m_HostHasScrollBack=false;
+        if(Version>=DPS_API_VERSION_4_WHIPPYTERM_VERSION &&
+                m_HostHasApplyStyle2Mark &&
+                m_TLF_DPS->GetScrollBackLines!=NULL &&
+                m_TLF_DPS->GetScrollBackLine!=NULL &&
+                m_TLF_DPS->SetMark2ScrollBackLine!=NULL)
+        {
+            m_HostHasScrollBack=true;
+        }
+
+        PerfTimer_Init();
+
+        /* If asked we put a shim between us and WhippyTerm that times all
+           the calls we make */
+        m_UsingHostCallShim=HostCallShim_IsWanted();
+        if(m_UsingHostCallShim)
+        {
+            m_TLF_DPS=HostCallShim_Wrap(m_TLF_DPS,
+                    m_HostHasScrollBack?DPS_API_VERSION_4:
+                    m_HostHasApplyStyle2Mark?DPS_API_VERSION_3:
+                    DPS_API_VERSION_2);
+        }
+
+        MetricsExport_StartFromEnv(TextLineHighlighter_BuildMetrics);
+
         /* If we are have the correct experimental API */
         if(SysAPI->GetExperimentalID()>0 &&
                 SysAPI->GetExperimentalID()<1)
@@ -294,6 +903,61 @@ static t_DataProcessorHandleType *TextLineHighlighter_AllocateData(void)
 
         Data->StartOfLineMarker=NULL;
         Data->GrabNewMark=false;
+        Data->MaxLineLength=DEFAULT_MAX_LINE_LENGTH;
+        Data->LineBytes=0;
+        Data->LineWindowed=false;
+        Data->LineEnd=e_LineEnd_LF;
+        Data->LineEndByte='\n';
+        Data->LastByte=0;
+        Data->RecordMode=false;
+        Data->RecordCont=e_RecordCont_Indented;
+        Data->RecordMaxLines=DEFAULT_RECORD_MAX_LINES;
+        Data->InRecord=false;
+        Data->RecordCommitted=false;
+        MarkPool_Init(&Data->Marks);
+        Data->AsyncMode=false;
+        Data->AsyncMaxLines=DEFAULT_ASYNC_MAX_LINES;
+        Data->AsyncShardRules=DEFAULT_ASYNC_SHARD_RULES;
+        Data->HelperMode=false;
+        Data->HelperTimeoutMS=DEFAULT_HELPER_TIMEOUT_MS;
+        Data->Async=NULL;
+        Data->LineEndTicks=0;
+        Data->LineQueued=false;
+        Data->BatchLines=DEFAULT_BATCH_LINES;
+        Data->BatchDelayUS=DEFAULT_BATCH_DELAY_US;
+        Data->BatchCount=0;
+        Data->BatchStartTicks=0;
+        Data->ShedMax=e_Shed_Full;
+        Data->ShedBudgetPct=DEFAULT_SHED_BUDGET_PCT;
+        Data->ShedSample=DEFAULT_SHED_SAMPLE;
+        TextLineHighlighter_ResetGovernor(Data);
+        Data->StyleLimitRule=0;
+        Data->StyleLimitCon=0;
+        Data->StyleLimitWindowMS=DEFAULT_STYLE_LIMIT_WINDOW_MS;
+        Data->StyleLimitPolicy=e_StyleLimit_Drop;
+        Data->StyleLimitNth=DEFAULT_STYLE_LIMIT_NTH;
+        TextLineHighlighter_ResetStyleLimits(Data);
+        Data->Rehighlight=e_Rehighlight_Off;
+        Data->RescanFeed=0;
+        Data->RescanChunkLeft=0;
+        Data->RescanNext=0;
+        Data->RescanEnd=0;
+        Data->RescanMark=NULL;
+        Data->RescanFG=0;
+        Data->RescanBG=0;
+        Data->EarlyMode=false;
+        TextLineHighlighter_ResetEarly(Data);
+        Data->Capture=NULL;
+        Data->Stats.AsyncQueue=0;
+        Data->Stats.Marks=0;
+        Data->Stats.MarksInUse=0;
+        Data->Stats.RehighlightTotal=0;
+        Data->Stats.RehighlightLeft=0;
+        TextLineHighlighter_ResetStats(Data);
+
+        lock_guard<mutex> Lock(m_ConnectionsMutex);
+        Data->ConnectionID=m_NextConnectionID++;
+        m_Connections.push_back(Data);
     }
     catch(...)
     {
@@ -328,8 +992,17 @@ static void TextLineHighlighter_FreeData(t_DataProcessorHandleType *DataHandle)
 {
     struct TextLineHighlighterData *Data=(struct TextLineHighlighterData *)DataHandle;
 
-    if(Data->StartOfLineMarker!=NULL)
-        m_TLF_DPS->FreeMark(Data->StartOfLineMarker);
+    TextLineHighlighter_StopRescan(Data);
+    TextLineHighlighter_StopAsync(Data,false);
+    TextLineHighlighter_FlushBatch(Data,true);
+    TextLineHighlighter_DropRecord(Data);
+    MarkPool_Free(&Data->Marks,m_TLF_DPS);
+
+    StreamCapture_Stop(Data->Capture);
+
+    m_ConnectionsMutex.lock();
+    m_Connections.remove(Data);
+    m_ConnectionsMutex.unlock();
 
     delete Data;
 }
@@ -429,28 +1102,98 @@ void TextLineHighlighter_ProcessIncomingTextByte(t_DataProcessorHandleType *Data
 {
     struct TextLineHighlighterData *Data=(struct TextLineHighlighterData *)DataHandle;
 
-    /* If we haven't allocated a marker yet, then we need to (we can't
-       allocate this in the AllocateData() because the m_TLF_DPS API doesn't
-       work in that function) */
-    if(Data->StartOfLineMarker==NULL)
+    if(m_UsingHostCallShim)
     {
-        Data->StartOfLineMarker=m_TLF_DPS->AllocateMark();
-        if(Data->StartOfLineMarker==NULL)
-            return;
-        Data->GrabNewMark=true;
+        HostCallShim_Enter(&Data->HostCalls);
+        TextLineHighlighter_ProcessByte(Data,RawByte);
+        HostCallShim_Leave(&Data->HostCalls);
+        return;
     }
 
-    if(Data->GrabNewMark)
-    {
-        m_TLF_DPS->SetMark2CursorPos(Data->StartOfLineMarker);
-        Data->GrabNewMark=false;
-    }
+    TextLineHighlighter_ProcessByte(Data,RawByte);
+}
+
+/*******************************************************************************
+ * NAME:
+ *   ProcessIncomingTextBlock
+ *
+ * SYNOPSIS:
+ *   int ProcessIncomingTextBlock(t_DataProcessorHandleType *DataHandle,
+ *       const uint8_t *Buf,int Len);
+ *
+ * PARAMETERS:
+ *   DataHandle [I] -- The data handle to work on.  This is your internal
+ *                     data.
+ *   Buf [I] -- The bytes that came in.  They have not been added to the
+ *              screen yet.
+ *   Len [I] -- The number of bytes in 'Buf'
+ *
+ * FUNCTION:
+ *   This function is called instead of ProcessIncomingTextByte() by hosts
+ *   that support DATA_PROCESSORS_API_VERSION_4.  We handle everything up to
+ *   the next end of line in one go (the host has to add the text before
+ *   the end of line to the screen before we can look at the line).  Older
+ *   hosts don't know about this and keep calling ProcessIncomingTextByte().
+ *
+ * RETURNS:
+ *   The number of bytes we handled.  The host adds this many bytes to the
+ *   screen and calls us again with the rest.
+ ******************************************************************************/
+int TextLineHighlighter_ProcessIncomingTextBlock(t_DataProcessorHandleType *DataHandle,
+        const uint8_t *Buf,int Len)
+{
+    struct TextLineHighlighterData *Data=(struct TextLineHighlighterData *)DataHandle;
+    int Handled;
 
-    if(RawByte=='\n')
+    if(m_UsingHostCallShim)
     {
-        /* We are at the end of the line, see if it matches anything */
-        TextLineHighlighter_HandleLine(Data);
+        HostCallShim_Enter(&Data->HostCalls);
+        Handled=TextLineHighlighter_ProcessBlock(Data,Buf,Len);
+        HostCallShim_Leave(&Data->HostCalls);
+        return Handled;
     }
+
+    return TextLineHighlighter_ProcessBlock(Data,Buf,Len);
+}
+
+/*******************************************************************************
+ * NAME:
+ *   ProcessIdle
+ *
+ * SYNOPSIS:
+ *   void ProcessIdle(t_DataProcessorHandleType *DataHandle);
+ *
+ * PARAMETERS:
+ *   DataHandle [I] -- The data handle to work on.  This is your internal
+ *                     data.
+ *
+ * FUNCTION:
+ *   This function is called every so often by hosts that support
+ *   DATA_PROCESSORS_API_VERSION_5 when no bytes are coming in.  We apply
+ *   what the worker thread has finished, check any batch that is waiting,
+ *   check the early rules on the part of the line we have so far and do a
+ *   bigger piece of the scroll back re-highlight (if one is running).
+ *
+ * RETURNS:
+ *   NONE
+ ******************************************************************************/
+void TextLineHighlighter_ProcessIdle(t_DataProcessorHandleType *DataHandle)
+{
+    struct TextLineHighlighterData *Data=(struct TextLineHighlighterData *)DataHandle;
+
+    if(m_UsingHostCallShim)
+        HostCallShim_Enter(&Data->HostCalls);
+
+    if(Data->Async!=NULL)
+        TextLineHighlighter_ApplyAsyncResults(Data,false);
+    TextLineHighlighter_FlushBatch(Data,false);
+    if(!Data->EarlyRules.empty())
+        TextLineHighlighter_EarlyCheck(Data,1);
+    if(!Data->RescanMatchers.empty())
+        TextLineHighlighter_RunRescan(Data,RESCAN_IDLE_BUDGET_US);
+
+    if(m_UsingHostCallShim)
+        HostCallShim_Leave(&Data->HostCalls);
 }
 
 /*******************************************************************************
@@ -496,7 +1239,29 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
     int r;
     int c;
     char buff[100];
+    static const char *ConStatsColumns[]=
+    {
+        "Connection","Lines","Bytes","Host Calls","Long Lines","Records",
+        "Worker Lines","Worker Behind","Worker Stale","Worker Queue",
+        "Worker Steals","Marks","Marks In Use","Marks Peak","Batches",
+        "Shed Level","Shed Lines","Styles Suppressed","Helper Fallback",
+        "Re-highlight","Early Lines"
+    };
+    static const char *RuleStatsColumns[]=
+    {
+        "Connection","Rule","Evaluations","Hits","Avg ns","Max ns",
+        "Total ms","Suppressed"
+    };
+    static const char *LatencyColumns[]=
+    {
+        "Connection","Lines","p50","p90","p99","p99.9","Max"
+    };
+    static const char *HostCallsColumns[]=
+    {
+        "Connection","Call","Count","Total us","Avg ns"
+    };
 
+    WData=NULL;
     try
     {
         WData=new TextLineHighlighter_SettingsWidgets;
@@ -509,6 +1274,8 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
             WData->Regex[r].StyleList=NULL;
             WData->Regex[r].RegexWid=NULL;
             WData->Regex[r].GroupBox=NULL;
+            WData->Regex[r].MatchSpan=NULL;
+            WData->Regex[r].GroupStyles=NULL;
         }
         for(r=0;r<NUM_OF_SIMPLE;r++)
         {
@@ -517,9 +1284,51 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
             WData->Simple[r].StartsWith=NULL;
             WData->Simple[r].Contains=NULL;
             WData->Simple[r].EndsWith=NULL;
+            WData->Simple[r].MatchSpan=NULL;
         }
         for(r=0;r<NUM_OF_STYLES;r++)
             WData->StylesTabHandle[r]=NULL;
+        WData->StatsTabHandle=NULL;
+        WData->ConStatsView=NULL;
+        WData->RuleStatsView=NULL;
+        WData->LatencyView=NULL;
+        WData->HostCallsView=NULL;
+        WData->ResetStatsBttn=NULL;
+        for(c=0;c<e_ShedMAX-1;c++)
+            WData->ShedIndicators[c]=NULL;
+        WData->RehighlightIndicator=NULL;
+        WData->SaveLatencyBttn=NULL;
+        WData->CaptureTabHandle=NULL;
+        WData->CaptureOn=NULL;
+        WData->CaptureFile=NULL;
+        WData->AdvancedTabHandle=NULL;
+        WData->MaxLineLength=NULL;
+        WData->LineEnd=NULL;
+        WData->LineEndByte=NULL;
+        WData->AsyncMode=NULL;
+        WData->AsyncMaxLines=NULL;
+        WData->AsyncShardRules=NULL;
+        WData->HelperMode=NULL;
+        WData->HelperCPUs=NULL;
+        WData->HelperTimeout=NULL;
+        WData->BatchLines=NULL;
+        WData->BatchDelay=NULL;
+        WData->ShedMax=NULL;
+        WData->ShedBudget=NULL;
+        WData->ShedSample=NULL;
+        WData->StyleLimitRule=NULL;
+        WData->StyleLimitCon=NULL;
+        WData->StyleLimitWindow=NULL;
+        WData->StyleLimitPolicy=NULL;
+        WData->StyleLimitNth=NULL;
+        WData->Rehighlight=NULL;
+        WData->EarlyMode=NULL;
+        WData->RecordsTabHandle=NULL;
+        WData->RecordMode=NULL;
+        WData->RecordStart=NULL;
+        WData->RecordCont=NULL;
+        WData->RecordPrefix=NULL;
+        WData->RecordMaxLines=NULL;
 
         /* Add widgets */
 
@@ -555,6 +1364,18 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
                         GroupWidgetHandle,WData->Regex[r].StyleList->Ctrl,
                         buff,c);
             }
+
+            WData->Regex[r].MatchSpan=m_TLF_UIAPI->AddCheckbox(WData->
+                    Regex[r].GroupBox->GroupWidgetHandle,
+                    "Only highlight the match",NULL,NULL);
+            if(WData->Regex[r].MatchSpan==NULL)
+                throw(0);
+
+            WData->Regex[r].GroupStyles=m_TLF_UIAPI->AddTextInput(WData->
+                    Regex[r].GroupBox->GroupWidgetHandle,
+                    "Group color sets (group=set,...)",NULL,NULL);
+            if(WData->Regex[r].GroupStyles==NULL)
+                throw(0);
         }
 
         for(r=0;r<NUM_OF_SIMPLE;r++)
@@ -595,6 +1416,12 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
                         GroupWidgetHandle,WData->Simple[r].StyleList->Ctrl,
                         buff,c);
             }
+
+            WData->Simple[r].MatchSpan=m_TLF_UIAPI->AddCheckbox(WData->
+                    Simple[r].GroupBox->GroupWidgetHandle,
+                    "Only highlight the match",NULL,NULL);
+            if(WData->Simple[r].MatchSpan==NULL)
+                throw(0);
         }
 
         /** Regex **/
@@ -615,6 +1442,21 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
             m_TLF_UIAPI->SetComboBoxSelectedEntry(WData->Regex[r].GroupBox->
                     GroupWidgetHandle,WData->Regex[r].StyleList->Ctrl,
                     atoi(Str));
+
+            sprintf(buff,"RegexSpan%d",r);
+            Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+            if(Str==NULL)
+                Str="0";
+            m_TLF_UIAPI->SetCheckboxChecked(WData->Regex[r].GroupBox->
+                    GroupWidgetHandle,WData->Regex[r].MatchSpan->Ctrl,
+                    atoi(Str)?true:false);
+
+            sprintf(buff,"RegexGroups%d",r);
+            Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+            if(Str==NULL)
+                Str="";
+            m_TLF_UIAPI->SetTextInputText(WData->Regex[r].GroupBox->
+                    GroupWidgetHandle,WData->Regex[r].GroupStyles->Ctrl,Str);
         }
 
         for(r=0;r<NUM_OF_SIMPLE;r++)
@@ -648,6 +1490,14 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
             m_TLF_UIAPI->SetComboBoxSelectedEntry(WData->Simple[r].GroupBox->
                     GroupWidgetHandle,WData->Simple[r].StyleList->Ctrl,
                     atoi(Str));
+
+            sprintf(buff,"SimpleSpan%d",r);
+            Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+            if(Str==NULL)
+                Str="0";
+            m_TLF_UIAPI->SetCheckboxChecked(WData->Simple[r].GroupBox->
+                    GroupWidgetHandle,WData->Simple[r].MatchSpan->Ctrl,
+                    atoi(Str)?true:false);
         }
 
         /* Styling tabs (colors) */
@@ -664,119 +1514,485 @@ t_DataProSettingsWidgetsType *TextLineHighlighter_AllocSettingsWidgets(t_WidgetS
             TextLineHighlighter_SetSettingStyleWidgets(Settings,&WData->Styles[r],
                     WData->StylesTabHandle[r],buff,r);
         }
-    }
-    catch(...)
-    {
-        if(WData!=NULL)
-        {
-            TextLineHighlighter_FreeSettingsWidgets(
-                    (t_DataProSettingsWidgetsType *)WData);
-        }
-        return NULL;
-    }
 
-    return (t_DataProSettingsWidgetsType *)WData;
-}
+        /* Statistics */
+        WData->StatsTabHandle=m_TLF_DPS->AddNewSettingsTab("Statistics");
+        if(WData->StatsTabHandle==NULL)
+            throw(0);
 
-/*******************************************************************************
- * NAME:
- *    FreeSettingsWidgets
- *
- * SYNOPSIS:
- *    void FreeSettingsWidgets(t_DataProSettingsWidgetsType *PrivData);
- *
- * PARAMETERS:
- *    PrivData [I] -- The private data to free
- *
- * FUNCTION:
- *      This function is called when the system frees the settings widets.
- *      It should free any private data you allocated in AllocSettingsWidgets().
- *
- * RETURNS:
- *    NONE
- *
- * SEE ALSO:
- *    AllocSettingsWidgets()
- ******************************************************************************/
-void TextLineHighlighter_FreeSettingsWidgets(t_DataProSettingsWidgetsType *PrivData)
-{
-    struct TextLineHighlighter_SettingsWidgets *WData=(struct TextLineHighlighter_SettingsWidgets *)PrivData;
-    int r;
+        WData->ConStatsView=m_TLF_UIAPI->AddColumnViewInput(WData->
+                StatsTabHandle,"Connections",
+                sizeof(ConStatsColumns)/sizeof(ConStatsColumns[0]),
+                ConStatsColumns,NULL,NULL);
+        if(WData->ConStatsView==NULL)
+            throw(0);
 
-    /* Free everything in reverse order */
+        WData->RuleStatsView=m_TLF_UIAPI->AddColumnViewInput(WData->
+                StatsTabHandle,"Rules",
+                sizeof(RuleStatsColumns)/sizeof(RuleStatsColumns[0]),
+                RuleStatsColumns,NULL,NULL);
+        if(WData->RuleStatsView==NULL)
+            throw(0);
 
-    /* Styling tabs (colors) */
-    for(r=NUM_OF_STYLES-1;r>=0;r--)
-    {
-        TextLineHighlighter_FreeSettingStyleWidgets(&WData->Styles[r],
-                WData->StylesTabHandle[r]);
-    }
+        WData->LatencyView=m_TLF_UIAPI->AddColumnViewInput(WData->
+                StatsTabHandle,"Line Latency (us)",
+                sizeof(LatencyColumns)/sizeof(LatencyColumns[0]),
+                LatencyColumns,NULL,NULL);
+        if(WData->LatencyView==NULL)
+            throw(0);
 
-    for(r=NUM_OF_SIMPLE-1;r>=0;r--)
-    {
-        if(WData->Simple[r].StyleList!=NULL)
+        /* We only have host call info if the shim is on */
+        if(m_UsingHostCallShim)
         {
-            m_TLF_UIAPI->FreeComboBox(WData->Simple[r].GroupBox->
-                    GroupWidgetHandle,WData->Simple[r].StyleList);
+            WData->HostCallsView=m_TLF_UIAPI->AddColumnViewInput(WData->
+                    StatsTabHandle,"Host Calls",
+                    sizeof(HostCallsColumns)/sizeof(HostCallsColumns[0]),
+                    HostCallsColumns,NULL,NULL);
+            if(WData->HostCallsView==NULL)
+                throw(0);
         }
-        if(WData->Simple[r].EndsWith!=NULL)
+
+        for(c=0;c<e_ShedMAX-1;c++)
         {
-            m_TLF_UIAPI->FreeTextInput(WData->Simple[r].GroupBox->
-                    GroupWidgetHandle,WData->Simple[r].EndsWith);
+            WData->ShedIndicators[c]=m_TLF_UIAPI->AddIndicator(WData->
+                    StatsTabHandle,m_ShedIndicatorNames[c]);
+            if(WData->ShedIndicators[c]==NULL)
+                throw(0);
         }
-        if(WData->Simple[r].Contains!=NULL)
+
+        WData->RehighlightIndicator=m_TLF_UIAPI->AddIndicator(WData->
+                StatsTabHandle,"Re-highlighting the scroll back");
+        if(WData->RehighlightIndicator==NULL)
+            throw(0);
+
+        WData->ResetStatsBttn=m_TLF_UIAPI->AddButtonInput(WData->
+                StatsTabHandle,"Reset Statistics",
+                TextLineHighlighter_ResetStatsBttnCB,WData);
+        if(WData->ResetStatsBttn==NULL)
+            throw(0);
+
+        WData->SaveLatencyBttn=m_TLF_UIAPI->AddButtonInput(WData->
+                StatsTabHandle,"Save Latency Histograms...",
+                TextLineHighlighter_SaveLatencyBttnCB,WData);
+        if(WData->SaveLatencyBttn==NULL)
+            throw(0);
+
+        TextLineHighlighter_FillStatsViews(WData);
+
+        /* Capture */
+        WData->CaptureTabHandle=m_TLF_DPS->AddNewSettingsTab("Capture");
+        if(WData->CaptureTabHandle==NULL)
+            throw(0);
+
+        WData->CaptureOn=m_TLF_UIAPI->AddCheckbox(WData->CaptureTabHandle,
+                "Capture incoming bytes to a file (for CaptureReplay)",
+                NULL,NULL);
+        if(WData->CaptureOn==NULL)
+            throw(0);
+
+        WData->CaptureFile=m_TLF_UIAPI->AddTextInput(WData->CaptureTabHandle,
+                "Capture file",NULL,NULL);
+        if(WData->CaptureFile==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"CaptureOn");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetCheckboxChecked(WData->CaptureTabHandle,
+                WData->CaptureOn->Ctrl,atoi(Str)?true:false);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"CaptureFile");
+        if(Str==NULL)
+            Str="";
+        m_TLF_UIAPI->SetTextInputText(WData->CaptureTabHandle,
+                WData->CaptureFile->Ctrl,Str);
+
+        /* Advanced */
+        WData->AdvancedTabHandle=m_TLF_DPS->AddNewSettingsTab("Advanced");
+        if(WData->AdvancedTabHandle==NULL)
+            throw(0);
+
+        WData->MaxLineLength=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Max line length (bytes, 0 = no max)",
+                NULL,NULL);
+        if(WData->MaxLineLength==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"MaxLineLength");
+        if(Str==NULL)
         {
-            m_TLF_UIAPI->FreeTextInput(WData->Simple[r].GroupBox->
-                    GroupWidgetHandle,WData->Simple[r].Contains);
+            sprintf(buff,"%d",DEFAULT_MAX_LINE_LENGTH);
+            Str=buff;
         }
-        if(WData->Simple[r].StartsWith!=NULL)
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->MaxLineLength->Ctrl,Str);
+
+        WData->LineEnd=m_TLF_UIAPI->AddComboBox(WData->AdvancedTabHandle,
+                false,"End of line",NULL,NULL);
+        if(WData->LineEnd==NULL)
+            throw(0);
+        for(c=0;c<e_LineEndMAX;c++)
         {
-            m_TLF_UIAPI->FreeTextInput(WData->Simple[r].GroupBox->
-                    GroupWidgetHandle,WData->Simple[r].StartsWith);
+            m_TLF_UIAPI->AddItem2ComboBox(WData->AdvancedTabHandle,
+                    WData->LineEnd->Ctrl,m_LineEndNames[c],c);
         }
-        if(WData->Simple[r].GroupBox!=NULL)
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"LineEnd");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+                WData->LineEnd->Ctrl,atoi(Str));
+
+        WData->LineEndByte=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Custom end of line byte (hex)",NULL,NULL);
+        if(WData->LineEndByte==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"LineEndByte");
+        if(Str==NULL)
+            Str="1E";
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->LineEndByte->Ctrl,Str);
+
+        WData->AsyncMode=m_TLF_UIAPI->AddCheckbox(WData->AdvancedTabHandle,
+                "Check lines on a worker thread",NULL,NULL);
+        if(WData->AsyncMode==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"AsyncMode");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetCheckboxChecked(WData->AdvancedTabHandle,
+                WData->AsyncMode->Ctrl,atoi(Str)?true:false);
+
+        WData->AsyncMaxLines=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Worker max lag (lines)",NULL,NULL);
+        if(WData->AsyncMaxLines==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"AsyncMaxLines");
+        if(Str==NULL)
         {
-            m_TLF_UIAPI->FreeGroupBox(WData->SimpleTabHandle,
-                    WData->Simple[r].GroupBox);
+            sprintf(buff,"%d",DEFAULT_ASYNC_MAX_LINES);
+            Str=buff;
         }
-    }
-    for(r=NUM_OF_REGEXS-1;r>=0;r--)
-    {
-        if(WData->Regex[r].StyleList!=NULL)
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->AsyncMaxLines->Ctrl,Str);
+
+        WData->AsyncShardRules=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Worker rules per shard (0 = off)",NULL,
+                NULL);
+        if(WData->AsyncShardRules==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"AsyncShardRules");
+        if(Str==NULL)
         {
-            m_TLF_UIAPI->FreeComboBox(WData->Regex[r].GroupBox->
-                    GroupWidgetHandle,WData->Regex[r].StyleList);
+            sprintf(buff,"%d",DEFAULT_ASYNC_SHARD_RULES);
+            Str=buff;
         }
-        if(WData->Regex[r].RegexWid!=NULL)
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->AsyncShardRules->Ctrl,Str);
+
+        WData->HelperMode=m_TLF_UIAPI->AddCheckbox(WData->AdvancedTabHandle,
+                "Worker checks lines in a helper process",NULL,NULL);
+        if(WData->HelperMode==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"HelperMode");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetCheckboxChecked(WData->AdvancedTabHandle,
+                WData->HelperMode->Ctrl,atoi(Str)?true:false);
+
+        WData->HelperCPUs=m_TLF_UIAPI->AddTextInput(WData->AdvancedTabHandle,
+                "Helper CPUs (blank = any)",NULL,NULL);
+        if(WData->HelperCPUs==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"HelperCPUs");
+        if(Str==NULL)
+            Str="";
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->HelperCPUs->Ctrl,Str);
+
+        WData->HelperTimeout=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Helper timeout (ms)",NULL,NULL);
+        if(WData->HelperTimeout==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"HelperTimeoutMS");
+        if(Str==NULL)
         {
-            m_TLF_UIAPI->FreeTextInput(WData->Regex[r].GroupBox->
-                    GroupWidgetHandle,WData->Regex[r].RegexWid);
+            sprintf(buff,"%d",DEFAULT_HELPER_TIMEOUT_MS);
+            Str=buff;
         }
-        if(WData->Regex[r].GroupBox!=NULL)
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->HelperTimeout->Ctrl,Str);
+
+        WData->BatchLines=m_TLF_UIAPI->AddTextInput(WData->AdvancedTabHandle,
+                "Lines per batch (1 = off)",NULL,NULL);
+        if(WData->BatchLines==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"BatchLines");
+        if(Str==NULL)
         {
-            m_TLF_UIAPI->FreeGroupBox(WData->RegexTabHandle,
-                    WData->Regex[r].GroupBox);
+            sprintf(buff,"%d",DEFAULT_BATCH_LINES);
+            Str=buff;
+        }
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->BatchLines->Ctrl,Str);
+
+        WData->BatchDelay=m_TLF_UIAPI->AddTextInput(WData->AdvancedTabHandle,
+                "Batch max delay (us)",NULL,NULL);
+        if(WData->BatchDelay==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"BatchDelayUS");
+        if(Str==NULL)
+        {
+            sprintf(buff,"%d",DEFAULT_BATCH_DELAY_US);
+            Str=buff;
+        }
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->BatchDelay->Ctrl,Str);
+
+        WData->ShedMax=m_TLF_UIAPI->AddComboBox(WData->AdvancedTabHandle,
+                false,"Load shedding",NULL,NULL);
+        if(WData->ShedMax==NULL)
+            throw(0);
+        for(c=0;c<e_ShedMAX;c++)
+        {
+            m_TLF_UIAPI->AddItem2ComboBox(WData->AdvancedTabHandle,
+                    WData->ShedMax->Ctrl,m_ShedLevelNames[c],c);
+        }
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"ShedMax");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+                WData->ShedMax->Ctrl,atoi(Str));
+
+        WData->ShedBudget=m_TLF_UIAPI->AddTextInput(WData->AdvancedTabHandle,
+                "Load shedding time budget (%)",NULL,NULL);
+        if(WData->ShedBudget==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"ShedBudget");
+        if(Str==NULL)
+        {
+            sprintf(buff,"%d",DEFAULT_SHED_BUDGET_PCT);
+            Str=buff;
+        }
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->ShedBudget->Ctrl,Str);
+
+        WData->ShedSample=m_TLF_UIAPI->AddTextInput(WData->AdvancedTabHandle,
+                "Load shedding sample (1 in N lines)",NULL,NULL);
+        if(WData->ShedSample==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"ShedSample");
+        if(Str==NULL)
+        {
+            sprintf(buff,"%d",DEFAULT_SHED_SAMPLE);
+            Str=buff;
+        }
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->ShedSample->Ctrl,Str);
+
+        WData->StyleLimitRule=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Max styled matches per rule per window "
+                "(0 = no limit)",NULL,NULL);
+        if(WData->StyleLimitRule==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitRule");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->StyleLimitRule->Ctrl,Str);
+
+        WData->StyleLimitPolicy=m_TLF_UIAPI->AddComboBox(WData->
+                AdvancedTabHandle,false,"Over the rule limit",NULL,NULL);
+        if(WData->StyleLimitPolicy==NULL)
+            throw(0);
+        for(c=0;c<e_StyleLimitMAX;c++)
+        {
+            m_TLF_UIAPI->AddItem2ComboBox(WData->AdvancedTabHandle,
+                    WData->StyleLimitPolicy->Ctrl,m_StyleLimitNames[c],c);
+        }
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitPolicy");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+                WData->StyleLimitPolicy->Ctrl,atoi(Str));
+
+        WData->StyleLimitNth=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Highlight every Nth match (N)",NULL,NULL);
+        if(WData->StyleLimitNth==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitNth");
+        if(Str==NULL)
+        {
+            sprintf(buff,"%d",DEFAULT_STYLE_LIMIT_NTH);
+            Str=buff;
+        }
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->StyleLimitNth->Ctrl,Str);
+
+        WData->StyleLimitCon=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Max styles per connection per window "
+                "(0 = no limit)",NULL,NULL);
+        if(WData->StyleLimitCon==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitCon");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->StyleLimitCon->Ctrl,Str);
+
+        WData->StyleLimitWindow=m_TLF_UIAPI->AddTextInput(WData->
+                AdvancedTabHandle,"Style limit window (ms)",NULL,NULL);
+        if(WData->StyleLimitWindow==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitWindowMS");
+        if(Str==NULL)
+        {
+            sprintf(buff,"%d",DEFAULT_STYLE_LIMIT_WINDOW_MS);
+            Str=buff;
+        }
+        m_TLF_UIAPI->SetTextInputText(WData->AdvancedTabHandle,
+                WData->StyleLimitWindow->Ctrl,Str);
+
+        WData->Rehighlight=m_TLF_UIAPI->AddComboBox(WData->
+                AdvancedTabHandle,false,"Re-highlight the scroll back when "
+                "the settings are applied",NULL,NULL);
+        if(WData->Rehighlight==NULL)
+            throw(0);
+        for(c=0;c<e_RehighlightMAX;c++)
+        {
+            m_TLF_UIAPI->AddItem2ComboBox(WData->AdvancedTabHandle,
+                    WData->Rehighlight->Ctrl,m_RehighlightNames[c],c);
+        }
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"Rehighlight");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+                WData->Rehighlight->Ctrl,atoi(Str));
+
+        WData->EarlyMode=m_TLF_UIAPI->AddCheckbox(WData->AdvancedTabHandle,
+                "Highlight starts with / contains matches before the line "
+                "ends",NULL,NULL);
+        if(WData->EarlyMode==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"EarlyMode");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetCheckboxChecked(WData->AdvancedTabHandle,
+                WData->EarlyMode->Ctrl,atoi(Str)?true:false);
+
+        /* Records */
+        WData->RecordsTabHandle=m_TLF_DPS->AddNewSettingsTab("Records");
+        if(WData->RecordsTabHandle==NULL)
+            throw(0);
+
+        WData->RecordMode=m_TLF_UIAPI->AddCheckbox(WData->RecordsTabHandle,
+                "Group lines in to multi-line records",NULL,NULL);
+        if(WData->RecordMode==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordMode");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetCheckboxChecked(WData->RecordsTabHandle,
+                WData->RecordMode->Ctrl,atoi(Str)?true:false);
+
+        WData->RecordStart=m_TLF_UIAPI->AddTextInput(WData->RecordsTabHandle,
+                "Record start regex",NULL,NULL);
+        if(WData->RecordStart==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordStart");
+        if(Str==NULL)
+            Str="";
+        m_TLF_UIAPI->SetTextInputText(WData->RecordsTabHandle,
+                WData->RecordStart->Ctrl,Str);
+
+        WData->RecordCont=m_TLF_UIAPI->AddComboBox(WData->RecordsTabHandle,
+                false,"Continuation lines",NULL,NULL);
+        if(WData->RecordCont==NULL)
+            throw(0);
+        for(c=0;c<e_RecordContMAX;c++)
+        {
+            m_TLF_UIAPI->AddItem2ComboBox(WData->RecordsTabHandle,
+                    WData->RecordCont->Ctrl,m_RecordContNames[c],c);
+        }
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordCont");
+        if(Str==NULL)
+            Str="0";
+        m_TLF_UIAPI->SetComboBoxSelectedEntry(WData->RecordsTabHandle,
+                WData->RecordCont->Ctrl,atoi(Str));
+
+        WData->RecordPrefix=m_TLF_UIAPI->AddTextInput(WData->
+                RecordsTabHandle,"Continuation prefix",NULL,NULL);
+        if(WData->RecordPrefix==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordPrefix");
+        if(Str==NULL)
+            Str="";
+        m_TLF_UIAPI->SetTextInputText(WData->RecordsTabHandle,
+                WData->RecordPrefix->Ctrl,Str);
+
+        WData->RecordMaxLines=m_TLF_UIAPI->AddTextInput(WData->
+                RecordsTabHandle,"Max lines per record",NULL,NULL);
+        if(WData->RecordMaxLines==NULL)
+            throw(0);
+
+        Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordMaxLines");
+        if(Str==NULL)
+        {
+            sprintf(buff,"%d",DEFAULT_RECORD_MAX_LINES);
+            Str=buff;
+        }
+        m_TLF_UIAPI->SetTextInputText(WData->RecordsTabHandle,
+                WData->RecordMaxLines->Ctrl,Str);
+    }
+    catch(...)
+    {
+        if(WData!=NULL)
+        {
+            TextLineHighlighter_FreeSettingsWidgets(
+                    (t_DataProSettingsWidgetsType *)WData);
         }
+        return NULL;
     }
 
-    delete WData;
+    return (t_DataProSettingsWidgetsType *)WData;
 }
 
 /*******************************************************************************
  * NAME:
- *    SetSettingsFromWidgets
+ *    FreeSettingsWidgets
  *
  * SYNOPSIS:
- *    void SetSettingsFromWidgets(t_DataProSettingsWidgetsType *PrivData,
- *              t_PIKVList *Settings);
+ *    void FreeSettingsWidgets(t_DataProSettingsWidgetsType *PrivData);
  *
  * PARAMETERS:
- *    PrivData [I] -- Your private data allocated in AllocSettingsWidgets()
- *    Settings [O] -- This is where you store the settings.
+ *    PrivData [I] -- The private data to free
  *
  * FUNCTION:
- *    This function takes the widgets added with AllocSettingsWidgets() and
- *    stores them is a key/value pair list in 'Settings'.
+ *      This function is called when the system frees the settings widets.
+ *      It should free any private data you allocated in AllocSettingsWidgets().
  *
  * RETURNS:
  *    NONE
@@ -784,82 +2000,4193 @@ void TextLineHighlighter_FreeSettingsWidgets(t_DataProSettingsWidgetsType *PrivD
  * SEE ALSO:
  *    AllocSettingsWidgets()
  ******************************************************************************/
-void TextLineHighlighter_SetSettingsFromWidgets(t_DataProSettingsWidgetsType *PrivData,t_PIKVList *Settings)
+void TextLineHighlighter_FreeSettingsWidgets(t_DataProSettingsWidgetsType *PrivData)
 {
     struct TextLineHighlighter_SettingsWidgets *WData=(struct TextLineHighlighter_SettingsWidgets *)PrivData;
-    string Str;
     int r;
-    char buff[100];
-    char buff2[100];
-    uint32_t Num;
 
-    /** Simple **/
-    for(r=0;r<NUM_OF_SIMPLE;r++)
+    /* Free everything in reverse order */
+
+    /* Records */
+    if(WData->RecordMaxLines!=NULL)
     {
-        Str=m_TLF_UIAPI->GetTextInputText(WData->Simple[r].GroupBox->
-                GroupWidgetHandle,WData->Simple[r].StartsWith->Ctrl);
-        sprintf(buff,"SimpleStart%d",r);
-        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+        m_TLF_UIAPI->FreeTextInput(WData->RecordsTabHandle,
+                WData->RecordMaxLines);
+    }
+    if(WData->RecordPrefix!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->RecordsTabHandle,
+                WData->RecordPrefix);
+    }
+    if(WData->RecordCont!=NULL)
+        m_TLF_UIAPI->FreeComboBox(WData->RecordsTabHandle,WData->RecordCont);
+    if(WData->RecordStart!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->RecordsTabHandle,
+                WData->RecordStart);
+    }
+    if(WData->RecordMode!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(WData->RecordsTabHandle,WData->RecordMode);
 
-        Str=m_TLF_UIAPI->GetTextInputText(WData->Simple[r].GroupBox->
-                GroupWidgetHandle,WData->Simple[r].Contains->Ctrl);
-        sprintf(buff,"SimpleContains%d",r);
-        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+    /* Advanced */
+    if(WData->EarlyMode!=NULL)
+    {
+        m_TLF_UIAPI->FreeCheckbox(WData->AdvancedTabHandle,
+                WData->EarlyMode);
+    }
+    if(WData->Rehighlight!=NULL)
+    {
+        m_TLF_UIAPI->FreeComboBox(WData->AdvancedTabHandle,
+                WData->Rehighlight);
+    }
+    if(WData->StyleLimitWindow!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->StyleLimitWindow);
+    }
+    if(WData->StyleLimitCon!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->StyleLimitCon);
+    }
+    if(WData->StyleLimitNth!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->StyleLimitNth);
+    }
+    if(WData->StyleLimitPolicy!=NULL)
+    {
+        m_TLF_UIAPI->FreeComboBox(WData->AdvancedTabHandle,
+                WData->StyleLimitPolicy);
+    }
+    if(WData->StyleLimitRule!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->StyleLimitRule);
+    }
+    if(WData->ShedSample!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->ShedSample);
+    }
+    if(WData->ShedBudget!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->ShedBudget);
+    }
+    if(WData->ShedMax!=NULL)
+        m_TLF_UIAPI->FreeComboBox(WData->AdvancedTabHandle,WData->ShedMax);
+    if(WData->BatchDelay!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->BatchDelay);
+    }
+    if(WData->BatchLines!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->BatchLines);
+    }
+    if(WData->HelperTimeout!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->HelperTimeout);
+    }
+    if(WData->HelperCPUs!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->HelperCPUs);
+    }
+    if(WData->HelperMode!=NULL)
+    {
+        m_TLF_UIAPI->FreeCheckbox(WData->AdvancedTabHandle,
+                WData->HelperMode);
+    }
+    if(WData->AsyncShardRules!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->AsyncShardRules);
+    }
+    if(WData->AsyncMaxLines!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->AsyncMaxLines);
+    }
+    if(WData->AsyncMode!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(WData->AdvancedTabHandle,WData->AsyncMode);
+    if(WData->LineEndByte!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->LineEndByte);
+    }
+    if(WData->LineEnd!=NULL)
+        m_TLF_UIAPI->FreeComboBox(WData->AdvancedTabHandle,WData->LineEnd);
+    if(WData->MaxLineLength!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->AdvancedTabHandle,
+                WData->MaxLineLength);
+    }
 
-        Str=m_TLF_UIAPI->GetTextInputText(WData->Simple[r].GroupBox->
-                GroupWidgetHandle,WData->Simple[r].EndsWith->Ctrl);
-        sprintf(buff,"SimpleEnd%d",r);
-        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+    /* Capture */
+    if(WData->CaptureFile!=NULL)
+    {
+        m_TLF_UIAPI->FreeTextInput(WData->CaptureTabHandle,
+                WData->CaptureFile);
+    }
+    if(WData->CaptureOn!=NULL)
+    {
+        m_TLF_UIAPI->FreeCheckbox(WData->CaptureTabHandle,
+                WData->CaptureOn);
+    }
+
+    /* Statistics */
+    if(WData->SaveLatencyBttn!=NULL)
+    {
+        m_TLF_UIAPI->FreeButtonInput(WData->StatsTabHandle,
+                WData->SaveLatencyBttn);
+    }
+    if(WData->ResetStatsBttn!=NULL)
+    {
+        m_TLF_UIAPI->FreeButtonInput(WData->StatsTabHandle,
+                WData->ResetStatsBttn);
+    }
+    if(WData->RehighlightIndicator!=NULL)
+    {
+        m_TLF_UIAPI->FreeIndicator(WData->StatsTabHandle,
+                WData->RehighlightIndicator);
+    }
+    for(r=e_ShedMAX-2;r>=0;r--)
+    {
+        if(WData->ShedIndicators[r]!=NULL)
+        {
+            m_TLF_UIAPI->FreeIndicator(WData->StatsTabHandle,
+                    WData->ShedIndicators[r]);
+        }
+    }
+    if(WData->HostCallsView!=NULL)
+    {
+        m_TLF_UIAPI->FreeColumnViewInput(WData->StatsTabHandle,
+                WData->HostCallsView);
+    }
+    if(WData->LatencyView!=NULL)
+    {
+        m_TLF_UIAPI->FreeColumnViewInput(WData->StatsTabHandle,
+                WData->LatencyView);
+    }
+    if(WData->RuleStatsView!=NULL)
+    {
+        m_TLF_UIAPI->FreeColumnViewInput(WData->StatsTabHandle,
+                WData->RuleStatsView);
+    }
+    if(WData->ConStatsView!=NULL)
+    {
+        m_TLF_UIAPI->FreeColumnViewInput(WData->StatsTabHandle,
+                WData->ConStatsView);
+    }
+
+    /* Styling tabs (colors) */
+    for(r=NUM_OF_STYLES-1;r>=0;r--)
+    {
+        TextLineHighlighter_FreeSettingStyleWidgets(&WData->Styles[r],
+                WData->StylesTabHandle[r]);
+    }
+
+    for(r=NUM_OF_SIMPLE-1;r>=0;r--)
+    {
+        if(WData->Simple[r].MatchSpan!=NULL)
+        {
+            m_TLF_UIAPI->FreeCheckbox(WData->Simple[r].GroupBox->
+                    GroupWidgetHandle,WData->Simple[r].MatchSpan);
+        }
+        if(WData->Simple[r].StyleList!=NULL)
+        {
+            m_TLF_UIAPI->FreeComboBox(WData->Simple[r].GroupBox->
+                    GroupWidgetHandle,WData->Simple[r].StyleList);
+        }
+        if(WData->Simple[r].EndsWith!=NULL)
+        {
+            m_TLF_UIAPI->FreeTextInput(WData->Simple[r].GroupBox->
+                    GroupWidgetHandle,WData->Simple[r].EndsWith);
+        }
+        if(WData->Simple[r].Contains!=NULL)
+        {
+            m_TLF_UIAPI->FreeTextInput(WData->Simple[r].GroupBox->
+                    GroupWidgetHandle,WData->Simple[r].Contains);
+        }
+        if(WData->Simple[r].StartsWith!=NULL)
+        {
+            m_TLF_UIAPI->FreeTextInput(WData->Simple[r].GroupBox->
+                    GroupWidgetHandle,WData->Simple[r].StartsWith);
+        }
+        if(WData->Simple[r].GroupBox!=NULL)
+        {
+            m_TLF_UIAPI->FreeGroupBox(WData->SimpleTabHandle,
+                    WData->Simple[r].GroupBox);
+        }
+    }
+    for(r=NUM_OF_REGEXS-1;r>=0;r--)
+    {
+        if(WData->Regex[r].GroupStyles!=NULL)
+        {
+            m_TLF_UIAPI->FreeTextInput(WData->Regex[r].GroupBox->
+                    GroupWidgetHandle,WData->Regex[r].GroupStyles);
+        }
+        if(WData->Regex[r].MatchSpan!=NULL)
+        {
+            m_TLF_UIAPI->FreeCheckbox(WData->Regex[r].GroupBox->
+                    GroupWidgetHandle,WData->Regex[r].MatchSpan);
+        }
+        if(WData->Regex[r].StyleList!=NULL)
+        {
+            m_TLF_UIAPI->FreeComboBox(WData->Regex[r].GroupBox->
+                    GroupWidgetHandle,WData->Regex[r].StyleList);
+        }
+        if(WData->Regex[r].RegexWid!=NULL)
+        {
+            m_TLF_UIAPI->FreeTextInput(WData->Regex[r].GroupBox->
+                    GroupWidgetHandle,WData->Regex[r].RegexWid);
+        }
+        if(WData->Regex[r].GroupBox!=NULL)
+        {
+            m_TLF_UIAPI->FreeGroupBox(WData->RegexTabHandle,
+                    WData->Regex[r].GroupBox);
+        }
+    }
+
+    delete WData;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    SetSettingsFromWidgets
+ *
+ * SYNOPSIS:
+ *    void SetSettingsFromWidgets(t_DataProSettingsWidgetsType *PrivData,
+ *              t_PIKVList *Settings);
+ *
+ * PARAMETERS:
+ *    PrivData [I] -- Your private data allocated in AllocSettingsWidgets()
+ *    Settings [O] -- This is where you store the settings.
+ *
+ * FUNCTION:
+ *    This function takes the widgets added with AllocSettingsWidgets() and
+ *    stores them is a key/value pair list in 'Settings'.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    AllocSettingsWidgets()
+ ******************************************************************************/
+void TextLineHighlighter_SetSettingsFromWidgets(t_DataProSettingsWidgetsType *PrivData,t_PIKVList *Settings)
+{
+    struct TextLineHighlighter_SettingsWidgets *WData=(struct TextLineHighlighter_SettingsWidgets *)PrivData;
+    string Str;
+    int r;
+    char buff[100];
+    char buff2[100];
+    uint32_t Num;
+
+    /** Simple **/
+    for(r=0;r<NUM_OF_SIMPLE;r++)
+    {
+        Str=m_TLF_UIAPI->GetTextInputText(WData->Simple[r].GroupBox->
+                GroupWidgetHandle,WData->Simple[r].StartsWith->Ctrl);
+        sprintf(buff,"SimpleStart%d",r);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+
+        Str=m_TLF_UIAPI->GetTextInputText(WData->Simple[r].GroupBox->
+                GroupWidgetHandle,WData->Simple[r].Contains->Ctrl);
+        sprintf(buff,"SimpleContains%d",r);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+
+        Str=m_TLF_UIAPI->GetTextInputText(WData->Simple[r].GroupBox->
+                GroupWidgetHandle,WData->Simple[r].EndsWith->Ctrl);
+        sprintf(buff,"SimpleEnd%d",r);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+
+        Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->Simple[r].GroupBox->
+                GroupWidgetHandle,WData->Simple[r].StyleList->Ctrl);
+        sprintf(buff,"SimpleStyle%d",r);
+        sprintf(buff2,"%d",Num);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,buff2);
+
+        sprintf(buff,"SimpleSpan%d",r);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,m_TLF_UIAPI->IsCheckboxChecked(
+                WData->Simple[r].GroupBox->GroupWidgetHandle,
+                WData->Simple[r].MatchSpan->Ctrl)?"1":"0");
+    }
+
+    /** Regex **/
+    for(r=0;r<NUM_OF_REGEXS;r++)
+    {
+        Str=m_TLF_UIAPI->GetTextInputText(WData->Regex[r].GroupBox->
+                GroupWidgetHandle,WData->Regex[r].RegexWid->Ctrl);
+
+        sprintf(buff,"RegexStr%d",r);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+
+        Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->Regex[r].GroupBox->
+                GroupWidgetHandle,WData->Regex[r].StyleList->Ctrl);
+        sprintf(buff,"RegexStyle%d",r);
+        sprintf(buff2,"%d",Num);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,buff2);
+
+        sprintf(buff,"RegexSpan%d",r);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,m_TLF_UIAPI->IsCheckboxChecked(
+                WData->Regex[r].GroupBox->GroupWidgetHandle,
+                WData->Regex[r].MatchSpan->Ctrl)?"1":"0");
+
+        Str=m_TLF_UIAPI->GetTextInputText(WData->Regex[r].GroupBox->
+                GroupWidgetHandle,WData->Regex[r].GroupStyles->Ctrl);
+        sprintf(buff,"RegexGroups%d",r);
+        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
+    }
+
+    /* Styling tabs (colors) */
+    for(r=0;r<NUM_OF_STYLES;r++)
+    {
+        sprintf(buff,"Colors%d",r);
+        TextLineHighlighter_UpdateSettingFromStyleWidgets(Settings,
+                &WData->Styles[r],WData->StylesTabHandle[r],buff);
+    }
+
+    /* Capture */
+    m_TLF_SysAPI->KVAddItem(Settings,"CaptureOn",
+            m_TLF_UIAPI->IsCheckboxChecked(WData->CaptureTabHandle,
+            WData->CaptureOn->Ctrl)?"1":"0");
+    Str=m_TLF_UIAPI->GetTextInputText(WData->CaptureTabHandle,
+            WData->CaptureFile->Ctrl);
+    m_TLF_SysAPI->KVAddItem(Settings,"CaptureFile",Str.c_str());
+
+    /* Advanced */
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->MaxLineLength->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"MaxLineLength",buff);
+
+    Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+            WData->LineEnd->Ctrl);
+    sprintf(buff,"%d",Num);
+    m_TLF_SysAPI->KVAddItem(Settings,"LineEnd",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->LineEndByte->Ctrl);
+    sprintf(buff,"%02X",(unsigned)(strtoul(Str.c_str(),NULL,16)&0xFF));
+    m_TLF_SysAPI->KVAddItem(Settings,"LineEndByte",buff);
+
+    m_TLF_SysAPI->KVAddItem(Settings,"AsyncMode",
+            m_TLF_UIAPI->IsCheckboxChecked(WData->AdvancedTabHandle,
+            WData->AsyncMode->Ctrl)?"1":"0");
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->AsyncMaxLines->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"AsyncMaxLines",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->AsyncShardRules->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"AsyncShardRules",buff);
+
+    m_TLF_SysAPI->KVAddItem(Settings,"HelperMode",
+            m_TLF_UIAPI->IsCheckboxChecked(WData->AdvancedTabHandle,
+            WData->HelperMode->Ctrl)?"1":"0");
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->HelperCPUs->Ctrl);
+    m_TLF_SysAPI->KVAddItem(Settings,"HelperCPUs",Str.c_str());
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->HelperTimeout->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"HelperTimeoutMS",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->BatchLines->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"BatchLines",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->BatchDelay->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"BatchDelayUS",buff);
+
+    Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+            WData->ShedMax->Ctrl);
+    sprintf(buff,"%d",Num);
+    m_TLF_SysAPI->KVAddItem(Settings,"ShedMax",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->ShedBudget->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"ShedBudget",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->ShedSample->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"ShedSample",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->StyleLimitRule->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"StyleLimitRule",buff);
+
+    Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+            WData->StyleLimitPolicy->Ctrl);
+    sprintf(buff,"%d",Num);
+    m_TLF_SysAPI->KVAddItem(Settings,"StyleLimitPolicy",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->StyleLimitNth->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"StyleLimitNth",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->StyleLimitCon->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"StyleLimitCon",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->AdvancedTabHandle,
+            WData->StyleLimitWindow->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"StyleLimitWindowMS",buff);
+
+    Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->AdvancedTabHandle,
+            WData->Rehighlight->Ctrl);
+    sprintf(buff,"%d",Num);
+    m_TLF_SysAPI->KVAddItem(Settings,"Rehighlight",buff);
+
+    m_TLF_SysAPI->KVAddItem(Settings,"EarlyMode",
+            m_TLF_UIAPI->IsCheckboxChecked(WData->AdvancedTabHandle,
+            WData->EarlyMode->Ctrl)?"1":"0");
+
+    /* Records */
+    m_TLF_SysAPI->KVAddItem(Settings,"RecordMode",
+            m_TLF_UIAPI->IsCheckboxChecked(WData->RecordsTabHandle,
+            WData->RecordMode->Ctrl)?"1":"0");
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->RecordsTabHandle,
+            WData->RecordStart->Ctrl);
+    m_TLF_SysAPI->KVAddItem(Settings,"RecordStart",Str.c_str());
+
+    Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->RecordsTabHandle,
+            WData->RecordCont->Ctrl);
+    sprintf(buff,"%d",Num);
+    m_TLF_SysAPI->KVAddItem(Settings,"RecordCont",buff);
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->RecordsTabHandle,
+            WData->RecordPrefix->Ctrl);
+    m_TLF_SysAPI->KVAddItem(Settings,"RecordPrefix",Str.c_str());
+
+    Str=m_TLF_UIAPI->GetTextInputText(WData->RecordsTabHandle,
+            WData->RecordMaxLines->Ctrl);
+    sprintf(buff,"%d",atoi(Str.c_str()));
+    m_TLF_SysAPI->KVAddItem(Settings,"RecordMaxLines",buff);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    ApplySettings
+ *
+ * SYNOPSIS:
+ *    void ApplySettings(t_DataProcessorHandleType *DataHandle,
+ *              t_PIKVList *Settings);
+ *
+ * PARAMETERS:
+ *    DataHandle [I] -- The data handle to work on.  This is your internal
+ *                      data.
+ *    Settings [I] -- This is where you get your settings from.
+ *
+ * FUNCTION:
+ *    This function takes the settings from 'Settings' and setups the
+ *    plugin to use them when new bytes come in or out.  It will normally
+ *    copy the settings from key/value pairs to internal data structures.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    
+ ******************************************************************************/
+static void TextLineHighlighter_ApplySettings(t_DataProcessorHandleType *DataHandle,
+        t_PIKVList *Settings)
+{
+    struct TextLineHighlighterData *Data=(struct TextLineHighlighterData *)DataHandle;
+    const char *Str;
+    int r;
+    unsigned int e;
+    char buff[100];
+    char Name[100];
+    int StyleIndex;
+    bool MatchSpan;
+    t_LineMatchGroupStyleList Groups;
+    uint32_t PoolMaxRetained;
+
+    /* The record we are in has flags for the old rules and the worker has
+       a copy of the old rules.  A batch is checked with the old rules. */
+    TextLineHighlighter_StopRescan(Data);
+    TextLineHighlighter_StopAsync(Data,true);
+    TextLineHighlighter_FlushBatch(Data,false);
+    TextLineHighlighter_DropRecord(Data);
+
+    /* The metrics thread reads the rule stats */
+    unique_lock<mutex> Lock(m_ConnectionsMutex);
+
+    /* We rebuild the rules in the same order HandleLine() has always
+       checked them in (simple start/contains/end, then the regex's) */
+    Data->Rules.clear();
+    Data->RuleStats.clear();
+    for(r=0;r<NUM_OF_SIMPLE;r++)
+    {
+        sprintf(buff,"SimpleStyle%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        if(Str==NULL)
+            Str="0";
+        StyleIndex=atoi(Str);
+
+        sprintf(buff,"SimpleSpan%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        MatchSpan=Str!=NULL && atoi(Str)!=0;
+
+        sprintf(buff,"SimpleStart%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        if(Str!=NULL)
+        {
+            sprintf(Name,"Simple %d starts with",r+1);
+            TextLineHighlighter_AddRule(Data,e_LineMatchRule_StartsWith,Str,
+                    StyleIndex,MatchSpan,Name);
+        }
+
+        sprintf(buff,"SimpleContains%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        if(Str!=NULL)
+        {
+            sprintf(Name,"Simple %d contains",r+1);
+            TextLineHighlighter_AddRule(Data,e_LineMatchRule_Contains,Str,
+                    StyleIndex,MatchSpan,Name);
+        }
+
+        sprintf(buff,"SimpleEnd%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        if(Str!=NULL)
+        {
+            sprintf(Name,"Simple %d ends with",r+1);
+            TextLineHighlighter_AddRule(Data,e_LineMatchRule_EndsWith,Str,
+                    StyleIndex,MatchSpan,Name);
+        }
+    }
+
+    for(r=0;r<NUM_OF_REGEXS;r++)
+    {
+        sprintf(buff,"RegexStyle%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        if(Str==NULL)
+            Str="0";
+        StyleIndex=atoi(Str);
+
+        sprintf(buff,"RegexSpan%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        MatchSpan=Str!=NULL && atoi(Str)!=0;
+
+        sprintf(buff,"RegexGroups%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        TextLineHighlighter_ParseGroupStyles(Str!=NULL?Str:"",Groups);
+
+        /* Bad regex's are just not added (they used to throw in HandleLine()) */
+        sprintf(buff,"RegexStr%d",r);
+        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        if(Str!=NULL)
+        {
+            sprintf(Name,"Regex %d",r+1);
+            if(TextLineHighlighter_AddRule(Data,e_LineMatchRule_Regex,Str,
+                    StyleIndex,MatchSpan,Name))
+            {
+                LineMatch_SetGroupStyles(&Data->Rules.back(),Groups);
+            }
+        }
+    }
+
+    /* Styling tabs (colors) */
+    for(r=0;r<NUM_OF_STYLES;r++)
+    {
+        sprintf(buff,"Colors%d",r);
+        TextLineHighlighter_ApplySetting_SetData(Settings,&Data->Styles[r],buff,
+                r);
+    }
+
+    /* Advanced.  If the max goes down while we are on a long line the next
+       byte will check the window */
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"MaxLineLength");
+    Data->MaxLineLength=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_MAX_LINE_LENGTH;
+    if(Data->MaxLineLength!=0 && Data->MaxLineLength<MIN_MAX_LINE_LENGTH)
+        Data->MaxLineLength=MIN_MAX_LINE_LENGTH;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"LineEnd");
+    Data->LineEnd=e_LineEnd_LF;
+    if(Str!=NULL && atoi(Str)>=0 && atoi(Str)<e_LineEndMAX)
+        Data->LineEnd=(e_LineEndType)atoi(Str);
+
+    switch(Data->LineEnd)
+    {
+        case e_LineEnd_LF:
+        case e_LineEnd_CRLF:
+        case e_LineEndMAX:
+        default:
+            Data->LineEndByte='\n';
+        break;
+        case e_LineEnd_CR:
+            Data->LineEndByte='\r';
+        break;
+        case e_LineEnd_NUL:
+            Data->LineEndByte=0;
+        break;
+        case e_LineEnd_Custom:
+            Str=m_TLF_SysAPI->KVGetItem(Settings,"LineEndByte");
+            Data->LineEndByte=Str!=NULL?strtoul(Str,NULL,16)&0xFF:'\n';
+        break;
+    }
+
+    /* Records.  A bad start regex turns them off. */
+    Data->RecordStart.clear();
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordStart");
+    if(Str!=NULL && *Str!=0)
+    {
+        LineMatch_AddRule(Data->RecordStart,e_LineMatchRule_Regex,Str,0,
+                false);
+    }
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordMode");
+    Data->RecordMode=Str!=NULL && atoi(Str)!=0 && !Data->RecordStart.empty();
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordCont");
+    Data->RecordCont=e_RecordCont_Indented;
+    if(Str!=NULL && atoi(Str)>=0 && atoi(Str)<e_RecordContMAX)
+        Data->RecordCont=(e_RecordContType)atoi(Str);
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordPrefix");
+    Data->RecordPrefix=Str!=NULL?Str:"";
+    if(Data->RecordCont==e_RecordCont_Prefix && Data->RecordPrefix.empty())
+        Data->RecordMode=false;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"RecordMaxLines");
+    Data->RecordMaxLines=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_RECORD_MAX_LINES;
+    if(Data->RecordMaxLines<MIN_RECORD_MAX_LINES)
+        Data->RecordMaxLines=MIN_RECORD_MAX_LINES;
+    if(Data->RecordMaxLines>MAX_RECORD_MAX_LINES)
+        Data->RecordMaxLines=MAX_RECORD_MAX_LINES;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"AsyncMode");
+    Data->AsyncMode=Str!=NULL && atoi(Str)!=0;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"AsyncMaxLines");
+    Data->AsyncMaxLines=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_ASYNC_MAX_LINES;
+    if(Data->AsyncMaxLines<MIN_ASYNC_MAX_LINES)
+        Data->AsyncMaxLines=MIN_ASYNC_MAX_LINES;
+    if(Data->AsyncMaxLines>MAX_ASYNC_MAX_LINES)
+        Data->AsyncMaxLines=MAX_ASYNC_MAX_LINES;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"AsyncShardRules");
+    Data->AsyncShardRules=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_ASYNC_SHARD_RULES;
+    if(Data->AsyncShardRules!=0 && Data->AsyncShardRules<MIN_ASYNC_SHARD_RULES)
+        Data->AsyncShardRules=MIN_ASYNC_SHARD_RULES;
+    if(Data->AsyncShardRules>MAX_ASYNC_SHARD_RULES)
+        Data->AsyncShardRules=MAX_ASYNC_SHARD_RULES;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"HelperMode");
+    Data->HelperMode=Str!=NULL && atoi(Str)!=0;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"HelperCPUs");
+    Data->HelperCPUs=Str!=NULL?Str:"";
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"HelperTimeoutMS");
+    Data->HelperTimeoutMS=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_HELPER_TIMEOUT_MS;
+    if(Data->HelperTimeoutMS<MIN_HELPER_TIMEOUT_MS)
+        Data->HelperTimeoutMS=MIN_HELPER_TIMEOUT_MS;
+    if(Data->HelperTimeoutMS>MAX_HELPER_TIMEOUT_MS)
+        Data->HelperTimeoutMS=MAX_HELPER_TIMEOUT_MS;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"BatchLines");
+    Data->BatchLines=Str!=NULL?strtoul(Str,NULL,10):DEFAULT_BATCH_LINES;
+    if(Data->BatchLines<1)
+        Data->BatchLines=1;
+    if(Data->BatchLines>MAX_BATCH_LINES)
+        Data->BatchLines=MAX_BATCH_LINES;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"BatchDelayUS");
+    Data->BatchDelayUS=Str!=NULL?strtoul(Str,NULL,10):DEFAULT_BATCH_DELAY_US;
+    if(Data->BatchDelayUS>MAX_BATCH_DELAY_US)
+        Data->BatchDelayUS=MAX_BATCH_DELAY_US;
+
+    /* The costs the governor has are for the old rules */
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"ShedMax");
+    Data->ShedMax=e_Shed_Full;
+    if(Str!=NULL && atoi(Str)>=0 && atoi(Str)<e_ShedMAX)
+        Data->ShedMax=(e_ShedLevelType)atoi(Str);
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"ShedBudget");
+    Data->ShedBudgetPct=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_SHED_BUDGET_PCT;
+    if(Data->ShedBudgetPct<MIN_SHED_BUDGET_PCT)
+        Data->ShedBudgetPct=MIN_SHED_BUDGET_PCT;
+    if(Data->ShedBudgetPct>MAX_SHED_BUDGET_PCT)
+        Data->ShedBudgetPct=MAX_SHED_BUDGET_PCT;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"ShedSample");
+    Data->ShedSample=Str!=NULL?strtoul(Str,NULL,10):DEFAULT_SHED_SAMPLE;
+    if(Data->ShedSample<MIN_SHED_SAMPLE)
+        Data->ShedSample=MIN_SHED_SAMPLE;
+    if(Data->ShedSample>MAX_SHED_SAMPLE)
+        Data->ShedSample=MAX_SHED_SAMPLE;
+
+    TextLineHighlighter_ResetGovernor(Data);
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitRule");
+    Data->StyleLimitRule=Str!=NULL?strtoul(Str,NULL,10):0;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitCon");
+    Data->StyleLimitCon=Str!=NULL?strtoul(Str,NULL,10):0;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitWindowMS");
+    Data->StyleLimitWindowMS=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_STYLE_LIMIT_WINDOW_MS;
+    if(Data->StyleLimitWindowMS<MIN_STYLE_LIMIT_WINDOW_MS)
+        Data->StyleLimitWindowMS=MIN_STYLE_LIMIT_WINDOW_MS;
+    if(Data->StyleLimitWindowMS>MAX_STYLE_LIMIT_WINDOW_MS)
+        Data->StyleLimitWindowMS=MAX_STYLE_LIMIT_WINDOW_MS;
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitPolicy");
+    Data->StyleLimitPolicy=e_StyleLimit_Drop;
+    if(Str!=NULL && atoi(Str)>=0 && atoi(Str)<e_StyleLimitMAX)
+        Data->StyleLimitPolicy=(e_StyleLimitType)atoi(Str);
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"StyleLimitNth");
+    Data->StyleLimitNth=Str!=NULL?strtoul(Str,NULL,10):
+            DEFAULT_STYLE_LIMIT_NTH;
+    if(Data->StyleLimitNth<MIN_STYLE_LIMIT_NTH)
+        Data->StyleLimitNth=MIN_STYLE_LIMIT_NTH;
+    if(Data->StyleLimitNth>MAX_STYLE_LIMIT_NTH)
+        Data->StyleLimitNth=MAX_STYLE_LIMIT_NTH;
+
+    TextLineHighlighter_ResetStyleLimits(Data);
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"Rehighlight");
+    Data->Rehighlight=e_Rehighlight_Off;
+    if(Str!=NULL && atoi(Str)>=0 && atoi(Str)<e_RehighlightMAX)
+        Data->Rehighlight=(e_RehighlightType)atoi(Str);
+
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"EarlyMode");
+    Data->EarlyMode=Str!=NULL && atoi(Str)!=0;
+
+    /* Records are checked as they come in, so they don't use the worker.
+       A record keeps the current line's mark as well as its other lines. */
+    PoolMaxRetained=0;
+    if(Data->RecordMode)
+    {
+        PoolMaxRetained=Data->RecordMaxLines-1;
+    }
+    else if(Data->AsyncMode)
+    {
+        Data->Async=AsyncMatch_Start(Data->Rules,Data->AsyncMaxLines,
+                Data->AsyncShardRules);
+        if(Data->Async!=NULL)
+        {
+            PoolMaxRetained=Data->AsyncMaxLines;
+
+            /* If the helper doesn't start the lines still go to the worker
+               (with just the simple rules, see "Helper Fallback") */
+            if(Data->HelperMode)
+            {
+                AsyncMatch_UseHelper(Data->Async,Data->HelperCPUs.c_str(),
+                        Data->HelperTimeoutMS);
+            }
+        }
+    }
+
+    /* Batches are only used when the lines are checked on the connection */
+    if(!Data->RecordMode && Data->Async==NULL && Data->BatchLines>1)
+    {
+        Data->Batch.resize(Data->BatchLines);
+        PoolMaxRetained=Data->BatchLines;
+    }
+    else
+    {
+        Data->Batch.clear();
+    }
+
+    /* Early styles are only kept track of for lines checked on the
+       connection as they end (see TextLineHighlighter_RunRules()) */
+    Data->EarlyRules.clear();
+    if(Data->EarlyMode && !Data->RecordMode && Data->Async==NULL &&
+            Data->Batch.empty())
+    {
+        for(e=0;e<Data->Rules.size();e++)
+        {
+            if(Data->Rules[e].Type==e_LineMatchRule_StartsWith ||
+                    Data->Rules[e].Type==e_LineMatchRule_Contains)
+            {
+                Data->EarlyRules.emplace_back();
+                Data->EarlyRules.back().Rule=e;
+            }
+        }
+    }
+    TextLineHighlighter_ResetEarly(Data);
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,
+            MarkPool_Resize(&Data->Marks,m_TLF_DPS,PoolMaxRetained));
+    Data->Stats.Marks.store(Data->Marks.Slots.size(),memory_order_relaxed);
+
+    /* This may ask the user something, don't hold up the metrics thread */
+    Lock.unlock();
+
+    TextLineHighlighter_ApplyCaptureSettings(Data,Settings);
+
+    /* The lines already on the screen were colored with the old rules */
+    TextLineHighlighter_StartRescan(Data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_AddSettingStyleWidgets
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_AddSettingStyleWidgets(
+ *          struct SettingsStylingWidgetsSet *Widgets,
+ *          t_WidgetSysHandle *SysHandle);
+ *
+ * PARAMETERS:
+ *    Widgets [O] -- Where to store the pointers to the widgets
+ *    SysHandle [I] -- The widget handle to use when adding the widgets.
+ *
+ * FUNCTION:
+ *    This is a helper function that allocates a set of styling widgets.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * NOTES:
+ *    Will throw(0) if there is an error.
+ *
+ * SEE ALSO:
+ *    
+ ******************************************************************************/
+static void TextLineHighlighter_AddSettingStyleWidgets(
+        struct SettingsStylingWidgetsSet *Widgets,
+        t_WidgetSysHandle *SysHandle)
+{
+    Widgets->FgColor=m_TLF_UIAPI->AddColorPick(SysHandle,"Forground Color",0x000000,NULL,NULL);
+    if(Widgets->FgColor==NULL)
+        throw(0);
+
+    Widgets->BgColor=m_TLF_UIAPI->AddColorPick(SysHandle,"Background Color",0x000000,NULL,NULL);
+    if(Widgets->BgColor==NULL)
+        throw(0);
+
+    Widgets->AttribUnderLine=m_TLF_UIAPI->AddCheckbox(SysHandle,"Underline",NULL,NULL);
+    if(Widgets->AttribUnderLine==NULL)
+        throw(0);
+
+    Widgets->AttribOverLine=m_TLF_UIAPI->AddCheckbox(SysHandle,"Overline",NULL,NULL);
+    if(Widgets->AttribOverLine==NULL)
+        throw(0);
+
+    Widgets->AttribLineThrough=m_TLF_UIAPI->AddCheckbox(SysHandle,"Line through",NULL,NULL);
+    if(Widgets->AttribLineThrough==NULL)
+        throw(0);
+
+    Widgets->AttribBold=m_TLF_UIAPI->AddCheckbox(SysHandle,"Bold",NULL,NULL);
+    if(Widgets->AttribBold==NULL)
+        throw(0);
+
+    Widgets->AttribItalic=m_TLF_UIAPI->AddCheckbox(SysHandle,"Italic",NULL,NULL);
+    if(Widgets->AttribItalic==NULL)
+        throw(0);
+
+    Widgets->AttribOutLine=m_TLF_UIAPI->AddCheckbox(SysHandle,"Outline",NULL,NULL);
+    if(Widgets->AttribOutLine==NULL)
+        throw(0);
+
+    Widgets->ULineColorOn=m_TLF_UIAPI->AddCheckbox(SysHandle,"Custom underline color",NULL,NULL);
+    if(Widgets->ULineColorOn==NULL)
+        throw(0);
+
+    Widgets->ULineColor=m_TLF_UIAPI->AddColorPick(SysHandle,"Underline Color",0x000000,NULL,NULL);
+    if(Widgets->ULineColor==NULL)
+        throw(0);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_FreeSettingStyleWidgets
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_FreeSettingStyleWidgets(
+ *          struct SettingsStylingWidgetsSet *Widgets,
+ *          t_WidgetSysHandle *SysHandle);
+ *
+ * PARAMETERS:
+ *    Widgets [I] -- The widgets style set to free
+ *    SysHandle [I] -- The widget system handle use to allocate these widgets.
+ *
+ * FUNCTION:
+ *    This function frees the widgets that was allocated with
+ *    TextLineHighlighter_AddSettingStyleWidgets()
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_AddSettingStyleWidgets()
+ ******************************************************************************/
+static void TextLineHighlighter_FreeSettingStyleWidgets(
+        struct SettingsStylingWidgetsSet *Widgets,
+        t_WidgetSysHandle *SysHandle)
+{
+    if(Widgets->ULineColor!=NULL)
+        m_TLF_UIAPI->FreeColorPick(SysHandle,Widgets->ULineColor);
+    if(Widgets->ULineColorOn!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->ULineColorOn);
+
+    if(Widgets->AttribOutLine!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribOutLine);
+    if(Widgets->AttribItalic!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribItalic);
+    if(Widgets->AttribBold!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribBold);
+    if(Widgets->AttribLineThrough!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribLineThrough);
+    if(Widgets->AttribOverLine!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribOverLine);
+    if(Widgets->AttribUnderLine!=NULL)
+        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribUnderLine);
+
+    if(Widgets->BgColor!=NULL)
+        m_TLF_UIAPI->FreeColorPick(SysHandle,Widgets->BgColor);
+    if(Widgets->FgColor!=NULL)
+        m_TLF_UIAPI->FreeColorPick(SysHandle,Widgets->FgColor);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_SetSettingStyleWidgets
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_SetSettingStyleWidgets(t_PIKVList *Settings,
+ *          struct SettingsStylingWidgetsSet *Widgets,
+ *          t_WidgetSysHandle *SysHandle,const char *Prefix,
+ *          uint32_t DefaultStyleSet)
+ *
+ * PARAMETERS:
+ *    Settings [I] -- The settings to apply
+ *    Widgets [I] -- The widget set to set to the settings
+ *    SysHandle [I] -- The widget system handle that these widgets where added
+ *                     with.
+ *    Prefix [I] -- The prefix for the styling names in the settings.  This
+ *                  function will take this string and add it to the start
+ *                  of the setting KV name before trying to read it from
+ *                  settings.
+ *    DefaultStyleSet [I] -- The default colors and style to use if a setting
+ *                           isn't found in settings.
+ *
+ * FUNCTION:
+ *    This is a helper function that reads the styling widgets out of settings
+ *    and applies it to the widgets.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    
+ ******************************************************************************/
+static void TextLineHighlighter_SetSettingStyleWidgets(t_PIKVList *Settings,
+        struct SettingsStylingWidgetsSet *Widgets,t_WidgetSysHandle *SysHandle,
+        const char *Prefix,uint32_t DefaultStyleSet)
+{
+    uint32_t Num;
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"FGColor",
+            m_DefaultStyleSets[DefaultStyleSet].FGColor,16);
+    m_TLF_UIAPI->SetColorPickValue(SysHandle,Widgets->FgColor->Ctrl,Num);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"BGColor",
+            m_DefaultStyleSets[DefaultStyleSet].BGColor,16);
+    m_TLF_UIAPI->SetColorPickValue(SysHandle,Widgets->BgColor->Ctrl,Num);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribUnderLine",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_UNDERLINE,10);
+    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribUnderLine->Ctrl,
+            Num?true:false);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOverLine",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OVERLINE,10);
+    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribOverLine->Ctrl,
+            Num?true:false);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribLineThrough",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_LINETHROUGH,10);
+    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribLineThrough->Ctrl,
+            Num?true:false);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribBold",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_BOLD,10);
+    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribBold->Ctrl,
+            Num?true:false);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribItalic",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_ITALIC,10);
+    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribItalic->Ctrl,
+            Num?true:false);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOutLine",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OUTLINE,10);
+    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribOutLine->Ctrl,
+            Num?true:false);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"ULineColorOn",
+            m_DefaultStyleSets[DefaultStyleSet].ULineColorOn,10);
+    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->ULineColorOn->Ctrl,
+            Num?true:false);
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"ULineColor",
+            m_DefaultStyleSets[DefaultStyleSet].FGColor,16);
+    m_TLF_UIAPI->SetColorPickValue(SysHandle,Widgets->ULineColor->Ctrl,Num);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_GrabSettingKV
+ *
+ * SYNOPSIS:
+ *    static uint32_t TextLineHighlighter_GrabSettingKV(t_PIKVList *Settings,
+ *          const char *Prefix,const char *Key,uint32_t DefaultValue,int Base);
+ *
+ * PARAMETERS:
+ *    Settings [I] -- The settings to apply
+ *    Prefix [I] -- The prefix for the styling names in the settings.  This
+ *                  function will take this string and add it to the start
+ *                  of the setting KV name before trying to read it from
+ *                  settings.
+ *    Key [I] -- The key to look for in the settings
+ *    DefaultValue [I] -- What value to apply if it wasn't found
+ *    Base [I] -- What number base is the setting value stored as (sent into
+ *                strtol()).
+ *
+ * FUNCTION:
+ *    This is a helper function for TextLineHighlighter_SetSettingStyleWidgets()
+ *    that tries to find a setting and if it's not found applies a default
+ *    value.
+ *
+ * RETURNS:
+ *    The value that was in settings or 'DefaultValue' if it was not found.
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_SetSettingStyleWidgets()
+ ******************************************************************************/
+static uint32_t TextLineHighlighter_GrabSettingKV(t_PIKVList *Settings,
+        const char *Prefix,const char *Key,uint32_t DefaultValue,int Base)
+{
+    char buff[100];
+    const char *Str;
+    uint32_t Number;
+
+    sprintf(buff,"%s_%s",Prefix,Key);
+    Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+    if(Str!=NULL)
+        Number=strtol(Str,NULL,Base);
+    else
+        Number=DefaultValue;
+
+    return Number;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_UpdateSettingFromStyleWidgets
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_UpdateSettingFromStyleWidgets(
+ *          t_PIKVList *Settings,struct SettingsStylingWidgetsSet *Widgets,
+ *          t_WidgetSysHandle *SysHandle,const char *Prefix);
+ *
+ * PARAMETERS:
+ *    Settings [O] -- The settings to set the data in
+ *    Widgets [I] -- The widgets to read the data from
+ *    SysHandle [I] -- The widget system handle that these widgets where added
+ *                     with.
+ *    Prefix [I] -- The prefix for the styling names in the settings.  This
+ *                  function will take this string and add it to the start
+ *                  of the setting KV name before trying to read it from
+ *                  settings.
+ *
+ * FUNCTION:
+ *    This function takes and reads the values from the widgets and put them
+ *    in 'Settings'.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    
+ ******************************************************************************/
+static void TextLineHighlighter_UpdateSettingFromStyleWidgets(t_PIKVList *Settings,
+        struct SettingsStylingWidgetsSet *Widgets,t_WidgetSysHandle *SysHandle,
+        const char *Prefix)
+{
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"FGColor",
+            m_TLF_UIAPI->GetColorPickValue(SysHandle,Widgets->FgColor->Ctrl),
+            16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"BGColor",
+            m_TLF_UIAPI->GetColorPickValue(SysHandle,Widgets->BgColor->Ctrl),
+            16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribUnderLine",
+            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
+            Widgets->AttribUnderLine->Ctrl),16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribOverLine",
+            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
+            Widgets->AttribOverLine->Ctrl),16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribLineThrough",
+            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
+            Widgets->AttribLineThrough->Ctrl),16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribBold",
+            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
+            Widgets->AttribBold->Ctrl),16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribItalic",
+            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
+            Widgets->AttribItalic->Ctrl),16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribOutLine",
+            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
+            Widgets->AttribOutLine->Ctrl),16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"ULineColorOn",
+            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
+            Widgets->ULineColorOn->Ctrl),16);
+
+    TextLineHighlighter_SetSettingKV(Settings,Prefix,"ULineColor",
+            m_TLF_UIAPI->GetColorPickValue(SysHandle,
+            Widgets->ULineColor->Ctrl),16);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_SetSettingKV
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_SetSettingKV(t_PIKVList *Settings,
+ *              const char *Prefix,const char *Key,uint32_t Value,int Base);
+ *
+ * PARAMETERS:
+ *    Settings [O] -- The settings to set the data in
+ *    Prefix [I] -- The prefix for the styling names in the settings.  This
+ *                  function will take this string and add it to the start
+ *                  of the setting KV name before trying to read it from
+ *                  settings.
+ *    Key [I] -- The key to look for in the settings
+ *    Value [I] -- The value to store
+ *    Base [I] -- What number base is the setting value stored as.
+ *
+ * FUNCTION:
+ *    This is a helper function for
+ *    TextLineHighlighter_UpdateSettingFromStyleWidgets() that sets the value in
+ *    'Settings'.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_UpdateSettingFromStyleWidgets()
+ ******************************************************************************/
+static void TextLineHighlighter_SetSettingKV(t_PIKVList *Settings,
+        const char *Prefix,const char *Key,uint32_t Value,int Base)
+{
+    char buff[100];
+    char buff2[100];
+
+    sprintf(buff,"%s_%s",Prefix,Key);
+    if(Base==10)
+        sprintf(buff2,"%d",Value);
+    else
+        sprintf(buff2,"%06X",Value);
+    m_TLF_SysAPI->KVAddItem(Settings,buff,buff2);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ApplySetting_SetData
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ApplySetting_SetData(t_PIKVList *Settings,
+ *              struct TextLineHighlighter_TextStyle *Style,const char *Prefix,
+ *              uint32_t DefaultStyleSet);
+ *
+ * PARAMETERS:
+ *    Settings [I] -- The settings to read out
+ *    Style [O] -- The style to be set to what is in 'Settings'
+ *    Prefix [I] -- The prefix for the styling names in the settings.  This
+ *                  function will take this string and add it to the start
+ *                  of the setting KV name before trying to read it from
+ *                  settings.
+ *    DefaultStyleSet [I] -- The default colors and style to use if a setting
+ *                           isn't found in settings.
+ *
+ * FUNCTION:
+ *    This function takes the settings in 'Settings' copies / converts then
+ *    to the styling in 'Style'.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    
+ ******************************************************************************/
+static void TextLineHighlighter_ApplySetting_SetData(t_PIKVList *Settings,
+        struct TextLineHighlighter_TextStyle *Style,const char *Prefix,
+        uint32_t DefaultStyleSet)
+{
+    uint32_t Num;
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"FGColor",
+            m_DefaultStyleSets[DefaultStyleSet].FGColor,16);
+    Style->FGColor=Num;
+
+    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"BGColor",
+            m_DefaultStyleSets[DefaultStyleSet].BGColor,16);
+    Style->BGColor=Num;
+
+    Style->Attribs=0;
+    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribUnderLine",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_UNDERLINE,
+            10))
+    {
+        Style->Attribs|=TXT_ATTRIB_UNDERLINE;
+    }
+
+    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOverLine",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OVERLINE,
+            10))
+    {
+        Style->Attribs|=TXT_ATTRIB_OVERLINE;
+    }
+
+    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribLineThrough",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_LINETHROUGH,
+            10))
+    {
+        Style->Attribs|=TXT_ATTRIB_LINETHROUGH;
+    }
+
+    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribBold",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_BOLD,
+            10))
+    {
+        Style->Attribs|=TXT_ATTRIB_BOLD;
+    }
+
+    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribItalic",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_ITALIC,
+            10))
+    {
+        Style->Attribs|=TXT_ATTRIB_ITALIC;
+    }
+
+    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOutLine",
+            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OUTLINE,
+            10))
+    {
+        Style->Attribs|=TXT_ATTRIB_OUTLINE;
+    }
+
+    Style->ULineColorOn=TextLineHighlighter_GrabSettingKV(Settings,Prefix,
+            "ULineColorOn",m_DefaultStyleSets[DefaultStyleSet].ULineColorOn,
+            10)?true:false;
+
+    Style->ULineColor=TextLineHighlighter_GrabSettingKV(Settings,Prefix,
+            "ULineColor",Style->FGColor,16);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ProcessByte
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ProcessByte(
+ *              struct TextLineHighlighterData *Data,uint8_t RawByte);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    RawByte [I] -- The byte that came in
+ *
+ * FUNCTION:
+ *    This function does the work for ProcessIncomingTextByte().  It tracks
+ *    the start of the line and handles the line when we see the end of it
+ *    (see e_LineEndType for what ends a line).
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_HandleLine()
+ ******************************************************************************/
+static void TextLineHighlighter_ProcessByte(struct TextLineHighlighterData *Data,
+        uint8_t RawByte)
+{
+    uint64_t StartTicks;
+    uint64_t EndTicks;
+    uint8_t LastByte;
+
+    TextLineHighlighter_StatAdd(Data->Stats.Bytes,1);
+
+    if(Data->Capture!=NULL)
+        StreamCapture_AddByte(Data->Capture,RawByte,
+                RawByte==Data->LineEndByte);
+
+    /* Color the lines the worker is done with as soon as we can, a host
+       without ProcessIdle() may not give us another line end for a while */
+    if(Data->Async!=NULL && AsyncMatch_HasDoneJobs(Data->Async))
+        TextLineHighlighter_ApplyAsyncResults(Data,false);
+
+    LastByte=Data->LastByte;
+    Data->LastByte=RawByte;
+
+    TextLineHighlighter_PollBatch(Data);
+
+    /* The '\n' of a "\r\n" when '\r' ends the line isn't part of any line */
+    if(Data->LineEnd==e_LineEnd_CR && RawByte=='\n' && LastByte=='\r')
+        return;
+
+    if(!TextLineHighlighter_MarkStartOfLine(Data))
+        return;
+
+    if(TextLineHighlighter_IsLineEnd(Data,RawByte))
+    {
+        if(Data->LineEnd!=e_LineEnd_CRLF || LastByte=='\r')
+        {
+            /* We are at the end of the line, see if it matches anything */
+            StartTicks=PerfTimer_Now();
+            Data->LineEndTicks=StartTicks;
+            Data->LineQueued=false;
+            TextLineHighlighter_HandleLine(Data);
+            EndTicks=PerfTimer_Now();
+            if(!Data->LineQueued)
+                LatencyHist_Record(&Data->LineLatency,EndTicks-StartTicks);
+            if(Data->ShedMax!=e_Shed_Full)
+            {
+                TextLineHighlighter_Governor(Data,EndTicks,
+                        EndTicks-StartTicks);
+            }
+
+            /* A little of the scroll back after each line, so a busy
+               connection still gets it done */
+            if(!Data->RescanMatchers.empty())
+                TextLineHighlighter_RunRescan(Data,RESCAN_LINE_BUDGET_US);
+            return;
+        }
+    }
+
+    if(!Data->EarlyRules.empty())
+        TextLineHighlighter_EarlyCheck(Data,EARLY_CHECK_BYTES);
+
+    if(Data->MaxLineLength!=0 && Data->LineBytes>=Data->MaxLineLength)
+        TextLineHighlighter_HandleLongLine(Data);
+    Data->LineBytes++;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ProcessBlock
+ *
+ * SYNOPSIS:
+ *    static int TextLineHighlighter_ProcessBlock(
+ *              struct TextLineHighlighterData *Data,const uint8_t *Buf,
+ *              int Len);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Buf [I] -- The bytes that came in
+ *    Len [I] -- The number of bytes in 'Buf'
+ *
+ * FUNCTION:
+ *    This function does the work for ProcessIncomingTextBlock().  If the
+ *    block starts with what may be the end of a line we hand it to the
+ *    byte path.  Otherwise we scan for the next end of line (see
+ *    TextLineHighlighter_FindLineEnd()) and take all the bytes before it at
+ *    once (but never past the end of the current window if the line is over
+ *    the max line length).
+ *
+ *    A micro-batch never waits past the end of the block.
+ *
+ * RETURNS:
+ *    The number of bytes handled
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_ProcessByte()
+ ******************************************************************************/
+static int TextLineHighlighter_ProcessBlock(struct TextLineHighlighterData *Data,
+        const uint8_t *Buf,int Len)
+{
+    const uint8_t *EndOfLine;
+    int Run;
+
+    if(Len<=0)
+        return 0;
+
+    if(Data->Async!=NULL && AsyncMatch_HasDoneJobs(Data->Async))
+        TextLineHighlighter_ApplyAsyncResults(Data,false);
+
+    EndOfLine=TextLineHighlighter_FindLineEnd(Data,Buf,Len);
+    if(EndOfLine==Buf)
+    {
+        TextLineHighlighter_ProcessByte(Data,Buf[0]);
+        if(Len==1)
+            TextLineHighlighter_FlushBatch(Data,false);
+        return 1;
+    }
+    Run=EndOfLine!=NULL?EndOfLine-Buf:Len;
+
+    /* The rest of the block is the start of a line, the lines before it
+       can't wait for more bytes that may never come */
+    if(Run==Len)
+        TextLineHighlighter_FlushBatch(Data,false);
+
+    /* The bytes before this block are on the screen now */
+    if(!Data->EarlyRules.empty())
+        TextLineHighlighter_EarlyCheck(Data,EARLY_CHECK_BYTES);
+
+    if(TextLineHighlighter_MarkStartOfLine(Data) && Data->MaxLineLength!=0)
+    {
+        if(Data->LineBytes>=Data->MaxLineLength)
+            TextLineHighlighter_HandleLongLine(Data);
+        if((uint32_t)Run>Data->MaxLineLength-Data->LineBytes)
+            Run=Data->MaxLineLength-Data->LineBytes;
+    }
+    Data->LineBytes+=Run;
+    Data->LastByte=Buf[Run-1];
+
+    TextLineHighlighter_StatAdd(Data->Stats.Bytes,Run);
+
+    if(Data->Capture!=NULL)
+        StreamCapture_AddBlock(Data->Capture,Buf,Run);
+
+    return Run;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_MarkStartOfLine
+ *
+ * SYNOPSIS:
+ *    static inline bool TextLineHighlighter_MarkStartOfLine(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function is called before a byte is added to the screen.  If the
+ *    byte is the first one on a new line it moves the start of line marker
+ *    to it.
+ *
+ * RETURNS:
+ *    true -- We have a start of line marker
+ *    false -- We couldn't allocate the marker
+ ******************************************************************************/
+static inline bool TextLineHighlighter_MarkStartOfLine(
+        struct TextLineHighlighterData *Data)
+{
+    /* If we haven't allocated a marker yet, then we need to (we can't
+       allocate this in the AllocateData() because the m_TLF_DPS API doesn't
+       work in that function) */
+    if(Data->StartOfLineMarker==NULL)
+    {
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,
+                MarkPool_Fill(&Data->Marks,m_TLF_DPS));
+        Data->Stats.Marks.store(Data->Marks.Slots.size(),
+                memory_order_relaxed);
+        Data->StartOfLineMarker=MarkPool_Current(&Data->Marks);
+        if(Data->StartOfLineMarker==NULL)
+            return false;
+        Data->GrabNewMark=true;
+    }
+
+    if(Data->GrabNewMark)
+    {
+        /* New settings can make the pool bigger (it can only grow with
+           nothing retained) */
+        if(Data->Marks.Slots.size()<Data->Marks.Size &&
+                Data->Marks.InUse==0)
+        {
+            TextLineHighlighter_StatAdd(Data->Stats.HostCalls,
+                    MarkPool_Fill(&Data->Marks,m_TLF_DPS));
+            Data->Stats.Marks.store(Data->Marks.Slots.size(),
+                    memory_order_relaxed);
+            Data->StartOfLineMarker=MarkPool_Current(&Data->Marks);
+        }
+
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+        m_TLF_DPS->SetMark2CursorPos(Data->StartOfLineMarker);
+        Data->GrabNewMark=false;
+        Data->LineBytes=0;
+        if(!Data->EarlyRules.empty())
+            TextLineHighlighter_ResetEarly(Data);
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ResetEarly
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ResetEarly(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function forgets what the early rules know about the line (it is
+ *    called at the start of every line).
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_EarlyCheck()
+ ******************************************************************************/
+static void TextLineHighlighter_ResetEarly(
+        struct TextLineHighlighterData *Data)
+{
+    size_t e;
+
+    for(e=0;e<Data->EarlyRules.size();e++)
+        Data->EarlyRules[e].State=e_Early_Undecided;
+    Data->EarlyUndecided=Data->EarlyRules.size();
+    Data->EarlyMatched=0;
+    Data->EarlyCheckedBytes=0;
+    Data->EarlyAskedBytes=0;
+    Data->EarlyWholeLines=0;
+    Data->EarlyApplied.clear();
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_EarlyCheck
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_EarlyCheck(
+ *              struct TextLineHighlighterData *Data,uint32_t MinNewBytes);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    MinNewBytes [I] -- Don't do anything unless at least this many bytes
+ *                       of the line have come in since the last time
+ *
+ * FUNCTION:
+ *    This function styles the part of the current line that is on the
+ *    screen with the rules that are already sure to match, so on a slow
+ *    link the user doesn't have to wait for the end of the line.
+ *
+ *    Only the starts with and contains rules are used.  A starts with rule
+ *    is decided (one way or the other) once the line is as long as its
+ *    string, and a contains rule as soon as its string turns up.  The host
+ *    is only asked for the line when new bytes have come in that could
+ *    decide one of the rules that are left, and then only for the new
+ *    bytes (and enough before them for a contains string that crosses
+ *    over).
+ *
+ *    A rule's style is applied when it is decided and goes through the
+ *    rule and connection style limits like any other style.  The early
+ *    styles of later rules that it overlaps are applied again on top so
+ *    they stack in rule order.  The styles of the rules that style the
+ *    whole line are then stretched over the new bytes each time we get
+ *    here (see TextLineHighlighter_EarlyExtend()).
+ *
+ *    What is decided here is final.  The end of line still runs all the
+ *    rules, but TextLineHighlighter_RunRules() doesn't style over the
+ *    bytes the early styles cover.
+ *
+ *    Nothing is done on a long line once it has gone past the max line
+ *    length (the windows are checked as they fill up) or when the load
+ *    shedding governor is sampling lines or has paused.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_ResetEarly(), TextLineHighlighter_HandleLine()
+ ******************************************************************************/
+static void TextLineHighlighter_EarlyCheck(
+        struct TextLineHighlighterData *Data,uint32_t MinNewBytes)
+{
+    struct TextLineHighlighter_EarlyRule *Early;
+    struct TextLineHighlighter_EarlyStyle *Style;
+    const struct LineMatchRule *Rule;
+    const uint8_t *Line;
+    const uint8_t *Found;
+    uint32_t From;
+    uint32_t Need;
+    uint32_t Bytes;
+    uint32_t StrLen;
+    uint32_t MinLen;
+    uint32_t OverStart;
+    uint32_t OverEnd;
+    size_t e;
+    size_t a;
+
+    if(Data->GrabNewMark || Data->LineWindowed ||
+            Data->StartOfLineMarker==NULL ||
+            Data->LineBytes<Data->EarlyAskedBytes+MinNewBytes ||
+            Data->LineBytes==Data->EarlyAskedBytes ||
+            Data->ShedLevel>=e_Shed_Sample)
+    {
+        return;
+    }
+
+    /* Only ask for what the undecided rules haven't looked at yet (and
+       not at all if the line is still too short to decide any of them) */
+    From=Data->LineBytes;
+    MinLen=UINT32_MAX;
+    for(e=0;e<Data->EarlyRules.size() && Data->EarlyUndecided>0;e++)
+    {
+        Early=&Data->EarlyRules[e];
+        if(Early->State!=e_Early_Undecided)
+            continue;
+        Rule=&Data->Rules[Early->Rule];
+        StrLen=Rule->Literal.length();
+        if(StrLen<MinLen)
+            MinLen=StrLen;
+        Need=0;
+        if(Rule->Type==e_LineMatchRule_Contains &&
+                Data->EarlyCheckedBytes>=StrLen)
+        {
+            Need=Data->EarlyCheckedBytes-(StrLen-1);
+        }
+        if(Need<From)
+            From=Need;
+    }
+    if(Data->LineBytes<MinLen)
+    {
+        if(Data->EarlyWholeLines>0)
+        {
+            Data->EarlyAskedBytes=Data->LineBytes;
+            TextLineHighlighter_EarlyExtend(Data,Data->LineBytes,false);
+        }
+        return;
+    }
+
+    Data->EarlyAskedBytes=Data->LineBytes;
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+    Line=m_TLF_DPS->GetMarkString(Data->StartOfLineMarker,&Bytes,From,
+            Data->LineBytes-From);
+    if(Line==NULL)
+        return;
+
+    /* The older styles go under the ones decided now */
+    TextLineHighlighter_EarlyExtend(Data,From+Bytes,false);
+
+    for(e=0;e<Data->EarlyRules.size();e++)
+    {
+        Early=&Data->EarlyRules[e];
+        if(Early->State!=e_Early_Undecided)
+            continue;
+        Rule=&Data->Rules[Early->Rule];
+        StrLen=Rule->Literal.length();
+
+        if(Rule->Type==e_LineMatchRule_StartsWith)
+        {
+            /* 'From' is always 0 while a starts with is undecided */
+            if(Bytes<StrLen)
+                continue;
+            Early->State=e_Early_NoMatch;
+            if(LineMatch_StartsWith(Line,Bytes,Rule->Literal.c_str(),StrLen))
+            {
+                Early->State=e_Early_Match;
+                Early->Start=0;
+                Early->Len=StrLen;
+            }
+        }
+        else
+        {
+            Need=0;
+            if(Data->EarlyCheckedBytes>=StrLen)
+                Need=Data->EarlyCheckedBytes-(StrLen-1)-From;
+            if(Need>Bytes)
+                continue;
+            Found=LineMatch_FindContains(Line+Need,Bytes-Need,
+                    Rule->Literal.c_str(),StrLen);
+            if(Found==NULL)
+                continue;
+            Early->State=e_Early_Match;
+            Early->Start=From+(Found-Line);
+            Early->Len=StrLen;
+        }
+
+        Data->EarlyUndecided--;
+        if(Early->State!=e_Early_Match)
+            continue;
+        Data->EarlyMatched++;
+
+        /* The rule limit is only checked once a line, so the end of line
+           goes by what we decided here */
+        Early->Allowed=TextLineHighlighter_RuleStyleAllowed(Data,
+                Early->Rule);
+        if(!Early->Allowed || !TextLineHighlighter_ConStyleAllowed(Data,1))
+            continue;
+
+        if(!Rule->MatchSpan)
+        {
+            Early->Start=0;
+            Early->Len=From+Bytes;
+            Data->EarlyWholeLines++;
+        }
+        TextLineHighlighter_ApplyStyleSet2Marker(Data,Data->StartOfLineMarker,
+                Rule->StyleIndex,Early->Start,Early->Len);
+
+        if(Data->EarlyApplied.empty())
+            TextLineHighlighter_StatAdd(Data->Stats.EarlyLines,1);
+
+        /* Keep them in rule order, the later rules go back on top */
+        for(a=0;a<Data->EarlyApplied.size();a++)
+        {
+            if(Data->EarlyApplied[a].Rule>Early->Rule)
+                break;
+        }
+        Style=&*Data->EarlyApplied.emplace(Data->EarlyApplied.begin()+a);
+        Style->Rule=Early->Rule;
+        Style->Start=Early->Start;
+        Style->End=Early->Start+Early->Len;
+        Style->StyleIndex=Rule->StyleIndex;
+        Style->WholeLine=!Rule->MatchSpan;
+        for(a++;a<Data->EarlyApplied.size();a++)
+        {
+            Style=&Data->EarlyApplied[a];
+            OverStart=Style->Start>Early->Start?Style->Start:Early->Start;
+            OverEnd=Style->End<Early->Start+Early->Len?Style->End:
+                    Early->Start+Early->Len;
+            if(OverStart>=OverEnd)
+                continue;
+            if(!TextLineHighlighter_ConStyleAllowed(Data,1))
+                break;
+            TextLineHighlighter_ApplyStyleSet2Marker(Data,
+                    Data->StartOfLineMarker,Style->StyleIndex,OverStart,
+                    OverEnd-OverStart);
+        }
+    }
+    Data->EarlyCheckedBytes=From+Bytes;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_EarlyExtend
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_EarlyExtend(
+ *              struct TextLineHighlighterData *Data,uint32_t Bytes,
+ *              bool ToCursor);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Bytes [I] -- How much of the line is on the screen
+ *    ToCursor [I] -- Style all the way to the cursor (so the '\r' of a
+ *                    "\r\n" that the rules don't see gets it too)
+ *
+ * FUNCTION:
+ *    This function stretches the early styles that style the whole line
+ *    over the bytes that came in since they were last applied.  They are
+ *    applied in rule order so they stack the same way they do on the rest
+ *    of the line.
+ *
+ *    The new styles go through the connection style limit.  If it is over
+ *    the limit they are left for the next time (when they cover the bytes
+ *    they missed as well).
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_EarlyCheck(), TextLineHighlighter_RunRules()
+ ******************************************************************************/
+static void TextLineHighlighter_EarlyExtend(
+        struct TextLineHighlighterData *Data,uint32_t Bytes,bool ToCursor)
+{
+    struct TextLineHighlighter_EarlyStyle *Style;
+    uint32_t Styles;
+    size_t a;
+
+    Styles=0;
+    for(a=0;a<Data->EarlyApplied.size();a++)
+    {
+        Style=&Data->EarlyApplied[a];
+        if(Style->WholeLine && Style->End<Bytes)
+            Styles++;
+    }
+    if(Styles==0 || !TextLineHighlighter_ConStyleAllowed(Data,Styles))
+        return;
+
+    for(a=0;a<Data->EarlyApplied.size();a++)
+    {
+        Style=&Data->EarlyApplied[a];
+        if(!Style->WholeLine || Style->End>=Bytes)
+            continue;
+        TextLineHighlighter_ApplyStyleSet2Marker(Data,Data->StartOfLineMarker,
+                Style->StyleIndex,Style->End,ToCursor?0:Bytes-Style->End);
+        Style->End=Bytes;
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_EarlyCovers
+ *
+ * SYNOPSIS:
+ *    static bool TextLineHighlighter_EarlyCovers(
+ *              struct TextLineHighlighterData *Data,
+ *              const struct LineMatchInterval *Interval);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Interval [I] -- The interval (from 'Data->Spans') to be styled
+ *
+ * FUNCTION:
+ *    This function checks if an interval at the end of a line is under
+ *    one of the styles TextLineHighlighter_EarlyCheck() applied.  The early
+ *    styles are in 'Data->Spans' as well, so an interval is always all in
+ *    or all out of each of them.
+ *
+ * RETURNS:
+ *    true -- The interval already has its (final) early styles
+ *    false -- The interval still has to be styled
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_RunRules()
+ ******************************************************************************/
+static bool TextLineHighlighter_EarlyCovers(
+        struct TextLineHighlighterData *Data,
+        const struct LineMatchInterval *Interval)
+{
+    const struct TextLineHighlighter_EarlyStyle *Style;
+    size_t a;
+
+    for(a=0;a<Data->EarlyApplied.size();a++)
+    {
+        Style=&Data->EarlyApplied[a];
+        if(Style->Start<=Interval->Start && Style->End>Interval->Start)
+            return true;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_HandleLine
+ *
+ * SYNOPSIS:
+ *    void TextLineHighlighter_HandleLine(struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function handles when we finish reading a line.  It will check
+ *    for any matches and color the line as needed.
+ *
+ *    If the line went over the max line length only the last window is
+ *    left to check (see TextLineHighlighter_HandleLongLine()).  Long lines
+ *    are never part of a multi-line record and are never given to the
+ *    worker thread or put in a micro-batch.
+ *
+ *    Load shedding (see TextLineHighlighter_Governor()) can skip any line
+ *    that isn't part of a record.  Lines are shed before they would go to
+ *    the worker thread, so a connection that floods the worker backs off
+ *    too.
+ *
+ *    It will then reset the mark.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_CheckLine(), TextLineHighlighter_HandleRecordLine()
+ ******************************************************************************/
+static void TextLineHighlighter_HandleLine(struct TextLineHighlighterData *Data)
+{
+    const uint8_t *Line;
+    uint32_t Bytes;
+    uint32_t Len;
+
+    Data->ShedLineChecked=false;
+    if(Data->StartOfLineMarker==NULL)
+        return;
+
+    TextLineHighlighter_StatAdd(Data->Stats.Lines,1);
+    if(Data->LineWindowed)
+        TextLineHighlighter_StatAdd(Data->Stats.LongLines,1);
+
+    if(Data->RecordMode && !Data->LineWindowed)
+    {
+        Data->ShedLineChecked=true;
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+        Line=m_TLF_DPS->GetMarkString(Data->StartOfLineMarker,&Bytes,0,0);
+        if(Line==NULL)
+        {
+            TextLineHighlighter_EndRecord(Data);
+        }
+        else
+        {
+            Len=TextLineHighlighter_TrimLineEnd(Data,Line,Bytes,0);
+            if(!TextLineHighlighter_HandleRecordLine(Data,Line,Len,Bytes))
+                TextLineHighlighter_RunRules(Data,Line,Len,0,false);
+        }
+    }
+    else if(TextLineHighlighter_ShedLine(Data))
+    {
+        TextLineHighlighter_StatAdd(Data->Stats.ShedLines,1);
+    }
+    else if(Data->Async!=NULL && !Data->LineWindowed)
+    {
+        TextLineHighlighter_QueueLine(Data);
+    }
+    else if(!Data->Batch.empty() && !Data->LineWindowed)
+    {
+        TextLineHighlighter_BatchLine(Data);
+    }
+    else
+    {
+        /* Keep the styles in the order the lines came in */
+        TextLineHighlighter_FlushBatch(Data,false);
+
+        if(Data->InRecord)
+            TextLineHighlighter_EndRecord(Data);
+
+        TextLineHighlighter_CheckLine(Data,0,
+                Data->LineWindowed?LINEMATCH_NOT_LINE_START:0,false);
+    }
+
+    /* Ok, reset the mark */
+    Data->GrabNewMark=true;
+    Data->LineWindowed=false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_HandleLongLine
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_HandleLongLine(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function is called when the current line reaches the max line
+ *    length without an end of line.  It checks the window we have (the
+ *    bytes from the marker to the cursor) and then moves the marker up so
+ *    the next window starts LINE_WINDOW_OVERLAP bytes before the cursor.
+ *    This keeps the most we ever ask the host for (and the time it takes to
+ *    check) to the max line length, no matter how long the line gets.
+ *
+ *    The rule at the window edges is:
+ *      - Windows overlap by LINE_WINDOW_OVERLAP bytes, so anything up to
+ *        LINE_WINDOW_OVERLAP+1 bytes long that crosses the edge of a window
+ *        is found whole in one of them.  Longer matches that cross an edge
+ *        are not found.
+ *      - "Starts with" is only checked on the first window and "ends with"
+ *        only on the last one.  Regex '^' only matches in the first window
+ *        and '$' only in the last.
+ *      - A rule that styles the whole line styles the window it matched in
+ *        (and only that window).
+ *      - Something that is wholly in the overlap may be styled twice (with
+ *        the same style).
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_HandleLine()
+ ******************************************************************************/
+static void TextLineHighlighter_HandleLongLine(struct TextLineHighlighterData *Data)
+{
+    uint32_t Flags;
+
+    Flags=LINEMATCH_NOT_LINE_END;
+    if(Data->LineWindowed)
+        Flags|=LINEMATCH_NOT_LINE_START;
+    else
+        TextLineHighlighter_FlushBatch(Data,false);
+    Data->LineWindowed=true;
+
+    if(Data->LineBytes>LINE_WINDOW_OVERLAP &&
+            Data->ShedLevel!=e_Shed_Pause &&
+            TextLineHighlighter_CheckLine(Data,Data->LineBytes,Flags,false))
+    {
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+        m_TLF_DPS->MoveMark(Data->StartOfLineMarker,
+                Data->LineBytes-LINE_WINDOW_OVERLAP);
+        Data->LineBytes=LINE_WINDOW_OVERLAP;
+        if(!Data->EarlyRules.empty())
+            TextLineHighlighter_ResetEarly(Data);
+        return;
+    }
+
+    /* The host couldn't give us the window (or the max got smaller than the
+       overlap, or highlighting is paused), so just start a new window at
+       the cursor */
+    Data->GrabNewMark=true;
+    TextLineHighlighter_MarkStartOfLine(Data);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_CheckLine
+ *
+ * SYNOPSIS:
+ *    static bool TextLineHighlighter_CheckLine(
+ *              struct TextLineHighlighterData *Data,uint32_t Len,
+ *              uint32_t Flags,bool SimpleOnly);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Len [I] -- The number of bytes from the marker to check (0 = to the
+ *               cursor)
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* flags if this is only part of a line
+ *    SimpleOnly [I] -- Skip the regex rules
+ *
+ * FUNCTION:
+ *    This function gets the bytes from the start of line marker from the
+ *    host and runs the rules on them.
+ *
+ * RETURNS:
+ *    true -- The bytes were checked
+ *    false -- We couldn't get the bytes from the host
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_RunRules()
+ ******************************************************************************/
+static bool TextLineHighlighter_CheckLine(struct TextLineHighlighterData *Data,
+        uint32_t Len,uint32_t Flags,bool SimpleOnly)
+{
+    const uint8_t *Line;
+    uint32_t Bytes;
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+    Line=m_TLF_DPS->GetMarkString(Data->StartOfLineMarker,&Bytes,0,Len);
+    if(Line==NULL)
+    {
+        Data->GrabNewMark=true;
+        return false;
+    }
+
+    TextLineHighlighter_RunRules(Data,Line,
+            TextLineHighlighter_TrimLineEnd(Data,Line,Bytes,Flags),Flags,
+            SimpleOnly);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_RunRules
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_RunRules(
+ *              struct TextLineHighlighterData *Data,const uint8_t *Line,
+ *              uint32_t Bytes,uint32_t Flags,bool SimpleOnly);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Line [I] -- The bytes from the start of line marker
+ *    Bytes [I] -- The number of bytes in 'Line' (without the end of line)
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* flags if this is only part of a line
+ *    SimpleOnly [I] -- Skip the regex rules
+ *
+ * FUNCTION:
+ *    This function runs the rules on the bytes from the start of line
+ *    marker and applies the styles.
+ *
+ *    Each rule that matches adds its spans (the whole line, just what it
+ *    matched or its capture groups) to 'Data->Spans'.  Once all the rules
+ *    have run the spans are merged and the styles are applied to each
+ *    interval in rule order, so later rules still win over earlier ones
+ *    where they overlap.
+ *
+ *    Regex rules are skipped while the load shedding governor has backed
+ *    off to e_Shed_SkipRegex or past it (or if 'SimpleOnly' is set).  A rule
+ *    that is over its style limit has its spans taken back out, and nothing
+ *    is applied if the connection is over its style limit.
+ *
+ *    The styles TextLineHighlighter_EarlyCheck() applied to the line are
+ *    final.  The whole line ones are stretched to the end of the line and
+ *    nothing else is applied over the bytes they cover (so a later rule
+ *    can't change what was decided).  A rule it decided has already been
+ *    checked against its style limit.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_CheckLine()
+ ******************************************************************************/
+static void TextLineHighlighter_RunRules(struct TextLineHighlighterData *Data,
+        const uint8_t *Line,uint32_t Bytes,uint32_t Flags,bool SimpleOnly)
+{
+    unsigned int r;
+    struct TextLineHighlighter_RuleStats *Stats;
+    const struct LineMatchRule *Rule;
+    const struct LineMatchInterval *Interval;
+    const struct TextLineHighlighter_EarlyRule *Early;
+    bool TimeIt;
+    bool Hit;
+    bool Allowed;
+    uint64_t StartTicks;
+    uint64_t Ticks;
+    size_t SpanCount;
+    size_t e;
+    size_t i;
+    uint32_t s;
+    uint32_t Styles;
+
+    TimeIt=(Data->Stats.Lines.load(memory_order_relaxed)%
+            STATS_TIME_SAMPLE_RATE)==0;
+    LineMatch_ClearSpans(&Data->Spans);
+    e=0;
+    for(r=0;r<Data->Rules.size();r++)
+    {
+        Rule=&Data->Rules[r];
+        if(Rule->Type==e_LineMatchRule_Regex &&
+                (SimpleOnly || Data->ShedLevel>=e_Shed_SkipRegex))
+        {
+            continue;
+        }
+        Stats=&Data->RuleStats[r];
+        TextLineHighlighter_StatAdd(Stats->Evaluations,1);
+        SpanCount=Data->Spans.Spans.size();
+        if(TimeIt)
+        {
+            StartTicks=PerfTimer_Now();
+            Hit=LineMatch_RunRule(Rule,Line,Bytes,Flags,&Data->Spans);
+            Ticks=PerfTimer_Now()-StartTicks;
+
+            TextLineHighlighter_StatAdd(Stats->TimedEvaluations,1);
+            TextLineHighlighter_StatAdd(Stats->TotalTicks,Ticks);
+            if(Ticks>Stats->MaxTicks.load(memory_order_relaxed))
+                Stats->MaxTicks.store(Ticks,memory_order_relaxed);
+        }
+        else
+        {
+            Hit=LineMatch_RunRule(Rule,Line,Bytes,Flags,&Data->Spans);
+        }
+
+        if(Hit)
+        {
+            TextLineHighlighter_StatAdd(Stats->Hits,1);
+
+            /* Both are in rule order */
+            Early=NULL;
+            if(Data->EarlyMatched>0)
+            {
+                while(e<Data->EarlyRules.size() &&
+                        Data->EarlyRules[e].Rule<r)
+                {
+                    e++;
+                }
+                if(e<Data->EarlyRules.size() &&
+                        Data->EarlyRules[e].Rule==r &&
+                        Data->EarlyRules[e].State==e_Early_Match)
+                {
+                    Early=&Data->EarlyRules[e];
+                }
+            }
+
+            if(Early!=NULL)
+                Allowed=Early->Allowed;
+            else
+                Allowed=TextLineHighlighter_RuleStyleAllowed(Data,r);
+            if(!Allowed)
+                Data->Spans.Spans.resize(SpanCount);
+        }
+    }
+
+    LineMatch_MergeSpans(&Data->Spans);
+
+    Styles=Data->Spans.Styles.size();
+    if(!Data->EarlyApplied.empty())
+    {
+        /* A whole line style that couldn't be stretched (over the style
+           limit) is styled with the rest of the line in rule order */
+        TextLineHighlighter_EarlyExtend(Data,Data->LineBytes,true);
+        for(i=Data->EarlyApplied.size();i>0;i--)
+        {
+            if(Data->EarlyApplied[i-1].WholeLine &&
+                    Data->EarlyApplied[i-1].End<Bytes)
+            {
+                Data->EarlyApplied.erase(Data->EarlyApplied.begin()+i-1);
+            }
+        }
+
+        for(i=0;i<Data->Spans.Intervals.size();i++)
+        {
+            Interval=&Data->Spans.Intervals[i];
+            if(TextLineHighlighter_EarlyCovers(Data,Interval))
+                Styles-=Interval->StyleCount;
+        }
+    }
+    if(!TextLineHighlighter_ConStyleAllowed(Data,Styles))
+        return;
+
+    for(i=0;i<Data->Spans.Intervals.size();i++)
+    {
+        Interval=&Data->Spans.Intervals[i];
+        if(!Data->EarlyApplied.empty() &&
+                TextLineHighlighter_EarlyCovers(Data,Interval))
+        {
+            continue;
+        }
+        for(s=0;s<Interval->StyleCount;s++)
+        {
+            /* All the bytes are sent as 0,0 (to the cursor, which is always
+               the end of what we checked, plus any '\r' we left off) */
+            if(Interval->Start==0 && Interval->End==Bytes)
+            {
+                TextLineHighlighter_ApplyStyleSet2Marker(Data,
+                        Data->StartOfLineMarker,
+                        Data->Spans.Styles[Interval->FirstStyle+s],0,0);
+            }
+            else
+            {
+                TextLineHighlighter_ApplyStyleSet2Marker(Data,
+                        Data->StartOfLineMarker,
+                        Data->Spans.Styles[Interval->FirstStyle+s],
+                        Interval->Start,Interval->End-Interval->Start);
+            }
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_TrimLineEnd
+ *
+ * SYNOPSIS:
+ *    static inline uint32_t TextLineHighlighter_TrimLineEnd(
+ *              struct TextLineHighlighterData *Data,const uint8_t *Line,
+ *              uint32_t Bytes,uint32_t Flags);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Line [I] -- The bytes from the start of line marker
+ *    Bytes [I] -- The number of bytes in 'Line'
+ *    Flags [I] -- LINEMATCH_NOT_LINE_* flags if this is only part of a line
+ *
+ * FUNCTION:
+ *    This function works out how many bytes of the line the rules should
+ *    see.  The end of line isn't on the screen yet, but the '\r' of a
+ *    "\r\n" is.  We leave it out so the rules see the same line for both
+ *    (without copying the line).
+ *
+ * RETURNS:
+ *    The number of bytes the rules should see
+ ******************************************************************************/
+static inline uint32_t TextLineHighlighter_TrimLineEnd(
+        struct TextLineHighlighterData *Data,const uint8_t *Line,
+        uint32_t Bytes,uint32_t Flags)
+{
+    if(!(Flags&LINEMATCH_NOT_LINE_END) && Bytes>0 && Line[Bytes-1]=='\r' &&
+            (Data->LineEnd==e_LineEnd_LF || Data->LineEnd==e_LineEnd_CRLF))
+    {
+        return Bytes-1;
+    }
+    return Bytes;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_HandleRecordLine
+ *
+ * SYNOPSIS:
+ *    static bool TextLineHighlighter_HandleRecordLine(
+ *              struct TextLineHighlighterData *Data,const uint8_t *Line,
+ *              uint32_t Len,uint32_t Bytes);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Line [I] -- The line (from the start of line marker)
+ *    Len [I] -- The number of bytes in 'Line' the rules should see
+ *    Bytes [I] -- The number of bytes in 'Line' on the screen
+ *
+ * FUNCTION:
+ *    This function handles a line when multi-line records are on.
+ *
+ *    A record starts with a line that matches the record start regex and
+ *    goes on for as long as the lines are continuation lines (indented or
+ *    starting with the prefix).  The first line that isn't ends the record,
+ *    it is then checked like any other line (it may start the next
+ *    record).
+ *
+ *    The rules see the record one line at a time as the lines come in, and
+ *    a rule is not checked again once it has matched, so a long record
+ *    isn't checked over and over.  "Starts with" is only checked on the
+ *    first line and "ends with" on the last.  Every rule that matched the
+ *    record styles all the lines in it (match only and capture group
+ *    styles are only used outside of records).
+ *
+ *    The styles are applied when the record ends.  If the record gets to
+ *    'RecordMaxLines' lines (or we can't get a mark) it is styled then
+ *    and the rest of its lines get the same styles as they come in.
+ *
+ * RETURNS:
+ *    true -- The line was part of a record
+ *    false -- The line isn't part of a record, check it normally
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_AddRecordLine(), TextLineHighlighter_EndRecord()
+ ******************************************************************************/
+static bool TextLineHighlighter_HandleRecordLine(
+        struct TextLineHighlighterData *Data,const uint8_t *Line,
+        uint32_t Len,uint32_t Bytes)
+{
+    bool Continuation;
+
+    if(Data->InRecord)
+    {
+        if(Data->RecordCont==e_RecordCont_Prefix)
+        {
+            Continuation=LineMatch_StartsWith(Line,Len,
+                    Data->RecordPrefix.c_str(),Data->RecordPrefix.length());
+        }
+        else
+        {
+            Continuation=Len>0 && (Line[0]==' ' || Line[0]=='\t');
+        }
+
+        if(Continuation)
+        {
+            if(Data->RecordCommitted)
+            {
+                TextLineHighlighter_ApplyRecordStyles(Data,
+                        Data->StartOfLineMarker,0);
+            }
+            else
+            {
+                TextLineHighlighter_AddRecordLine(Data,Line,Len,Bytes);
+            }
+            return true;
+        }
+
+        TextLineHighlighter_EndRecord(Data);
+    }
+
+    if(!LineMatch_TestRule(&Data->RecordStart[0],Line,Len,0))
+        return false;
+
+    TextLineHighlighter_StatAdd(Data->Stats.Records,1);
+    Data->InRecord=true;
+    Data->RecordCommitted=false;
+    Data->RecordHits.assign(Data->Rules.size(),0);
+    TextLineHighlighter_AddRecordLine(Data,Line,Len,Bytes);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_AddRecordLine
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_AddRecordLine(
+ *              struct TextLineHighlighterData *Data,const uint8_t *Line,
+ *              uint32_t Len,uint32_t Bytes);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Line [I] -- The line (from the start of line marker)
+ *    Len [I] -- The number of bytes in 'Line' the rules should see
+ *    Bytes [I] -- The number of bytes in 'Line' on the screen
+ *
+ * FUNCTION:
+ *    This function adds a line to the current record.  The rules that
+ *    haven't matched the record yet are checked on the line, and the start
+ *    of line marker is kept (we swap in a mark from the pool for the next
+ *    line).
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_HandleRecordLine()
+ ******************************************************************************/
+static void TextLineHighlighter_AddRecordLine(
+        struct TextLineHighlighterData *Data,const uint8_t *Line,
+        uint32_t Len,uint32_t Bytes)
+{
+    const struct LineMatchRule *Rule;
+    t_MarkPoolHandle Handle;
+    unsigned int r;
+
+    for(r=0;r<Data->Rules.size();r++)
+    {
+        if(Data->RecordHits[r]&RECORD_RULE_HIT)
+            continue;
+
+        Rule=&Data->Rules[r];
+        if(Rule->Type==e_LineMatchRule_StartsWith && !Data->RecordMarks.empty())
+            continue;
+
+        TextLineHighlighter_StatAdd(Data->RuleStats[r].Evaluations,1);
+        if(Rule->Type==e_LineMatchRule_EndsWith)
+        {
+            /* We don't know if this is the last line yet */
+            Data->RecordHits[r]=LineMatch_TestRule(Rule,Line,Len,0)?
+                    RECORD_RULE_LAST_LINE_HIT:0;
+        }
+        else if(LineMatch_TestRule(Rule,Line,Len,0))
+        {
+            Data->RecordHits[r]=RECORD_RULE_HIT;
+        }
+    }
+
+    Handle=TextLineHighlighter_RetainLineMark(Data);
+    if(Handle==MARKPOOL_NO_HANDLE)
+    {
+        /* Out of room, style what we have and the rest as it comes in */
+        TextLineHighlighter_EndRecord(Data);
+        TextLineHighlighter_ApplyRecordStyles(Data,Data->StartOfLineMarker,0);
+        Data->InRecord=true;
+        Data->RecordCommitted=true;
+        return;
+    }
+
+    Data->RecordMarks.push_back(Handle);
+    Data->RecordLineBytes.push_back(Bytes);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_EndRecord
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_EndRecord(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function ends the current record.  If the record hasn't been
+ *    styled yet, all of the lines we kept marks for are styled.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_DropRecord()
+ ******************************************************************************/
+static void TextLineHighlighter_EndRecord(struct TextLineHighlighterData *Data)
+{
+    unsigned int r;
+    size_t l;
+
+    if(!Data->InRecord)
+        return;
+
+    if(!Data->RecordCommitted)
+    {
+        for(r=0;r<Data->Rules.size();r++)
+            if(Data->RecordHits[r]!=0)
+                TextLineHighlighter_StatAdd(Data->RuleStats[r].Hits,1);
+
+        for(l=0;l<Data->RecordMarks.size();l++)
+        {
+            /* A 0 length would style to the cursor */
+            if(Data->RecordLineBytes[l]!=0)
+            {
+                TextLineHighlighter_ApplyRecordStyles(Data,
+                        MarkPool_GetMark(&Data->Marks,Data->RecordMarks[l]),
+                        Data->RecordLineBytes[l]);
+            }
+        }
+    }
+
+    TextLineHighlighter_DropRecord(Data);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_DropRecord
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_DropRecord(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function forgets the current record (without styling it) and
+ *    puts its marks back in the pool.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_EndRecord()
+ ******************************************************************************/
+static void TextLineHighlighter_DropRecord(struct TextLineHighlighterData *Data)
+{
+    size_t l;
+
+    for(l=0;l<Data->RecordMarks.size();l++)
+        TextLineHighlighter_ReleaseLineMark(Data,Data->RecordMarks[l]);
+    Data->RecordMarks.clear();
+    Data->RecordLineBytes.clear();
+    Data->InRecord=false;
+    Data->RecordCommitted=false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ApplyRecordStyles
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ApplyRecordStyles(
+ *              struct TextLineHighlighterData *Data,t_DataProMark *Mark,
+ *              uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Mark [I] -- The start of the line to style
+ *    Len [I] -- The number of bytes to style (0 = to the cursor)
+ *
+ * FUNCTION:
+ *    This function applies the styles of all the rules that matched the
+ *    current record to one of its lines (in rule order).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void TextLineHighlighter_ApplyRecordStyles(
+        struct TextLineHighlighterData *Data,t_DataProMark *Mark,uint32_t Len)
+{
+    unsigned int r;
+    uint32_t Styles;
+
+    Styles=0;
+    for(r=0;r<Data->Rules.size();r++)
+        if(Data->RecordHits[r]!=0)
+            Styles++;
+    if(!TextLineHighlighter_ConStyleAllowed(Data,Styles))
+        return;
+
+    for(r=0;r<Data->Rules.size();r++)
+    {
+        if(Data->RecordHits[r]!=0 &&
+                TextLineHighlighter_RuleStyleAllowed(Data,r))
+        {
+            TextLineHighlighter_ApplyStyleSet2Marker(Data,Mark,
+                    Data->Rules[r].StyleIndex,0,Len);
+        }
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_RetainLineMark
+ *
+ * SYNOPSIS:
+ *    static t_MarkPoolHandle TextLineHighlighter_RetainLineMark(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function keeps the start of line marker for the line that just
+ *    ended and moves 'StartOfLineMarker' on to the next mark in the pool
+ *    (it is pointed at the cursor when the next line starts).
+ *
+ * RETURNS:
+ *    A handle to the kept mark or MARKPOOL_NO_HANDLE if the pool is all in
+ *    use (the start of line marker is left alone).
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_ReleaseLineMark()
+ ******************************************************************************/
+static t_MarkPoolHandle TextLineHighlighter_RetainLineMark(
+        struct TextLineHighlighterData *Data)
+{
+    t_MarkPoolHandle Handle;
+
+    Handle=MarkPool_Retain(&Data->Marks);
+    if(Handle==MARKPOOL_NO_HANDLE)
+        return MARKPOOL_NO_HANDLE;
+
+    Data->StartOfLineMarker=MarkPool_Current(&Data->Marks);
+
+    Data->Stats.MarksInUse.store(Data->Marks.InUse,memory_order_relaxed);
+    if(Data->Marks.InUse>Data->Stats.MarksPeak.load(memory_order_relaxed))
+        Data->Stats.MarksPeak.store(Data->Marks.InUse,memory_order_relaxed);
+
+    return Handle;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ReleaseLineMark
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ReleaseLineMark(
+ *              struct TextLineHighlighterData *Data,t_MarkPoolHandle Handle);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Handle [I] -- The mark to give back (always the oldest one we kept)
+ *
+ * FUNCTION:
+ *    This function gives a mark from TextLineHighlighter_RetainLineMark()
+ *    back to the pool.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_RetainLineMark()
+ ******************************************************************************/
+static void TextLineHighlighter_ReleaseLineMark(
+        struct TextLineHighlighterData *Data,t_MarkPoolHandle Handle)
+{
+    MarkPool_Release(&Data->Marks,Handle);
+    Data->Stats.MarksInUse.store(Data->Marks.InUse,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_QueueLine
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_QueueLine(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function gives the line that just ended to the worker thread.  The
+ *    line is copied in to a job, the start of line marker is retained in
+ *    the pool, and the styles are applied when the job comes back.
+ *
+ *    First any jobs the worker has finished are applied.  If there are
+ *    still 'AsyncMaxLines' lines waiting the worker is too far behind and
+ *    this line is checked here instead (so the styles are never more than
+ *    'AsyncMaxLines' lines behind).  When the worker uses the helper process
+ *    only the simple rules are run here, the same as when the helper has
+ *    failed (a hung helper is what fills up the queue).
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_ApplyAsyncResults()
+ ******************************************************************************/
+static void TextLineHighlighter_QueueLine(struct TextLineHighlighterData *Data)
+{
+    struct AsyncMatchJob *Job;
+    const uint8_t *Line;
+    uint32_t Bytes;
+
+    TextLineHighlighter_ApplyAsyncResults(Data,false);
+
+    Job=AsyncMatch_GetFreeJob(Data->Async);
+    if(Job==NULL || Data->Marks.InUse+1>=Data->Marks.Slots.size())
+    {
+        /* A regex that hung the helper would hang us too */
+        TextLineHighlighter_StatAdd(Data->Stats.AsyncInline,1);
+        if(Data->HelperMode)
+            TextLineHighlighter_StatAdd(Data->Stats.HelperFallback,1);
+        TextLineHighlighter_CheckLine(Data,0,0,Data->HelperMode);
+        return;
+    }
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+    Line=m_TLF_DPS->GetMarkString(Data->StartOfLineMarker,&Bytes,0,0);
+    if(Line==NULL)
+        return;
+
+    Job->Line.assign(Line,Line+Bytes);
+    Job->Len=TextLineHighlighter_TrimLineEnd(Data,Line,Bytes,0);
+    Job->Mark=TextLineHighlighter_RetainLineMark(Data);
+    Job->EndTicks=Data->LineEndTicks;
+    Data->LineQueued=true;
+    AsyncMatch_QueueJob(Data->Async);
+    TextLineHighlighter_StatAdd(Data->Stats.AsyncLines,1);
+    Data->Stats.AsyncQueue.store(AsyncMatch_GetBacklog(Data->Async),
+            memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ApplyAsyncResults
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ApplyAsyncResults(
+ *              struct TextLineHighlighterData *Data,bool Drop);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Drop [I] -- Throw the styles away instead of applying them
+ *
+ * FUNCTION:
+ *    This function applies the styles for the lines the worker thread has
+ *    finished (in the order the lines came in) and releases their marks
+ *    back to the pool.
+ *
+ *    If WhippyTerm has already thrown the line away (it scrolled out of
+ *    the scroll back buffer) the mark isn't valid any more and the styles
+ *    are dropped.
+ *
+ *    The line latency for these lines is recorded here (from the end of
+ *    the line to its styles being applied).  Dropped lines aren't recorded.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_QueueLine()
+ ******************************************************************************/
+static void TextLineHighlighter_ApplyAsyncResults(
+        struct TextLineHighlighterData *Data,bool Drop)
+{
+    struct AsyncMatchJob *Job;
+    t_DataProMark *Mark;
+    unsigned int r;
+    size_t s;
+
+    while((Job=AsyncMatch_GetDoneJob(Data->Async))!=NULL)
+    {
+        Mark=MarkPool_GetMark(&Data->Marks,Job->Mark);
+
+        /* The worker is stopped before the rules change, so the hits always
+           line up with the rule stats */
+        for(r=0;r<Job->Hits.size() && r<Data->RuleStats.size();r++)
+        {
+            if(Job->Fallback && Data->Rules[r].Type==e_LineMatchRule_Regex)
+                continue;
+            TextLineHighlighter_StatAdd(Data->RuleStats[r].Evaluations,1);
+            if(Job->Hits[r])
+                TextLineHighlighter_StatAdd(Data->RuleStats[r].Hits,1);
+        }
+        if(Job->Stolen)
+            TextLineHighlighter_StatAdd(Data->Stats.AsyncSteals,1);
+        if(Job->Fallback)
+            TextLineHighlighter_StatAdd(Data->Stats.HelperFallback,1);
+
+        if(!Drop && !Job->Styles.empty())
+        {
+            TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+            if(Mark==NULL || !m_TLF_DPS->IsMarkValid(Mark))
+            {
+                TextLineHighlighter_StatAdd(Data->Stats.AsyncStale,1);
+            }
+            else if(TextLineHighlighter_ConStyleAllowed(Data,
+                    Job->Styles.size()))
+            {
+                for(s=0;s<Job->Styles.size();s++)
+                {
+                    TextLineHighlighter_ApplyStyleSet2Marker(Data,Mark,
+                            Job->Styles[s].StyleIndex,Job->Styles[s].Offset,
+                            Job->Styles[s].Len);
+                }
+            }
+        }
+
+        if(!Drop)
+        {
+            LatencyHist_Record(&Data->LineLatency,
+                    PerfTimer_Now()-Job->EndTicks);
+        }
+
+        TextLineHighlighter_ReleaseLineMark(Data,Job->Mark);
+        AsyncMatch_FreeJob(Data->Async);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_StopAsync
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_StopAsync(
+ *              struct TextLineHighlighterData *Data,bool Apply);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Apply [I] -- Wait for the worker and apply what it has done (false to
+ *                 just throw it all away)
+ *
+ * FUNCTION:
+ *    This function takes the connection off the worker threads (if it is
+ *    using them) and releases all of its marks back to the pool.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void TextLineHighlighter_StopAsync(struct TextLineHighlighterData *Data,
+        bool Apply)
+{
+    if(Data->Async==NULL)
+        return;
+
+    if(Apply)
+        AsyncMatch_WaitIdle(Data->Async,ASYNC_FLUSH_WAIT_US);
+    AsyncMatch_Stop(Data->Async);
+    TextLineHighlighter_ApplyAsyncResults(Data,!Apply);
+    AsyncMatch_Free(Data->Async);
+    Data->Async=NULL;
+    Data->Stats.AsyncQueue.store(0,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_StartRescan
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_StartRescan(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function starts re-highlighting the scroll back with the current
+ *    rules (if 'Rehighlight' is on and WhippyTerm can give us the scroll
+ *    back).  The lines that have ended so far are split between up to
+ *    RESCAN_MAX_MATCHERS matchers (one for each worker thread) so the
+ *    workers check them at the same time.  The lines are fed to the
+ *    matchers and the styles applied a little at a time by
+ *    TextLineHighlighter_RunRescan().
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_StopRescan(), TextLineHighlighter_RunRescan()
+ ******************************************************************************/
+static void TextLineHighlighter_StartRescan(
+        struct TextLineHighlighterData *Data)
+{
+    struct AsyncMatcher *Async;
+    uint64_t FirstLine;
+    uint64_t EndLine;
+    unsigned int Count;
+    unsigned int m;
+
+    TextLineHighlighter_StopRescan(Data);
+
+    if(Data->Rehighlight==e_Rehighlight_Off || !m_HostHasScrollBack ||
+            Data->Rules.empty())
+    {
+        return;
+    }
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+    m_TLF_DPS->GetScrollBackLines(&FirstLine,&EndLine);
+    if(FirstLine>=EndLine)
+        return;
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+    Data->RescanMark=m_TLF_DPS->AllocateMark();
+    if(Data->RescanMark==NULL)
+        return;
+
+    /* The first one starts the worker pool */
+    Count=1;
+    for(m=0;m<Count;m++)
+    {
+        Async=AsyncMatch_Start(Data->Rules,RESCAN_CHUNK_LINES*2,0);
+        if(Async==NULL)
+            break;
+        try
+        {
+            Data->RescanMatchers.push_back(Async);
+        }
+        catch(...)
+        {
+            AsyncMatch_Free(Async);
+            break;
+        }
+        if(m==0)
+        {
+            Count=AsyncMatch_GetWorkerCount();
+            if(Count>RESCAN_MAX_MATCHERS)
+                Count=RESCAN_MAX_MATCHERS;
+        }
+    }
+    if(Data->RescanMatchers.empty())
+    {
+        TextLineHighlighter_StopRescan(Data);
+        return;
+    }
+
+    if(Data->Rehighlight==e_Rehighlight_Reset)
+    {
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,2);
+        Data->RescanFG=m_TLF_DPS->GetSysDefaultColor(e_DefaultColors_FG);
+        Data->RescanBG=m_TLF_DPS->GetSysDefaultColor(e_DefaultColors_BG);
+    }
+
+    Data->RescanFeed=0;
+    Data->RescanChunkLeft=RESCAN_CHUNK_LINES;
+    Data->RescanNext=FirstLine;
+    Data->RescanEnd=EndLine;
+    Data->Stats.RehighlightTotal.store(EndLine-FirstLine,
+            memory_order_relaxed);
+    Data->Stats.RehighlightLeft.store(EndLine-FirstLine,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_StopRescan
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_StopRescan(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function stops the scroll back re-highlight (if it is running).
+ *    Lines the workers haven't finished are left as they are.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_StartRescan()
+ ******************************************************************************/
+static void TextLineHighlighter_StopRescan(
+        struct TextLineHighlighterData *Data)
+{
+    unsigned int m;
+
+    for(m=0;m<Data->RescanMatchers.size();m++)
+        AsyncMatch_Free(Data->RescanMatchers[m]);
+    Data->RescanMatchers.clear();
+
+    if(Data->RescanMark!=NULL)
+    {
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+        m_TLF_DPS->FreeMark(Data->RescanMark);
+        Data->RescanMark=NULL;
+    }
+
+    Data->RescanNext=0;
+    Data->RescanEnd=0;
+    Data->Stats.RehighlightTotal.store(0,memory_order_relaxed);
+    Data->Stats.RehighlightLeft.store(0,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_RunRescan
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_RunRescan(
+ *              struct TextLineHighlighterData *Data,uint32_t BudgetUS);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    BudgetUS [I] -- About how long we can take (in us)
+ *
+ * FUNCTION:
+ *    This function moves the scroll back re-highlight along.  The styles
+ *    for the lines the workers have finished are applied, and then more
+ *    lines are read from the scroll back and fed to the matchers.  Each
+ *    matcher gets RESCAN_CHUNK_LINES lines in a row before we move on to
+ *    the next one (or less if its jobs are all in use).
+ *
+ *    This is called after each line that ends (with a small budget, so
+ *    live lines aren't held up much) and when WhippyTerm is idle (with a
+ *    bigger one).  We stop early if the budget runs out or all the
+ *    matchers are full.  Once all the lines are done the re-highlight is
+ *    stopped.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_StartRescan(), TextLineHighlighter_ApplyRescanJob()
+ ******************************************************************************/
+static void TextLineHighlighter_RunRescan(struct TextLineHighlighterData *Data,
+        uint32_t BudgetUS)
+{
+    struct AsyncMatcher *Async;
+    struct AsyncMatchJob *Job;
+    const uint8_t *Line;
+    uint64_t StartTicks;
+    uint64_t BudgetNS;
+    uint32_t Bytes;
+    unsigned int Count;
+    unsigned int Full;
+    unsigned int m;
+
+    StartTicks=PerfTimer_Now();
+    BudgetNS=(uint64_t)BudgetUS*1000;
+    Count=Data->RescanMatchers.size();
+
+    /* Apply what the workers have finished */
+    for(m=0;m<Count;m++)
+    {
+        Async=Data->RescanMatchers[m];
+        while((Job=AsyncMatch_GetDoneJob(Async))!=NULL)
+        {
+            TextLineHighlighter_ApplyRescanJob(Data,Job);
+            AsyncMatch_FreeJob(Async);
+            Data->Stats.RehighlightLeft.fetch_sub(1,memory_order_relaxed);
+        }
+        if(PerfTimer_Ticks2NS(PerfTimer_Now()-StartTicks)>=BudgetNS)
+            return;
+    }
+
+    /* Feed them more lines */
+    Full=0;
+    while(Data->RescanNext<Data->RescanEnd && Full<Count)
+    {
+        Async=Data->RescanMatchers[Data->RescanFeed];
+        Job=AsyncMatch_GetFreeJob(Async);
+        if(Job==NULL)
+        {
+            /* This one has all it can take, try the next one */
+            Full++;
+            Data->RescanFeed=(Data->RescanFeed+1)%Count;
+            Data->RescanChunkLeft=RESCAN_CHUNK_LINES;
+            continue;
+        }
+        Full=0;
+
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+        Line=m_TLF_DPS->GetScrollBackLine(Data->RescanNext,&Bytes);
+        if(Line==NULL)
+        {
+            /* It has scrolled out of the scroll back already */
+            Data->RescanNext++;
+            Data->Stats.RehighlightLeft.fetch_sub(1,memory_order_relaxed);
+            continue;
+        }
+
+        /* Like the live lines, only the first window of a long line */
+        if(Data->MaxLineLength!=0 && Bytes>Data->MaxLineLength)
+            Bytes=Data->MaxLineLength;
+        Job->Line.assign(Line,Line+Bytes);
+        if(Bytes>0 && Line[Bytes-1]=='\r')
+            Bytes--;
+        Job->Len=Bytes;
+        Job->Mark=Data->RescanNext++;
+        AsyncMatch_QueueJob(Async);
+
+        if(--Data->RescanChunkLeft==0)
+        {
+            Data->RescanFeed=(Data->RescanFeed+1)%Count;
+            Data->RescanChunkLeft=RESCAN_CHUNK_LINES;
+        }
+
+        if(PerfTimer_Ticks2NS(PerfTimer_Now()-StartTicks)>=BudgetNS)
+            return;
+    }
+
+    if(Data->RescanNext<Data->RescanEnd)
+        return;
+    for(m=0;m<Count;m++)
+        if(AsyncMatch_GetBacklog(Data->RescanMatchers[m])>0)
+            return;
+
+    /* The last of the styles were applied above */
+    TextLineHighlighter_StopRescan(Data);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ApplyRescanJob
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ApplyRescanJob(
+ *              struct TextLineHighlighterData *Data,
+ *              struct AsyncMatchJob *Job);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Job [I] -- The finished job ('Mark' is the scroll back line number)
+ *
+ * FUNCTION:
+ *    This function applies the styles for a scroll back line.  With
+ *    e_Rehighlight_Reset the line is first put back to the default colors
+ *    (with no attribs), whether the new rules matched it or not.  If the
+ *    line has scrolled away it is skipped.
+ *
+ *    The style limits aren't used here, they are for live lines.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_RunRescan()
+ ******************************************************************************/
+static void TextLineHighlighter_ApplyRescanJob(
+        struct TextLineHighlighterData *Data,struct AsyncMatchJob *Job)
+{
+    size_t s;
+
+    if(Job->Styles.empty() && Data->Rehighlight!=e_Rehighlight_Reset)
+    {
+        TextLineHighlighter_StatAdd(Data->Stats.RehighlightLines,1);
+        return;
+    }
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+    if(!m_TLF_DPS->SetMark2ScrollBackLine(Data->RescanMark,Job->Mark))
+        return;
+
+    if(Data->Rehighlight==e_Rehighlight_Reset && !Job->Line.empty())
+    {
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+        m_TLF_DPS->ApplyStyle2Mark(Data->RescanMark,Data->RescanFG,
+                Data->RescanBG,0,0,0,Job->Line.size(),APPLY_STYLE_ATTRIBS|
+                APPLY_STYLE_FGCOLOR|APPLY_STYLE_BGCOLOR);
+    }
+
+    for(s=0;s<Job->Styles.size();s++)
+    {
+        TextLineHighlighter_ApplyStyleSet2Marker(Data,Data->RescanMark,
+                Job->Styles[s].StyleIndex,Job->Styles[s].Offset,
+                Job->Styles[s].Len);
+    }
+    TextLineHighlighter_StatAdd(Data->Stats.RehighlightLines,1);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_BatchLine
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_BatchLine(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function adds the line that just ended to the micro-batch.  The
+ *    line is copied and the start of line marker is retained in the pool.
+ *    When the batch has 'BatchLines' lines (or the first line has waited
+ *    'BatchDelayUS') the whole batch is checked.
+ *
+ *    If the pool has no free marks the batch is checked now and then so is
+ *    this line (on its own).
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_FlushBatch()
+ ******************************************************************************/
+static void TextLineHighlighter_BatchLine(struct TextLineHighlighterData *Data)
+{
+    struct TextLineHighlighter_BatchLine *Entry;
+    const uint8_t *Line;
+    uint32_t Bytes;
+
+    if(Data->Marks.InUse+1>=Data->Marks.Slots.size())
+    {
+        TextLineHighlighter_FlushBatch(Data,false);
+        TextLineHighlighter_CheckLine(Data,0,0,false);
+        return;
+    }
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+    Line=m_TLF_DPS->GetMarkString(Data->StartOfLineMarker,&Bytes,0,0);
+    if(Line==NULL)
+        return;
+
+    if(Data->BatchCount==0)
+        Data->BatchStartTicks=PerfTimer_Now();
+
+    Entry=&Data->Batch[Data->BatchCount];
+    Entry->Line.assign(Line,Line+Bytes);
+    Entry->Len=TextLineHighlighter_TrimLineEnd(Data,Line,Bytes,0);
+    Entry->Mark=TextLineHighlighter_RetainLineMark(Data);
+    Data->BatchCount++;
+
+    if(Data->BatchCount>=Data->Batch.size() ||
+            PerfTimer_Ticks2NS(PerfTimer_Now()-Data->BatchStartTicks)>=
+            (uint64_t)Data->BatchDelayUS*1000)
+    {
+        TextLineHighlighter_FlushBatch(Data,false);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_FlushBatch
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_FlushBatch(
+ *              struct TextLineHighlighterData *Data,bool Drop);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Drop [I] -- Throw the lines away instead of checking them
+ *
+ * FUNCTION:
+ *    This function checks all the lines in the micro-batch, applies their
+ *    styles (in the order the lines came in) and releases their marks.
+ *
+ *    The loops are rule major, each rule is run on every line in the batch
+ *    before moving on to the next rule, so the rule (its regex or string)
+ *    stays in the cache while it is used.  Each line keeps its own spans,
+ *    so the styles come out the same as TextLineHighlighter_RunRules().
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_BatchLine()
+ ******************************************************************************/
+static void TextLineHighlighter_FlushBatch(struct TextLineHighlighterData *Data,
+        bool Drop)
+{
+    struct TextLineHighlighter_BatchLine *Entry;
+    struct TextLineHighlighter_RuleStats *Stats;
+    const struct LineMatchRule *Rule;
+    const struct LineMatchInterval *Interval;
+    t_DataProMark *Mark;
+    bool TimeIt;
+    uint64_t StartTicks;
+    uint64_t Ticks;
+    uint32_t Hits;
+    uint32_t Len;
+    unsigned int r;
+    uint32_t l;
+    size_t SpanCount;
+    size_t i;
+    uint32_t s;
+
+    if(Data->BatchCount==0)
+        return;
+
+    if(!Drop)
+    {
+        TimeIt=(Data->Stats.Batches.load(memory_order_relaxed)%
+                STATS_TIME_SAMPLE_RATE)==0;
+        for(l=0;l<Data->BatchCount;l++)
+            LineMatch_ClearSpans(&Data->Batch[l].Spans);
+
+        for(r=0;r<Data->Rules.size();r++)
+        {
+            Rule=&Data->Rules[r];
+            if(Rule->Type==e_LineMatchRule_Regex &&
+                    Data->ShedLevel>=e_Shed_SkipRegex)
+            {
+                continue;
+            }
+            Stats=&Data->RuleStats[r];
+            Hits=0;
+            StartTicks=TimeIt?PerfTimer_Now():0;
+            for(l=0;l<Data->BatchCount;l++)
+            {
+                Entry=&Data->Batch[l];
+                SpanCount=Entry->Spans.Spans.size();
+                if(LineMatch_RunRule(Rule,Entry->Line.data(),Entry->Len,0,
+                        &Entry->Spans))
+                {
+                    Hits++;
+                    if(!TextLineHighlighter_RuleStyleAllowed(Data,r))
+                        Entry->Spans.Spans.resize(SpanCount);
+                }
+            }
+            if(TimeIt)
+            {
+                /* Max is the average line of the slowest batch */
+                Ticks=PerfTimer_Now()-StartTicks;
+                TextLineHighlighter_StatAdd(Stats->TimedEvaluations,
+                        Data->BatchCount);
+                TextLineHighlighter_StatAdd(Stats->TotalTicks,Ticks);
+                Ticks/=Data->BatchCount;
+                if(Ticks>Stats->MaxTicks.load(memory_order_relaxed))
+                    Stats->MaxTicks.store(Ticks,memory_order_relaxed);
+            }
+            TextLineHighlighter_StatAdd(Stats->Evaluations,Data->BatchCount);
+            TextLineHighlighter_StatAdd(Stats->Hits,Hits);
+        }
+    }
+
+    for(l=0;l<Data->BatchCount;l++)
+    {
+        Entry=&Data->Batch[l];
+        if(!Drop)
+        {
+            LineMatch_MergeSpans(&Entry->Spans);
+            Mark=MarkPool_GetMark(&Data->Marks,Entry->Mark);
+            if(!Entry->Spans.Intervals.empty())
+                TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+            if(Entry->Spans.Intervals.empty() || Mark==NULL ||
+                    !m_TLF_DPS->IsMarkValid(Mark) ||
+                    !TextLineHighlighter_ConStyleAllowed(Data,
+                    Entry->Spans.Styles.size()))
+            {
+                Mark=NULL;
+            }
+
+            for(i=0;Mark!=NULL && i<Entry->Spans.Intervals.size();i++)
+            {
+                Interval=&Entry->Spans.Intervals[i];
+                Len=Interval->End-Interval->Start;
+
+                /* The whole line includes any '\r' the rules didn't see */
+                if(Interval->Start==0 && Interval->End==Entry->Len)
+                    Len=Entry->Line.size();
+
+                for(s=0;s<Interval->StyleCount;s++)
+                {
+                    TextLineHighlighter_ApplyStyleSet2Marker(Data,Mark,
+                            Entry->Spans.Styles[Interval->FirstStyle+s],
+                            Interval->Start,Len);
+                }
+            }
+        }
+        TextLineHighlighter_ReleaseLineMark(Data,Entry->Mark);
+    }
+
+    Data->BatchCount=0;
+    TextLineHighlighter_StatAdd(Data->Stats.Batches,1);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_PollBatch
+ *
+ * SYNOPSIS:
+ *    static inline void TextLineHighlighter_PollBatch(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function is called for every byte on the byte path.  If there is
+ *    a micro-batch waiting it checks if it has waited 'BatchDelayUS' and
+ *    checks it if it has.  This is how the delay is kept on hosts without
+ *    ProcessIncomingTextBlock() (the block path checks the batch at the end
+ *    of every block, and ProcessIdle() when the connection goes quiet).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static inline void TextLineHighlighter_PollBatch(
+        struct TextLineHighlighterData *Data)
+{
+    if(Data->BatchCount==0)
+        return;
+
+    if(PerfTimer_Ticks2NS(PerfTimer_Now()-Data->BatchStartTicks)>=
+            (uint64_t)Data->BatchDelayUS*1000)
+    {
+        TextLineHighlighter_FlushBatch(Data,false);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ShedLine
+ *
+ * SYNOPSIS:
+ *    static bool TextLineHighlighter_ShedLine(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function decides if the line that just ended should be skipped
+ *    because of load shedding.  When the governor is sampling 1 in
+ *    'ShedSample' lines is still checked, when it is paused none are.
+ *
+ * RETURNS:
+ *    true -- Skip the line (don't color it)
+ *    false -- Check the line as normal
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_Governor()
+ ******************************************************************************/
+static bool TextLineHighlighter_ShedLine(struct TextLineHighlighterData *Data)
+{
+    if(Data->ShedLevel<e_Shed_Sample)
+    {
+        Data->ShedLineChecked=true;
+        return false;
+    }
+
+    if(Data->ShedLevel==e_Shed_Pause)
+        return true;
+
+    if(++Data->ShedSampleCount<Data->ShedSample)
+        return true;
+
+    Data->ShedSampleCount=0;
+    Data->ShedLineChecked=true;
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_Governor
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_Governor(
+ *              struct TextLineHighlighterData *Data,uint64_t Now,
+ *              uint64_t Ticks);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Now [I] -- The time the line was done (from PerfTimer_Now())
+ *    Ticks [I] -- How long TextLineHighlighter_HandleLine() took
+ *
+ * FUNCTION:
+ *    This function is the load shedding governor.  It is called at the end
+ *    of every line and every SHED_WINDOW_MS it picks how much checking
+ *    this connection can afford.
+ *
+ *    It keeps the average time to check a line with all the rules and with
+ *    just the simple rules (guessed from the number of regex rules until it
+ *    has been measured).  From these and the number of lines that came in
+ *    during the window it works out the part of the window each level
+ *    would take.  If the current level takes more than 'ShedBudgetPct' it
+ *    goes to the first level that fits (up to 'ShedMax').  It only comes
+ *    back to a lower level once that level fits in half the budget, so it
+ *    recovers by itself when the flood is over without flipping back and
+ *    forth at the edge.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_ShedLine()
+ ******************************************************************************/
+static void TextLineHighlighter_Governor(struct TextLineHighlighterData *Data,
+        uint64_t Now,uint64_t Ticks)
+{
+    uint64_t Cost[e_ShedMAX];
+    uint64_t WindowTicks;
+    uint64_t LineTicks;
+    uint64_t Budget;
+    t_LineMatchRuleList::iterator Rule;
+    unsigned int Simple;
+    int c;
+    int Level;
+
+    Data->ShedWindowLines++;
+    if(Data->ShedLineChecked)
+    {
+        Data->ShedWindowChecked++;
+        Data->ShedWindowTicks+=Ticks;
+    }
+
+    if(Data->ShedWindowStart==0)
+    {
+        Data->ShedWindowStart=Now;
+        return;
+    }
+    WindowTicks=Now-Data->ShedWindowStart;
+    if(PerfTimer_Ticks2NS(WindowTicks)<(uint64_t)SHED_WINDOW_MS*1000000)
+        return;
+
+    /* Update the average for the level we were at */
+    if(Data->ShedWindowChecked>0 && Data->ShedLevel!=e_Shed_Pause)
+    {
+        c=Data->ShedLevel==e_Shed_Full?0:1;
+        LineTicks=Data->ShedWindowTicks/Data->ShedWindowChecked;
+        if(!Data->ShedCostKnown[c])
+        {
+            Data->ShedCost[c]=LineTicks;
+            Data->ShedCostKnown[c]=true;
+        }
+        else
+        {
+            Data->ShedCost[c]=Data->ShedCost[c]-
+                    (Data->ShedCost[c]>>SHED_COST_SHIFT)+
+                    (LineTicks>>SHED_COST_SHIFT);
+        }
+    }
+
+    Cost[e_Shed_Full]=Data->ShedCost[0];
+    if(Data->ShedCostKnown[1])
+    {
+        Cost[e_Shed_SkipRegex]=Data->ShedCost[1];
+    }
+    else
+    {
+        Simple=0;
+        for(Rule=Data->Rules.begin();Rule!=Data->Rules.end();Rule++)
+            if(Rule->Type!=e_LineMatchRule_Regex)
+                Simple++;
+        Cost[e_Shed_SkipRegex]=Data->Rules.empty()?0:
+                Data->ShedCost[0]*Simple/Data->Rules.size();
+    }
+    Cost[e_Shed_Sample]=Cost[e_Shed_SkipRegex]/Data->ShedSample;
+    Cost[e_Shed_Pause]=0;
+
+    /* Part of the window each level would take, times 100 so it can be
+       checked against the budget in percent without dividing */
+    for(c=0;c<e_ShedMAX;c++)
+        Cost[c]*=(uint64_t)Data->ShedWindowLines*100;
+    Budget=WindowTicks*Data->ShedBudgetPct;
+
+    /* Back off to the first level that fits */
+    for(Level=e_Shed_Full;Level<Data->ShedMax;Level++)
+        if(Cost[Level]<=Budget)
+            break;
+
+    if(Level<Data->ShedLevel)
+    {
+        /* Only come back down to a level that fits in half the budget */
+        for(Level=e_Shed_Full;Level<Data->ShedLevel;Level++)
+            if(Cost[Level]*2<=Budget)
+                break;
+    }
+
+    if(Level!=Data->ShedLevel)
+    {
+        Data->ShedLevel=(e_ShedLevelType)Level;
+        Data->ShedSampleCount=0;
+        Data->Stats.ShedLevel.store(Level,memory_order_relaxed);
+    }
+
+    Data->ShedWindowStart=Now;
+    Data->ShedWindowLines=0;
+    Data->ShedWindowChecked=0;
+    Data->ShedWindowTicks=0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ResetGovernor
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ResetGovernor(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function puts the load shedding governor back to checking every
+ *    line with every rule and forgets the line costs (they are for the old
+ *    rules).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void TextLineHighlighter_ResetGovernor(
+        struct TextLineHighlighterData *Data)
+{
+    Data->ShedLevel=e_Shed_Full;
+    Data->ShedLineChecked=false;
+    Data->ShedSampleCount=0;
+    Data->ShedWindowStart=0;
+    Data->ShedWindowLines=0;
+    Data->ShedWindowChecked=0;
+    Data->ShedWindowTicks=0;
+    Data->ShedCost[0]=0;
+    Data->ShedCost[1]=0;
+    Data->ShedCostKnown[0]=false;
+    Data->ShedCostKnown[1]=false;
+    Data->Stats.ShedLevel.store(e_Shed_Full,memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_StyleLimitPass
+ *
+ * SYNOPSIS:
+ *    static bool TextLineHighlighter_StyleLimitPass(
+ *              struct TextLineHighlighterData *Data,
+ *              struct TextLineHighlighter_StyleLimit *Limit,uint32_t Max,
+ *              uint32_t Amount,bool UsePolicy);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Limit [I/O] -- The rule's or the connection's window
+ *    Max [I] -- The most that can go through in a window
+ *    Amount [I] -- How much we want to put through
+ *    UsePolicy [I] -- Use 'StyleLimitPolicy' once we are over 'Max'
+ *                     (otherwise they are always dropped)
+ *
+ * FUNCTION:
+ *    This function checks a style limit.  The window starts over every
+ *    'StyleLimitWindowMS'.  Once 'Max' has gone through the rest are
+ *    dropped (or with e_StyleLimit_EveryNth 1 in 'StyleLimitNth' still
+ *    goes through) until the next window.
+ *
+ * RETURNS:
+ *    true -- Go ahead and style
+ *    false -- Over the limit, don't style
+ ******************************************************************************/
+static bool TextLineHighlighter_StyleLimitPass(
+        struct TextLineHighlighterData *Data,
+        struct TextLineHighlighter_StyleLimit *Limit,uint32_t Max,
+        uint32_t Amount,bool UsePolicy)
+{
+    uint64_t Now;
+
+    Now=PerfTimer_Now();
+    if(Limit->WindowStart==0 || PerfTimer_Ticks2NS(Now-Limit->WindowStart)>=
+            (uint64_t)Data->StyleLimitWindowMS*1000000)
+    {
+        Limit->WindowStart=Now;
+        Limit->Count=0;
+        Limit->Over=0;
+    }
+
+    if(Limit->Count+Amount<=Max)
+    {
+        Limit->Count+=Amount;
+        return true;
+    }
+
+    if(UsePolicy && Data->StyleLimitPolicy==e_StyleLimit_EveryNth &&
+            ++Limit->Over>=Data->StyleLimitNth)
+    {
+        Limit->Over=0;
+        return true;
+    }
+
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_RuleStyleAllowed
+ *
+ * SYNOPSIS:
+ *    static inline bool TextLineHighlighter_RuleStyleAllowed(
+ *              struct TextLineHighlighterData *Data,unsigned int RuleIndex);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    RuleIndex [I] -- The rule that matched
+ *
+ * FUNCTION:
+ *    This function checks if a match of a rule can be styled or if the rule
+ *    is over its style limit (using 'StyleLimitPolicy').  Matches that
+ *    can't are counted in the rule's "Suppressed" statistic.
+ *
+ * RETURNS:
+ *    true -- Style the match
+ *    false -- Leave it
+ ******************************************************************************/
+static inline bool TextLineHighlighter_RuleStyleAllowed(
+        struct TextLineHighlighterData *Data,unsigned int RuleIndex)
+{
+    if(Data->StyleLimitRule==0)
+        return true;
+
+    if(TextLineHighlighter_StyleLimitPass(Data,&Data->RuleLimits[RuleIndex],
+            Data->StyleLimitRule,1,true))
+    {
+        return true;
+    }
+
+    TextLineHighlighter_StatAdd(Data->RuleStats[RuleIndex].Suppressed,1);
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ConStyleAllowed
+ *
+ * SYNOPSIS:
+ *    static inline bool TextLineHighlighter_ConStyleAllowed(
+ *              struct TextLineHighlighterData *Data,uint32_t Styles);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Styles [I] -- The number of styles a line wants applied
+ *
+ * FUNCTION:
+ *    This function checks if a line can have its styles applied or if the
+ *    connection is over its style limit.  A line is styled all or nothing.
+ *    The connection limit always drops (it doesn't use 'StyleLimitPolicy')
+ *    so the number of styles applied a window, and so the time WhippyTerm
+ *    spends styling and repainting, never goes over 'StyleLimitCon'.
+ *
+ * RETURNS:
+ *    true -- Apply the styles
+ *    false -- Leave the line as it is
+ ******************************************************************************/
+static inline bool TextLineHighlighter_ConStyleAllowed(
+        struct TextLineHighlighterData *Data,uint32_t Styles)
+{
+    if(Data->StyleLimitCon==0 || Styles==0)
+        return true;
+
+    if(TextLineHighlighter_StyleLimitPass(Data,&Data->ConLimit,
+            Data->StyleLimitCon,Styles,false))
+    {
+        return true;
+    }
+
+    TextLineHighlighter_StatAdd(Data->Stats.StylesSuppressed,Styles);
+    return false;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ResetStyleLimits
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ResetStyleLimits(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *
+ * FUNCTION:
+ *    This function starts the style limit windows over with one window for
+ *    each rule.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void TextLineHighlighter_ResetStyleLimits(
+        struct TextLineHighlighterData *Data)
+{
+    struct TextLineHighlighter_StyleLimit Empty;
+
+    Empty.WindowStart=0;
+    Empty.Count=0;
+    Empty.Over=0;
+    Data->RuleLimits.assign(Data->Rules.size(),Empty);
+    Data->ConLimit=Empty;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_IsLineEnd
+ *
+ * SYNOPSIS:
+ *    static inline bool TextLineHighlighter_IsLineEnd(
+ *              struct TextLineHighlighterData *Data,uint8_t RawByte);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    RawByte [I] -- The byte to check
+ *
+ * FUNCTION:
+ *    This function checks if a byte can end a line.  For CRLF this is the
+ *    '\n', the caller has to check the byte before it.
+ *
+ * RETURNS:
+ *    true -- This byte can end a line
+ *    false -- It can't
+ ******************************************************************************/
+static inline bool TextLineHighlighter_IsLineEnd(
+        struct TextLineHighlighterData *Data,uint8_t RawByte)
+{
+    if(Data->LineEnd==e_LineEnd_CR)
+        return RawByte=='\r' || RawByte=='\n';
+    return RawByte==Data->LineEndByte;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_FindLineEnd
+ *
+ * SYNOPSIS:
+ *    static inline const uint8_t *TextLineHighlighter_FindLineEnd(
+ *              struct TextLineHighlighterData *Data,const uint8_t *Buf,
+ *              int Len);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Buf [I] -- The bytes to scan
+ *    Len [I] -- The number of bytes in 'Buf'
+ *
+ * FUNCTION:
+ *    This function finds the first byte in a block that can end a line.
+ *
+ *    When there is only one end of line byte we use memchr() (which is
+ *    vectorised in every C lib we care about).  For CR (where '\r' and
+ *    '\n' both end a line) we check 16 bytes at a time with SSE2 when we
+ *    have it, which is one pass instead of two memchr()'s.
+ *
+ * RETURNS:
+ *    A pointer to the first byte that may end the line or NULL if there
+ *    isn't one.
+ *
+ * SEE ALSO:
+ *    TextLineHighlighter_IsLineEnd()
+ ******************************************************************************/
+static inline const uint8_t *TextLineHighlighter_FindLineEnd(
+        struct TextLineHighlighterData *Data,const uint8_t *Buf,int Len)
+{
+    const uint8_t *End;
+#if defined(__SSE2__)
+    __m128i CR;
+    __m128i LF;
+    __m128i Chunk;
+    int Hits;
+#endif
+
+    if(Data->LineEnd!=e_LineEnd_CR)
+        return (const uint8_t *)memchr(Buf,Data->LineEndByte,Len);
+
+    End=Buf+Len;
+#if defined(__SSE2__)
+    CR=_mm_set1_epi8('\r');
+    LF=_mm_set1_epi8('\n');
+    while(End-Buf>=16)
+    {
+        Chunk=_mm_loadu_si128((const __m128i *)Buf);
+        Hits=_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(Chunk,CR),
+                _mm_cmpeq_epi8(Chunk,LF)));
+        if(Hits!=0)
+            return Buf+__builtin_ctz(Hits);
+        Buf+=16;
+    }
+#endif
+    for(;Buf<End;Buf++)
+        if(*Buf=='\r' || *Buf=='\n')
+            return Buf;
+
+    return NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ApplyStyleSet2Marker
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ApplyStyleSet2Marker(struct TextLineHighlighterData *Data,
+ *              t_DataProMark *Mark,int StyleIndex,uint32_t Offset,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Mark [I] -- The mark to style from (normally the start of line marker)
+ *    StyleIndex [I] -- The index of the style to apply.
+ *    Offset [I] -- The number of bytes from the marker to start at
+ *    Len [I] -- The number of bytes to style (0 = to the cursor)
+ *
+ * FUNCTION:
+ *    This function applies a style to part of the line starting at the
+ *    current marker.
+ *
+ *    If WhippyTerm has ApplyStyle2Mark() (DPS_API_VERSION_3) we do it all
+ *    in one call (this is also the only way to set the underline color),
+ *    if not we fall back to the attrib / fg / bg calls.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    
+ ******************************************************************************/
+static void TextLineHighlighter_ApplyStyleSet2Marker(struct TextLineHighlighterData *Data,
+        t_DataProMark *Mark,int StyleIndex,uint32_t Offset,uint32_t Len)
+{
+    const struct TextLineHighlighter_TextStyle *Style;
+    uint32_t Mask;
+
+    if(m_HostHasApplyStyle2Mark)
+    {
+        Style=&Data->Styles[StyleIndex];
+        Mask=APPLY_STYLE_ATTRIBS|APPLY_STYLE_FGCOLOR|APPLY_STYLE_BGCOLOR;
+        if(Style->ULineColorOn)
+            Mask|=APPLY_STYLE_ULINECOLOR;
+
+        TextLineHighlighter_StatAdd(Data->Stats.HostCalls,1);
+        m_TLF_DPS->ApplyStyle2Mark(Mark,Style->FGColor,
+                Style->BGColor,Style->Attribs,Style->ULineColor,Offset,Len,
+                Mask);
+        return;
+    }
+
+    TextLineHighlighter_StatAdd(Data->Stats.HostCalls,3);
+    m_TLF_DPS->ApplyAttrib2Mark(Mark,Data->Styles[StyleIndex].Attribs,Offset,
+            Len);
+    m_TLF_DPS->ApplyFGColor2Mark(Mark,Data->Styles[StyleIndex].FGColor,Offset,
+            Len);
+    m_TLF_DPS->ApplyBGColor2Mark(Mark,Data->Styles[StyleIndex].BGColor,Offset,
+            Len);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_AddRule
+ *
+ * SYNOPSIS:
+ *    static bool TextLineHighlighter_AddRule(struct TextLineHighlighterData *Data,
+ *              e_LineMatchRuleType Type,const char *Str,int StyleIndex,
+ *              bool MatchSpan,const char *Name);
+ *
+ * PARAMETERS:
+ *    Data [I] -- Our data
+ *    Type [I] -- What type of rule to add
+ *    Str [I] -- The string or regex to match
+ *    StyleIndex [I] -- The style to apply when the rule matches
+ *    MatchSpan [I] -- Only style what matched (true) or the whole line
+ *    Name [I] -- The name to show for this rule in the statistics
+ *
+ * FUNCTION:
+ *    This function adds a rule to the rule list and a matching entry to the
+ *    rule statistics.  If the rule isn't added (empty string or a bad regex)
+ *    no statistics entry is added either.
+ *
+ *    'm_ConnectionsMutex' must be locked.
+ *
+ * RETURNS:
+ *    true -- The rule was added (it is at the end of 'Data->Rules')
+ *    false -- It was not
+ *
+ * SEE ALSO:
+ *    LineMatch_AddRule()
+ ******************************************************************************/
+static bool TextLineHighlighter_AddRule(struct TextLineHighlighterData *Data,
+        e_LineMatchRuleType Type,const char *Str,int StyleIndex,
+        bool MatchSpan,const char *Name)
+{
+    struct TextLineHighlighter_RuleStats *NewStats;
+
+    if(!LineMatch_AddRule(Data->Rules,Type,Str,StyleIndex,MatchSpan))
+        return false;
+
+    Data->RuleStats.emplace_back();
+    NewStats=&Data->RuleStats.back();
+    NewStats->Name=Name;
+    NewStats->Evaluations=0;
+    NewStats->Hits=0;
+    NewStats->TimedEvaluations=0;
+    NewStats->TotalTicks=0;
+    NewStats->MaxTicks=0;
+    NewStats->Suppressed=0;
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ParseGroupStyles
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ParseGroupStyles(const char *Str,
+ *              t_LineMatchGroupStyleList &Groups);
+ *
+ * PARAMETERS:
+ *    Str [I] -- The "RegexGroups" setting
+ *    Groups [O] -- The group styles
+ *
+ * FUNCTION:
+ *    This function converts the capture group styles from the settings.
+ *    They are a list of "group=set" (the color set number as shown in the
+ *    UI, starting at 1) separated by commas or spaces, for example
+ *    "1=2,3=5".  Anything that doesn't make sense is skipped.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    LineMatch_SetGroupStyles()
+ ******************************************************************************/
+static void TextLineHighlighter_ParseGroupStyles(const char *Str,
+        t_LineMatchGroupStyleList &Groups)
+{
+    struct LineMatchGroupStyle NewGroup;
+    char *End;
+    long Group;
+    long Set;
+
+    Groups.clear();
+    while(*Str!=0)
+    {
+        if(*Str==',' || *Str==' ')
+        {
+            Str++;
+            continue;
+        }
+
+        Group=strtol(Str,&End,10);
+        if(End==Str || *End!='=')
+        {
+            /* Skip to the next one */
+            while(*Str!=0 && *Str!=',' && *Str!=' ')
+                Str++;
+            continue;
+        }
+        Str=End+1;
+        Set=strtol(Str,&End,10);
+        if(End==Str)
+            continue;
+        Str=End;
+
+        if(Group<0 || Set<1 || Set>NUM_OF_STYLES)
+            continue;
+
+        NewGroup.Group=Group;
+        NewGroup.StyleIndex=Set-1;
+        Groups.push_back(NewGroup);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ResetStats
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ResetStats(
+ *              struct TextLineHighlighterData *Data);
+ *
+ * PARAMETERS:
+ *    Data [I] -- The connection to reset the statistics for
+ *
+ * FUNCTION:
+ *    This function zeros all the statistics for a connection.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    
+ ******************************************************************************/
+static void TextLineHighlighter_ResetStats(struct TextLineHighlighterData *Data)
+{
+    t_RuleStatsList::iterator Stats;
+
+    Data->Stats.Lines=0;
+    Data->Stats.Bytes=0;
+    Data->Stats.HostCalls=0;
+    Data->Stats.LongLines=0;
+    Data->Stats.Records=0;
+    Data->Stats.AsyncLines=0;
+    Data->Stats.AsyncInline=0;
+    Data->Stats.AsyncStale=0;
+    Data->Stats.AsyncSteals=0;
+    Data->Stats.Batches=0;
+    Data->Stats.ShedLines=0;
+    Data->Stats.StylesSuppressed=0;
+    Data->Stats.HelperFallback=0;
+    Data->Stats.RehighlightLines=0;
+    Data->Stats.EarlyLines=0;
+    Data->Stats.MarksPeak=Data->Stats.MarksInUse.load(memory_order_relaxed);
+    LatencyHist_Reset(&Data->LineLatency);
+    HostCallShim_Reset(&Data->HostCalls);
+
+    for(Stats=Data->RuleStats.begin();Stats!=Data->RuleStats.end();Stats++)
+    {
+        Stats->Evaluations=0;
+        Stats->Hits=0;
+        Stats->TimedEvaluations=0;
+        Stats->TotalTicks=0;
+        Stats->MaxTicks=0;
+        Stats->Suppressed=0;
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    TextLineHighlighter_ApplyCaptureSettings
+ *
+ * SYNOPSIS:
+ *    static void TextLineHighlighter_ApplyCaptureSettings(
+ *              struct TextLineHighlighterData *Data,t_PIKVList *Settings);
+ *
+ * PARAMETERS:
+ *    Data [I] -- The connection to start / stop the capture on
+ *    Settings [I] -- The settings to apply
+ *
+ * FUNCTION:
+ *    This function starts or stops capturing the raw stream to a file
+ *    based on the "CaptureOn" and "CaptureFile" settings.  If we are already
+ *    capturing to the same file the capture just keeps going.
+ *
+ *    If the file can't be opened we tell the user and the capture is left
+ *    off.
+ *
+ * RETURNS:
+ *    NONE
+ *
+ * SEE ALSO:
+ *    StreamCapture_Start(), StreamCapture_Stop()
+ ******************************************************************************/
+static void TextLineHighlighter_ApplyCaptureSettings(
+        struct TextLineHighlighterData *Data,t_PIKVList *Settings)
+{
+    const char *Str;
+    const char *Filename;
+    bool On;
 
-        Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->Simple[r].GroupBox->
-                GroupWidgetHandle,WData->Simple[r].StyleList->Ctrl);
-        sprintf(buff,"SimpleStyle%d",r);
-        sprintf(buff2,"%d",Num);
-        m_TLF_SysAPI->KVAddItem(Settings,buff,buff2);
-    }
+    Str=m_TLF_SysAPI->KVGetItem(Settings,"CaptureOn");
+    On=Str!=NULL && atoi(Str)!=0;
+    Filename=m_TLF_SysAPI->KVGetItem(Settings,"CaptureFile");
+    if(Filename==NULL || *Filename==0)
+        On=false;
 
-    /** Regex **/
-    for(r=0;r<NUM_OF_REGEXS;r++)
+    if(Data->Capture!=NULL)
     {
-        Str=m_TLF_UIAPI->GetTextInputText(WData->Regex[r].GroupBox->
-                GroupWidgetHandle,WData->Regex[r].RegexWid->Ctrl);
-
-        sprintf(buff,"RegexStr%d",r);
-        m_TLF_SysAPI->KVAddItem(Settings,buff,Str.c_str());
-
-        Num=m_TLF_UIAPI->GetComboBoxSelectedEntry(WData->Regex[r].GroupBox->
-                GroupWidgetHandle,WData->Regex[r].StyleList->Ctrl);
-        sprintf(buff,"RegexStyle%d",r);
-        sprintf(buff2,"%d",Num);
-        m_TLF_SysAPI->KVAddItem(Settings,buff,buff2);
+        if(On && Data->CaptureFile==Filename)
+            return;
+        StreamCapture_Stop(Data->Capture);
+        Data->Capture=NULL;
     }
 
-    /* Styling tabs (colors) */
-    for(r=0;r<NUM_OF_STYLES;r++)
+    if(!On)
+        return;
+
+    Data->Capture=StreamCapture_Start(Filename);
+    if(Data->Capture==NULL)
     {
-        sprintf(buff,"Colors%d",r);
-        TextLineHighlighter_UpdateSettingFromStyleWidgets(Settings,
-                &WData->Styles[r],WData->StylesTabHandle[r],buff);
+        m_TLF_UIAPI->Ask("Failed to open the capture file.  The stream will "
+                "not be captured.",PIUI_ASK_OK);
+        return;
     }
+    Data->CaptureFile=Filename;
 }
 
 /*******************************************************************************
  * NAME:
- *    ApplySettings
+ *    TextLineHighlighter_FillStatsViews
  *
  * SYNOPSIS:
- *    void ApplySettings(t_DataProcessorHandleType *DataHandle,
- *              t_PIKVList *Settings);
+ *    static void TextLineHighlighter_FillStatsViews(
+ *              struct TextLineHighlighter_SettingsWidgets *WData);
  *
  * PARAMETERS:
- *    DataHandle [I] -- The data handle to work on.  This is your internal
- *                      data.
- *    Settings [I] -- This is where you get your settings from.
+ *    WData [I] -- The settings widgets with the statistics views in it
  *
  * FUNCTION:
- *    This function takes the settings from 'Settings' and setups the
- *    plugin to use them when new bytes come in or out.  It will normally
- *    copy the settings from key/value pairs to internal data structures.
+ *    This function fills in the statistics tab with the current statistics
+ *    for all the connections.
+ *
+ *    The average and max times only come from the lines that where timed
+ *    (1 in STATS_TIME_SAMPLE_RATE).  The total time is the average times
+ *    all the evaluations.
+ *
+ *    The load shedding indicators show the level of the connection that
+ *    has backed off the most.
  *
  * RETURNS:
  *    NONE
@@ -867,206 +6194,310 @@ void TextLineHighlighter_SetSettingsFromWidgets(t_DataProSettingsWidgetsType *Pr
  * SEE ALSO:
  *    
  ******************************************************************************/
-static void TextLineHighlighter_ApplySettings(t_DataProcessorHandleType *DataHandle,
-        t_PIKVList *Settings)
+static void TextLineHighlighter_FillStatsViews(
+        struct TextLineHighlighter_SettingsWidgets *WData)
 {
-    struct TextLineHighlighterData *Data=(struct TextLineHighlighterData *)DataHandle;
-    const char *Str;
-    int r;
+    t_ConnectionList::iterator Con;
+    t_RuleStatsList::iterator Stats;
+    t_WidgetSysHandle *Handle;
+    t_PIUIColumnViewInputCtrl *ConView;
+    t_PIUIColumnViewInputCtrl *RuleView;
+    t_PIUIColumnViewInputCtrl *LatencyView;
+    struct LatencyHistogramSummary Latency;
+    uint64_t LatencyValues[5];
+    char ConName[100];
     char buff[100];
+    uint64_t AvgNS;
+    uint64_t Level;
+    uint64_t MaxLevel;
+    uint64_t Total;
+    uint64_t Left;
+    bool Rehighlighting;
+    int Row;
+    int c;
 
-    for(r=0;r<NUM_OF_SIMPLE;r++)
-    {
-        sprintf(buff,"SimpleStart%d",r);
-        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
-        if(Str==NULL)
-            Str="";
-        Data->Simple[r].StartsWith=Str;
-
-        sprintf(buff,"SimpleContains%d",r);
-        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
-        if(Str==NULL)
-            Str="";
-        Data->Simple[r].Contains=Str;
-
-        sprintf(buff,"SimpleEnd%d",r);
-        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
-        if(Str==NULL)
-            Str="";
-        Data->Simple[r].EndsWith=Str;
+    Handle=WData->StatsTabHandle;
+    ConView=WData->ConStatsView->Ctrl;
+    RuleView=WData->RuleStatsView->Ctrl;
+    LatencyView=WData->LatencyView->Ctrl;
 
-        sprintf(buff,"SimpleStyle%d",r);
-        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
-        if(Str==NULL)
-            Str="0";
-        Data->Simple[r].StyleIndex=atoi(Str);
+    m_TLF_UIAPI->ColumnViewInputClear(Handle,ConView);
+    m_TLF_UIAPI->ColumnViewInputClear(Handle,RuleView);
+    m_TLF_UIAPI->ColumnViewInputClear(Handle,LatencyView);
+    if(WData->HostCallsView!=NULL)
+    {
+        m_TLF_UIAPI->ColumnViewInputClear(Handle,
+                WData->HostCallsView->Ctrl);
     }
 
-    for(r=0;r<NUM_OF_REGEXS;r++)
+    MaxLevel=e_Shed_Full;
+    Rehighlighting=false;
+    lock_guard<mutex> Lock(m_ConnectionsMutex);
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        sprintf(buff,"RegexStr%d",r);
-        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
+        sprintf(ConName,"%u",(*Con)->ConnectionID);
+
+        Row=m_TLF_UIAPI->ColumnViewInputAddRow(Handle,ConView);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,0,Row,
+                ConName);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.Lines);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,1,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.Bytes);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,2,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.HostCalls);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,3,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.LongLines);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,4,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.Records);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,5,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.AsyncLines);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,6,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.AsyncInline);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,7,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.AsyncStale);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,8,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.AsyncQueue);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,9,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.AsyncSteals);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,10,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.Marks);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,11,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.MarksInUse);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,12,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.MarksPeak);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,13,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.Batches);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,14,Row,buff);
+        Level=(*Con)->Stats.ShedLevel.load(memory_order_relaxed);
+        if(Level>=e_ShedMAX)
+            Level=e_Shed_Full;
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,15,Row,
+                m_ShedStateNames[Level]);
+        if(Level>MaxLevel)
+            MaxLevel=Level;
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.ShedLines);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,16,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)
+                (*Con)->Stats.StylesSuppressed);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,17,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.HelperFallback);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,18,Row,buff);
+        Total=(*Con)->Stats.RehighlightTotal.load(memory_order_relaxed);
+        Left=(*Con)->Stats.RehighlightLeft.load(memory_order_relaxed);
+        strcpy(buff,"-");
+        if(Total>0)
+        {
+            if(Left>Total)
+                Left=Total;
+            sprintf(buff,"%u%%",(unsigned int)((Total-Left)*100/Total));
+            Rehighlighting=true;
+        }
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,19,Row,buff);
+        sprintf(buff,"%llu",(unsigned long long)(*Con)->Stats.EarlyLines);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,ConView,20,Row,buff);
+
+        LatencyHist_Summary(&(*Con)->LineLatency,&Latency);
+        LatencyValues[0]=Latency.P50;
+        LatencyValues[1]=Latency.P90;
+        LatencyValues[2]=Latency.P99;
+        LatencyValues[3]=Latency.P999;
+        LatencyValues[4]=Latency.Max;
+        Row=m_TLF_UIAPI->ColumnViewInputAddRow(Handle,LatencyView);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,LatencyView,0,Row,
+                ConName);
+        sprintf(buff,"%llu",(unsigned long long)Latency.Count);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,LatencyView,1,Row,
+                buff);
+        for(c=0;c<5;c++)
+        {
+            sprintf(buff,"%.2f",PerfTimer_Ticks2NS(LatencyValues[c])/1000.0);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,LatencyView,
+                    2+c,Row,buff);
+        }
 
-        if(Str==NULL)
-            Str="";
+        if(WData->HostCallsView!=NULL)
+        {
+            TextLineHighlighter_FillHostCallsView(WData,ConName,
+                    &(*Con)->HostCalls);
+        }
 
-        Data->Regex[r].Pattern=Str;
+        for(Stats=(*Con)->RuleStats.begin();Stats!=(*Con)->RuleStats.end();
+                Stats++)
+        {
+            AvgNS=0;
+            if(Stats->TimedEvaluations>0)
+            {
+                AvgNS=PerfTimer_Ticks2NS(Stats->TotalTicks)/
+                        Stats->TimedEvaluations;
+            }
 
-        sprintf(buff,"RegexStyle%d",r);
-        Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
-        if(Str==NULL)
-            Str="0";
-        Data->Regex[r].StyleIndex=atoi(Str);
+            Row=m_TLF_UIAPI->ColumnViewInputAddRow(Handle,RuleView);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,0,Row,
+                    ConName);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,1,Row,
+                    Stats->Name.c_str());
+            sprintf(buff,"%llu",(unsigned long long)Stats->Evaluations);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,2,Row,
+                    buff);
+            sprintf(buff,"%llu",(unsigned long long)Stats->Hits);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,3,Row,
+                    buff);
+            sprintf(buff,"%llu",(unsigned long long)AvgNS);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,4,Row,
+                    buff);
+            sprintf(buff,"%llu",(unsigned long long)
+                    PerfTimer_Ticks2NS(Stats->MaxTicks));
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,5,Row,
+                    buff);
+            sprintf(buff,"%.3f",(double)AvgNS*Stats->Evaluations/1000000.0);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,6,Row,
+                    buff);
+            sprintf(buff,"%llu",(unsigned long long)Stats->Suppressed);
+            m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,RuleView,7,Row,
+                    buff);
+        }
     }
 
-    /* Styling tabs (colors) */
-    for(r=0;r<NUM_OF_STYLES;r++)
+    /* The indicators show the connection that has backed off the most */
+    for(c=0;c<e_ShedMAX-1;c++)
     {
-        sprintf(buff,"Colors%d",r);
-        TextLineHighlighter_ApplySetting_SetData(Settings,&Data->Styles[r],buff,
-                r);
+        m_TLF_UIAPI->SetIndicator(Handle,WData->ShedIndicators[c]->Ctrl,
+                MaxLevel==(uint64_t)c+1);
     }
+    m_TLF_UIAPI->SetIndicator(Handle,WData->RehighlightIndicator->Ctrl,
+            Rehighlighting);
 }
 
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
-
 /*******************************************************************************
  * NAME:
- *    TextLineHighlighter_AddSettingStyleWidgets
+ *    TextLineHighlighter_FillHostCallsView
  *
  * SYNOPSIS:
- *    static void TextLineHighlighter_AddSettingStyleWidgets(
- *          struct SettingsStylingWidgetsSet *Widgets,
- *          t_WidgetSysHandle *SysHandle);
+ *    static void TextLineHighlighter_FillHostCallsView(
+ *              struct TextLineHighlighter_SettingsWidgets *WData,
+ *              const char *ConName,const struct HostCallCounters *Counters);
  *
  * PARAMETERS:
- *    Widgets [O] -- Where to store the pointers to the widgets
- *    SysHandle [I] -- The widget handle to use when adding the widgets.
+ *    WData [I] -- The settings widgets with the host calls view in it
+ *    ConName [I] -- The name of the connection to show
+ *    Counters [I] -- The host call counters for this connection
  *
  * FUNCTION:
- *    This is a helper function that allocates a set of styling widgets.
+ *    This function adds the rows for one connection to the host calls view.
+ *    The first 2 rows split the time spent processing bytes in to the time
+ *    spent in our code and the time spent in WhippyTerm.  The rest of the
+ *    rows are for each of the calls we made.
  *
  * RETURNS:
  *    NONE
  *
- * NOTES:
- *    Will throw(0) if there is an error.
- *
  * SEE ALSO:
- *    
+ *    TextLineHighlighter_FillStatsViews()
  ******************************************************************************/
-static void TextLineHighlighter_AddSettingStyleWidgets(
-        struct SettingsStylingWidgetsSet *Widgets,
-        t_WidgetSysHandle *SysHandle)
+static void TextLineHighlighter_FillHostCallsView(
+        struct TextLineHighlighter_SettingsWidgets *WData,const char *ConName,
+        const struct HostCallCounters *Counters)
 {
-    Widgets->FgColor=m_TLF_UIAPI->AddColorPick(SysHandle,"Forground Color",0x000000,NULL,NULL);
-    if(Widgets->FgColor==NULL)
-        throw(0);
-
-    Widgets->BgColor=m_TLF_UIAPI->AddColorPick(SysHandle,"Background Color",0x000000,NULL,NULL);
-    if(Widgets->BgColor==NULL)
-        throw(0);
-
-    Widgets->AttribUnderLine=m_TLF_UIAPI->AddCheckbox(SysHandle,"Underline",NULL,NULL);
-    if(Widgets->AttribUnderLine==NULL)
-        throw(0);
-
-    Widgets->AttribOverLine=m_TLF_UIAPI->AddCheckbox(SysHandle,"Overline",NULL,NULL);
-    if(Widgets->AttribOverLine==NULL)
-        throw(0);
+    uint64_t TotalCalls;
+    uint64_t PluginTicks;
+    int c;
 
-    Widgets->AttribLineThrough=m_TLF_UIAPI->AddCheckbox(SysHandle,"Line through",NULL,NULL);
-    if(Widgets->AttribLineThrough==NULL)
-        throw(0);
+    TotalCalls=0;
+    for(c=0;c<e_HostCallMAX;c++)
+        TotalCalls+=Counters->Calls[c];
 
-    Widgets->AttribBold=m_TLF_UIAPI->AddCheckbox(SysHandle,"Bold",NULL,NULL);
-    if(Widgets->AttribBold==NULL)
-        throw(0);
+    PluginTicks=0;
+    if(Counters->TotalTicks>Counters->HostTicks)
+        PluginTicks=Counters->TotalTicks-Counters->HostTicks;
 
-    Widgets->AttribItalic=m_TLF_UIAPI->AddCheckbox(SysHandle,"Italic",NULL,NULL);
-    if(Widgets->AttribItalic==NULL)
-        throw(0);
+    TextLineHighlighter_AddHostCallsRow(WData,ConName,"(plugin code)",0,
+            PluginTicks);
+    TextLineHighlighter_AddHostCallsRow(WData,ConName,"(host code)",
+            TotalCalls,Counters->HostTicks);
 
-    Widgets->AttribOutLine=m_TLF_UIAPI->AddCheckbox(SysHandle,"Outline",NULL,NULL);
-    if(Widgets->AttribOutLine==NULL)
-        throw(0);
+    for(c=0;c<e_HostCallMAX;c++)
+    {
+        if(Counters->Calls[c]==0)
+            continue;
+        TextLineHighlighter_AddHostCallsRow(WData,ConName,
+                HostCallShim_GetCallName((e_HostCallType)c),
+                Counters->Calls[c],Counters->Ticks[c]);
+    }
 }
 
 /*******************************************************************************
  * NAME:
- *    TextLineHighlighter_FreeSettingStyleWidgets
+ *    TextLineHighlighter_AddHostCallsRow
  *
  * SYNOPSIS:
- *    static void TextLineHighlighter_FreeSettingStyleWidgets(
- *          struct SettingsStylingWidgetsSet *Widgets,
- *          t_WidgetSysHandle *SysHandle);
+ *    static void TextLineHighlighter_AddHostCallsRow(
+ *              struct TextLineHighlighter_SettingsWidgets *WData,
+ *              const char *ConName,const char *Call,uint64_t Count,
+ *              uint64_t Ticks);
  *
  * PARAMETERS:
- *    Widgets [I] -- The widgets style set to free
- *    SysHandle [I] -- The widget system handle use to allocate these widgets.
+ *    WData [I] -- The settings widgets with the host calls view in it
+ *    ConName [I] -- The name of the connection to show
+ *    Call [I] -- The name of the call
+ *    Count [I] -- The number of calls (0 to leave count and avg blank)
+ *    Ticks [I] -- The total time spent in the calls
  *
  * FUNCTION:
- *    This function frees the widgets that was allocated with
- *    TextLineHighlighter_AddSettingStyleWidgets()
+ *    This is a helper function that adds a row to the host calls view.
  *
  * RETURNS:
  *    NONE
  *
  * SEE ALSO:
- *    TextLineHighlighter_AddSettingStyleWidgets()
+ *    TextLineHighlighter_FillHostCallsView()
  ******************************************************************************/
-static void TextLineHighlighter_FreeSettingStyleWidgets(
-        struct SettingsStylingWidgetsSet *Widgets,
-        t_WidgetSysHandle *SysHandle)
+static void TextLineHighlighter_AddHostCallsRow(
+        struct TextLineHighlighter_SettingsWidgets *WData,const char *ConName,
+        const char *Call,uint64_t Count,uint64_t Ticks)
 {
-    if(Widgets->AttribOutLine!=NULL)
-        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribOutLine);
-    if(Widgets->AttribItalic!=NULL)
-        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribItalic);
-    if(Widgets->AttribBold!=NULL)
-        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribBold);
-    if(Widgets->AttribLineThrough!=NULL)
-        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribLineThrough);
-    if(Widgets->AttribOverLine!=NULL)
-        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribOverLine);
-    if(Widgets->AttribUnderLine!=NULL)
-        m_TLF_UIAPI->FreeCheckbox(SysHandle,Widgets->AttribUnderLine);
+    t_WidgetSysHandle *Handle;
+    t_PIUIColumnViewInputCtrl *View;
+    uint64_t NS;
+    char buff[100];
+    int Row;
 
-    if(Widgets->BgColor!=NULL)
-        m_TLF_UIAPI->FreeColorPick(SysHandle,Widgets->BgColor);
-    if(Widgets->FgColor!=NULL)
-        m_TLF_UIAPI->FreeColorPick(SysHandle,Widgets->FgColor);
+    Handle=WData->StatsTabHandle;
+    View=WData->HostCallsView->Ctrl;
+    NS=PerfTimer_Ticks2NS(Ticks);
+
+    Row=m_TLF_UIAPI->ColumnViewInputAddRow(Handle,View);
+    m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,View,0,Row,ConName);
+    m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,View,1,Row,Call);
+    if(Count>0)
+    {
+        sprintf(buff,"%llu",(unsigned long long)Count);
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,View,2,Row,buff);
+    }
+    sprintf(buff,"%.1f",NS/1000.0);
+    m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,View,3,Row,buff);
+    if(Count>0)
+    {
+        sprintf(buff,"%llu",(unsigned long long)(NS/Count));
+        m_TLF_UIAPI->ColumnViewInputSetColumnText(Handle,View,4,Row,buff);
+    }
 }
 
 /*******************************************************************************
  * NAME:
- *    TextLineHighlighter_SetSettingStyleWidgets
+ *    TextLineHighlighter_ResetStatsBttnCB
  *
  * SYNOPSIS:
- *    static void TextLineHighlighter_SetSettingStyleWidgets(t_PIKVList *Settings,
- *          struct SettingsStylingWidgetsSet *Widgets,
- *          t_WidgetSysHandle *SysHandle,const char *Prefix,
- *          uint32_t DefaultStyleSet)
+ *    static void TextLineHighlighter_ResetStatsBttnCB(
+ *              const struct PIButtonEvent *Event,void *UserData);
  *
  * PARAMETERS:
- *    Settings [I] -- The settings to apply
- *    Widgets [I] -- The widget set to set to the settings
- *    SysHandle [I] -- The widget system handle that these widgets where added
- *                     with.
- *    Prefix [I] -- The prefix for the styling names in the settings.  This
- *                  function will take this string and add it to the start
- *                  of the setting KV name before trying to read it from
- *                  settings.
- *    DefaultStyleSet [I] -- The default colors and style to use if a setting
- *                           isn't found in settings.
+ *    Event [I] -- The button event
+ *    UserData [I] -- The settings widgets (TextLineHighlighter_SettingsWidgets)
  *
  * FUNCTION:
- *    This is a helper function that reads the styling widgets out of settings
- *    and applies it to the widgets.
+ *    This function is called when the user presses the reset statistics
+ *    button.  It zeros the statistics for all the connections and then
+ *    refreshes the statistics tab.
  *
  * RETURNS:
  *    NONE
@@ -1074,409 +6505,424 @@ static void TextLineHighlighter_FreeSettingStyleWidgets(
  * SEE ALSO:
  *    
  ******************************************************************************/
-static void TextLineHighlighter_SetSettingStyleWidgets(t_PIKVList *Settings,
-        struct SettingsStylingWidgetsSet *Widgets,t_WidgetSysHandle *SysHandle,
-        const char *Prefix,uint32_t DefaultStyleSet)
+static void TextLineHighlighter_ResetStatsBttnCB(
+        const struct PIButtonEvent *Event,void *UserData)
 {
-    uint32_t Num;
-
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"FGColor",
-            m_DefaultStyleSets[DefaultStyleSet].FGColor,16);
-    m_TLF_UIAPI->SetColorPickValue(SysHandle,Widgets->FgColor->Ctrl,Num);
-
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"BGColor",
-            m_DefaultStyleSets[DefaultStyleSet].BGColor,16);
-    m_TLF_UIAPI->SetColorPickValue(SysHandle,Widgets->BgColor->Ctrl,Num);
-
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribUnderLine",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_UNDERLINE,10);
-    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribUnderLine->Ctrl,
-            Num?true:false);
-
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOverLine",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OVERLINE,10);
-    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribOverLine->Ctrl,
-            Num?true:false);
-
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribLineThrough",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_LINETHROUGH,10);
-    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribLineThrough->Ctrl,
-            Num?true:false);
+    struct TextLineHighlighter_SettingsWidgets *WData=
+            (struct TextLineHighlighter_SettingsWidgets *)UserData;
+    t_ConnectionList::iterator Con;
 
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribBold",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_BOLD,10);
-    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribBold->Ctrl,
-            Num?true:false);
+    if(Event->EventType!=e_PIEButton_Press)
+        return;
 
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribItalic",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_ITALIC,10);
-    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribItalic->Ctrl,
-            Num?true:false);
+    m_ConnectionsMutex.lock();
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+        TextLineHighlighter_ResetStats(*Con);
+    m_ConnectionsMutex.unlock();
 
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOutLine",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OUTLINE,10);
-    m_TLF_UIAPI->SetCheckboxChecked(SysHandle,Widgets->AttribOutLine->Ctrl,
-            Num?true:false);
+    TextLineHighlighter_FillStatsViews(WData);
 }
 
 /*******************************************************************************
  * NAME:
- *    TextLineHighlighter_GrabSettingKV
+ *    TextLineHighlighter_SaveLatencyBttnCB
  *
  * SYNOPSIS:
- *    static uint32_t TextLineHighlighter_GrabSettingKV(t_PIKVList *Settings,
- *          const char *Prefix,const char *Key,uint32_t DefaultValue,int Base);
+ *    static void TextLineHighlighter_SaveLatencyBttnCB(
+ *              const struct PIButtonEvent *Event,void *UserData);
  *
  * PARAMETERS:
- *    Settings [I] -- The settings to apply
- *    Prefix [I] -- The prefix for the styling names in the settings.  This
- *                  function will take this string and add it to the start
- *                  of the setting KV name before trying to read it from
- *                  settings.
- *    Key [I] -- The key to look for in the settings
- *    DefaultValue [I] -- What value to apply if it wasn't found
- *    Base [I] -- What number base is the setting value stored as (sent into
- *                strtol()).
+ *    Event [I] -- The button event
+ *    UserData [I] -- The settings widgets (TextLineHighlighter_SettingsWidgets)
  *
- * FUNCTION:
- *    This is a helper function for TextLineHighlighter_SetSettingStyleWidgets()
- *    that tries to find a setting and if it's not found applies a default
- *    value.
+ * FUNCTION:
+ *    This function is called when the user presses the save latency
+ *    histograms button.  It asks for a file name and then saves the
+ *    histograms for all the connections to it.
  *
  * RETURNS:
- *    The value that was in settings or 'DefaultValue' if it was not found.
+ *    NONE
  *
  * SEE ALSO:
- *    TextLineHighlighter_SetSettingStyleWidgets()
+ *    TextLineHighlighter_SaveLatencyHistograms()
  ******************************************************************************/
-static uint32_t TextLineHighlighter_GrabSettingKV(t_PIKVList *Settings,
-        const char *Prefix,const char *Key,uint32_t DefaultValue,int Base)
+static void TextLineHighlighter_SaveLatencyBttnCB(
+        const struct PIButtonEvent *Event,void *UserData)
 {
-    char buff[100];
-    const char *Str;
-    uint32_t Number;
+    char *Path;
+    char *Filename;
+    string FullPath;
 
-    sprintf(buff,"%s_%s",Prefix,Key);
-    Str=m_TLF_SysAPI->KVGetItem(Settings,buff);
-    if(Str!=NULL)
-        Number=strtol(Str,NULL,Base);
-    else
-        Number=DefaultValue;
+    if(Event->EventType!=e_PIEButton_Press)
+        return;
 
-    return Number;
+    if(!m_TLF_UIAPI->FileReq(e_FileReqType_Save,"Save Latency Histograms",
+            &Path,&Filename,"CSV Files|*.csv\nAll Files|*",0))
+    {
+        return;
+    }
+
+    try
+    {
+        FullPath=Path;
+        if(!FullPath.empty() && FullPath.back()!='/' && FullPath.back()!='\\')
+            FullPath+="/";
+        FullPath+=Filename;
+    }
+    catch(...)
+    {
+        FullPath="";
+    }
+    m_TLF_UIAPI->FreeFileReqPathAndFile(&Path,&Filename);
+
+    if(FullPath=="" ||
+            !TextLineHighlighter_SaveLatencyHistograms(FullPath.c_str()))
+    {
+        m_TLF_UIAPI->Ask("Failed to save the latency histograms",
+                PIUI_ASK_OK);
+    }
 }
 
 /*******************************************************************************
  * NAME:
- *    TextLineHighlighter_UpdateSettingFromStyleWidgets
+ *    TextLineHighlighter_SaveLatencyHistograms
  *
  * SYNOPSIS:
- *    static void TextLineHighlighter_UpdateSettingFromStyleWidgets(
- *          t_PIKVList *Settings,struct SettingsStylingWidgetsSet *Widgets,
- *          t_WidgetSysHandle *SysHandle,const char *Prefix);
+ *    static bool TextLineHighlighter_SaveLatencyHistograms(
+ *              const char *Filename);
  *
  * PARAMETERS:
- *    Settings [O] -- The settings to set the data in
- *    Widgets [I] -- The widgets to read the data from
- *    SysHandle [I] -- The widget system handle that these widgets where added
- *                     with.
- *    Prefix [I] -- The prefix for the styling names in the settings.  This
- *                  function will take this string and add it to the start
- *                  of the setting KV name before trying to read it from
- *                  settings.
+ *    Filename [I] -- The file to write
  *
  * FUNCTION:
- *    This function takes and reads the values from the widgets and put them
- *    in 'Settings'.
+ *    This function writes the line latency histograms for all the
+ *    connections to a file.  Each connection starts with a few '#' comment
+ *    lines with the percentiles (in ns) and then the none empty buckets as
+ *    CSV (see LatencyHist_Dump()).
  *
  * RETURNS:
- *    NONE
+ *    true -- Things worked out
+ *    false -- We couldn't write the file
  *
  * SEE ALSO:
- *    
+ *    LatencyHist_Dump()
  ******************************************************************************/
-static void TextLineHighlighter_UpdateSettingFromStyleWidgets(t_PIKVList *Settings,
-        struct SettingsStylingWidgetsSet *Widgets,t_WidgetSysHandle *SysHandle,
-        const char *Prefix)
+static bool TextLineHighlighter_SaveLatencyHistograms(const char *Filename)
 {
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"FGColor",
-            m_TLF_UIAPI->GetColorPickValue(SysHandle,Widgets->FgColor->Ctrl),
-            16);
-
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"BGColor",
-            m_TLF_UIAPI->GetColorPickValue(SysHandle,Widgets->BgColor->Ctrl),
-            16);
-
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribUnderLine",
-            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
-            Widgets->AttribUnderLine->Ctrl),16);
-
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribOverLine",
-            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
-            Widgets->AttribOverLine->Ctrl),16);
+    t_ConnectionList::iterator Con;
+    struct LatencyHistogramSummary Latency;
+    FILE *out;
+    bool RetValue;
 
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribLineThrough",
-            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
-            Widgets->AttribLineThrough->Ctrl),16);
+    out=fopen(Filename,"w");
+    if(out==NULL)
+        return false;
 
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribBold",
-            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
-            Widgets->AttribBold->Ctrl),16);
+    m_ConnectionsMutex.lock();
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        LatencyHist_Summary(&(*Con)->LineLatency,&Latency);
+
+        fprintf(out,"# Connection %u\n",(*Con)->ConnectionID);
+        fprintf(out,"# lines=%llu p50_ns=%llu p90_ns=%llu p99_ns=%llu "
+                "p99.9_ns=%llu max_ns=%llu\n",
+                (unsigned long long)Latency.Count,
+                (unsigned long long)PerfTimer_Ticks2NS(Latency.P50),
+                (unsigned long long)PerfTimer_Ticks2NS(Latency.P90),
+                (unsigned long long)PerfTimer_Ticks2NS(Latency.P99),
+                (unsigned long long)PerfTimer_Ticks2NS(Latency.P999),
+                (unsigned long long)PerfTimer_Ticks2NS(Latency.Max));
+        LatencyHist_Dump(&(*Con)->LineLatency,out,PerfTimer_Ticks2NS);
+        fprintf(out,"\n");
+    }
+    m_ConnectionsMutex.unlock();
 
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribItalic",
-            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
-            Widgets->AttribItalic->Ctrl),16);
+    RetValue=!ferror(out);
+    if(fclose(out)!=0)
+        RetValue=false;
 
-    TextLineHighlighter_SetSettingKV(Settings,Prefix,"AttribOutLine",
-            m_TLF_UIAPI->IsCheckboxChecked(SysHandle,
-            Widgets->AttribOutLine->Ctrl),16);
+    return RetValue;
 }
 
 /*******************************************************************************
  * NAME:
- *    TextLineHighlighter_SetSettingKV
+ *    TextLineHighlighter_StatAdd
  *
  * SYNOPSIS:
- *    static void TextLineHighlighter_SetSettingKV(t_PIKVList *Settings,
- *              const char *Prefix,const char *Key,uint32_t Value,int Base);
+ *    static inline void TextLineHighlighter_StatAdd(t_StatCounter &Counter,
+ *              uint64_t Amount);
  *
  * PARAMETERS:
- *    Settings [O] -- The settings to set the data in
- *    Prefix [I] -- The prefix for the styling names in the settings.  This
- *                  function will take this string and add it to the start
- *                  of the setting KV name before trying to read it from
- *                  settings.
- *    Key [I] -- The key to look for in the settings
- *    Value [I] -- The value to store
- *    Base [I] -- What number base is the setting value stored as.
+ *    Counter [I/O] -- The counter to add to
+ *    Amount [I] -- The amount to add
  *
  * FUNCTION:
- *    This is a helper function for
- *    TextLineHighlighter_UpdateSettingFromStyleWidgets() that sets the value in
- *    'Settings'.
+ *    This function adds to one of the statistics counters.  Only the
+ *    connection's thread writes to its counters so this is a relaxed
+ *    load and store (no locked read/modify/write).  Other threads just see
+ *    the count a little late.
  *
  * RETURNS:
  *    NONE
- *
- * SEE ALSO:
- *    TextLineHighlighter_UpdateSettingFromStyleWidgets()
  ******************************************************************************/
-static void TextLineHighlighter_SetSettingKV(t_PIKVList *Settings,
-        const char *Prefix,const char *Key,uint32_t Value,int Base)
+static inline void TextLineHighlighter_StatAdd(t_StatCounter &Counter,
+        uint64_t Amount)
 {
-    char buff[100];
-    char buff2[100];
-
-    sprintf(buff,"%s_%s",Prefix,Key);
-    if(Base==10)
-        sprintf(buff2,"%d",Value);
-    else
-        sprintf(buff2,"%06X",Value);
-    m_TLF_SysAPI->KVAddItem(Settings,buff,buff2);
+    Counter.store(Counter.load(memory_order_relaxed)+Amount,
+            memory_order_relaxed);
 }
 
 /*******************************************************************************
  * NAME:
- *    TextLineHighlighter_ApplySetting_SetData
+ *    TextLineHighlighter_BuildMetrics
  *
  * SYNOPSIS:
- *    static void TextLineHighlighter_ApplySetting_SetData(t_PIKVList *Settings,
- *              struct TextLineHighlighter_TextStyle *Style,const char *Prefix,
- *              uint32_t DefaultStyleSet);
+ *    static void TextLineHighlighter_BuildMetrics(string &Out);
  *
  * PARAMETERS:
- *    Settings [I] -- The settings to read out
- *    Style [O] -- The style to be set to what is in 'Settings'
- *    Prefix [I] -- The prefix for the styling names in the settings.  This
- *                  function will take this string and add it to the start
- *                  of the setting KV name before trying to read it from
- *                  settings.
- *    DefaultStyleSet [I] -- The default colors and style to use if a setting
- *                           isn't found in settings.
+ *    Out [O] -- The text to fill in
  *
  * FUNCTION:
- *    This function takes the settings in 'Settings' copies / converts then
- *    to the styling in 'Style'.
+ *    This function builds the Prometheus text for all the connections.  It
+ *    is called from the metrics export thread.
  *
  * RETURNS:
  *    NONE
  *
  * SEE ALSO:
- *    
+ *    MetricsExport_StartFromEnv()
  ******************************************************************************/
-static void TextLineHighlighter_ApplySetting_SetData(t_PIKVList *Settings,
-        struct TextLineHighlighter_TextStyle *Style,const char *Prefix,
-        uint32_t DefaultStyleSet)
+static void TextLineHighlighter_BuildMetrics(string &Out)
 {
-    uint32_t Num;
+    t_ConnectionList::iterator Con;
+    t_RuleStatsList::iterator Stats;
+    struct LatencyHistogramSummary Latency;
+    char ConLabel[100];
+    string Labels;
 
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"FGColor",
-            m_DefaultStyleSets[DefaultStyleSet].FGColor,16);
-    Style->FGColor=Num;
+    lock_guard<mutex> Lock(m_ConnectionsMutex);
 
-    Num=TextLineHighlighter_GrabSettingKV(Settings,Prefix,"BGColor",
-            m_DefaultStyleSets[DefaultStyleSet].BGColor,16);
-    Style->BGColor=Num;
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_lines_total","counter",
+            "Lines processed.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_lines_total",ConLabel,
+                (*Con)->Stats.Lines.load(memory_order_relaxed));
+    }
 
-    Style->Attribs=0;
-    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribUnderLine",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_UNDERLINE,
-            10))
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_bytes_total","counter",
+            "Bytes processed.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        Style->Attribs|=TXT_ATTRIB_UNDERLINE;
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_bytes_total",ConLabel,
+                (*Con)->Stats.Bytes.load(memory_order_relaxed));
     }
 
-    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOverLine",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OVERLINE,
-            10))
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_long_lines_total","counter",
+            "Lines longer than the max line length (checked in windows).");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        Style->Attribs|=TXT_ATTRIB_OVERLINE;
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_long_lines_total",ConLabel,
+                (*Con)->Stats.LongLines.load(memory_order_relaxed));
     }
 
-    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribLineThrough",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_LINETHROUGH,
-            10))
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_worker_queue_depth","gauge",
+            "Lines waiting for a worker thread.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        Style->Attribs|=TXT_ATTRIB_LINETHROUGH;
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_worker_queue_depth",
+                ConLabel,(*Con)->Stats.AsyncQueue.load(memory_order_relaxed));
     }
 
-    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribBold",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_BOLD,
-            10))
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_worker_steals_total",
+            "counter","Batches of lines a worker stole from another worker.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        Style->Attribs|=TXT_ATTRIB_BOLD;
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_worker_steals_total",
+                ConLabel,(*Con)->Stats.AsyncSteals.load(memory_order_relaxed));
     }
 
-    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribItalic",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_ITALIC,
-            10))
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_batches_total","counter",
+            "Micro-batches of lines checked on the connection.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        Style->Attribs|=TXT_ATTRIB_ITALIC;
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_batches_total",ConLabel,
+                (*Con)->Stats.Batches.load(memory_order_relaxed));
     }
 
-    if(TextLineHighlighter_GrabSettingKV(Settings,Prefix,"AttribOutLine",
-            m_DefaultStyleSets[DefaultStyleSet].Attribs&TXT_ATTRIB_OUTLINE,
-            10))
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_shed_level","gauge",
+            "How far load shedding has backed off (0 = every rule on "
+            "every line, 3 = paused).");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        Style->Attribs|=TXT_ATTRIB_OUTLINE;
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_shed_level",ConLabel,
+                (*Con)->Stats.ShedLevel.load(memory_order_relaxed));
     }
-}
 
-/*******************************************************************************
- * NAME:
- *    TextLineHighlighter_HandleLine
- *
- * SYNOPSIS:
- *    void TextLineHighlighter_HandleLine(struct TextLineHighlighterData *Data);
- *
- * PARAMETERS:
- *    Data [I] -- Our data
- *
- * FUNCTION:
- *    This function handles when we finish reading a line.  It will check
- *    for any matches and color the line as needed.
- *
- *    It will then reset the mark.
- *
- * RETURNS:
- *    NONE
- *
- * SEE ALSO:
- *    
- ******************************************************************************/
-static void TextLineHighlighter_HandleLine(struct TextLineHighlighterData *Data)
-{
-    const uint8_t *Line;
-    uint32_t Bytes;
-    int r;
-    size_t Len;
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_shed_lines_total","counter",
+            "Lines not checked because of load shedding.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_shed_lines_total",ConLabel,
+                (*Con)->Stats.ShedLines.load(memory_order_relaxed));
+    }
 
-    if(Data->StartOfLineMarker==NULL)
-        return;
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_styles_suppressed_total",
+            "counter","Styles not applied because of the connection's style "
+            "limit.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_styles_suppressed_total",
+                ConLabel,(*Con)->Stats.StylesSuppressed.load(
+                memory_order_relaxed));
+    }
 
-    Line=m_TLF_DPS->GetMarkString(Data->StartOfLineMarker,&Bytes,0,0);
-    if(Line==NULL)
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_helper_fallback_lines_total",
+            "counter","Lines only checked with the simple rules because the "
+            "helper process failed.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        Data->GrabNewMark=true;
-        return;
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_helper_fallback_lines_total",
+                ConLabel,(*Con)->Stats.HelperFallback.load(
+                memory_order_relaxed));
     }
 
-    for(r=0;r<NUM_OF_SIMPLE;r++)
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_rehighlight_lines_total",
+            "counter","Scroll back lines re-highlighted after the settings "
+            "changed.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        if(!Data->Simple[r].StartsWith.empty())
-        {
-            Len=Data->Simple[r].StartsWith.length();
-            if(strncmp((char *)Line,Data->Simple[r].StartsWith.c_str(),Len)==0)
-            {
-                TextLineHighlighter_ApplyStyleSet2Marker(Data,
-                        Data->Simple[r].StyleIndex);
-            }
-        }
-        if(!Data->Simple[r].Contains.empty())
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_rehighlight_lines_total",
+                ConLabel,(*Con)->Stats.RehighlightLines.load(
+                memory_order_relaxed));
+    }
+
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_rehighlight_lines_left",
+            "gauge","Scroll back lines the running re-highlight has left.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_rehighlight_lines_left",
+                ConLabel,(*Con)->Stats.RehighlightLeft.load(
+                memory_order_relaxed));
+    }
+
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_early_lines_total",
+            "counter","Lines styled before they ended.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_early_lines_total",
+                ConLabel,(*Con)->Stats.EarlyLines.load(memory_order_relaxed));
+    }
+
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_marks","gauge",
+            "Marks in the mark pool.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_marks",ConLabel,
+                (*Con)->Stats.Marks.load(memory_order_relaxed));
+    }
+
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_marks_in_use","gauge",
+            "Marks retained from the mark pool.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_marks_in_use",ConLabel,
+                (*Con)->Stats.MarksInUse.load(memory_order_relaxed));
+    }
+
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_rule_evaluations_total",
+            "counter","Lines checked against a rule.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        for(Stats=(*Con)->RuleStats.begin();Stats!=(*Con)->RuleStats.end();
+                Stats++)
         {
-            if(strstr((char *)Line,Data->Simple[r].Contains.c_str())!=NULL)
-            {
-                TextLineHighlighter_ApplyStyleSet2Marker(Data,
-                        Data->Simple[r].StyleIndex);
-            }
+            Labels=ConLabel;
+            Labels+=",rule=\"";
+            Labels+=MetricsExport_EscapeLabel(Stats->Name.c_str());
+            Labels+="\"";
+            MetricsExport_AddValue(Out,
+                    "whippyterm_tlh_rule_evaluations_total",Labels.c_str(),
+                    Stats->Evaluations.load(memory_order_relaxed));
         }
-        if(!Data->Simple[r].EndsWith.empty())
+    }
+
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_rule_hits_total","counter",
+            "Lines that matched a rule.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        for(Stats=(*Con)->RuleStats.begin();Stats!=(*Con)->RuleStats.end();
+                Stats++)
         {
-            Len=Data->Simple[r].EndsWith.length();
-            if(Bytes>=Len && strcmp((char *)&Line[Bytes-Len],
-                    Data->Simple[r].EndsWith.c_str())==0)
-            {
-                TextLineHighlighter_ApplyStyleSet2Marker(Data,
-                        Data->Simple[r].StyleIndex);
-            }
+            Labels=ConLabel;
+            Labels+=",rule=\"";
+            Labels+=MetricsExport_EscapeLabel(Stats->Name.c_str());
+            Labels+="\"";
+            MetricsExport_AddValue(Out,"whippyterm_tlh_rule_hits_total",
+                    Labels.c_str(),Stats->Hits.load(memory_order_relaxed));
         }
     }
 
-    for(r=0;r<NUM_OF_REGEXS;r++)
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_rule_suppressed_total",
+            "counter","Matches of a rule not styled because of its style "
+            "limit.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
     {
-        if(!Data->Regex[r].Pattern.empty())
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        for(Stats=(*Con)->RuleStats.begin();Stats!=(*Con)->RuleStats.end();
+                Stats++)
         {
-            regex RxPattern(Data->Regex[r].Pattern);
-            if(regex_search((const char *)Line,RxPattern))
-            {
-                TextLineHighlighter_ApplyStyleSet2Marker(Data,
-                    Data->Regex[r].StyleIndex);
-            }
+            Labels=ConLabel;
+            Labels+=",rule=\"";
+            Labels+=MetricsExport_EscapeLabel(Stats->Name.c_str());
+            Labels+="\"";
+            MetricsExport_AddValue(Out,"whippyterm_tlh_rule_suppressed_total",
+                    Labels.c_str(),Stats->Suppressed.load(memory_order_relaxed));
         }
     }
 
-    /* Ok, reset the mark */
-    Data->GrabNewMark=true;
-}
-
-/*******************************************************************************
- * NAME:
- *    TextLineHighlighter_ApplyStyleSet2Marker
- *
- * SYNOPSIS:
- *    static void TextLineHighlighter_ApplyStyleSet2Marker(struct TextLineHighlighterData *Data,
- *              int StyleIndex);
- *
- * PARAMETERS:
- *    Data [I] -- Our data
- *    StyleIndex [I] -- The index of the style to apply.
- *
- * FUNCTION:
- *    This function applies a style to the current marker to the cursor.
- *
- * RETURNS:
- *    NONE
- *
- * SEE ALSO:
- *    
- ******************************************************************************/
-static void TextLineHighlighter_ApplyStyleSet2Marker(struct TextLineHighlighterData *Data,
-        int StyleIndex)
-{
-    m_TLF_DPS->ApplyAttrib2Mark(Data->StartOfLineMarker,
-            Data->Styles[StyleIndex].Attribs,0,0);
-    m_TLF_DPS->ApplyFGColor2Mark(Data->StartOfLineMarker,
-            Data->Styles[StyleIndex].FGColor,0,0);
-    m_TLF_DPS->ApplyBGColor2Mark(Data->StartOfLineMarker,
-            Data->Styles[StyleIndex].BGColor,0,0);
+    MetricsExport_AddHeader(Out,"whippyterm_tlh_line_latency_seconds",
+            "summary","Time from the end of a line arriving to it being "
+            "highlighted.");
+    for(Con=m_Connections.begin();Con!=m_Connections.end();Con++)
+    {
+        sprintf(ConLabel,"connection=\"%u\"",(*Con)->ConnectionID);
+        LatencyHist_Summary(&(*Con)->LineLatency,&Latency);
+
+        Labels=ConLabel;
+        Labels+=",quantile=\"0.5\"";
+        MetricsExport_AddValue(Out,"whippyterm_tlh_line_latency_seconds",
+                Labels.c_str(),PerfTimer_Ticks2NS(Latency.P50)/1e9);
+        Labels=ConLabel;
+        Labels+=",quantile=\"0.9\"";
+        MetricsExport_AddValue(Out,"whippyterm_tlh_line_latency_seconds",
+                Labels.c_str(),PerfTimer_Ticks2NS(Latency.P90)/1e9);
+        Labels=ConLabel;
+        Labels+=",quantile=\"0.99\"";
+        MetricsExport_AddValue(Out,"whippyterm_tlh_line_latency_seconds",
+                Labels.c_str(),PerfTimer_Ticks2NS(Latency.P99)/1e9);
+        Labels=ConLabel;
+        Labels+=",quantile=\"0.999\"";
+        MetricsExport_AddValue(Out,"whippyterm_tlh_line_latency_seconds",
+                Labels.c_str(),PerfTimer_Ticks2NS(Latency.P999)/1e9);
+        MetricsExport_AddValue(Out,"whippyterm_tlh_line_latency_seconds_count",
+                ConLabel,Latency.Count);
+    }
 }
@@ -0,0 +1,452 @@
+/*******************************************************************************
+ * FILENAME: KernelBench.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a micro bench mark for the text line highlighter matching
+ *    kernels.  It times each kernel on its own over a sweep of line
+ *    lengths and rule counts and prints the results as CSV.
+ *
+ *    Usage:
+ *      KernelBench [--kernels k1,k2,...] [--max-len Bytes]
+ *                  [--max-rules Count] [--min-ms Milliseconds]
+ *
+ *    Kernels:
+ *      prefix -- StartsWith rules (LineMatch_StartsWith())
+ *      suffix -- EndsWith rules (LineMatch_EndsWith())
+ *      substring -- Contains rules (LineMatch_Contains())
+ *      regex_ecmascript -- Regex rules (std::regex, the only regex backend
+ *                          the plugin has)
+ *      ruleset -- A mix of all the rule types run though
+ *                 LineMatch_TestRule() (the matching part of
+ *                 TextLineHighlighter_HandleLine())
+ *      resolve -- Style resolution.  One span per rule is added with
+ *                 LineMatch_AddSpan() and merged with
+ *                 LineMatch_MergeSpans() (the part of
+ *                 TextLineHighlighter_HandleLine() after the matching).
+ *                 The hits column is the number of styles in the merged
+ *                 intervals.
+ *
+ *    CSV columns:
+ *      kernel,line_bytes,rules,iterations,ns_per_line,mb_per_sec,hits
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "LineMatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define MIN_LINE_LEN                16
+#define MAX_LINE_LEN                (1024*1024)
+#define MAX_RULES                   10000
+#define DEFAULT_MIN_MS              20
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+typedef enum
+{
+    e_Kernel_Prefix,
+    e_Kernel_Suffix,
+    e_Kernel_Substring,
+    e_Kernel_Regex,
+    e_Kernel_RuleSet,
+    e_Kernel_Resolve,
+    e_KernelMAX
+} e_KernelType;
+
+/*** FUNCTION PROTOTYPES      ***/
+static void BuildLine(string &Line,uint32_t Len);
+static bool BuildRules(e_KernelType Kernel,t_LineMatchRuleList &Rules,
+        int Count);
+static void BuildSpans(vector<struct LineMatchSpan> &Spans,
+        const t_LineMatchRuleList &Rules,uint32_t Len);
+static void RunCell(e_KernelType Kernel,const string &Line,
+        const t_LineMatchRuleList &Rules,unsigned int MinMS);
+
+/*** VARIABLE DEFINITIONS     ***/
+static const char *m_KernelNames[e_KernelMAX]=
+{
+    "prefix",
+    "suffix",
+    "substring",
+    "regex_ecmascript",
+    "ruleset",
+    "resolve",
+};
+
+static uint32_t m_RandSeed=0x12345678;
+
+/* Keeps the optimizer from throwing away the results */
+volatile int m_Sink;
+
+static uint32_t BenchRand(void)
+{
+    /* xorshift32, we want the same lines every run */
+    m_RandSeed^=m_RandSeed<<13;
+    m_RandSeed^=m_RandSeed>>17;
+    m_RandSeed^=m_RandSeed<<5;
+    return m_RandSeed;
+}
+
+int main(int argc,char *argv[])
+{
+    bool DoKernel[e_KernelMAX];
+    uint32_t MaxLen;
+    int MaxRules;
+    unsigned int MinMS;
+    uint32_t Len;
+    int Count;
+    int k;
+    int a;
+    string Line;
+    t_LineMatchRuleList Rules;
+    char *Tok;
+
+    MaxLen=MAX_LINE_LEN;
+    MaxRules=MAX_RULES;
+    MinMS=DEFAULT_MIN_MS;
+    for(k=0;k<e_KernelMAX;k++)
+        DoKernel[k]=true;
+
+    for(a=1;a<argc;a++)
+    {
+        if(strcmp(argv[a],"--kernels")==0 && a+1<argc)
+        {
+            for(k=0;k<e_KernelMAX;k++)
+                DoKernel[k]=false;
+            for(Tok=strtok(argv[++a],",");Tok!=NULL;Tok=strtok(NULL,","))
+            {
+                for(k=0;k<e_KernelMAX;k++)
+                    if(strcmp(Tok,m_KernelNames[k])==0)
+                        break;
+                if(k==e_KernelMAX)
+                {
+                    fprintf(stderr,"Unknown kernel: %s\n",Tok);
+                    return 1;
+                }
+                DoKernel[k]=true;
+            }
+        }
+        else if(strcmp(argv[a],"--max-len")==0 && a+1<argc)
+        {
+            MaxLen=strtoul(argv[++a],NULL,0);
+        }
+        else if(strcmp(argv[a],"--max-rules")==0 && a+1<argc)
+        {
+            MaxRules=atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a],"--min-ms")==0 && a+1<argc)
+        {
+            MinMS=atoi(argv[++a]);
+        }
+        else
+        {
+            fprintf(stderr,"Usage: %s [--kernels k1,k2,...] [--max-len Bytes] "
+                    "[--max-rules Count] [--min-ms Milliseconds]\n",argv[0]);
+            fprintf(stderr,"Kernels:");
+            for(k=0;k<e_KernelMAX;k++)
+                fprintf(stderr," %s",m_KernelNames[k]);
+            fprintf(stderr,"\n");
+            return 1;
+        }
+    }
+
+    printf("kernel,line_bytes,rules,iterations,ns_per_line,mb_per_sec,hits\n");
+    fflush(stdout);
+
+    for(k=0;k<e_KernelMAX;k++)
+    {
+        if(!DoKernel[k])
+            continue;
+        for(Count=1;Count<=MaxRules;Count*=10)
+        {
+            if(!BuildRules((e_KernelType)k,Rules,Count))
+            {
+                fprintf(stderr,"Failed to build rules for %s\n",
+                        m_KernelNames[k]);
+                return 1;
+            }
+            for(Len=MIN_LINE_LEN;Len<=MaxLen;Len*=4)
+            {
+                BuildLine(Line,Len);
+                RunCell((e_KernelType)k,Line,Rules,MinMS);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildLine
+ *
+ * SYNOPSIS:
+ *    static void BuildLine(string &Line,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Line [O] -- The line to fill in
+ *    Len [I] -- How long to make the line
+ *
+ * FUNCTION:
+ *    This function makes a log like line of printable text.  The rules made
+ *    by BuildRules() are built so they never match this text, which gives
+ *    the worst case (full scan) for every kernel.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void BuildLine(string &Line,uint32_t Len)
+{
+    static const char Words[]="abcdefghijklmnopqrstuvwxyz0123456789 :.[]=-";
+    uint32_t r;
+
+    Line.resize(Len);
+    for(r=0;r<Len;r++)
+        Line[r]=Words[BenchRand()%(sizeof(Words)-1)];
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildRules
+ *
+ * SYNOPSIS:
+ *    static bool BuildRules(e_KernelType Kernel,t_LineMatchRuleList &Rules,
+ *          int Count);
+ *
+ * PARAMETERS:
+ *    Kernel [I] -- The kernel to build the rules for
+ *    Rules [O] -- The rules
+ *    Count [I] -- How many rules to make
+ *
+ * FUNCTION:
+ *    This function builds a rule set for a kernel.  The rules use upper case
+ *    letters so they never match the lines from BuildLine().
+ *
+ * RETURNS:
+ *    true -- Things worked out
+ *    false -- A rule could not be added
+ ******************************************************************************/
+static bool BuildRules(e_KernelType Kernel,t_LineMatchRuleList &Rules,
+        int Count)
+{
+    static const e_LineMatchRuleType Mix[]=
+    {
+        e_LineMatchRule_StartsWith,
+        e_LineMatchRule_Contains,
+        e_LineMatchRule_EndsWith,
+        e_LineMatchRule_Regex,
+    };
+    e_LineMatchRuleType Type;
+    char buff[100];
+    int r;
+
+    Rules.clear();
+    Rules.reserve(Count);
+    for(r=0;r<Count;r++)
+    {
+        switch(Kernel)
+        {
+            case e_Kernel_Prefix:
+                Type=e_LineMatchRule_StartsWith;
+            break;
+            case e_Kernel_Suffix:
+                Type=e_LineMatchRule_EndsWith;
+            break;
+            case e_Kernel_Substring:
+                Type=e_LineMatchRule_Contains;
+            break;
+            case e_Kernel_Regex:
+                Type=e_LineMatchRule_Regex;
+            break;
+            case e_Kernel_RuleSet:
+            case e_Kernel_Resolve:
+            case e_KernelMAX:
+            default:
+                Type=Mix[r%(sizeof(Mix)/sizeof(Mix[0]))];
+            break;
+        }
+
+        if(Type==e_LineMatchRule_Regex)
+            sprintf(buff,"ERR[0-9]+ R%d",r);
+        else
+            sprintf(buff,"a:ERROR %d",r);
+
+        if(!LineMatch_AddRule(Rules,Type,buff,r%8,false))
+            return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildSpans
+ *
+ * SYNOPSIS:
+ *    static void BuildSpans(vector<struct LineMatchSpan> &Spans,
+ *          const t_LineMatchRuleList &Rules,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Spans [O] -- The spans to fill in
+ *    Rules [I] -- The rules the spans are for
+ *    Len [I] -- The length of the line the spans are on
+ *
+ * FUNCTION:
+ *    This function makes the spans the 'resolve' kernel merges, one for
+ *    every rule.  Rules that are not match span rules style the whole
+ *    line, the rest style a short run of bytes some where in the line so
+ *    the spans overlap like they would on a real line.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void BuildSpans(vector<struct LineMatchSpan> &Spans,
+        const t_LineMatchRuleList &Rules,uint32_t Len)
+{
+    struct LineMatchSpan NewSpan;
+    uint32_t SpanLen;
+    size_t r;
+
+    Spans.clear();
+    for(r=0;r<Rules.size();r++)
+    {
+        if(r%4==0)
+        {
+            NewSpan.Start=0;
+            NewSpan.End=Len;
+        }
+        else
+        {
+            SpanLen=1+BenchRand()%16;
+            if(SpanLen>Len)
+                SpanLen=Len;
+            NewSpan.Start=BenchRand()%(Len-SpanLen+1);
+            NewSpan.End=NewSpan.Start+SpanLen;
+        }
+        NewSpan.StyleIndex=Rules[r].StyleIndex;
+        Spans.push_back(NewSpan);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    RunCell
+ *
+ * SYNOPSIS:
+ *    static void RunCell(e_KernelType Kernel,const string &Line,
+ *          const t_LineMatchRuleList &Rules,unsigned int MinMS);
+ *
+ * PARAMETERS:
+ *    Kernel [I] -- The kernel being timed (just for the output)
+ *    Line [I] -- The line to run the rules on
+ *    Rules [I] -- The rules to run
+ *    MinMS [I] -- The min number of milliseconds to run for.  At least
+ *                 one pass is always done.
+ *
+ * FUNCTION:
+ *    This function times running every rule in 'Rules' over a line and
+ *    prints one CSV row.  For the 'resolve' kernel it times adding a span
+ *    for every rule and merging them instead.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void RunCell(e_KernelType Kernel,const string &Line,
+        const t_LineMatchRuleList &Rules,unsigned int MinMS)
+{
+    chrono::steady_clock::time_point Start;
+    chrono::steady_clock::duration Elapsed;
+    chrono::steady_clock::duration MinTime;
+    const uint8_t *LineBuff;
+    uint32_t Len;
+    uint64_t Iterations;
+    uint64_t Batch;
+    uint64_t b;
+    uint64_t Hits;
+    double NS;
+    int Style;
+    size_t r;
+    vector<struct LineMatchSpan> Spans;
+    struct LineMatchSpanSet Set;
+
+    LineBuff=(const uint8_t *)Line.data();
+    Len=Line.length();
+    MinTime=chrono::milliseconds(MinMS);
+    Iterations=0;
+    Hits=0;
+    Style=-1;
+
+    if(Kernel==e_Kernel_Resolve)
+        BuildSpans(Spans,Rules,Len);
+
+    /* We double the number of passes between clock reads so reading the
+       clock doesn't swamp the small kernels */
+    Batch=1;
+    Start=chrono::steady_clock::now();
+    do
+    {
+        for(b=0;b<Batch;b++)
+        {
+            if(Kernel==e_Kernel_Resolve)
+            {
+                LineMatch_ClearSpans(&Set);
+                for(r=0;r<Spans.size();r++)
+                {
+                    LineMatch_AddSpan(&Set,Spans[r].Start,
+                            Spans[r].End-Spans[r].Start,Spans[r].StyleIndex);
+                }
+                LineMatch_MergeSpans(&Set);
+                Hits+=Set.Styles.size();
+                continue;
+            }
+            for(r=0;r<Rules.size();r++)
+            {
+                if(LineMatch_TestRule(&Rules[r],LineBuff,Len,0))
+                {
+                    Hits++;
+                    Style=Rules[r].StyleIndex;
+                }
+            }
+        }
+        Iterations+=Batch;
+        Batch*=2;
+        Elapsed=chrono::steady_clock::now()-Start;
+    } while(Elapsed<MinTime);
+    m_Sink=Style;
+
+    NS=chrono::duration<double,nano>(Elapsed).count()/Iterations;
+    printf("%s,%u,%u,%llu,%.1f,%.2f,%llu\n",m_KernelNames[Kernel],Len,
+            (unsigned)Rules.size(),(unsigned long long)Iterations,NS,
+            NS>0?(Len/NS)*1000.0:0.0,(unsigned long long)Hits);
+    fflush(stdout);
+}
@@ -0,0 +1,386 @@
+/*******************************************************************************
+ * FILENAME: ShardBench.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a bench mark for splitting a big rule set in to shards on the
+ *    worker pool (see AsyncMatch.cpp).  It runs the same lines and rules
+ *    through the workers with the rules in one piece (the serial run) and
+ *    then split in to shards with 1 to N workers, and prints the results as
+ *    CSV.  Every run's styles are checked against the serial run.
+ *
+ *    With 1 worker the rules are never split, so that row is the cost of
+ *    the worker pool on its own.
+ *
+ *    Usage:
+ *      ShardBench [--rules Count] [--lines Count] [--shard-rules Count]
+ *                 [--max-threads Count]
+ *
+ *    CSV columns:
+ *      threads,lines,rules,shard_rules,seconds,lines_per_sec,speedup,
+ *      digest,identical
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "AsyncMatch.h"
+#include "LineMatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define DEFAULT_RULES               2000
+#define DEFAULT_LINES               2000
+#define DEFAULT_SHARD_RULES         256
+#define JOB_RING_SIZE               256
+#define WAIT_US                     1000
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+static void BuildLines(vector<string> &Lines,unsigned int Count,
+        unsigned int RuleCount);
+static bool BuildRules(t_LineMatchRuleList &Rules,unsigned int Count);
+static bool RunLines(const vector<string> &Lines,
+        const t_LineMatchRuleList &Rules,uint32_t RulesPerShard,
+        double *Seconds,uint64_t *Digest);
+static void DigestJob(uint64_t *Digest,const struct AsyncMatchJob *Job);
+
+/*** VARIABLE DEFINITIONS     ***/
+static uint32_t m_RandSeed=0x12345678;
+
+static uint32_t BenchRand(void)
+{
+    /* xorshift32, we want the same lines every run */
+    m_RandSeed^=m_RandSeed<<13;
+    m_RandSeed^=m_RandSeed>>17;
+    m_RandSeed^=m_RandSeed<<5;
+    return m_RandSeed;
+}
+
+int main(int argc,char *argv[])
+{
+    unsigned int RuleCount;
+    unsigned int LineCount;
+    unsigned int ShardRules;
+    unsigned int MaxThreads;
+    unsigned int Threads;
+    int a;
+    vector<string> Lines;
+    t_LineMatchRuleList Rules;
+    double SerialSeconds;
+    double Seconds;
+    uint64_t SerialDigest;
+    uint64_t Digest;
+
+    RuleCount=DEFAULT_RULES;
+    LineCount=DEFAULT_LINES;
+    ShardRules=DEFAULT_SHARD_RULES;
+    MaxThreads=thread::hardware_concurrency();
+    if(MaxThreads<1)
+        MaxThreads=1;
+
+    for(a=1;a<argc;a++)
+    {
+        if(strcmp(argv[a],"--rules")==0 && a+1<argc)
+        {
+            RuleCount=strtoul(argv[++a],NULL,0);
+        }
+        else if(strcmp(argv[a],"--lines")==0 && a+1<argc)
+        {
+            LineCount=strtoul(argv[++a],NULL,0);
+        }
+        else if(strcmp(argv[a],"--shard-rules")==0 && a+1<argc)
+        {
+            ShardRules=strtoul(argv[++a],NULL,0);
+        }
+        else if(strcmp(argv[a],"--max-threads")==0 && a+1<argc)
+        {
+            MaxThreads=strtoul(argv[++a],NULL,0);
+        }
+        else
+        {
+            fprintf(stderr,"Usage: %s [--rules Count] [--lines Count] "
+                    "[--shard-rules Count] [--max-threads Count]\n",argv[0]);
+            return 1;
+        }
+    }
+    if(RuleCount<1 || LineCount<1 || ShardRules<1 || MaxThreads<1)
+    {
+        fprintf(stderr,"Counts must be at least 1\n");
+        return 1;
+    }
+
+    if(!BuildRules(Rules,RuleCount))
+    {
+        fprintf(stderr,"Failed to build the rules\n");
+        return 1;
+    }
+    BuildLines(Lines,LineCount,RuleCount);
+
+    printf("threads,lines,rules,shard_rules,seconds,lines_per_sec,speedup,"
+            "digest,identical\n");
+    fflush(stdout);
+
+    /* The serial run is one worker with the rules in one piece */
+    AsyncMatch_SetPoolSize(1);
+    if(!RunLines(Lines,Rules,0,&SerialSeconds,&SerialDigest))
+    {
+        fprintf(stderr,"Failed to start the workers\n");
+        return 1;
+    }
+    printf("serial,%u,%u,0,%.3f,%.0f,1.00,%016llx,yes\n",LineCount,RuleCount,
+            SerialSeconds,LineCount/SerialSeconds,
+            (unsigned long long)SerialDigest);
+    fflush(stdout);
+
+    for(Threads=1;Threads<=MaxThreads;Threads++)
+    {
+        AsyncMatch_SetPoolSize(Threads);
+        if(!RunLines(Lines,Rules,ShardRules,&Seconds,&Digest))
+        {
+            fprintf(stderr,"Failed to start %u workers\n",Threads);
+            return 1;
+        }
+        printf("%u,%u,%u,%u,%.3f,%.0f,%.2f,%016llx,%s\n",Threads,LineCount,
+                RuleCount,ShardRules,Seconds,LineCount/Seconds,
+                SerialSeconds/Seconds,(unsigned long long)Digest,
+                Digest==SerialDigest?"yes":"no");
+        fflush(stdout);
+    }
+
+    AsyncMatch_SetPoolSize(0);
+
+    return 0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildLines
+ *
+ * SYNOPSIS:
+ *    static void BuildLines(vector<string> &Lines,unsigned int Count,
+ *          unsigned int RuleCount);
+ *
+ * PARAMETERS:
+ *    Lines [O] -- The lines
+ *    Count [I] -- How many lines to make
+ *    RuleCount [I] -- The number of rules from BuildRules()
+ *
+ * FUNCTION:
+ *    This function makes log like lines with a few keys in them that some
+ *    of the rules from BuildRules() will match.  Most rules don't match
+ *    any given line, like a big rule set on a real log.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void BuildLines(vector<string> &Lines,unsigned int Count,
+        unsigned int RuleCount)
+{
+    static const char Words[]="abcdefghijklmnopqrstuvwxyz0123456789 :.[]=-";
+    char buff[100];
+    unsigned int l;
+    unsigned int k;
+    unsigned int r;
+
+    Lines.resize(Count);
+    for(l=0;l<Count;l++)
+    {
+        Lines[l].clear();
+        for(k=0;k<4;k++)
+        {
+            sprintf(buff,"key%u=%u ",BenchRand()%RuleCount,BenchRand()%1000);
+            Lines[l]+=buff;
+            for(r=0;r<24;r++)
+                Lines[l]+=Words[BenchRand()%(sizeof(Words)-1)];
+            Lines[l]+=' ';
+        }
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildRules
+ *
+ * SYNOPSIS:
+ *    static bool BuildRules(t_LineMatchRuleList &Rules,unsigned int Count);
+ *
+ * PARAMETERS:
+ *    Rules [O] -- The rules
+ *    Count [I] -- How many rules to make
+ *
+ * FUNCTION:
+ *    This function builds a rule set of "contains" and regex rules, all
+ *    only highlighting the match.  Rule 'n' looks for "key<n>=" so the
+ *    overlapping styles of the matches have to come out in rule order.
+ *
+ * RETURNS:
+ *    true -- Things worked out
+ *    false -- A rule could not be added
+ ******************************************************************************/
+static bool BuildRules(t_LineMatchRuleList &Rules,unsigned int Count)
+{
+    char buff[100];
+    unsigned int r;
+
+    Rules.clear();
+    for(r=0;r<Count;r++)
+    {
+        if(r%2==0)
+        {
+            sprintf(buff,"key%u=",r);
+            if(!LineMatch_AddRule(Rules,e_LineMatchRule_Contains,buff,r%8,
+                    true))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            sprintf(buff,"key%u=[0-9]+",r);
+            if(!LineMatch_AddRule(Rules,e_LineMatchRule_Regex,buff,r%8,true))
+                return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    RunLines
+ *
+ * SYNOPSIS:
+ *    static bool RunLines(const vector<string> &Lines,
+ *          const t_LineMatchRuleList &Rules,uint32_t RulesPerShard,
+ *          double *Seconds,uint64_t *Digest);
+ *
+ * PARAMETERS:
+ *    Lines [I] -- The lines to check
+ *    Rules [I] -- The rules to check them with
+ *    RulesPerShard [I] -- Passed to AsyncMatch_Start()
+ *    Seconds [O] -- How long it took
+ *    Digest [O] -- A hash of the styles and hits of every line
+ *
+ * FUNCTION:
+ *    This function feeds the lines through a matcher like a connection
+ *    would (keeping the job ring as full as it can) and waits for the last
+ *    line to be checked.
+ *
+ * RETURNS:
+ *    true -- Things worked out
+ *    false -- The matcher could not be started
+ ******************************************************************************/
+static bool RunLines(const vector<string> &Lines,
+        const t_LineMatchRuleList &Rules,uint32_t RulesPerShard,
+        double *Seconds,uint64_t *Digest)
+{
+    struct AsyncMatcher *Async;
+    struct AsyncMatchJob *Job;
+    chrono::steady_clock::time_point Start;
+    size_t Sent;
+    size_t Got;
+
+    Async=AsyncMatch_Start(Rules,JOB_RING_SIZE,RulesPerShard);
+    if(Async==NULL)
+        return false;
+
+    *Digest=14695981039346656037ULL;
+    Start=chrono::steady_clock::now();
+    Sent=0;
+    Got=0;
+    while(Got<Lines.size())
+    {
+        while(Sent<Lines.size() && (Job=AsyncMatch_GetFreeJob(Async))!=NULL)
+        {
+            Job->Line.assign(Lines[Sent].begin(),Lines[Sent].end());
+            Job->Len=Job->Line.size();
+            AsyncMatch_QueueJob(Async);
+            Sent++;
+        }
+
+        if(AsyncMatch_GetDoneJob(Async)==NULL)
+            AsyncMatch_WaitIdle(Async,WAIT_US);
+        while((Job=AsyncMatch_GetDoneJob(Async))!=NULL)
+        {
+            DigestJob(Digest,Job);
+            AsyncMatch_FreeJob(Async);
+            Got++;
+        }
+    }
+    *Seconds=chrono::duration<double>(chrono::steady_clock::now()-Start).
+            count();
+
+    AsyncMatch_Free(Async);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    DigestJob
+ *
+ * SYNOPSIS:
+ *    static void DigestJob(uint64_t *Digest,const struct AsyncMatchJob *Job);
+ *
+ * PARAMETERS:
+ *    Digest [I/O] -- The hash to add to
+ *    Job [I] -- The checked job
+ *
+ * FUNCTION:
+ *    This function adds a job's styles (in the order they would be
+ *    applied) and hits to an FNV-1a hash.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void DigestJob(uint64_t *Digest,const struct AsyncMatchJob *Job)
+{
+    uint32_t Values[3];
+    const uint8_t *Bytes;
+    size_t s;
+    size_t b;
+
+    for(s=0;s<Job->Styles.size();s++)
+    {
+        Values[0]=Job->Styles[s].Offset;
+        Values[1]=Job->Styles[s].Len;
+        Values[2]=Job->Styles[s].StyleIndex;
+        Bytes=(const uint8_t *)Values;
+        for(b=0;b<sizeof(Values);b++)
+            *Digest=(*Digest^Bytes[b])*1099511628211ULL;
+    }
+    for(b=0;b<Job->Hits.size();b++)
+        *Digest=(*Digest^Job->Hits[b])*1099511628211ULL;
+    *Digest=(*Digest^0xFF)*1099511628211ULL;
+}
@@ -0,0 +1,1016 @@
+/*******************************************************************************
+ * FILENAME: HostStub.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a stand in for WhippyTerm that the tools link with the plugin.
+ *    It has just enough of the DPS API for the highlighter to run: a
+ *    screen buffer per connection, marks into that buffer and the style
+ *    calls (which are counted and hashed so output can be compared between
+ *    runs).
+ *
+ *    The screen buffer only keeps 'SCREEN_KEEP_BYTES' of scroll back.  When
+ *    it is trimmed any marks pointing at the removed text become invalid
+ *    (IsMarkValid() returns false) like WhippyTerm does when the scroll
+ *    back is trimmed.  The start of each line in the buffer is kept for
+ *    the DPS_API_VERSION_4 scroll back calls.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "Common/HostStub.h"
+#include "PluginSDK/Plugin.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <string>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define HOSTSTUB_WHIPPYTERM_VERSION         DPS_API_VERSION_4_WHIPPYTERM_VERSION
+#define SCREEN_TRIM_BYTES                   (4*1024*1024)
+#define SCREEN_KEEP_BYTES                   (1*1024*1024)
+
+#define FNV_OFFSET_BASIS                    0xCBF29CE484222325ULL
+#define FNV_PRIME                           0x00000100000001B3ULL
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+struct HostStubMark
+{
+    struct HostStubConnection *Con;
+    uint64_t Pos;               // Absolute offset into the stream
+    bool Valid;
+};
+
+struct HostStubConnection
+{
+    t_DataProcessorHandleType *Handle;
+    string Screen;              // The text on the "screen"
+    uint64_t ScreenBase;        // The absolute offset of Screen[0]
+    string MarkStr;             // Buffer returned from GetMarkString()
+    list<struct HostStubMark *> Marks;
+    struct HostStubCounters Counters;
+
+    /* The absolute offset of the start of each line from 'FirstLine' on
+       (the last one is the line the cursor is on) */
+    deque<uint64_t> LineStarts;
+    uint64_t FirstLine;
+};
+
+typedef enum
+{
+    e_StyleCall_Attrib,
+    e_StyleCall_FGColor,
+    e_StyleCall_BGColor,
+    e_StyleCall_ULineColor,
+    e_StyleCallMAX
+} e_StyleCallType;
+
+/*** FUNCTION PROTOTYPES      ***/
+extern "C" unsigned int RegisterPlugin(const struct PI_SystemAPI *SysAPI,
+        unsigned int Version);
+
+static const struct IOS_API *HS_GetAPI_IO(void);
+static const struct DPS_API *HS_GetAPI_DataProcessors(void);
+static const struct FTPS_API *HS_GetAPI_FileTransfersProtocol(void);
+static void HS_KVClear(t_PIKVList *Handle);
+static PG_BOOL HS_KVAddItem(t_PIKVList *Handle,const char *Key,const char *Value);
+static const char *HS_KVGetItem(const t_PIKVList *Handle,const char *Key);
+static uint32_t HS_GetExperimentalID(void);
+static PG_BOOL HS_RegisterDataProcessor(const char *ProID,
+        const struct DataProcessorAPI *ProAPI,int SizeOfProAPI);
+static const struct PI_UIAPI *HS_GetAPI_UI(void);
+static void HS_SetCurrentSettingsTabName(const char *Name);
+static t_WidgetSysHandle *HS_AddNewSettingsTab(const char *Name);
+static t_DataProMark *HS_AllocateMark(void);
+static void HS_FreeMark(t_DataProMark *Mark);
+static PG_BOOL HS_IsMarkValid(t_DataProMark *Mark);
+static void HS_SetMark2CursorPos(t_DataProMark *Mark);
+static void HS_ApplyAttrib2Mark(t_DataProMark *Mark,uint32_t Attrib,
+        uint32_t Offset,uint32_t Len);
+static void HS_RemoveAttribFromMark(t_DataProMark *Mark,uint32_t Attrib,
+        uint32_t Offset,uint32_t Len);
+static void HS_ApplyFGColor2Mark(t_DataProMark *Mark,uint32_t FGColor,
+        uint32_t Offset,uint32_t Len);
+static void HS_ApplyBGColor2Mark(t_DataProMark *Mark,uint32_t BGColor,
+        uint32_t Offset,uint32_t Len);
+static void HS_MoveMark(t_DataProMark *Mark,int Amount);
+static const uint8_t *HS_GetMarkString(t_DataProMark *Mark,uint32_t *Size,
+        uint32_t Offset,uint32_t Len);
+static void HS_FreezeStream(void);
+static void HS_ClearFrozenStream(void);
+static void HS_ReleaseFrozenStream(void);
+static const uint8_t *HS_GetFrozenString(uint32_t *Size);
+static void HS_ApplyStyle2Mark(t_DataProMark *Mark,uint32_t FGColor,
+        uint32_t BGColor,uint32_t Attribs,uint32_t ULineColor,uint32_t Offset,
+        uint32_t Len,uint32_t Mask);
+static uint32_t HS_GetSysDefaultColor(uint32_t DefaultColor);
+static void HS_GetScrollBackLines(uint64_t *FirstLine,uint64_t *EndLine);
+static const uint8_t *HS_GetScrollBackLine(uint64_t Line,uint32_t *Size);
+static PG_BOOL HS_SetMark2ScrollBackLine(t_DataProMark *Mark,uint64_t Line);
+static void HS_RecordStyle(struct HostStubMark *Mark,e_StyleCallType Call,
+        uint32_t Value,uint32_t Offset,uint32_t Len);
+static void HS_AddToScreen(struct HostStubConnection *Con,const char *Str,
+        size_t Len);
+static void HS_TrimScreen(struct HostStubConnection *Con);
+static bool HS_HaveBlockAPI(void);
+static bool HS_HaveIdleAPI(void);
+
+/*** VARIABLE DEFINITIONS     ***/
+static struct PI_SystemAPI m_HS_SysAPI;
+static struct DPS_API m_HS_DPS;
+static struct PI_UIAPI m_HS_UI;
+static const struct DataProcessorAPI *m_HS_PluginAPI;
+static int m_HS_PluginAPISize;
+static bool m_HS_UseBlockAPI;
+
+/* The connection that is being fed (WhippyTerm does the same thing, the DPS
+   calls always work on the connection that is being processed) */
+static struct HostStubConnection *m_HS_CurrentCon;
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_Init
+ *
+ * SYNOPSIS:
+ *    bool HostStub_Init(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function sets up the fake WhippyTerm API's and registers the
+ *    plugin.  We act like the newest WhippyTerm we know about.
+ *
+ * RETURNS:
+ *    true -- Things worked out
+ *    false -- The plugin didn't register
+ *
+ * SEE ALSO:
+ *    HostStub_InitVersion()
+ ******************************************************************************/
+bool HostStub_Init(void)
+{
+    return HostStub_InitVersion(HOSTSTUB_WHIPPYTERM_VERSION);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_InitVersion
+ *
+ * SYNOPSIS:
+ *    bool HostStub_InitVersion(unsigned int Version);
+ *
+ * PARAMETERS:
+ *    Version [I] -- The WhippyTerm version to act like (in the
+ *                   Major<<24 | Minor<<16 | Rev<<8 | Patch format).
+ *
+ * FUNCTION:
+ *    This function is the same as HostStub_Init() but lets you pick what
+ *    version of WhippyTerm the plugin sees.  The DPS_API functions that
+ *    version didn't have are left NULL.
+ *
+ * RETURNS:
+ *    true -- Things worked out
+ *    false -- The plugin didn't register
+ *
+ * SEE ALSO:
+ *    HostStub_Init()
+ ******************************************************************************/
+bool HostStub_InitVersion(unsigned int Version)
+{
+    memset(&m_HS_SysAPI,0x00,sizeof(m_HS_SysAPI));
+    memset(&m_HS_DPS,0x00,sizeof(m_HS_DPS));
+    memset(&m_HS_UI,0x00,sizeof(m_HS_UI));
+    m_HS_PluginAPI=NULL;
+    m_HS_PluginAPISize=0;
+    m_HS_UseBlockAPI=true;
+    m_HS_CurrentCon=NULL;
+
+    m_HS_SysAPI.GetAPI_IO=HS_GetAPI_IO;
+    m_HS_SysAPI.GetAPI_DataProcessors=HS_GetAPI_DataProcessors;
+    m_HS_SysAPI.GetAPI_FileTransfersProtocol=HS_GetAPI_FileTransfersProtocol;
+    m_HS_SysAPI.KVClear=HS_KVClear;
+    m_HS_SysAPI.KVAddItem=HS_KVAddItem;
+    m_HS_SysAPI.KVGetItem=HS_KVGetItem;
+    m_HS_SysAPI.GetExperimentalID=HS_GetExperimentalID;
+
+    m_HS_DPS.RegisterDataProcessor=HS_RegisterDataProcessor;
+    m_HS_DPS.GetAPI_UI=HS_GetAPI_UI;
+    m_HS_DPS.GetSysDefaultColor=HS_GetSysDefaultColor;
+    m_HS_DPS.SetCurrentSettingsTabName=HS_SetCurrentSettingsTabName;
+    m_HS_DPS.AddNewSettingsTab=HS_AddNewSettingsTab;
+    m_HS_DPS.AllocateMark=HS_AllocateMark;
+    m_HS_DPS.FreeMark=HS_FreeMark;
+    m_HS_DPS.IsMarkValid=HS_IsMarkValid;
+    m_HS_DPS.SetMark2CursorPos=HS_SetMark2CursorPos;
+    m_HS_DPS.ApplyAttrib2Mark=HS_ApplyAttrib2Mark;
+    m_HS_DPS.RemoveAttribFromMark=HS_RemoveAttribFromMark;
+    m_HS_DPS.ApplyFGColor2Mark=HS_ApplyFGColor2Mark;
+    m_HS_DPS.ApplyBGColor2Mark=HS_ApplyBGColor2Mark;
+    m_HS_DPS.MoveMark=HS_MoveMark;
+    m_HS_DPS.GetMarkString=HS_GetMarkString;
+    m_HS_DPS.FreezeStream=HS_FreezeStream;
+    m_HS_DPS.ClearFrozenStream=HS_ClearFrozenStream;
+    m_HS_DPS.ReleaseFrozenStream=HS_ReleaseFrozenStream;
+    m_HS_DPS.GetFrozenString=HS_GetFrozenString;
+    if(Version>=DPS_API_VERSION_3_WHIPPYTERM_VERSION)
+        m_HS_DPS.ApplyStyle2Mark=HS_ApplyStyle2Mark;
+    if(Version>=DPS_API_VERSION_4_WHIPPYTERM_VERSION)
+    {
+        m_HS_DPS.GetScrollBackLines=HS_GetScrollBackLines;
+        m_HS_DPS.GetScrollBackLine=HS_GetScrollBackLine;
+        m_HS_DPS.SetMark2ScrollBackLine=HS_SetMark2ScrollBackLine;
+    }
+
+    if(RegisterPlugin(&m_HS_SysAPI,Version)!=0)
+        return false;
+
+    return m_HS_PluginAPI!=NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_LoadSettings
+ *
+ * SYNOPSIS:
+ *    bool HostStub_LoadSettings(const char *Filename,
+ *          t_HostStubKVList &Settings);
+ *
+ * PARAMETERS:
+ *    Filename [I] -- The file to load
+ *    Settings [O] -- The settings that where read
+ *
+ * FUNCTION:
+ *    This function reads a rule profile.  The file has one "Key=Value" per
+ *    line using the same keys the plugin saves in its settings.  Blank lines
+ *    and lines starting with '#' are skipped.
+ *
+ * RETURNS:
+ *    true -- The file was read
+ *    false -- The file could not be opened
+ ******************************************************************************/
+bool HostStub_LoadSettings(const char *Filename,t_HostStubKVList &Settings)
+{
+    FILE *in;
+    char buff[1000];
+    char *Equ;
+    size_t Len;
+
+    in=fopen(Filename,"r");
+    if(in==NULL)
+        return false;
+
+    Settings.clear();
+    while(fgets(buff,sizeof(buff),in)!=NULL)
+    {
+        Len=strlen(buff);
+        while(Len>0 && (buff[Len-1]=='\n' || buff[Len-1]=='\r'))
+            buff[--Len]=0;
+        if(buff[0]=='#' || buff[0]==0)
+            continue;
+        Equ=strchr(buff,'=');
+        if(Equ==NULL)
+            continue;
+        *Equ=0;
+        Settings[buff]=Equ+1;
+    }
+    fclose(in);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_AllocConnection
+ *
+ * SYNOPSIS:
+ *    struct HostStubConnection *HostStub_AllocConnection(
+ *          const t_HostStubKVList &Settings);
+ *
+ * PARAMETERS:
+ *    Settings [I] -- The settings to apply to the plugin for this connection
+ *
+ * FUNCTION:
+ *    This function makes a new connection with the plugin added to it.
+ *
+ * RETURNS:
+ *    The new connection or NULL if there was an error.
+ ******************************************************************************/
+struct HostStubConnection *HostStub_AllocConnection(
+        const t_HostStubKVList &Settings)
+{
+    struct HostStubConnection *Con;
+
+    Con=NULL;
+    try
+    {
+        Con=new struct HostStubConnection;
+        Con->Handle=NULL;
+        Con->ScreenBase=0;
+        Con->LineStarts.push_back(0);
+        Con->FirstLine=0;
+        memset(&Con->Counters,0x00,sizeof(Con->Counters));
+        Con->Counters.StyleDigest=FNV_OFFSET_BASIS;
+
+        m_HS_CurrentCon=Con;
+        Con->Handle=m_HS_PluginAPI->AllocateData();
+        if(Con->Handle==NULL)
+            throw(0);
+
+        m_HS_PluginAPI->ApplySettings(Con->Handle,
+                (t_PIKVList *)&Settings);
+    }
+    catch(...)
+    {
+        if(Con!=NULL)
+            delete Con;
+        return NULL;
+    }
+    return Con;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_FreeConnection
+ *
+ * SYNOPSIS:
+ *    void HostStub_FreeConnection(struct HostStubConnection *Con);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection to free
+ *
+ * FUNCTION:
+ *    This function frees a connection (and the plugin data on it).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void HostStub_FreeConnection(struct HostStubConnection *Con)
+{
+    list<struct HostStubMark *>::iterator i;
+
+    m_HS_CurrentCon=Con;
+    m_HS_PluginAPI->FreeData(Con->Handle);
+
+    /* Anything the plugin didn't free */
+    for(i=Con->Marks.begin();i!=Con->Marks.end();i++)
+        delete *i;
+
+    if(m_HS_CurrentCon==Con)
+        m_HS_CurrentCon=NULL;
+
+    delete Con;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_FeedByte
+ *
+ * SYNOPSIS:
+ *    void HostStub_FeedByte(struct HostStubConnection *Con,uint8_t Byte);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection the byte came in on
+ *    Byte [I] -- The byte
+ *
+ * FUNCTION:
+ *    This function sends a byte to the plugin and then adds it to the
+ *    screen if the plugin didn't consume it.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void HostStub_FeedByte(struct HostStubConnection *Con,uint8_t Byte)
+{
+    uint8_t ProcessedChar[8];
+    int CharLen;
+    PG_BOOL Consumed;
+
+    m_HS_CurrentCon=Con;
+
+    ProcessedChar[0]=Byte;
+    CharLen=1;
+    Consumed=false;
+    m_HS_PluginAPI->ProcessIncomingTextByte(Con->Handle,Byte,ProcessedChar,
+            &CharLen,&Consumed);
+
+    Con->Counters.Bytes++;
+    if(Byte=='\n')
+        Con->Counters.Lines++;
+
+    if(!Consumed)
+        HS_AddToScreen(Con,(char *)ProcessedChar,CharLen);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_Feed
+ *
+ * SYNOPSIS:
+ *    void HostStub_Feed(struct HostStubConnection *Con,const uint8_t *Buff,
+ *          uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection the bytes came in on
+ *    Buff [I] -- The bytes
+ *    Len [I] -- The number of bytes in 'Buff'
+ *
+ * FUNCTION:
+ *    This function sends a block of bytes to the plugin.  If the plugin
+ *    has ProcessIncomingTextBlock() (and HostStub_UseBlockAPI() hasn't
+ *    turned it off) the bytes are given to it in blocks the way a
+ *    DATA_PROCESSORS_API_VERSION_4 host does, otherwise they are sent one
+ *    byte at a time.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void HostStub_Feed(struct HostStubConnection *Con,const uint8_t *Buff,
+        uint32_t Len)
+{
+    uint32_t r;
+    int Handled;
+
+    if(!m_HS_UseBlockAPI || !HS_HaveBlockAPI())
+    {
+        for(r=0;r<Len;r++)
+            HostStub_FeedByte(Con,Buff[r]);
+        return;
+    }
+
+    m_HS_CurrentCon=Con;
+    while(Len>0)
+    {
+        Handled=m_HS_PluginAPI->ProcessIncomingTextBlock(Con->Handle,Buff,
+                Len>0x7FFFFFFF?0x7FFFFFFF:Len);
+        if(Handled<=0 || (uint32_t)Handled>Len)
+        {
+            /* A broken plugin, just give it the byte */
+            HostStub_FeedByte(Con,*Buff);
+            Handled=1;
+        }
+        else
+        {
+            Con->Counters.Bytes+=Handled;
+            Con->Counters.Lines+=count(Buff,Buff+Handled,'\n');
+            HS_AddToScreen(Con,(const char *)Buff,Handled);
+        }
+        Buff+=Handled;
+        Len-=Handled;
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_UseBlockAPI
+ *
+ * SYNOPSIS:
+ *    bool HostStub_UseBlockAPI(bool Use);
+ *
+ * PARAMETERS:
+ *    Use [I] -- Should HostStub_Feed() use the plugin's
+ *               ProcessIncomingTextBlock() (if it has one).  false makes
+ *               us act like a host from before DATA_PROCESSORS_API_VERSION_4.
+ *
+ * FUNCTION:
+ *    This function picks how HostStub_Feed() gives bytes to the plugin.
+ *
+ * RETURNS:
+ *    true -- The block API will be used
+ *    false -- Bytes will be sent one at a time
+ ******************************************************************************/
+bool HostStub_UseBlockAPI(bool Use)
+{
+    m_HS_UseBlockAPI=Use;
+
+    return m_HS_UseBlockAPI && HS_HaveBlockAPI();
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HS_HaveBlockAPI
+ *
+ * SYNOPSIS:
+ *    static bool HS_HaveBlockAPI(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function checks if the plugin registered a struct DataProcessorAPI
+ *    big enough to have ProcessIncomingTextBlock() in it (and filled it in).
+ *
+ * RETURNS:
+ *    true -- The plugin has ProcessIncomingTextBlock()
+ *    false -- It's an older plugin
+ ******************************************************************************/
+static bool HS_HaveBlockAPI(void)
+{
+    return m_HS_PluginAPI!=NULL &&
+            m_HS_PluginAPISize>=(int)(offsetof(struct DataProcessorAPI,
+            ProcessIncomingTextBlock)+sizeof(m_HS_PluginAPI->
+            ProcessIncomingTextBlock)) &&
+            m_HS_PluginAPI->ProcessIncomingTextBlock!=NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_GetCounters
+ *
+ * SYNOPSIS:
+ *    void HostStub_GetCounters(struct HostStubConnection *Con,
+ *          struct HostStubCounters *Counters);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection to get the counters for
+ *    Counters [O] -- The counters
+ *
+ * FUNCTION:
+ *    This function gets a copy of what the host has seen on a connection.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void HostStub_GetCounters(struct HostStubConnection *Con,
+        struct HostStubCounters *Counters)
+{
+    *Counters=Con->Counters;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_ApplySettings
+ *
+ * SYNOPSIS:
+ *    void HostStub_ApplySettings(struct HostStubConnection *Con,
+ *          const t_HostStubKVList &Settings);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection to change
+ *    Settings [I] -- The new settings
+ *
+ * FUNCTION:
+ *    This function gives the plugin new settings in the middle of a
+ *    connection, like when the user changes them in WhippyTerm.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+void HostStub_ApplySettings(struct HostStubConnection *Con,
+        const t_HostStubKVList &Settings)
+{
+    m_HS_CurrentCon=Con;
+    m_HS_PluginAPI->ApplySettings(Con->Handle,(t_PIKVList *)&Settings);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HostStub_Idle
+ *
+ * SYNOPSIS:
+ *    bool HostStub_Idle(struct HostStubConnection *Con);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection that is idle
+ *
+ * FUNCTION:
+ *    This function calls the plugin's ProcessIdle() (if it has one) the way
+ *    a DATA_PROCESSORS_API_VERSION_5 host does when no bytes are coming in.
+ *
+ * RETURNS:
+ *    true -- ProcessIdle() was called
+ *    false -- The plugin doesn't have ProcessIdle()
+ ******************************************************************************/
+bool HostStub_Idle(struct HostStubConnection *Con)
+{
+    if(!HS_HaveIdleAPI())
+        return false;
+
+    m_HS_CurrentCon=Con;
+    m_HS_PluginAPI->ProcessIdle(Con->Handle);
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HS_HaveIdleAPI
+ *
+ * SYNOPSIS:
+ *    static bool HS_HaveIdleAPI(void);
+ *
+ * PARAMETERS:
+ *    NONE
+ *
+ * FUNCTION:
+ *    This function checks if the plugin registered a struct DataProcessorAPI
+ *    big enough to have ProcessIdle() in it (and filled it in).
+ *
+ * RETURNS:
+ *    true -- The plugin has ProcessIdle()
+ *    false -- It's an older plugin
+ ******************************************************************************/
+static bool HS_HaveIdleAPI(void)
+{
+    return m_HS_PluginAPI!=NULL &&
+            m_HS_PluginAPISize>=(int)(offsetof(struct DataProcessorAPI,
+            ProcessIdle)+sizeof(m_HS_PluginAPI->ProcessIdle)) &&
+            m_HS_PluginAPI->ProcessIdle!=NULL;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HS_TrimScreen
+ *
+ * SYNOPSIS:
+ *    static void HS_TrimScreen(struct HostStubConnection *Con);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection to trim
+ *
+ * FUNCTION:
+ *    This function throws away the old part of the screen buffer.  Any marks
+ *    that pointed into the part that was thrown away become invalid.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void HS_TrimScreen(struct HostStubConnection *Con)
+{
+    list<struct HostStubMark *>::iterator i;
+    size_t Remove;
+
+    Remove=Con->Screen.length()-SCREEN_KEEP_BYTES;
+    Con->Screen.erase(0,Remove);
+    Con->ScreenBase+=Remove;
+
+    for(i=Con->Marks.begin();i!=Con->Marks.end();i++)
+        if((*i)->Pos<Con->ScreenBase)
+            (*i)->Valid=false;
+
+    /* Lines that lost their start are gone from the scroll back */
+    while(Con->LineStarts.size()>1 && Con->LineStarts.front()<Con->ScreenBase)
+    {
+        Con->LineStarts.pop_front();
+        Con->FirstLine++;
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HS_AddToScreen
+ *
+ * SYNOPSIS:
+ *    static void HS_AddToScreen(struct HostStubConnection *Con,
+ *          const char *Str,size_t Len);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection to add to
+ *    Str [I] -- The text to add
+ *    Len [I] -- The number of bytes in 'Str'
+ *
+ * FUNCTION:
+ *    This function adds text at the cursor, notes where the new lines
+ *    start and trims the screen buffer if it has gotten too big.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void HS_AddToScreen(struct HostStubConnection *Con,const char *Str,
+        size_t Len)
+{
+    uint64_t Pos;
+    size_t r;
+
+    Pos=Con->ScreenBase+Con->Screen.length();
+    for(r=0;r<Len;r++)
+        if(Str[r]=='\n')
+            Con->LineStarts.push_back(Pos+r+1);
+
+    Con->Screen.append(Str,Len);
+    if(Con->Screen.length()>SCREEN_TRIM_BYTES)
+        HS_TrimScreen(Con);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    HS_RecordStyle
+ *
+ * SYNOPSIS:
+ *    static void HS_RecordStyle(struct HostStubMark *Mark,
+ *          e_StyleCallType Call,uint32_t Value,uint32_t Offset,uint32_t Len);
+ *
+ * PARAMETERS:
+ *    Mark [I] -- The mark the style was applied to
+ *    Call [I] -- What style call this was
+ *    Value [I] -- The attrib / color value
+ *    Offset [I] -- The offset from the mark
+ *    Len [I] -- The number of bytes (0 = to the cursor)
+ *
+ * FUNCTION:
+ *    This function adds a style to the style digest.  The digest is a
+ *    FNV-1a hash of the absolute range and value so two runs that styled
+ *    the same text the same way have the same digest (no matter if it was
+ *    done with one ApplyStyle2Mark() or the Apply*2Mark() calls).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void HS_RecordStyle(struct HostStubMark *Mark,e_StyleCallType Call,
+        uint32_t Value,uint32_t Offset,uint32_t Len)
+{
+    struct HostStubConnection *Con=Mark->Con;
+    uint64_t Fields[4];
+    uint64_t Hash;
+    const uint8_t *Bytes;
+    uint64_t Cursor;
+    unsigned int r;
+
+    Cursor=Con->ScreenBase+Con->Screen.length();
+
+    Fields[0]=Call;
+    Fields[1]=Mark->Pos+Offset;
+    Fields[2]=Len!=0?Len:Cursor-Fields[1];
+    Fields[3]=Value;
+
+    Hash=Con->Counters.StyleDigest;
+    Bytes=(const uint8_t *)Fields;
+    for(r=0;r<sizeof(Fields);r++)
+    {
+        Hash^=Bytes[r];
+        Hash*=FNV_PRIME;
+    }
+    Con->Counters.StyleDigest=Hash;
+}
+
+/* PI_SystemAPI */
+static const struct IOS_API *HS_GetAPI_IO(void)
+{
+    return NULL;
+}
+
+static const struct DPS_API *HS_GetAPI_DataProcessors(void)
+{
+    return &m_HS_DPS;
+}
+
+static const struct FTPS_API *HS_GetAPI_FileTransfersProtocol(void)
+{
+    return NULL;
+}
+
+static void HS_KVClear(t_PIKVList *Handle)
+{
+    ((t_HostStubKVList *)Handle)->clear();
+}
+
+static PG_BOOL HS_KVAddItem(t_PIKVList *Handle,const char *Key,const char *Value)
+{
+    (*(t_HostStubKVList *)Handle)[Key]=Value;
+    return true;
+}
+
+static const char *HS_KVGetItem(const t_PIKVList *Handle,const char *Key)
+{
+    const t_HostStubKVList *KV=(const t_HostStubKVList *)Handle;
+    t_HostStubKVList::const_iterator i;
+
+    i=KV->find(Key);
+    if(i==KV->end())
+        return NULL;
+    return i->second.c_str();
+}
+
+static uint32_t HS_GetExperimentalID(void)
+{
+    return 0;
+}
+
+/* DPS_API */
+static PG_BOOL HS_RegisterDataProcessor(const char *ProID,
+        const struct DataProcessorAPI *ProAPI,int SizeOfProAPI)
+{
+    m_HS_PluginAPI=ProAPI;
+    m_HS_PluginAPISize=SizeOfProAPI;
+    return true;
+}
+
+static const struct PI_UIAPI *HS_GetAPI_UI(void)
+{
+    return &m_HS_UI;
+}
+
+static uint32_t HS_GetSysDefaultColor(uint32_t DefaultColor)
+{
+    return DefaultColor==e_DefaultColors_BG?0x000000:0xFFFFFF;
+}
+
+static void HS_SetCurrentSettingsTabName(const char *Name)
+{
+}
+
+static t_WidgetSysHandle *HS_AddNewSettingsTab(const char *Name)
+{
+    return NULL;
+}
+
+static t_DataProMark *HS_AllocateMark(void)
+{
+    struct HostStubMark *Mark;
+
+    if(m_HS_CurrentCon==NULL)
+        return NULL;
+
+    Mark=new struct HostStubMark;
+    Mark->Con=m_HS_CurrentCon;
+    Mark->Pos=m_HS_CurrentCon->ScreenBase+m_HS_CurrentCon->Screen.length();
+    Mark->Valid=true;
+    m_HS_CurrentCon->Marks.push_back(Mark);
+
+    return (t_DataProMark *)Mark;
+}
+
+static void HS_FreeMark(t_DataProMark *Mark)
+{
+    struct HostStubMark *HSMark=(struct HostStubMark *)Mark;
+
+    HSMark->Con->Marks.remove(HSMark);
+    delete HSMark;
+}
+
+static PG_BOOL HS_IsMarkValid(t_DataProMark *Mark)
+{
+    return ((struct HostStubMark *)Mark)->Valid;
+}
+
+static void HS_SetMark2CursorPos(t_DataProMark *Mark)
+{
+    struct HostStubMark *HSMark=(struct HostStubMark *)Mark;
+
+    HSMark->Pos=HSMark->Con->ScreenBase+HSMark->Con->Screen.length();
+    HSMark->Valid=true;
+}
+
+static void HS_ApplyAttrib2Mark(t_DataProMark *Mark,uint32_t Attrib,
+        uint32_t Offset,uint32_t Len)
+{
+    ((struct HostStubMark *)Mark)->Con->Counters.StyleCalls++;
+    HS_RecordStyle((struct HostStubMark *)Mark,e_StyleCall_Attrib,Attrib,
+            Offset,Len);
+}
+
+static void HS_RemoveAttribFromMark(t_DataProMark *Mark,uint32_t Attrib,
+        uint32_t Offset,uint32_t Len)
+{
+}
+
+static void HS_ApplyFGColor2Mark(t_DataProMark *Mark,uint32_t FGColor,
+        uint32_t Offset,uint32_t Len)
+{
+    ((struct HostStubMark *)Mark)->Con->Counters.StyleCalls++;
+    HS_RecordStyle((struct HostStubMark *)Mark,e_StyleCall_FGColor,FGColor,
+            Offset,Len);
+}
+
+static void HS_ApplyBGColor2Mark(t_DataProMark *Mark,uint32_t BGColor,
+        uint32_t Offset,uint32_t Len)
+{
+    ((struct HostStubMark *)Mark)->Con->Counters.StyleCalls++;
+    HS_RecordStyle((struct HostStubMark *)Mark,e_StyleCall_BGColor,BGColor,
+            Offset,Len);
+}
+
+static void HS_MoveMark(t_DataProMark *Mark,int Amount)
+{
+    ((struct HostStubMark *)Mark)->Pos+=Amount;
+}
+
+static const uint8_t *HS_GetMarkString(t_DataProMark *Mark,uint32_t *Size,
+        uint32_t Offset,uint32_t Len)
+{
+    struct HostStubMark *HSMark=(struct HostStubMark *)Mark;
+    struct HostStubConnection *Con=HSMark->Con;
+    uint64_t Start;
+    uint64_t Cursor;
+
+    Con->Counters.MarkStringCalls++;
+
+    Cursor=Con->ScreenBase+Con->Screen.length();
+    Start=HSMark->Pos+Offset;
+    if(!HSMark->Valid || Start<Con->ScreenBase || Start>Cursor)
+        return NULL;
+    if(Len==0 || Start+Len>Cursor)
+        Len=Cursor-Start;
+
+    /* Like WhippyTerm we hand back a copy */
+    Con->MarkStr.assign(Con->Screen,Start-Con->ScreenBase,Len);
+    *Size=Len;
+    return (const uint8_t *)Con->MarkStr.c_str();
+}
+
+static void HS_FreezeStream(void)
+{
+}
+
+static void HS_ClearFrozenStream(void)
+{
+}
+
+static void HS_ReleaseFrozenStream(void)
+{
+}
+
+static const uint8_t *HS_GetFrozenString(uint32_t *Size)
+{
+    *Size=0;
+    return NULL;
+}
+
+/* DPS_API_VERSION_3 */
+static void HS_ApplyStyle2Mark(t_DataProMark *Mark,uint32_t FGColor,
+        uint32_t BGColor,uint32_t Attribs,uint32_t ULineColor,uint32_t Offset,
+        uint32_t Len,uint32_t Mask)
+{
+    struct HostStubMark *HSMark=(struct HostStubMark *)Mark;
+
+    /* Recorded in the same order the plugin makes the V2 calls so the
+       digest comes out the same */
+    HSMark->Con->Counters.StyleCalls++;
+    if(Mask&APPLY_STYLE_ATTRIBS)
+        HS_RecordStyle(HSMark,e_StyleCall_Attrib,Attribs,Offset,Len);
+    if(Mask&APPLY_STYLE_FGCOLOR)
+        HS_RecordStyle(HSMark,e_StyleCall_FGColor,FGColor,Offset,Len);
+    if(Mask&APPLY_STYLE_BGCOLOR)
+        HS_RecordStyle(HSMark,e_StyleCall_BGColor,BGColor,Offset,Len);
+    if(Mask&APPLY_STYLE_ULINECOLOR)
+        HS_RecordStyle(HSMark,e_StyleCall_ULineColor,ULineColor,Offset,Len);
+}
+
+/* DPS_API_VERSION_4 */
+static void HS_GetScrollBackLines(uint64_t *FirstLine,uint64_t *EndLine)
+{
+    struct HostStubConnection *Con=m_HS_CurrentCon;
+
+    *FirstLine=Con->FirstLine;
+    *EndLine=Con->FirstLine+Con->LineStarts.size()-1;
+}
+
+static const uint8_t *HS_GetScrollBackLine(uint64_t Line,uint32_t *Size)
+{
+    struct HostStubConnection *Con=m_HS_CurrentCon;
+    uint64_t Start;
+    uint64_t End;
+
+    Con->Counters.ScrollBackReads++;
+
+    if(Line<Con->FirstLine || Line+1>=Con->FirstLine+Con->LineStarts.size())
+        return NULL;
+
+    /* Without the '\n' */
+    Start=Con->LineStarts[Line-Con->FirstLine];
+    End=Con->LineStarts[Line-Con->FirstLine+1]-1;
+
+    Con->MarkStr.assign(Con->Screen,Start-Con->ScreenBase,End-Start);
+    *Size=End-Start;
+    return (const uint8_t *)Con->MarkStr.c_str();
+}
+
+static PG_BOOL HS_SetMark2ScrollBackLine(t_DataProMark *Mark,uint64_t Line)
+{
+    struct HostStubMark *HSMark=(struct HostStubMark *)Mark;
+    struct HostStubConnection *Con=HSMark->Con;
+
+    if(Line<Con->FirstLine || Line+1>=Con->FirstLine+Con->LineStarts.size())
+        return false;
+
+    HSMark->Pos=Con->LineStarts[Line-Con->FirstLine];
+    HSMark->Valid=true;
+    return true;
+}
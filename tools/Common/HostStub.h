@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * FILENAME: HostStub.h
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a stand in for WhippyTerm that the tools use to drive the
+ *    plugin the same way WhippyTerm does (one byte at a time through
+ *    ProcessIncomingTextByte()).
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * HISTORY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *       Created
+ *
+ *******************************************************************************/
+#ifndef __HOSTSTUB_H_
+#define __HOSTSTUB_H_
+
+/***  HEADER FILES TO INCLUDE          ***/
+#include <stdint.h>
+#include <map>
+#include <string>
+
+/***  DEFINES                          ***/
+
+/***  MACROS                           ***/
+
+/***  TYPE DEFINITIONS                 ***/
+typedef std::map<std::string,std::string> t_HostStubKVList;
+
+struct HostStubConnection;
+
+struct HostStubCounters
+{
+    uint64_t Lines;
+    uint64_t Bytes;
+    uint64_t StyleCalls;        // Apply*2Mark() / ApplyStyle2Mark() calls
+    uint64_t MarkStringCalls;   // GetMarkString() calls
+    uint64_t ScrollBackReads;   // GetScrollBackLine() calls
+    uint64_t StyleDigest;       // Hash of every style applied (to check output)
+};
+
+/***  CLASS DEFINITIONS                ***/
+
+/***  GLOBAL VARIABLE DEFINITIONS      ***/
+
+/***  EXTERNAL FUNCTION PROTOTYPES     ***/
+bool HostStub_Init(void);
+bool HostStub_InitVersion(unsigned int Version);
+bool HostStub_LoadSettings(const char *Filename,t_HostStubKVList &Settings);
+struct HostStubConnection *HostStub_AllocConnection(
+        const t_HostStubKVList &Settings);
+void HostStub_FreeConnection(struct HostStubConnection *Con);
+void HostStub_FeedByte(struct HostStubConnection *Con,uint8_t Byte);
+void HostStub_Feed(struct HostStubConnection *Con,const uint8_t *Buff,
+        uint32_t Len);
+bool HostStub_UseBlockAPI(bool Use);
+void HostStub_GetCounters(struct HostStubConnection *Con,
+        struct HostStubCounters *Counters);
+void HostStub_ApplySettings(struct HostStubConnection *Con,
+        const t_HostStubKVList &Settings);
+bool HostStub_Idle(struct HostStubConnection *Con);
+
+#endif
@@ -0,0 +1,718 @@
+/*******************************************************************************
+ * FILENAME: LatencyFuzz.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is a fuzzer that looks for rule / line pairs that make the
+ *    plugin slow (catastrophic regex back tracking, quadratic scans), crash
+ *    or run out of stack.
+ *
+ *    Each case is a random rule set (in the plugin's settings keys) and a
+ *    random line.  The line is fed through the plugin with the host stub
+ *    and the time to handle the end of line (TextLineHighlighter_HandleLine())
+ *    is checked against a budget.
+ *
+ *    The cases are run in a child process.  The child puts the seed of the
+ *    case it is running in shared memory so if it crashes, runs out of stack
+ *    or hangs (and is killed) the parent can rebuild the case from the seed.
+ *
+ *    Any case that goes over budget, crashes, overflows the stack or hangs
+ *    is saved in the output dir as KIND-SEED.rules + KIND-SEED.log (the same
+ *    format as the regression corpora).
+ *
+ *    Usage:
+ *      LatencyFuzz [--seed N] [--cases N] [--budget-us N] [--hang-ms N]
+ *                  [--max-line Bytes] [--out Dir]
+ *      LatencyFuzz --replay File.rules File.log [--budget-us N]
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "Common/HostStub.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define DEFAULT_BUDGET_US           1000
+#define DEFAULT_HANG_MS             2000
+#define DEFAULT_MAX_LINE            4096
+#define DEFAULT_OUT_DIR             "Reproducers"
+
+#define NUM_OF_SIMPLE               3       // Must match the plugin
+#define NUM_OF_REGEXS               5       // Must match the plugin
+
+#define ALT_STACK_SIZE              (64*1024)
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+typedef enum
+{
+    e_Fault_None,
+    e_Fault_Crash,
+    e_Fault_Stack,
+    e_FaultMAX
+} e_FaultType;
+
+/* Shared between the parent and the child */
+struct FuzzShared
+{
+    volatile uint64_t CurrentSeed;
+    volatile uint64_t CaseStartMS;      // 0 = not in a case
+    volatile uint64_t CasesDone;
+    volatile uint64_t Saved;
+    volatile int Fault;                 // e_FaultType
+};
+
+/*** FUNCTION PROTOTYPES      ***/
+static void BuildCase(uint64_t Seed,uint32_t MaxLine,
+        t_HostStubKVList &Settings,string &Line);
+static void BuildRegex(string &Rx,int Depth);
+static void BuildLiteral(string &Str);
+static uint64_t RunCase(const t_HostStubKVList &Settings,const string &Line);
+static bool SaveCase(const char *Dir,const char *Kind,uint64_t Seed,
+        const t_HostStubKVList &Settings,const string &Line);
+static void RunChild(uint64_t FirstSeed,uint64_t LastSeed,uint32_t MaxLine,
+        uint64_t BudgetUS,const char *OutDir);
+static void FaultHandler(int Sig,siginfo_t *Info,void *Context);
+static uint64_t NowMS(void);
+static int Replay(const char *RulesFile,const char *LogFile,uint64_t BudgetUS);
+
+/*** VARIABLE DEFINITIONS     ***/
+static struct FuzzShared *m_Shared;
+static uint64_t m_Rand;
+static uintptr_t m_StackTop;
+static uintptr_t m_StackSize;
+
+/* The bytes lines are built from.  Small so the regex's have something to
+   chew on. */
+static const char m_Alphabet[]="aaaab:= .x09AZ\\[]()";
+
+static uint32_t FuzzRand(void)
+{
+    /* xorshift64* */
+    m_Rand^=m_Rand>>12;
+    m_Rand^=m_Rand<<25;
+    m_Rand^=m_Rand>>27;
+    return (uint32_t)((m_Rand*0x2545F4914F6CDD1DULL)>>32);
+}
+
+int main(int argc,char *argv[])
+{
+    uint64_t Seed;
+    uint64_t Cases;
+    uint64_t BudgetUS;
+    uint64_t HangMS;
+    uint64_t NextSeed;
+    uint64_t LastSeed;
+    uint32_t MaxLine;
+    const char *OutDir;
+    const char *Kind;
+    t_HostStubKVList Settings;
+    string Line;
+    pid_t Child;
+    int Status;
+    int a;
+
+    Seed=(uint64_t)time(NULL);
+    Cases=0;
+    BudgetUS=DEFAULT_BUDGET_US;
+    HangMS=DEFAULT_HANG_MS;
+    MaxLine=DEFAULT_MAX_LINE;
+    OutDir=DEFAULT_OUT_DIR;
+
+    for(a=1;a<argc;a++)
+    {
+        if(strcmp(argv[a],"--seed")==0 && a+1<argc)
+            Seed=strtoull(argv[++a],NULL,0);
+        else if(strcmp(argv[a],"--cases")==0 && a+1<argc)
+            Cases=strtoull(argv[++a],NULL,0);
+        else if(strcmp(argv[a],"--budget-us")==0 && a+1<argc)
+            BudgetUS=strtoull(argv[++a],NULL,0);
+        else if(strcmp(argv[a],"--hang-ms")==0 && a+1<argc)
+            HangMS=strtoull(argv[++a],NULL,0);
+        else if(strcmp(argv[a],"--max-line")==0 && a+1<argc)
+            MaxLine=strtoul(argv[++a],NULL,0);
+        else if(strcmp(argv[a],"--out")==0 && a+1<argc)
+            OutDir=argv[++a];
+        else if(strcmp(argv[a],"--replay")==0 && a+2<argc)
+            return Replay(argv[a+1],argv[a+2],BudgetUS);
+        else
+        {
+            fprintf(stderr,"Usage: %s [--seed N] [--cases N] [--budget-us N] "
+                    "[--hang-ms N] [--max-line Bytes] [--out Dir]\n",argv[0]);
+            fprintf(stderr,"       %s --replay File.rules File.log "
+                    "[--budget-us N]\n",argv[0]);
+            return 1;
+        }
+    }
+    if(MaxLine<1)
+        MaxLine=1;
+
+    if(!HostStub_Init())
+    {
+        fprintf(stderr,"Failed to register the plugin\n");
+        return 1;
+    }
+    mkdir(OutDir,0777);
+
+    m_Shared=(struct FuzzShared *)mmap(NULL,sizeof(struct FuzzShared),
+            PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+    if(m_Shared==MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    memset((void *)m_Shared,0x00,sizeof(struct FuzzShared));
+
+    printf("Fuzzing from seed %llu, budget %lluus\n",(unsigned long long)Seed,
+            (unsigned long long)BudgetUS);
+    fflush(stdout);
+
+    LastSeed=Cases==0?UINT64_MAX:Seed+Cases;
+    NextSeed=Seed;
+    while(NextSeed<LastSeed)
+    {
+        m_Shared->CaseStartMS=0;
+        m_Shared->Fault=e_Fault_None;
+        m_Shared->CurrentSeed=NextSeed;
+
+        fflush(stdout);
+        Child=fork();
+        if(Child<0)
+        {
+            perror("fork");
+            return 1;
+        }
+        if(Child==0)
+        {
+            RunChild(NextSeed,LastSeed,MaxLine,BudgetUS,OutDir);
+            _exit(0);
+        }
+
+        /* Watch the child */
+        Kind=NULL;
+        for(;;)
+        {
+            if(waitpid(Child,&Status,WNOHANG)==Child)
+            {
+                if(WIFSIGNALED(Status) || (WIFEXITED(Status) &&
+                        WEXITSTATUS(Status)!=0))
+                {
+                    Kind=m_Shared->Fault==e_Fault_Stack?"stack":"crash";
+                }
+                break;
+            }
+            if(m_Shared->CaseStartMS!=0 &&
+                    NowMS()-m_Shared->CaseStartMS>HangMS)
+            {
+                kill(Child,SIGKILL);
+                waitpid(Child,&Status,0);
+                Kind="hang";
+                break;
+            }
+            usleep(10000);
+        }
+
+        if(Kind==NULL)
+            break;  // The child ran all the cases
+
+        /* Rebuild the case that killed the child and save it */
+        BuildCase(m_Shared->CurrentSeed,MaxLine,Settings,Line);
+        SaveCase(OutDir,Kind,m_Shared->CurrentSeed,Settings,Line);
+        m_Shared->Saved++;
+        printf("%s: seed %llu\n",Kind,
+                (unsigned long long)m_Shared->CurrentSeed);
+        NextSeed=m_Shared->CurrentSeed+1;
+    }
+
+    printf("Done: %llu cases, %llu reproducers saved in %s\n",
+            (unsigned long long)m_Shared->CasesDone,
+            (unsigned long long)m_Shared->Saved,OutDir);
+
+    return m_Shared->Saved!=0?1:0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    RunChild
+ *
+ * SYNOPSIS:
+ *    static void RunChild(uint64_t FirstSeed,uint64_t LastSeed,
+ *          uint32_t MaxLine,uint64_t BudgetUS,const char *OutDir);
+ *
+ * PARAMETERS:
+ *    FirstSeed [I] -- The seed of the first case to run
+ *    LastSeed [I] -- One past the seed of the last case to run
+ *    MaxLine [I] -- The longest line to make
+ *    BudgetUS [I] -- The time budget for the end of line in microseconds
+ *    OutDir [I] -- Where to save over budget cases
+ *
+ * FUNCTION:
+ *    This function is the child process.  It runs cases until it is done
+ *    (or dies).  Cases that go over the budget are saved here, crashes and
+ *    hangs are saved by the parent.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void RunChild(uint64_t FirstSeed,uint64_t LastSeed,uint32_t MaxLine,
+        uint64_t BudgetUS,const char *OutDir)
+{
+    struct sigaction Act;
+    struct rlimit Limit;
+    stack_t AltStack;
+    t_HostStubKVList Settings;
+    string Line;
+    uint64_t Seed;
+    uint64_t NS;
+    int StackMarker;
+
+    /* We need to know where the stack is to tell a stack overflow from
+       any other crash */
+    m_StackTop=(uintptr_t)&StackMarker;
+    m_StackSize=8*1024*1024;
+    if(getrlimit(RLIMIT_STACK,&Limit)==0 && Limit.rlim_cur!=RLIM_INFINITY)
+        m_StackSize=Limit.rlim_cur;
+
+    AltStack.ss_sp=malloc(ALT_STACK_SIZE);
+    AltStack.ss_size=ALT_STACK_SIZE;
+    AltStack.ss_flags=0;
+    sigaltstack(&AltStack,NULL);
+
+    memset(&Act,0x00,sizeof(Act));
+    Act.sa_sigaction=FaultHandler;
+    Act.sa_flags=SA_SIGINFO|SA_ONSTACK;
+    sigemptyset(&Act.sa_mask);
+    sigaction(SIGSEGV,&Act,NULL);
+    sigaction(SIGBUS,&Act,NULL);
+    sigaction(SIGFPE,&Act,NULL);
+    sigaction(SIGILL,&Act,NULL);
+    sigaction(SIGABRT,&Act,NULL);
+
+    for(Seed=FirstSeed;Seed<LastSeed;Seed++)
+    {
+        BuildCase(Seed,MaxLine,Settings,Line);
+
+        m_Shared->CurrentSeed=Seed;
+        m_Shared->CaseStartMS=NowMS();
+        NS=RunCase(Settings,Line);
+        m_Shared->CaseStartMS=0;
+        m_Shared->CasesDone++;
+
+        if(NS>BudgetUS*1000)
+        {
+            SaveCase(OutDir,"slow",Seed,Settings,Line);
+            m_Shared->Saved++;
+            printf("slow: seed %llu (%lluus)\n",(unsigned long long)Seed,
+                    (unsigned long long)(NS/1000));
+            fflush(stdout);
+        }
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    FaultHandler
+ *
+ * SYNOPSIS:
+ *    static void FaultHandler(int Sig,siginfo_t *Info,void *Context);
+ *
+ * PARAMETERS:
+ *    Sig [I] -- The signal
+ *    Info [I] -- Info about the fault
+ *    Context [I] -- Not used
+ *
+ * FUNCTION:
+ *    This function is called (on the alt stack) when the child crashes.  It
+ *    tells the parent if the crash was a stack overflow and exits.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void FaultHandler(int Sig,siginfo_t *Info,void *Context)
+{
+    uintptr_t Addr;
+
+    m_Shared->Fault=e_Fault_Crash;
+    if(Sig==SIGSEGV)
+    {
+        /* The stack grows down, a fault just below the stack is a stack
+           overflow */
+        Addr=(uintptr_t)Info->si_addr;
+        if(Addr<m_StackTop && Addr>m_StackTop-m_StackSize-ALT_STACK_SIZE)
+            m_Shared->Fault=e_Fault_Stack;
+    }
+    _exit(128+Sig);
+}
+
+/*******************************************************************************
+ * NAME:
+ *    RunCase
+ *
+ * SYNOPSIS:
+ *    static uint64_t RunCase(const t_HostStubKVList &Settings,
+ *          const string &Line);
+ *
+ * PARAMETERS:
+ *    Settings [I] -- The rules to use
+ *    Line [I] -- The line (without the '\n')
+ *
+ * FUNCTION:
+ *    This function runs one case through a new connection.
+ *
+ * RETURNS:
+ *    The number of nano seconds it took to handle the end of line.
+ ******************************************************************************/
+static uint64_t RunCase(const t_HostStubKVList &Settings,const string &Line)
+{
+    chrono::steady_clock::time_point Start;
+    struct HostStubConnection *Con;
+    uint64_t NS;
+
+    Con=HostStub_AllocConnection(Settings);
+    if(Con==NULL)
+        return 0;
+
+    HostStub_Feed(Con,(const uint8_t *)Line.data(),Line.length());
+
+    Start=chrono::steady_clock::now();
+    HostStub_FeedByte(Con,'\n');
+    NS=chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-
+            Start).count();
+
+    HostStub_FreeConnection(Con);
+
+    return NS;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildCase
+ *
+ * SYNOPSIS:
+ *    static void BuildCase(uint64_t Seed,uint32_t MaxLine,
+ *          t_HostStubKVList &Settings,string &Line);
+ *
+ * PARAMETERS:
+ *    Seed [I] -- The seed for this case.  The same seed always makes the
+ *                same case.
+ *    MaxLine [I] -- The longest line to make
+ *    Settings [O] -- The rule set (as plugin settings)
+ *    Line [O] -- The line (without the '\n')
+ *
+ * FUNCTION:
+ *    This function makes a random case.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void BuildCase(uint64_t Seed,uint32_t MaxLine,
+        t_HostStubKVList &Settings,string &Line)
+{
+    static const char *SimpleKeys[]={"SimpleStart","SimpleContains","SimpleEnd"};
+    char buff[100];
+    char buff2[100];
+    string Str;
+    uint32_t Len;
+    uint32_t Run;
+    unsigned int k;
+    int r;
+    char c;
+
+    m_Rand=Seed*0x9E3779B97F4A7C15ULL+1;
+    Settings.clear();
+
+    for(r=0;r<NUM_OF_SIMPLE;r++)
+    {
+        for(k=0;k<sizeof(SimpleKeys)/sizeof(SimpleKeys[0]);k++)
+        {
+            if(FuzzRand()%2)
+            {
+                BuildLiteral(Str);
+                sprintf(buff,"%s%d",SimpleKeys[k],r);
+                Settings[buff]=Str;
+            }
+        }
+        sprintf(buff,"SimpleStyle%d",r);
+        sprintf(buff2,"%d",FuzzRand()%8);
+        Settings[buff]=buff2;
+    }
+
+    for(r=0;r<NUM_OF_REGEXS;r++)
+    {
+        if(FuzzRand()%4!=0)
+        {
+            Str.clear();
+            BuildRegex(Str,0);
+            sprintf(buff,"RegexStr%d",r);
+            Settings[buff]=Str;
+        }
+        sprintf(buff,"RegexStyle%d",r);
+        sprintf(buff2,"%d",FuzzRand()%8);
+        Settings[buff]=buff2;
+    }
+
+    /* Lines are made of runs of the same char (which is what makes back
+       tracking blow up) mixed with random chars */
+    Len=FuzzRand()%(MaxLine+1);
+    Line.clear();
+    while(Line.length()<Len)
+    {
+        c=m_Alphabet[FuzzRand()%(sizeof(m_Alphabet)-1)];
+        Run=FuzzRand()%4==0?FuzzRand()%256:1;
+        Line.append(min(Run,(uint32_t)(Len-Line.length())),c);
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildRegex
+ *
+ * SYNOPSIS:
+ *    static void BuildRegex(string &Rx,int Depth);
+ *
+ * PARAMETERS:
+ *    Rx [I/O] -- The regex to add to
+ *    Depth [I] -- How deep in groups we are
+ *
+ * FUNCTION:
+ *    This function adds random regex parts to 'Rx'.  It favors nested
+ *    quantifiers and alternations that overlap because that is where the
+ *    back tracking problems are.  The regex's are not always valid (the
+ *    plugin has to deal with that too).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void BuildRegex(string &Rx,int Depth)
+{
+    static const char *Atoms[]=
+    {
+        "a","b","x",".","\\d","\\w","\\s","[a-z]","[^b]","[ab]","\\1","^","$",
+        "a|aa","=",":","\\[",
+    };
+    static const char *Quants[]={"","","*","+","?","{2,}","{1,3}","*?","+?"};
+    int Parts;
+    int r;
+
+    Parts=1+FuzzRand()%3;
+    for(r=0;r<Parts;r++)
+    {
+        if(Depth<2 && FuzzRand()%3==0)
+        {
+            Rx+="(";
+            BuildRegex(Rx,Depth+1);
+            if(FuzzRand()%2)
+            {
+                Rx+="|";
+                BuildRegex(Rx,Depth+1);
+            }
+            Rx+=")";
+        }
+        else
+        {
+            Rx+=Atoms[FuzzRand()%(sizeof(Atoms)/sizeof(Atoms[0]))];
+        }
+        Rx+=Quants[FuzzRand()%(sizeof(Quants)/sizeof(Quants[0]))];
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    BuildLiteral
+ *
+ * SYNOPSIS:
+ *    static void BuildLiteral(string &Str);
+ *
+ * PARAMETERS:
+ *    Str [O] -- The literal
+ *
+ * FUNCTION:
+ *    This function makes a random literal for the simple rules.  They are
+ *    mostly made of the first char of the alphabet so they partly match a
+ *    lot (the worst case for a naive substring scan).
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void BuildLiteral(string &Str)
+{
+    uint32_t Len;
+    uint32_t r;
+
+    Len=1+FuzzRand()%64;
+    Str.clear();
+    for(r=0;r<Len;r++)
+    {
+        if(FuzzRand()%8==0)
+            Str+=m_Alphabet[FuzzRand()%(sizeof(m_Alphabet)-1)];
+        else
+            Str+='a';
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    SaveCase
+ *
+ * SYNOPSIS:
+ *    static bool SaveCase(const char *Dir,const char *Kind,uint64_t Seed,
+ *          const t_HostStubKVList &Settings,const string &Line);
+ *
+ * PARAMETERS:
+ *    Dir [I] -- The dir to save in
+ *    Kind [I] -- What went wrong (slow, hang, crash, stack)
+ *    Seed [I] -- The seed of the case
+ *    Settings [I] -- The rules of the case
+ *    Line [I] -- The line of the case
+ *
+ * FUNCTION:
+ *    This function saves a reproducer as KIND-SEED.rules and KIND-SEED.log.
+ *
+ * RETURNS:
+ *    true -- The case was saved
+ *    false -- There was an error
+ ******************************************************************************/
+static bool SaveCase(const char *Dir,const char *Kind,uint64_t Seed,
+        const t_HostStubKVList &Settings,const string &Line)
+{
+    t_HostStubKVList::const_iterator i;
+    char Filename[1000];
+    FILE *out;
+
+    snprintf(Filename,sizeof(Filename),"%s/%s-%llu.rules",Dir,Kind,
+            (unsigned long long)Seed);
+    out=fopen(Filename,"w");
+    if(out==NULL)
+        return false;
+    fprintf(out,"# LatencyFuzz %s, seed %llu\n",Kind,(unsigned long long)Seed);
+    for(i=Settings.begin();i!=Settings.end();i++)
+        fprintf(out,"%s=%s\n",i->first.c_str(),i->second.c_str());
+    fclose(out);
+
+    snprintf(Filename,sizeof(Filename),"%s/%s-%llu.log",Dir,Kind,
+            (unsigned long long)Seed);
+    out=fopen(Filename,"wb");
+    if(out==NULL)
+        return false;
+    fwrite(Line.data(),1,Line.length(),out);
+    fputc('\n',out);
+    fclose(out);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    Replay
+ *
+ * SYNOPSIS:
+ *    static int Replay(const char *RulesFile,const char *LogFile,
+ *          uint64_t BudgetUS);
+ *
+ * PARAMETERS:
+ *    RulesFile [I] -- The rules of the reproducer
+ *    LogFile [I] -- The line(s) of the reproducer
+ *    BudgetUS [I] -- The time budget for each end of line
+ *
+ * FUNCTION:
+ *    This function runs a saved reproducer (in this process, so it can be
+ *    run under a debugger) and prints the time each line took.
+ *
+ * RETURNS:
+ *    0 if every line was in budget, 1 if not.
+ ******************************************************************************/
+static int Replay(const char *RulesFile,const char *LogFile,uint64_t BudgetUS)
+{
+    chrono::steady_clock::time_point Start;
+    struct HostStubConnection *Con;
+    t_HostStubKVList Settings;
+    uint64_t NS;
+    FILE *in;
+    int c;
+    int Ret;
+
+    if(!HostStub_Init() || !HostStub_LoadSettings(RulesFile,Settings))
+    {
+        fprintf(stderr,"Failed to load %s\n",RulesFile);
+        return 1;
+    }
+    in=fopen(LogFile,"rb");
+    if(in==NULL)
+    {
+        fprintf(stderr,"Failed to open %s\n",LogFile);
+        return 1;
+    }
+
+    Con=HostStub_AllocConnection(Settings);
+    if(Con==NULL)
+    {
+        fclose(in);
+        return 1;
+    }
+
+    Ret=0;
+    while((c=fgetc(in))!=EOF)
+    {
+        if(c!='\n')
+        {
+            HostStub_FeedByte(Con,c);
+            continue;
+        }
+        Start=chrono::steady_clock::now();
+        HostStub_FeedByte(Con,c);
+        NS=chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now()-Start).count();
+        printf("%lluus%s\n",(unsigned long long)(NS/1000),
+                NS>BudgetUS*1000?" (over budget)":"");
+        if(NS>BudgetUS*1000)
+            Ret=1;
+    }
+    fclose(in);
+    HostStub_FreeConnection(Con);
+
+    return Ret;
+}
+
+static uint64_t NowMS(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec*1000+ts.tv_nsec/1000000;
+}
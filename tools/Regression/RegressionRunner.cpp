@@ -0,0 +1,592 @@
+/*******************************************************************************
+ * FILENAME: RegressionRunner.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This is the performance regression runner.  It feeds each of the
+ *    checked in corpora through the plugin (using the host stub) with its
+ *    matching rule profile and compares the throughput and p99 per line
+ *    latency against a recorded baseline.
+ *
+ *    Usage:
+ *      RegressionRunner [--corpus-dir Dir] [--baseline File]
+ *                       [--tolerance Percent] [--repeat Count] [--record]
+ *                       [--per-byte] [--old-host] [--rehighlight]
+ *
+ *    The corpora are listed in 'Corpus.lst' in the corpus dir.  Each one
+ *    is a NAME.log (the raw bytes) and a NAME.rules (the plugin settings).
+ *
+ *    The per line latency is the time the plugin takes to handle the end
+ *    of line byte (where all the matching and styling happens).
+ *
+ *    The bytes are fed with the plugin's ProcessIncomingTextBlock() like a
+ *    DATA_PROCESSORS_API_VERSION_4 host does.  --per-byte feeds them one
+ *    at a time like an older host.  --old-host acts like a WhippyTerm
+ *    from before DPS_API_VERSION_3 (so the plugin styles with the separate
+ *    Apply*2Mark() calls).  The digest must be the same either way.
+ *
+ *    --rehighlight applies the settings again half way through each corpus
+ *    with "Rehighlight" on, so the p99 shows what re-highlighting the
+ *    scroll back does to the lines coming in.  After the corpus the
+ *    connection is left idle until the re-highlight is done.  The digest
+ *    changes (the scroll back is styled twice, in an order that isn't the
+ *    same from run to run).
+ *
+ *    The baseline is a CSV file of:
+ *      corpus,mb_per_sec,p99_us,digest
+ *    --record rewrites it with the current results.  The numbers are only
+ *    good for the machine they where recorded on.
+ *
+ *    Returns 0 if everything is within tolerance, 1 if something got worse
+ *    and 2 if something could not be run.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "Common/HostStub.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+#define DEFAULT_CORPUS_DIR          "../Regression/Corpus"
+#define DEFAULT_BASELINE            "../Regression/Baseline.csv"
+#define DEFAULT_TOLERANCE           10.0
+#define DEFAULT_REPEAT              5
+#define OLD_HOST_VERSION            0x02000000  // WhippyTerm 2.0
+#define IDLE_QUIET_CALLS            100         // ProcessIdle() calls with
+                                                // nothing done before we stop
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+struct CorpusResult
+{
+    uint64_t Bytes;
+    uint64_t Lines;
+    double MBPerSec;
+    double P50us;
+    double P99us;
+    double Maxus;
+    uint64_t StyleCalls;
+    uint64_t Digest;
+};
+
+struct BaselineEntry
+{
+    double MBPerSec;
+    double P99us;
+    uint64_t Digest;
+};
+
+typedef map<string,struct BaselineEntry> t_BaselineList;
+
+/*** FUNCTION PROTOTYPES      ***/
+static bool LoadFile(const string &Filename,string &Data);
+static bool RunCorpus(const string &Dir,const string &Name,
+        bool Rehighlight,struct CorpusResult *Result);
+static void WaitForIdle(struct HostStubConnection *Con);
+static double Percentile(vector<uint64_t> &Samples,double Pct);
+static bool LoadBaseline(const char *Filename,t_BaselineList &Baseline);
+static bool SaveBaseline(const char *Filename,
+        const vector<string> &Names,const vector<struct CorpusResult> &Results);
+
+/*** VARIABLE DEFINITIONS     ***/
+
+int main(int argc,char *argv[])
+{
+    const char *CorpusDir;
+    const char *BaselineFile;
+    double Tolerance;
+    int Repeat;
+    bool Record;
+    bool PerByte;
+    bool OldHost;
+    bool Rehighlight;
+    bool Failed;
+    bool Worse;
+    string List;
+    string Name;
+    vector<string> Names;
+    vector<struct CorpusResult> Results;
+    struct CorpusResult Best;
+    struct CorpusResult Run;
+    t_BaselineList Baseline;
+    t_BaselineList::iterator Base;
+    size_t Start;
+    size_t End;
+    size_t c;
+    int r;
+    int a;
+
+    CorpusDir=DEFAULT_CORPUS_DIR;
+    BaselineFile=DEFAULT_BASELINE;
+    Tolerance=DEFAULT_TOLERANCE;
+    Repeat=DEFAULT_REPEAT;
+    Record=false;
+    PerByte=false;
+    OldHost=false;
+    Rehighlight=false;
+
+    for(a=1;a<argc;a++)
+    {
+        if(strcmp(argv[a],"--corpus-dir")==0 && a+1<argc)
+            CorpusDir=argv[++a];
+        else if(strcmp(argv[a],"--baseline")==0 && a+1<argc)
+            BaselineFile=argv[++a];
+        else if(strcmp(argv[a],"--tolerance")==0 && a+1<argc)
+            Tolerance=atof(argv[++a]);
+        else if(strcmp(argv[a],"--repeat")==0 && a+1<argc)
+            Repeat=atoi(argv[++a]);
+        else if(strcmp(argv[a],"--record")==0)
+            Record=true;
+        else if(strcmp(argv[a],"--per-byte")==0)
+            PerByte=true;
+        else if(strcmp(argv[a],"--old-host")==0)
+            OldHost=true;
+        else if(strcmp(argv[a],"--rehighlight")==0)
+            Rehighlight=true;
+        else
+        {
+            fprintf(stderr,"Usage: %s [--corpus-dir Dir] [--baseline File] "
+                    "[--tolerance Percent] [--repeat Count] [--record] "
+                    "[--per-byte] [--old-host] [--rehighlight]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if(Repeat<1)
+        Repeat=1;
+
+    if(!(OldHost?HostStub_InitVersion(OLD_HOST_VERSION):HostStub_Init()))
+    {
+        fprintf(stderr,"Failed to register the plugin\n");
+        return 2;
+    }
+    HostStub_UseBlockAPI(!PerByte);
+
+    if(!LoadFile(string(CorpusDir)+"/Corpus.lst",List))
+    {
+        fprintf(stderr,"Failed to load %s/Corpus.lst\n",CorpusDir);
+        return 2;
+    }
+    for(Start=0;Start<List.length();Start=End+1)
+    {
+        End=List.find('\n',Start);
+        if(End==string::npos)
+            End=List.length();
+        Name=List.substr(Start,End-Start);
+        if(!Name.empty() && Name[Name.length()-1]=='\r')
+            Name.erase(Name.length()-1);
+        if(Name.empty() || Name[0]=='#')
+            continue;
+        Names.push_back(Name);
+    }
+
+    if(!Record && !LoadBaseline(BaselineFile,Baseline))
+    {
+        fprintf(stderr,"Failed to load baseline %s (use --record to make "
+                "one)\n",BaselineFile);
+        return 2;
+    }
+
+    printf("corpus,bytes,lines,mb_per_sec,p50_us,p99_us,max_us,style_calls,"
+            "digest,result\n");
+
+    Failed=false;
+    for(c=0;c<Names.size();c++)
+    {
+        /* We keep the best of the runs to take out some of the noise */
+        for(r=0;r<Repeat;r++)
+        {
+            if(!RunCorpus(CorpusDir,Names[c],Rehighlight,&Run))
+            {
+                fprintf(stderr,"Failed to run corpus %s\n",Names[c].c_str());
+                return 2;
+            }
+            if(r==0)
+            {
+                Best=Run;
+            }
+            else
+            {
+                Best.MBPerSec=max(Best.MBPerSec,Run.MBPerSec);
+                Best.P50us=min(Best.P50us,Run.P50us);
+                Best.P99us=min(Best.P99us,Run.P99us);
+                Best.Maxus=min(Best.Maxus,Run.Maxus);
+            }
+        }
+        Results.push_back(Best);
+
+        printf("%s,%llu,%llu,%.2f,%.2f,%.2f,%.2f,%llu,%016llx,",
+                Names[c].c_str(),(unsigned long long)Best.Bytes,
+                (unsigned long long)Best.Lines,Best.MBPerSec,Best.P50us,
+                Best.P99us,Best.Maxus,(unsigned long long)Best.StyleCalls,
+                (unsigned long long)Best.Digest);
+
+        if(Record)
+        {
+            printf("RECORDED\n");
+            continue;
+        }
+
+        Base=Baseline.find(Names[c]);
+        if(Base==Baseline.end())
+        {
+            printf("NO_BASELINE\n");
+            continue;
+        }
+
+        Worse=false;
+        if(Best.MBPerSec<Base->second.MBPerSec*(1.0-Tolerance/100.0))
+        {
+            printf("FAIL_THROUGHPUT");
+            Worse=true;
+        }
+        if(Best.P99us>Base->second.P99us*(1.0+Tolerance/100.0))
+        {
+            printf("%sFAIL_P99",Worse?"|":"");
+            Worse=true;
+        }
+        if(!Worse)
+            printf("PASS");
+
+        /* Output changes are only a warning, features change the output */
+        if(Best.Digest!=Base->second.Digest)
+            printf("|OUTPUT_CHANGED");
+        printf("\n");
+
+        if(Worse)
+            Failed=true;
+    }
+
+    if(Record)
+    {
+        if(!SaveBaseline(BaselineFile,Names,Results))
+        {
+            fprintf(stderr,"Failed to save baseline %s\n",BaselineFile);
+            return 2;
+        }
+    }
+
+    return Failed?1:0;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LoadFile
+ *
+ * SYNOPSIS:
+ *    static bool LoadFile(const string &Filename,string &Data);
+ *
+ * PARAMETERS:
+ *    Filename [I] -- The file to load
+ *    Data [O] -- The contents of the file
+ *
+ * FUNCTION:
+ *    This function loads a whole file into memory.
+ *
+ * RETURNS:
+ *    true -- The file was loaded
+ *    false -- There was an error
+ ******************************************************************************/
+static bool LoadFile(const string &Filename,string &Data)
+{
+    FILE *in;
+    char buff[65536];
+    size_t Bytes;
+
+    in=fopen(Filename.c_str(),"rb");
+    if(in==NULL)
+        return false;
+
+    Data.clear();
+    while((Bytes=fread(buff,1,sizeof(buff),in))>0)
+        Data.append(buff,Bytes);
+    fclose(in);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    RunCorpus
+ *
+ * SYNOPSIS:
+ *    static bool RunCorpus(const string &Dir,const string &Name,
+ *          bool Rehighlight,struct CorpusResult *Result);
+ *
+ * PARAMETERS:
+ *    Dir [I] -- The corpus dir
+ *    Name [I] -- The name of the corpus to run
+ *    Rehighlight [I] -- Apply the settings again half way through with
+ *                       the scroll back re-highlight on
+ *    Result [O] -- The results of the run
+ *
+ * FUNCTION:
+ *    This function feeds a corpus through a new connection with the
+ *    corpus's rule profile applied.
+ *
+ * RETURNS:
+ *    true -- The corpus was run
+ *    false -- There was an error
+ ******************************************************************************/
+static bool RunCorpus(const string &Dir,const string &Name,
+        bool Rehighlight,struct CorpusResult *Result)
+{
+    chrono::steady_clock::time_point Start;
+    chrono::steady_clock::time_point LineStart;
+    chrono::steady_clock::duration Total;
+    struct HostStubConnection *Con;
+    struct HostStubCounters Counters;
+    t_HostStubKVList Settings;
+    vector<uint64_t> LineNS;
+    string Data;
+    size_t r;
+    size_t End;
+    size_t Half;
+
+    if(!LoadFile(Dir+"/"+Name+".log",Data))
+        return false;
+    if(!HostStub_LoadSettings((Dir+"/"+Name+".rules").c_str(),Settings))
+        return false;
+
+    Con=HostStub_AllocConnection(Settings);
+    if(Con==NULL)
+        return false;
+
+    Half=Rehighlight?Data.length()/2:Data.length();
+
+    Start=chrono::steady_clock::now();
+    for(r=0;r<Data.length();r=End+1)
+    {
+        if(r>=Half)
+        {
+            Settings["Rehighlight"]="1";
+            HostStub_ApplySettings(Con,Settings);
+            Half=Data.length();
+        }
+
+        End=Data.find('\n',r);
+        if(End==string::npos)
+            End=Data.length();
+
+        HostStub_Feed(Con,(const uint8_t *)&Data[r],End-r);
+
+        if(End<Data.length())
+        {
+            LineStart=chrono::steady_clock::now();
+            HostStub_FeedByte(Con,Data[End]);
+            LineNS.push_back(chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now()-LineStart).count());
+        }
+    }
+    Total=chrono::steady_clock::now()-Start;
+
+    if(Rehighlight)
+        WaitForIdle(Con);
+
+    HostStub_GetCounters(Con,&Counters);
+    HostStub_FreeConnection(Con);
+
+    Result->Bytes=Data.length();
+    Result->Lines=Counters.Lines;
+    Result->MBPerSec=Data.length()/chrono::duration<double,micro>(Total).count();
+    Result->P50us=Percentile(LineNS,50.0)/1000.0;
+    Result->P99us=Percentile(LineNS,99.0)/1000.0;
+    Result->Maxus=Percentile(LineNS,100.0)/1000.0;
+    Result->StyleCalls=Counters.StyleCalls;
+    Result->Digest=Counters.StyleDigest;
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    WaitForIdle
+ *
+ * SYNOPSIS:
+ *    static void WaitForIdle(struct HostStubConnection *Con);
+ *
+ * PARAMETERS:
+ *    Con [I] -- The connection to leave idle
+ *
+ * FUNCTION:
+ *    This function acts like a quiet connection, calling the plugin's
+ *    ProcessIdle() every 1ms until it has made IDLE_QUIET_CALLS calls in a
+ *    row without reading the scroll back or applying a style.
+ *
+ * RETURNS:
+ *    NONE
+ ******************************************************************************/
+static void WaitForIdle(struct HostStubConnection *Con)
+{
+    struct HostStubCounters Before;
+    struct HostStubCounters After;
+    int Quiet;
+
+    Quiet=0;
+    while(Quiet<IDLE_QUIET_CALLS)
+    {
+        HostStub_GetCounters(Con,&Before);
+        if(!HostStub_Idle(Con))
+            return;
+        HostStub_GetCounters(Con,&After);
+
+        Quiet++;
+        if(After.StyleCalls!=Before.StyleCalls ||
+                After.ScrollBackReads!=Before.ScrollBackReads)
+        {
+            Quiet=0;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+/*******************************************************************************
+ * NAME:
+ *    Percentile
+ *
+ * SYNOPSIS:
+ *    static double Percentile(vector<uint64_t> &Samples,double Pct);
+ *
+ * PARAMETERS:
+ *    Samples [I/O] -- The samples.  These are reordered.
+ *    Pct [I] -- The percentile to get (0-100)
+ *
+ * FUNCTION:
+ *    This function gets a percentile out of a list of samples.
+ *
+ * RETURNS:
+ *    The sample at that percentile (0 if there are no samples)
+ ******************************************************************************/
+static double Percentile(vector<uint64_t> &Samples,double Pct)
+{
+    size_t Index;
+
+    if(Samples.empty())
+        return 0;
+
+    Index=(size_t)((Samples.size()-1)*Pct/100.0);
+    nth_element(Samples.begin(),Samples.begin()+Index,Samples.end());
+    return Samples[Index];
+}
+
+/*******************************************************************************
+ * NAME:
+ *    LoadBaseline
+ *
+ * SYNOPSIS:
+ *    static bool LoadBaseline(const char *Filename,t_BaselineList &Baseline);
+ *
+ * PARAMETERS:
+ *    Filename [I] -- The baseline file to load
+ *    Baseline [O] -- The baseline numbers for each corpus
+ *
+ * FUNCTION:
+ *    This function loads the recorded baseline.
+ *
+ * RETURNS:
+ *    true -- The baseline was loaded
+ *    false -- There was an error
+ ******************************************************************************/
+static bool LoadBaseline(const char *Filename,t_BaselineList &Baseline)
+{
+    FILE *in;
+    char buff[1000];
+    char Name[1000];
+    struct BaselineEntry Entry;
+    unsigned long long Digest;
+
+    in=fopen(Filename,"r");
+    if(in==NULL)
+        return false;
+
+    while(fgets(buff,sizeof(buff),in)!=NULL)
+    {
+        if(buff[0]=='#')
+            continue;
+        if(sscanf(buff,"%999[^,],%lf,%lf,%llx",Name,&Entry.MBPerSec,
+                &Entry.P99us,&Digest)!=4)
+        {
+            continue;
+        }
+        Entry.Digest=Digest;
+        Baseline[Name]=Entry;
+    }
+    fclose(in);
+
+    return true;
+}
+
+/*******************************************************************************
+ * NAME:
+ *    SaveBaseline
+ *
+ * SYNOPSIS:
+ *    static bool SaveBaseline(const char *Filename,
+ *          const vector<string> &Names,
+ *          const vector<struct CorpusResult> &Results);
+ *
+ * PARAMETERS:
+ *    Filename [I] -- The baseline file to write
+ *    Names [I] -- The names of the corpora
+ *    Results [I] -- The results for each corpus in 'Names'
+ *
+ * FUNCTION:
+ *    This function records a new baseline.
+ *
+ * RETURNS:
+ *    true -- The baseline was saved
+ *    false -- There was an error
+ ******************************************************************************/
+static bool SaveBaseline(const char *Filename,
+        const vector<string> &Names,const vector<struct CorpusResult> &Results)
+{
+    FILE *out;
+    size_t r;
+
+    out=fopen(Filename,"w");
+    if(out==NULL)
+        return false;
+
+    fprintf(out,"# corpus,mb_per_sec,p99_us,digest\n");
+    for(r=0;r<Names.size();r++)
+    {
+        fprintf(out,"%s,%.2f,%.2f,%016llx\n",Names[r].c_str(),
+                Results[r].MBPerSec,Results[r].P99us,
+                (unsigned long long)Results[r].Digest);
+    }
+    fclose(out);
+
+    return true;
+}
@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * FILENAME: CaptureReplay.cpp
+ *
+ * PROJECT:
+ *    Whippy Term
+ *
+ * FILE DESCRIPTION:
+ *    This tool replays a stream capture (made with the plugin's "Capture"
+ *    settings tab) through the plugin (using the host stub) so a stream
+ *    that a user had problems with can be looked at again.
+ *
+ *    Usage:
+ *      CaptureReplay [--rules File] [--realtime] [--speed Factor]
+ *                    [--dump File] Capture
+ *
+ *    By default the capture is fed in as fast as possible.  --realtime
+ *    feeds each record at the time it came in (--speed scales that, 2 is
+ *    twice as fast).  --rules is the plugin settings to use (the same
+ *    format as the regression corpus .rules files).  --dump writes the
+ *    raw bytes out so the capture can be used as a regression corpus.
+ *
+ *    Returns 0 if the capture was replayed, 1 if the capture was damaged
+ *    (everything up to the damage is replayed) and 2 on errors.
+ *
+ * COPYRIGHT:
+ *    Copyright 2025 Paul Hutchinson.
+ *
+ *    This program is free software: you can redistribute it and/or modify it
+ *    under the terms of the GNU General Public License as published by the
+ *    Free Software Foundation, either version 3 of the License, or (at your
+ *    option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *    General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License along
+ *    with this program. If not, see https://www.gnu.org/licenses/.
+ *
+ * CREATED BY:
+ *    Paul Hutchinson (18 Oct 2026)
+ *
+ ******************************************************************************/
+
+/*** HEADER FILES TO INCLUDE  ***/
+#include "Common/HostStub.h"
+#include "StreamCapture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+/*** DEFINES                  ***/
+
+/*** MACROS                   ***/
+
+/*** TYPE DEFINITIONS         ***/
+
+/*** FUNCTION PROTOTYPES      ***/
+
+/*** VARIABLE DEFINITIONS     ***/
+
+int main(int argc,char *argv[])
+{
+    const char *RulesFile;
+    const char *DumpFile;
+    const char *CaptureFile;
+    bool RealTime;
+    double Speed;
+    t_HostStubKVList Settings;
+    struct HostStubConnection *Con;
+    struct HostStubCounters Counters;
+    struct StreamCaptureReader Reader;
+    struct StreamCaptureRecord Record;
+    FILE *Dump;
+    bool Damaged;
+    uint64_t Records;
+    uint64_t Bytes;
+    uint64_t Lost;
+    uint64_t LastTimeUS;
+    chrono::steady_clock::time_point Start;
+    double Secs;
+    time_t StartTime;
+    int a;
+
+    RulesFile=NULL;
+    DumpFile=NULL;
+    CaptureFile=NULL;
+    RealTime=false;
+    Speed=1.0;
+
+    for(a=1;a<argc;a++)
+    {
+        if(strcmp(argv[a],"--rules")==0 && a+1<argc)
+            RulesFile=argv[++a];
+        else if(strcmp(argv[a],"--realtime")==0)
+            RealTime=true;
+        else if(strcmp(argv[a],"--speed")==0 && a+1<argc)
+            Speed=atof(argv[++a]);
+        else if(strcmp(argv[a],"--dump")==0 && a+1<argc)
+            DumpFile=argv[++a];
+        else if(argv[a][0]!='-' && CaptureFile==NULL)
+            CaptureFile=argv[a];
+        else
+            break;
+    }
+    if(a!=argc || CaptureFile==NULL || Speed<=0)
+    {
+        fprintf(stderr,"Usage: %s [--rules File] [--realtime] "
+                "[--speed Factor] [--dump File] Capture\n",argv[0]);
+        return 2;
+    }
+
+    if(!HostStub_Init())
+    {
+        fprintf(stderr,"Failed to register the plugin\n");
+        return 2;
+    }
+
+    if(RulesFile!=NULL && !HostStub_LoadSettings(RulesFile,Settings))
+    {
+        fprintf(stderr,"Failed to load %s\n",RulesFile);
+        return 2;
+    }
+
+    if(!StreamCapture_OpenReader(&Reader,CaptureFile))
+    {
+        fprintf(stderr,"%s is not a capture file\n",CaptureFile);
+        return 2;
+    }
+
+    Dump=NULL;
+    if(DumpFile!=NULL)
+    {
+        Dump=fopen(DumpFile,"wb");
+        if(Dump==NULL)
+        {
+            fprintf(stderr,"Failed to open %s\n",DumpFile);
+            StreamCapture_CloseReader(&Reader);
+            return 2;
+        }
+    }
+
+    Con=HostStub_AllocConnection(Settings);
+    if(Con==NULL)
+    {
+        fprintf(stderr,"Failed to allocate a connection\n");
+        StreamCapture_CloseReader(&Reader);
+        if(Dump!=NULL)
+            fclose(Dump);
+        return 2;
+    }
+
+    Records=0;
+    Bytes=0;
+    Lost=0;
+    LastTimeUS=0;
+    Start=chrono::steady_clock::now();
+    while(StreamCapture_ReadRecord(&Reader,&Record,&Damaged))
+    {
+        if(Record.Type==STREAMCAPTURE_RECORD_LOST)
+        {
+            Lost+=Record.Len;
+            continue;
+        }
+
+        if(RealTime)
+        {
+            this_thread::sleep_until(Start+chrono::microseconds(
+                    (uint64_t)(Record.TimeUS/Speed)));
+        }
+
+        HostStub_Feed(Con,Record.Data,Record.Len);
+        if(Dump!=NULL)
+            fwrite(Record.Data,Record.Len,1,Dump);
+
+        Records++;
+        Bytes+=Record.Len;
+        LastTimeUS=Record.TimeUS;
+    }
+    Secs=chrono::duration<double>(chrono::steady_clock::now()-Start).count();
+
+    HostStub_GetCounters(Con,&Counters);
+    HostStub_FreeConnection(Con);
+    StreamCapture_CloseReader(&Reader);
+    if(Dump!=NULL)
+        fclose(Dump);
+
+    StartTime=Reader.StartTime/1000000;
+    printf("captured_at=%s",ctime(&StartTime));
+    printf("sessions=%u\n",Reader.Sessions);
+    printf("records=%llu bytes=%llu lost_bytes=%llu lines=%llu\n",
+            (unsigned long long)Records,(unsigned long long)Bytes,
+            (unsigned long long)Lost,(unsigned long long)Counters.Lines);
+    printf("capture_secs=%.3f replay_secs=%.3f mb_per_sec=%.2f\n",
+            LastTimeUS/1000000.0,Secs,Secs>0?Bytes/Secs/1000000.0:0.0);
+    printf("style_calls=%llu digest=%016llx\n",
+            (unsigned long long)Counters.StyleCalls,
+            (unsigned long long)Counters.StyleDigest);
+
+    if(Damaged)
+    {
+        fprintf(stderr,"The capture is damaged after %llu bytes\n",
+                (unsigned long long)Bytes);
+        return 1;
+    }
+
+    return 0;
+}